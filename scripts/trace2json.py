@@ -0,0 +1,107 @@
+#!/usr/bin/env python3
+#
+# Convert a binary trace dumped by the tracedump application (tracedump -o file)
+# into the Chrome trace event format, which can be opened in chrome://tracing
+# or https://ui.perfetto.dev
+#
+# Usage: trace2json.py <trace file> [<output json>]
+#
+
+import json
+import struct
+import sys
+
+EVENTS = [
+    "sched_switch", "irq_entry", "irq_exit", "softirq_entry", "softirq_exit",
+    "syscall_entry", "syscall_exit", "timer_expire", "page_alloc", "page_free",
+    "evtchn_send",
+]
+
+HEADER = struct.Struct("<8sIIII")
+RECORD = struct.Struct("<QHHIQ")
+
+# Tracks of a CPU in the output
+TRACK_THREAD, TRACK_IRQ, TRACK_SOFTIRQ, TRACK_SYSCALL, TRACK_EVENTS = range(5)
+TRACK_NAMES = ["thread", "irq", "softirq", "syscall", "events"]
+
+
+def load(path):
+    with open(path, "rb") as f:
+        data = f.read()
+
+    magic, version, freq, record_size, _ = HEADER.unpack_from(data, 0)
+    if magic != b"SO3TRACE" or version != 1 or record_size != RECORD.size:
+        sys.exit("%s: not a SO3 trace" % path)
+
+    records = [RECORD.unpack_from(data, off)
+               for off in range(HEADER.size, len(data) - RECORD.size + 1, RECORD.size)]
+
+    # The kernel returns the records CPU after CPU
+    records.sort(key=lambda r: r[0])
+
+    return freq, records
+
+
+def convert(freq, records):
+    out = []
+    t0 = records[0][0] if records else 0
+    running = {}
+
+    def us(ts):
+        return (ts - t0) * 1000000.0 / freq
+
+    def ev(ph, name, ts, cpu, track, args=None):
+        e = {"ph": ph, "name": name, "ts": us(ts), "pid": cpu, "tid": track}
+        if args is not None:
+            e["args"] = args
+        if ph == "i":
+            e["s"] = "t"
+        out.append(e)
+
+    for ts, event, cpu, a0, a1 in records:
+        name = EVENTS[event] if event < len(EVENTS) else "event%d" % event
+
+        if name == "sched_switch":
+            if cpu in running:
+                ev("E", "tid %d" % running[cpu], ts, cpu, TRACK_THREAD)
+            ev("B", "tid %d" % a1, ts, cpu, TRACK_THREAD, {"prev": a0})
+            running[cpu] = a1
+        elif name == "irq_entry":
+            ev("B", "irq %d" % a0, ts, cpu, TRACK_IRQ)
+        elif name == "irq_exit":
+            ev("E", "irq %d" % a0, ts, cpu, TRACK_IRQ)
+        elif name == "softirq_entry":
+            ev("B", "softirq %d" % a0, ts, cpu, TRACK_SOFTIRQ)
+        elif name == "softirq_exit":
+            ev("E", "softirq %d" % a0, ts, cpu, TRACK_SOFTIRQ)
+        elif name == "syscall_entry":
+            ev("B", "syscall %d" % a0, ts, cpu, TRACK_SYSCALL)
+        elif name == "syscall_exit":
+            ev("E", "syscall %d" % a0, ts, cpu, TRACK_SYSCALL, {"result": a1 - (1 << 64) if a1 >> 63 else a1})
+        else:
+            ev("i", name, ts, cpu, TRACK_EVENTS, {"a0": a0, "a1": hex(a1)})
+
+    for cpu in sorted({r[2] for r in records}):
+        out.append({"ph": "M", "name": "process_name", "pid": cpu, "args": {"name": "CPU %d" % cpu}})
+        for track, tname in enumerate(TRACK_NAMES):
+            out.append({"ph": "M", "name": "thread_name", "pid": cpu, "tid": track, "args": {"name": tname}})
+
+    return {"traceEvents": out, "displayTimeUnit": "ns"}
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.exit("Usage: %s <trace file> [<output json>]" % sys.argv[0])
+
+    freq, records = load(sys.argv[1])
+    trace = convert(freq, records)
+
+    if len(sys.argv) > 2:
+        with open(sys.argv[2], "w") as f:
+            json.dump(trace, f)
+    else:
+        json.dump(trace, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
@@ -57,6 +57,9 @@ void __div0(void) {
 
 void kernel_panic(void)
 {
+	/* Get the buffered log out before dying */
+	console_flush_emergency();
+
 	if (cpu_mode() == PSR_USR_MODE)
 		printk("%s: entering infinite loop...\n", __func__);
 	else {
@@ -77,6 +80,8 @@ void kernel_panic(void)
 
 void _bug(char *file, int line)
 {
+	console_flush_emergency();
+
 	lprintk("BUG in %s at line: %d\n", file, line);
 
 	kernel_panic();
@@ -226,7 +226,8 @@ void mmu_get_current_pgtable(addr_t *pgtable_paddr);
 
 void clear_l1pte(void *l1pgtable, addr_t vaddr);
 
-void mmu_switch(void *l1pgtable);
+struct pcb;
+void mmu_switch(struct pcb *pcb);
 
 void ramdev_create_mapping(void *root_pgtable, addr_t ramdev_start, addr_t ramdev_end);
 
@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2014-2022 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef SYSCALL_H
+#define SYSCALL_H
+
+/*
+ * Syscall arguments are taken from the saved user context (r0-r5),
+ * the syscall number from r7 and the address of errno from r10.
+ */
+#define SYSCALL_ARG(regs, n)		((regs)->r##n)
+#define SYSCALL_NR(regs)		((regs)->r7)
+#define SYSCALL_ERRNO_ADDR(regs)	((uint32_t *) (regs)->r10)
+
+#endif /* SYSCALL_H */
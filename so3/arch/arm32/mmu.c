@@ -492,10 +492,10 @@ void mmu_switch_kernel(void *pgtable_paddr) {
 /**
  * Switch memory context in the user space
  *
- * @param pgtable
+ * @param pcb	Process to be run
  */
-void mmu_switch(void *pgtable_paddr) {
-	mmu_switch_kernel(pgtable_paddr);
+void mmu_switch(struct pcb *pcb) {
+	mmu_switch_kernel((void *) __pa(pcb->pgtable));
 }
 
 /*
@@ -549,8 +549,10 @@ void duplicate_user_space(struct pcb *from, struct pcb *to) {
 					paddr = get_free_page();
 					BUG_ON(!paddr);
 
-					/* Add the new page to the process list */
-					add_page_to_proc(to, (page_t *) phys_to_page(paddr));
+					vaddr = (void *) pte_index_to_vaddr(i, j);
+
+					/* Add the new page to the process extents */
+					add_page_to_proc(to, (addr_t) vaddr, (page_t *) phys_to_page(paddr));
 
 					create_mapping(current_pgtable(), FIXMAP_MAPPING, paddr, PAGE_SIZE, false);
 
@@ -558,8 +560,6 @@ void duplicate_user_space(struct pcb *from, struct pcb *to) {
 
 					set_l2_pte_dcache(l2pte_dst, L2_DCACHE_WRITEALLOC);
 
-					vaddr = (void *) pte_index_to_vaddr(i, j);
-
 					memcpy((void *) FIXMAP_MAPPING, vaddr, PAGE_SIZE);
 
 				}
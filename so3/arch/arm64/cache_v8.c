@@ -91,6 +91,9 @@ void mmu_setup(void *pgtable)
 	/* For kernel mapping */
 	asm volatile("msr ttbr1_el1, %0" : : "r" (pgtable) : "memory");
 
+	/* The ASID of the user space processes is given by TTBR0 */
+	tcr &= ~TCR_A1;
+
 	asm volatile("msr tcr_el1, %0" : : "r" (tcr) : "memory");
 
 	asm volatile("msr mair_el1, %0" : : "r" (attr) : "memory");
@@ -160,6 +163,14 @@ void flush_pte_entry(addr_t va, u64 *pte) {
 
 }
 
+/*
+ * Make a PTE update visible to the table walker. The TLB entries are
+ * invalidated afterwards by the caller (for a whole range).
+ */
+void flush_pte_cache(u64 *pte) {
+	invalidate_dcache_range((u64) pte, (u64) (pte+1));
+}
+
 void dcache_enable(void)
 {
 	set_sctlr(get_sctlr() | CR_C);
@@ -94,6 +94,10 @@ void __setup_dom_pgtable(struct domain *d, addr_t paddr_start, unsigned long map
         /* Make sure that the size is 2 MB block aligned */
 	map_size = ALIGN_UP(map_size, SZ_2M);
 
+	/* A restored ME gets new tables; the previous ones may have been split (see S2_split_block()) */
+	if (d->pagetable_vaddr)
+		reset_root_pgtable((void *) d->pagetable_vaddr, true);
+
 	/* Initial L0 page table for the domain */
 	new_pt = new_root_pgtable();
 
@@ -109,7 +113,18 @@ void __setup_dom_pgtable(struct domain *d, addr_t paddr_start, unsigned long map
 	d->pagetable_paddr = __pa(new_pt);
 
 	/* Prepare the IPA -> PA translation for this domain */
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+	if (slotID >= MEMSLOT_BASE) {
+		/* Chunks which are not populated yet are mapped on the first access (see memslot_fault()) */
+		for (i = 0; i < map_size / ME_MEMCHUNK_SIZE; i++)
+			if (test_bit(i, memslot[slotID].populated))
+				__create_mapping(new_pt, memslot[slotID].ipa_addr + i * ME_MEMCHUNK_SIZE,
+						 paddr_start + i * ME_MEMCHUNK_SIZE, ME_MEMCHUNK_SIZE, false, S2);
+	} else
+		__create_mapping(new_pt, memslot[slotID].ipa_addr, paddr_start, map_size, false, S2);
+#else
 	__create_mapping(new_pt, memslot[slotID].ipa_addr, paddr_start, map_size, false, S2);
+#endif
      
         if (d->avz_shared->domID == DOMID_AGENCY)
                 do_ipamap(new_pt, linux_ipamap, ARRAY_SIZE(linux_ipamap));
@@ -22,11 +22,18 @@
 #include <asm/processor.h>
 
 void flush_pte_entry(addr_t va, u64 *pte);
+void flush_pte_cache(u64 *pte);
 
 void mmu_page_table_flush(unsigned long start, unsigned long end);
 
 void __asm_invalidate_tlb_all(void);
 void __asm_invalidate_tlb(addr_t va);
+void __asm_invalidate_tlb_range(addr_t start, addr_t end);
+void __asm_invalidate_tlb_asid(u64 asid);
+#ifdef CONFIG_ARM64VT
+void __asm_invalidate_tlb_guest(void);
+void __asm_invalidate_tlb_ipa(addr_t ipa);
+#endif
 void __asm_dcache_level(int level);
 void __asm_invalidate_dcache_range(addr_t start, addr_t end);
 void __asm_flush_dcache_range(addr_t start, addr_t end);
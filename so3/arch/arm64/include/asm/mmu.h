@@ -66,6 +66,9 @@
 #define ME_BASE 		UL(0x0000200000000000)
 #define ME_ID_SHIFT 		32
 
+/* Mapping of the whole ME memory chunk area (the first ME_BASE slot is not used by MEs) */
+#define MEMCHUNK_VADDR		ME_BASE
+
 #ifdef CONFIG_VA_BITS_48
 #define AGENCY_VOFFSET		UL(0x0000110000000000)
  
@@ -227,18 +230,28 @@ enum dcache_option {
 #define PTE_BLOCK_AF		(1UL << 10)
 #define PTE_BLOCK_NG		(1UL << 11)
 #define PTE_BLOCK_DBM		(1UL << 51)
+#define PTE_BLOCK_CONT		(1UL << 52)
 #define PTE_BLOCK_PXN		(1UL << 53)
 #define PTE_BLOCK_UXN		(1UL << 54)
 
+/*
+ * The contiguous bit is a hint that allows the PE to store blocks of 16 pages
+ * in the TLB. It is set by alloc_init_l3() on every run of 16 pages which is
+ * 64 KB aligned both in the virtual and the physical address space.
+ * The 16 PTEs must be kept consistent; the hint is removed from the whole
+ * group before one of them is changed.
+ */
+#define CONT_PTES		16
+#define CONT_PTE_SIZE		(CONT_PTES * PAGE_SIZE)
+#define CONT_PTE_MASK		(~(CONT_PTE_SIZE - 1))
+
 /*
  * Stage-1 and Stage-2 lower attributes.
- * FIXME: The upper attributes (contiguous hint and XN) are not currently in
- * use. If needed in the future, they should be shifted towards the lower word,
- * since the core uses unsigned long to pass the flags.
+ * FIXME: The upper attributes (XN) are not currently in use. If needed in the
+ * future, they should be shifted towards the lower word, since the core uses
+ * unsigned long to pass the flags.
  * An arch-specific typedef for the flags as well as the addresses would be
  * useful.
- * The contiguous bit is a hint that allows the PE to store blocks of 16 pages
- * in the TLB. This may be a useful optimisation.
  */
 
 /* These bits differ in stage 1 and 2 translations */
@@ -687,6 +700,7 @@ void __mmu_setup(void *pgtable);
 
 #ifdef CONFIG_ARM64VT
 void do_ipamap(void *pgtable, ipamap_t ipamap[], int nbelement);
+void S2_set_write_access(void *pgtable, addr_t ipa, size_t size, bool writable);
 #endif
 
 void *current_pgtable(void);
@@ -704,6 +718,11 @@ void mmu_setup(void *pgtable);
 void create_mapping(void *pgtable, addr_t virt_base, addr_t phys_base, size_t size, bool nocache);
 void release_mapping(void *pgtable, addr_t virt_base, size_t size);
 
+bool user_page_mapped(void *pgtable, addr_t vaddr);
+addr_t release_user_page(void *pgtable, addr_t vaddr);
+void set_user_page_prot(void *pgtable, addr_t vaddr, bool read, bool write, bool exec);
+void user_try_cont_hint(void *pgtable, addr_t vaddr);
+
 void *new_root_pgtable(void);
 
 #ifdef CONFIG_AVZ
@@ -715,7 +734,8 @@ void __mmu_switch_kernel(void *pgtable, bool vttbr);
 
 void create_mapping(void *pgtable, addr_t virt_base, addr_t phys_base, size_t size, bool nocache);
 
-void mmu_switch(void *pgtable_paddr);
+struct pcb;
+void mmu_switch(struct pcb *pcb);
 void mmu_switch_kernel(void *pgtable);
 
 void mmu_get_current_pgtable(addr_t *pgtable_paddr);
@@ -168,6 +168,14 @@
 /* Instruction specific syndrome */
 #define ESR_ISS(esr)		GET_FIELD((esr), 24, 0)
 
+/* Data abort ISS fields */
+#define ESR_ELx_WNR		(UL(1) << 6)
+#define ESR_ELx_S1PTW		(UL(1) << 7)
+#define ESR_ELx_FSC		(0x3F)
+#define ESR_ELx_FSC_TYPE	(0x3C)
+#define ESR_ELx_FSC_FAULT	(0x04)
+#define ESR_ELx_FSC_PERM	(0x0C)
+
 /*
  * PSR bits
  */
@@ -21,5 +21,13 @@
 
 typedef int(*syscall_handle_t)(unsigned long, unsigned long, unsigned long, unsigned long);
 
+/*
+ * Syscall arguments are taken from the saved user context (x0-x5),
+ * the syscall number from x8 and the address of errno from x9.
+ */
+#define SYSCALL_ARG(regs, n)		((regs)->x##n)
+#define SYSCALL_NR(regs)		((regs)->x8)
+#define SYSCALL_ERRNO_ADDR(regs)	((uint32_t *) (regs)->x9)
+
 
 #endif /* SYSCALL_H */
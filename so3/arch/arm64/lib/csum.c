@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <types.h>
+
+/*
+ * Internet checksum used by lwIP (LWIP_CHKSUM) on ARM64.
+ *
+ * Same contract as lwip_standard_chksum(): the non-inverted 16-bit one's
+ * complement sum of <len> bytes at any alignment, in the byte order of the
+ * data. The bulk is read as 64-bit words whose 32-bit halves are added into
+ * four 64-bit accumulators, which cannot overflow for any IP packet, so the
+ * carries need not be propagated in the loop.
+ */
+u16 arm64_inet_chksum(const void *dataptr, int len)
+{
+	const u8 *p = dataptr;
+	const u64 *pl;
+	u64 sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0, w0, w1, w2, w3;
+	u64 sum;
+	u16 t = 0;
+	int odd = ((addr_t) p & 1);
+
+	/* Get aligned to 16 bits; the result is byte-swapped at the end */
+	if (odd && (len > 0)) {
+		((u8 *) &t)[1] = *p++;
+		len--;
+	}
+
+	/* Then to 64 bits */
+	while (((addr_t) p & 7) && (len > 1)) {
+		sum0 += *(const u16 *) p;
+		p += 2;
+		len -= 2;
+	}
+
+	pl = (const u64 *) p;
+
+	while (len >= 32) {
+		w0 = pl[0];
+		w1 = pl[1];
+		w2 = pl[2];
+		w3 = pl[3];
+
+		sum0 += (w0 & 0xffffffff) + (w0 >> 32);
+		sum1 += (w1 & 0xffffffff) + (w1 >> 32);
+		sum2 += (w2 & 0xffffffff) + (w2 >> 32);
+		sum3 += (w3 & 0xffffffff) + (w3 >> 32);
+
+		pl += 4;
+		len -= 32;
+	}
+
+	while (len >= 8) {
+		w0 = *pl++;
+		sum0 += (w0 & 0xffffffff) + (w0 >> 32);
+		len -= 8;
+	}
+
+	p = (const u8 *) pl;
+
+	while (len > 1) {
+		sum0 += *(const u16 *) p;
+		p += 2;
+		len -= 2;
+	}
+
+	/* Left-over byte */
+	if (len > 0)
+		((u8 *) &t)[0] = *p;
+
+	sum = sum0 + sum1 + sum2 + sum3 + t;
+
+	/* Fold 64 bits to 16 bits */
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffff) + (sum >> 16);
+	sum = (sum & 0xffff) + (sum >> 16);
+
+	if (odd)
+		sum = ((sum & 0xff) << 8) | ((sum >> 8) & 0xff);
+
+	return (u16) sum;
+}
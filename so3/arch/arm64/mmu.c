@@ -26,6 +26,7 @@
 #include <sizes.h>
 #include <string.h>
 #include <process.h>
+#include <vma.h>
 
 #include <device/ramdev.h>
 #include <device/fdt.h>
@@ -39,6 +40,167 @@ void *current_pgtable(void) {
 	return __current_pgtable;
 }
 
+#ifndef CONFIG_AVZ
+
+/*
+ * Address space identifiers (ASID)
+ *
+ * The user space mappings are not global; their TLB entries are tagged
+ * with the ASID of the process given in TTBR0, so that switching from a
+ * process to another does not require to invalidate the TLBs.
+ *
+ * pcb->asid holds the ASID and, in the upper bits, the generation in which
+ * it has been allocated. When all ASIDs of a generation are used, a new
+ * generation starts: the bitmap is reset and each CPU invalidates its TLB
+ * before running a process with a new ASID. The ASIDs which are running on
+ * the CPUs at this time are kept (reserved) by their process.
+ * ASID #0 is never allocated (kernel and boot page table).
+ */
+
+#define ASID_MAX_BITS		16
+
+#define ASID_MASK		((1UL << asid_bits) - 1)
+#define ASID_FIRST_VERSION	(1UL << asid_bits)
+
+static unsigned int asid_bits;
+static u64 asid_generation;
+static u64 asid_map[(1 << ASID_MAX_BITS) / 64];
+static unsigned long asid_next;
+
+/* ASID of the process running on each CPU */
+static u64 active_asids[CONFIG_NR_CPUS];
+static u64 reserved_asids[CONFIG_NR_CPUS];
+static bool asid_flush_pending[CONFIG_NR_CPUS];
+
+static DEFINE_SPINLOCK(asid_lock);
+
+static inline u64 current_asid(void) {
+	return read_sysreg(ttbr0_el1) >> 48;
+}
+
+static void asid_init(void) {
+	u64 mmfr0 = read_sysreg(id_aa64mmfr0_el1);
+
+	/* The CPU supports 8-bit or 16-bit ASIDs (TCR_EL1.AS is set accordingly) */
+	asid_bits = ((((mmfr0 >> ID_AA64MMFR0_ASID_SHIFT) & 0xf) == 2) ? 16 : 8);
+
+	asid_generation = ASID_FIRST_VERSION;
+
+	asid_map[0] = 1;
+	asid_next = 1;
+}
+
+/* Find a free ASID, 0 if none */
+static unsigned long asid_find_free(void) {
+	unsigned long i, nr_words = (1UL << asid_bits) / 64;
+
+	for (i = asid_next / 64; i < nr_words; i++)
+		if (~asid_map[i])
+			return i * 64 + __builtin_ctzll(~asid_map[i]);
+
+	return 0;
+}
+
+/*
+ * Start a new generation; the ASIDs currently in use remain allocated.
+ */
+static void asid_new_generation(void) {
+	unsigned long asid;
+	int cpu;
+
+	asid_generation += ASID_FIRST_VERSION;
+
+	memset(asid_map, 0, sizeof(asid_map));
+	asid_map[0] = 1;
+	asid_next = 1;
+
+	for (cpu = 0; cpu < CONFIG_NR_CPUS; cpu++) {
+
+		/* A CPU which did not switch since the previous generation still runs its reserved ASID */
+		if (active_asids[cpu])
+			reserved_asids[cpu] = active_asids[cpu];
+
+		active_asids[cpu] = 0;
+
+		asid = reserved_asids[cpu] & ASID_MASK;
+		asid_map[asid / 64] |= 1UL << (asid % 64);
+
+		asid_flush_pending[cpu] = true;
+	}
+}
+
+/*
+ * Give an ASID of the current generation to a process.
+ */
+static u64 asid_new_context(pcb_t *pcb) {
+	unsigned long asid = pcb->asid & ASID_MASK;
+	bool reserved = false;
+	int cpu;
+
+	if (asid) {
+		/* The process was running when the generation changed */
+		for (cpu = 0; cpu < CONFIG_NR_CPUS; cpu++)
+			if (reserved_asids[cpu] == pcb->asid) {
+				reserved_asids[cpu] = asid_generation | asid;
+				reserved = true;
+			}
+
+		if (reserved)
+			return asid_generation | asid;
+
+		/* Try to keep the same ASID */
+		if (!(asid_map[asid / 64] & (1UL << (asid % 64)))) {
+			asid_map[asid / 64] |= 1UL << (asid % 64);
+			return asid_generation | asid;
+		}
+	}
+
+	asid = asid_find_free();
+	if (!asid) {
+		asid_new_generation();
+
+		asid = asid_find_free();
+		BUG_ON(!asid);
+	}
+
+	asid_map[asid / 64] |= 1UL << (asid % 64);
+	asid_next = asid + 1;
+
+	return asid_generation | asid;
+}
+
+/*
+ * Get the ASID of a process which is about to run on this CPU and
+ * invalidate the local TLB if a new generation has started.
+ */
+static u64 asid_switch(pcb_t *pcb) {
+	unsigned long flags;
+	int cpu = smp_processor_id();
+	u64 asid;
+
+	flags = spin_lock_irqsave(&asid_lock);
+
+	if (!asid_bits)
+		asid_init();
+
+	if ((pcb->asid ^ asid_generation) >> asid_bits)
+		pcb->asid = asid_new_context(pcb);
+
+	if (asid_flush_pending[cpu]) {
+		flush_tlb_all();
+		asid_flush_pending[cpu] = false;
+	}
+
+	active_asids[cpu] = pcb->asid;
+	asid = pcb->asid & ASID_MASK;
+
+	spin_unlock_irqrestore(&asid_lock, flags);
+
+	return asid;
+}
+
+#endif /* !CONFIG_AVZ */
+
 /**
  * Retrieve the current physical address of the page table
  *
@@ -52,10 +214,83 @@ void mmu_get_current_pgtable(addr_t *pgtable_paddr) {
 	*pgtable_paddr = cpu_get_ttbr1();
 }
 
+/*
+ * Remove the contiguous hint of the group of 16 PTEs containing @l3pte
+ * before one of them is changed. The group is invalidated first
+ * (break-before-make) since the TLB may hold a single entry for it.
+ */
+static void clear_cont_hint(u64 *l3pte, addr_t vaddr)
+{
+	u64 *first;
+	u64 ptes[CONT_PTES];
+	int i;
+
+	if (!(*l3pte & PTE_BLOCK_CONT))
+		return ;
+
+	first = l3pte - (l3pte_index(vaddr) & (CONT_PTES - 1));
+	vaddr &= CONT_PTE_MASK;
+
+	for (i = 0; i < CONT_PTES; i++) {
+		ptes[i] = first[i] & ~PTE_BLOCK_CONT;
+		first[i] = 0;
+		flush_pte_entry(vaddr + i * PAGE_SIZE, &first[i]);
+	}
+
+	for (i = 0; i < CONT_PTES; i++) {
+		first[i] = ptes[i];
+		flush_pte_entry(vaddr + i * PAGE_SIZE, &first[i]);
+	}
+}
+
+/*
+ * Replace a 2 MB block by a L3 page table mapping the same range, so that
+ * a single page of it can be changed. The pages keep the attributes of
+ * the block and the contiguous hint.
+ */
+static void split_l2_block(u64 *l2pte, addr_t vaddr, mmu_stage_t stage)
+{
+	u64 *l3pgtable;
+	u64 block, attrs;
+	int i;
+
+	block = *l2pte;
+	attrs = (block & ~TTB_L2_BLOCK_ADDR_MASK & ~PTE_TYPE_MASK) | PTE_TYPE_PAGE | PTE_BLOCK_CONT;
+
+	l3pgtable = (u64 *) memalign(TTB_L3_SIZE, PAGE_SIZE);
+	BUG_ON(!l3pgtable);
+
+	for (i = 0; i < TTB_L3_ENTRIES; i++)
+		l3pgtable[i] = ((block & TTB_L2_BLOCK_ADDR_MASK) + i * PAGE_SIZE) | attrs;
+
+	mmu_page_table_flush((addr_t) l3pgtable, (addr_t) (l3pgtable + TTB_L3_ENTRIES));
+
+	vaddr &= BLOCK_2M_MASK;
+
+	*l2pte = 0;
+	flush_pte_entry(vaddr, l2pte);
+
+	*l2pte = __pa((addr_t) l3pgtable) & TTB_L2_TABLE_ADDR_MASK;
+
+#ifdef CONFIG_ARM64VT
+	if (stage == S1)
+		set_pte_table(l2pte, DCACHE_WRITEALLOC);
+	else
+		set_pte_table_S2(l2pte, DCACHE_WRITEALLOC);
+#else
+	set_pte_table(l2pte, DCACHE_WRITEALLOC);
+#endif
+
+	flush_pte_entry(vaddr, l2pte);
+
+	DBG("Split the 2 MB block at %lx into a L3 page table at %p\n", vaddr, l3pgtable);
+}
+
 static void alloc_init_l3(u64 *l0pgtable, addr_t addr, addr_t end, addr_t phys, bool nocache, mmu_stage_t stage)
 {
 	u64 *l1pte, *l2pte, *l3pte;
 	u64 *l3pgtable;
+	addr_t cont_end = 0;
 
 #ifdef CONFIG_VA_BITS_48
 	u64 *l0pte;
@@ -98,10 +333,23 @@ static void alloc_init_l3(u64 *l0pgtable, addr_t addr, addr_t end, addr_t phys,
 #endif
 
 			DBG("Allocating a L3 page table at %p in l2pte: %p with contents: %lx\n", l3pgtable, l2pte, *l2pte);
+
+		} else if (pte_type(l2pte) == PTE_TYPE_BLOCK) {
+			/* Part of a 2 MB block is re-mapped */
+			split_l2_block(l2pte, addr, stage);
 		}
 
+		/* A run of 16 pages aligned on 64 KB in both address spaces
+		 * can be held by a single TLB entry.
+		 */
+		if (!((addr | phys) & ~CONT_PTE_MASK) && (end - addr >= CONT_PTE_SIZE))
+			cont_end = addr + CONT_PTE_SIZE;
+
 		l3pte = l3pte_offset(l2pte, addr);
 
+		if (addr >= cont_end)
+			clear_cont_hint(l3pte, addr);
+
 		*l3pte = phys & TTB_L3_PAGE_ADDR_MASK;
 
 #ifdef CONFIG_ARM64VT
@@ -112,10 +360,14 @@ static void alloc_init_l3(u64 *l0pgtable, addr_t addr, addr_t end, addr_t phys,
 #else
 		set_pte_page(l3pte, (nocache ? DCACHE_OFF : DCACHE_WRITEALLOC));
 
-		/* Set AP[1] bit 6 to 1 to make R/W/Executable the pages in user space */
+		/* Set AP[1] bit 6 to 1 to make R/W/Executable the pages in user space;
+		 * user pages are not global, their TLB entries are tagged with the ASID.
+		 */
 		if ((addr != phys) && user_space_vaddr(addr))
-			*l3pte |= PTE_BLOCK_AP1;
+			*l3pte |= PTE_BLOCK_AP1 | PTE_BLOCK_NG;
 #endif
+		if (addr < cont_end)
+			*l3pte |= PTE_BLOCK_CONT;
 
 		DBG("Allocating a 4 KB page at l2pte: %p content: %lx\n", l3pte, *l3pte);
 
@@ -202,7 +454,7 @@ static void alloc_init_l2(u64 *l0pgtable, addr_t addr, addr_t end, addr_t phys,
 			 */
 
 			if ((addr != phys) && user_space_vaddr(addr))
-				*l2pte |= PTE_BLOCK_AP1;
+				*l2pte |= PTE_BLOCK_AP1 | PTE_BLOCK_NG;
 #endif
 			DBG("Allocating a 2 MB block at l2pte: %p content: %lx\n", l2pte, *l2pte);
 
@@ -274,7 +526,7 @@ static void alloc_init_l1(u64 *l0pgtable, addr_t addr, addr_t end, addr_t phys,
 			
 			/* Set AP[1] bit 6 to 1 to make R/W/Executable the pages in user space */
 			if ((addr != phys) && user_space_vaddr(addr))
-				*l1pte |= PTE_BLOCK_AP1;
+				*l1pte |= PTE_BLOCK_AP1 | PTE_BLOCK_NG;
 #endif
 
 			DBG("Allocating a 1 GB block at l1pte: %p content: %lx\n", l1pte, *l1pte);
@@ -374,7 +626,7 @@ static void __create_mapping(void *l1pgtable, addr_t virt_base, addr_t phys_base
 
 			/* Set AP[1] bit 6 to 1 to make R/W/Executable the pages in user space */
 			if ((addr != phys) && user_space_vaddr(addr))
-				*l1pte |= PTE_BLOCK_AP1;
+				*l1pte |= PTE_BLOCK_AP1 | PTE_BLOCK_NG;
 
 			DBG("Allocating a 1 GB block at l1pte: %p content: %lx\n", l1pte, *l1pte);
 
@@ -415,12 +667,35 @@ static bool empty_table(void *pgtable) {
 	return true;
 }
 
+/* Above this number of pages, a range is not invalidated page by page */
+#define TLBI_RANGE_MAX_PAGES	64
+
+/*
+ * Invalidate the TLB entries of [start, end[ mapped by @pgtable.
+ * A large range of the running process is invalidated with its ASID only.
+ */
+static void flush_tlb_range(void *pgtable, addr_t start, addr_t end)
+{
+	if (end <= start)
+		return ;
+
+	if (((end - start) >> PAGE_SHIFT) <= TLBI_RANGE_MAX_PAGES)
+		__asm_invalidate_tlb_range(start, end);
+#ifndef CONFIG_AVZ
+	else if (user_space_vaddr(start) && (pgtable == current_pgtable()))
+		__asm_invalidate_tlb_asid(current_asid());
+#endif
+	else
+		__asm_invalidate_tlb_all();
+}
+
 void release_mapping(void *pgtable, addr_t vaddr, size_t size) {
 #ifdef CONFIG_VA_BITS_48
 	uint64_t *l0pte;
 #endif
 	uint64_t *l1pte, *l2pte, *l3pte;
 	size_t free_size = 0;
+	addr_t start;
 
 	/* If pgtable is NULL, we consider the system page table */
 	if (pgtable == NULL)
@@ -429,20 +704,22 @@ void release_mapping(void *pgtable, addr_t vaddr, size_t size) {
 	vaddr = vaddr & PAGE_MASK;
 	size = ALIGN_UP(size + (vaddr & ~PAGE_MASK), PAGE_SIZE);
 
+	start = vaddr;
+
 	while (free_size < size) {
 
 #ifdef CONFIG_VA_BITS_48
 		l0pte = l0pte_offset(pgtable, vaddr);
 		if (!*l0pte)
 			/* Already free */
-			return ;
+			goto out;
 
 		l1pte = l1pte_offset(l0pte, vaddr);
 #elif CONFIG_VA_BITS_39
 		l1pte = l1pte_offset(pgtable, vaddr);
 		if (!*l1pte)
 			/* Already free */
-			return ;
+			goto out;
 #else
 #error "Wrong VA_BITS configuration."
 #endif
@@ -452,7 +729,7 @@ void release_mapping(void *pgtable, addr_t vaddr, size_t size) {
 		if (pte_type(l1pte) == PTE_TYPE_BLOCK) {
                         
                         *l1pte = 0;
-                        flush_pte_entry(vaddr, l1pte);
+                        flush_pte_cache(l1pte);
 
 			free_size += SZ_1G;
 			vaddr += SZ_1G;
@@ -471,7 +748,7 @@ void release_mapping(void *pgtable, addr_t vaddr, size_t size) {
                         if (pte_type(l2pte) == PTE_TYPE_BLOCK) {
                                
                                 *l2pte = 0;
-                                flush_pte_entry(vaddr, l2pte);
+                                flush_pte_cache(l2pte);
 
                                 free_size += SZ_2M;
                                 vaddr += SZ_2M;
@@ -482,9 +759,11 @@ void release_mapping(void *pgtable, addr_t vaddr, size_t size) {
 				BUG_ON(pte_type(l2pte) != PTE_TYPE_TABLE);
 				l3pte = l3pte_offset(l2pte, vaddr);
 				BUG_ON(!*l3pte);
-				
+
+				clear_cont_hint(l3pte, vaddr);
+
 				*l3pte = 0;
-				flush_pte_entry(vaddr, l3pte);
+				flush_pte_cache(l3pte);
 
 				free_size += PAGE_SIZE;
 				vaddr += PAGE_SIZE;
@@ -495,6 +774,10 @@ void release_mapping(void *pgtable, addr_t vaddr, size_t size) {
 		}
 	}
 
+out:
+	/* The TLBs are invalidated once for the whole range */
+	flush_tlb_range(pgtable, start, vaddr);
+
 	if (empty_table(pgtable))
 		free(pgtable);
 }
@@ -600,6 +883,15 @@ void reset_root_pgtable(void *pgtable, bool remove) {
 #error "Wrong VA_BITS configuration."
 #endif
 
+	/* Along an exec(), the process keeps its ASID; its entries are stale now */
+	if (pgtable == current_pgtable()) {
+#ifndef CONFIG_AVZ
+		__asm_invalidate_tlb_asid(current_asid());
+#else
+		__asm_invalidate_tlb_all();
+#endif
+	}
+
 	if (remove)
 		free(pgtable);
 }
@@ -728,16 +1020,29 @@ void mmu_switch_kernel(void *pgtable) {
 
 /**
  * Switch memory context in the user space range of EL1.
+ * The TLB entries of the other processes are kept thanks to their ASID.
  *
- * @param pgtable
+ * @param pcb	Process to be run
  */
-void mmu_switch(void *pgtable_paddr) {
+void mmu_switch(pcb_t *pcb) {
+#ifndef CONFIG_AVZ
+	u64 asid;
+
+	asid = asid_switch(pcb);
+
 	flush_dcache_all();
 
-	__mmu_switch_ttbr0(pgtable_paddr);
+	__mmu_switch_ttbr0((void *) (__pa(pcb->pgtable) | (asid << 48)));
+
+	invalidate_icache_all();
+#else
+	flush_dcache_all();
+
+	__mmu_switch_ttbr0((void *) __pa(pcb->pgtable));
 
 	invalidate_icache_all();
 	__asm_invalidate_tlb_all();
+#endif
 }
 
 /*
@@ -816,6 +1121,9 @@ void duplicate_pgtable_entry(u64 *from, u64 *to, int level, u64 vaddr, pcb_t *pc
 	u64 i;
 	int ttb_entries, size;
 	u64 paddr_to, __vaddr;
+#ifdef CONFIG_VMA
+	vma_t *vma;
+#endif
 
 	if (level < 3) {
 
@@ -839,6 +1147,12 @@ void duplicate_pgtable_entry(u64 *from, u64 *to, int level, u64 vaddr, pcb_t *pc
 
 		for (i = 0; i < ttb_entries; i++) {
 
+			/* Blocks only map device memory, which is shared */
+			if (from[i] && (pte_type(&from[i]) == PTE_TYPE_BLOCK)) {
+				to[i] = from[i];
+				continue;
+			}
+
 			if (from[i]) {
 				__from = (u64 *) __va(from[i] & mask);
 
@@ -875,28 +1189,45 @@ void duplicate_pgtable_entry(u64 *from, u64 *to, int level, u64 vaddr, pcb_t *pc
 
 				__vaddr = vaddr + (i << TTB_I3_SHIFT);
 
+#ifdef CONFIG_VMA
+				/* Pages of a shared area refer to the same frame in both processes */
+				vma = vma_find(pcb_to, __vaddr);
+
+				/* The area is left empty in the child */
+				if (vma && (vma->flags & VMA_DONTCOPY))
+					continue;
+
+				if (vma && (vma->flags & VMA_SHARED)) {
+					to[i] = from[i];
+
+					if (!(vma->flags & VMA_IO))
+						add_page_to_proc(pcb_to, __vaddr, phys_to_page(from[i] & TTB_L3_PAGE_ADDR_MASK));
+
+					continue;
+				}
+#endif /* CONFIG_VMA */
+
 				/* Get a new free page */
 				paddr_to = get_free_page();
 				BUG_ON(!paddr_to);
 
-				to[i] = (from[i] & ~TTB_L3_PAGE_ADDR_MASK) | (paddr_to & TTB_L3_PAGE_ADDR_MASK);
-
-				/* Add the new page to the process list */
-				add_page_to_proc(pcb_to, (page_t *) phys_to_page(paddr_to));
+				/* The new frames are not necessarily contiguous */
+				to[i] = (from[i] & ~(TTB_L3_PAGE_ADDR_MASK | PTE_BLOCK_CONT)) | (paddr_to & TTB_L3_PAGE_ADDR_MASK);
 
-				create_mapping(NULL, FIXMAP_MAPPING, paddr_to, PAGE_SIZE, false);
+				/* Add the new page to the process extents */
+				add_page_to_proc(pcb_to, __vaddr, (page_t *) phys_to_page(paddr_to));
 
-				memcpy((void *) FIXMAP_MAPPING, (void *) __vaddr, PAGE_SIZE);
+				/* The frame is reachable through the linear mapping */
+				memcpy((void *) __va(paddr_to), (void *) __vaddr, PAGE_SIZE);
 			}
 
 		}
-		release_mapping(current_pgtable(), FIXMAP_MAPPING, PAGE_SIZE);
 	}
 }
 
 /**
  * Duplicate the user space along a fork syscall.
- * User space is mapped with 4 KB page only.
+ * The process pages are mapped with 4 KB pages; blocks only map devices.
  *
  *
  * @param from	Origin L0 pagetable
@@ -914,6 +1245,145 @@ void duplicate_user_space(pcb_t *from, pcb_t *to) {
 #endif
 }
 
+/*
+ * Get the L3 PTE of a user space page, or NULL if no page table
+ * covers this address. A 2 MB block is split into pages.
+ */
+static u64 *user_l3pte(void *pgtable, addr_t vaddr) {
+#ifdef CONFIG_VA_BITS_48
+	u64 *l0pte;
+#endif
+	u64 *l1pte, *l2pte;
+
+#ifdef CONFIG_VA_BITS_48
+	l0pte = l0pte_offset(pgtable, vaddr);
+	if (!*l0pte)
+		return NULL;
+
+	l1pte = l1pte_offset(l0pte, vaddr);
+#elif CONFIG_VA_BITS_39
+	l1pte = l1pte_offset(pgtable, vaddr);
+#else
+#error "Wrong VA_BITS configuration."
+#endif
+	if (!*l1pte)
+		return NULL;
+
+	BUG_ON(pte_type(l1pte) != PTE_TYPE_TABLE);
+
+	l2pte = l2pte_offset(l1pte, vaddr);
+	if (!*l2pte)
+		return NULL;
+
+	/* A device may be mapped with 2 MB blocks */
+	if (pte_type(l2pte) == PTE_TYPE_BLOCK)
+		split_l2_block(l2pte, vaddr, S1);
+
+	return l3pte_offset(l2pte, vaddr);
+}
+
+/**
+ * Check if a user space page is currently mapped.
+ */
+bool user_page_mapped(void *pgtable, addr_t vaddr) {
+	u64 *l3pte = user_l3pte(pgtable, vaddr);
+
+	return (l3pte && *l3pte);
+}
+
+/**
+ * Set the access permissions of a user space page which is mapped.
+ * A page without any access remains accessible from the kernel only.
+ */
+void set_user_page_prot(void *pgtable, addr_t vaddr, bool read, bool write, bool exec) {
+	u64 *l3pte;
+
+	vaddr &= PAGE_MASK;
+
+	l3pte = user_l3pte(pgtable, vaddr);
+	if (!l3pte || !*l3pte)
+		return ;
+
+	clear_cont_hint(l3pte, vaddr);
+
+	*l3pte &= ~(PTE_BLOCK_AP1 | PTE_BLOCK_AP2 | PTE_BLOCK_UXN);
+
+	/* AP[1] gives the access to EL0, AP[2] makes the page read-only */
+	if (read || write)
+		*l3pte |= PTE_BLOCK_AP1;
+	if (!write)
+		*l3pte |= PTE_BLOCK_AP2;
+	if (!exec)
+		*l3pte |= PTE_BLOCK_UXN;
+
+	flush_pte_entry(vaddr, l3pte);
+}
+
+/**
+ * Unmap a user space page. The intermediate page tables are kept since
+ * the region is likely to be populated again.
+ *
+ * @return	the physical address of the frame which was mapped, 0 if none
+ */
+addr_t release_user_page(void *pgtable, addr_t vaddr) {
+	u64 *l3pte;
+	addr_t paddr;
+
+	vaddr &= PAGE_MASK;
+
+	l3pte = user_l3pte(pgtable, vaddr);
+	if (!l3pte || !*l3pte)
+		return 0;
+
+	clear_cont_hint(l3pte, vaddr);
+
+	paddr = *l3pte & TTB_L3_PAGE_ADDR_MASK;
+
+	*l3pte = 0;
+	flush_pte_entry(vaddr, l3pte);
+
+	return paddr;
+}
+
+/**
+ * Set the contiguous hint on the group of 16 pages containing @vaddr once
+ * all of them are mapped on contiguous frames with the same attributes.
+ * It is used for the regions populated page by page (heap, mmap areas),
+ * which mostly get consecutive frames.
+ */
+void user_try_cont_hint(void *pgtable, addr_t vaddr) {
+	u64 *l3pte, *first;
+	u64 ptes[CONT_PTES];
+	int i;
+
+	l3pte = user_l3pte(pgtable, vaddr);
+	if (!l3pte || !*l3pte || (*l3pte & PTE_BLOCK_CONT))
+		return ;
+
+	first = l3pte - (l3pte_index(vaddr) & (CONT_PTES - 1));
+
+	if ((first[0] & TTB_L3_PAGE_ADDR_MASK) & ~CONT_PTE_MASK)
+		return ;
+
+	for (i = 1; i < CONT_PTES; i++)
+		if (first[i] != first[0] + i * PAGE_SIZE)
+			return ;
+
+	vaddr &= CONT_PTE_MASK;
+
+	/* Break-before-make on the whole group */
+	for (i = 0; i < CONT_PTES; i++) {
+		ptes[i] = first[i] | PTE_BLOCK_CONT;
+		first[i] = 0;
+		flush_pte_entry(vaddr + i * PAGE_SIZE, &first[i]);
+	}
+
+	for (i = 0; i < CONT_PTES; i++) {
+		first[i] = ptes[i];
+		flush_pte_entry(vaddr + i * PAGE_SIZE, &first[i]);
+	}
+}
+
 #ifdef CONFIG_RAMDEV
 void ramdev_create_mapping(void *root_pgtable, addr_t ramdev_start, addr_t ramdev_end) {
 
@@ -1003,6 +1473,129 @@ void do_ipamap(void *pgtable, ipamap_t ipamap[], int nbelement) {
 
 }
 
+/**
+ * Split a stage-2 block entry into a next level page table made of
+ * smaller blocks (L1 -> L2) or pages (L2 -> L3) with the same attributes.
+ *
+ * The guest may be running on another CPU, so the live block entry follows
+ * the break-before-make sequence: it is invalidated and its TLB entries are
+ * discarded before the table entry is installed.
+ * The new table is released along with the other tables of the domain
+ * by reset_root_pgtable().
+ *
+ * @param pte	L1 or L2 block entry
+ * @param level	level of <pte>
+ * @param ipa	IPA within the block
+ */
+static void S2_split_block(u64 *pte, int level, addr_t ipa) {
+	u64 *pgtable;
+	u64 attrs, phys, desc_type;
+	size_t step;
+	int i;
+
+	if (level == 1) {
+		phys = *pte & TTB_L1_BLOCK_ADDR_MASK;
+		attrs = *pte & ~(TTB_L1_BLOCK_ADDR_MASK | PTE_TYPE_MASK);
+		step = SZ_2M;
+		desc_type = PTE_TYPE_BLOCK;
+	} else {
+		phys = *pte & TTB_L2_BLOCK_ADDR_MASK;
+		attrs = *pte & ~(TTB_L2_BLOCK_ADDR_MASK | PTE_TYPE_MASK);
+		step = PAGE_SIZE;
+		desc_type = PTE_TYPE_PAGE;
+	}
+
+	pgtable = (u64 *) memalign(TTB_L3_SIZE, PAGE_SIZE);
+	BUG_ON(!pgtable);
+
+	for (i = 0; i < TTB_L3_ENTRIES; i++)
+		pgtable[i] = (phys + i * step) | attrs | desc_type;
+
+	mmu_page_table_flush((addr_t) pgtable, (addr_t) (pgtable + TTB_L3_ENTRIES));
+
+	/* Break */
+	*pte = 0;
+	__asm_flush_dcache_range((addr_t) pte, (addr_t) (pte + 1));
+
+	__asm_invalidate_tlb_ipa(ipa & ((level == 1) ? BLOCK_1G_MASK : BLOCK_2M_MASK));
+
+	/* Make */
+	*pte = (__pa((addr_t) pgtable) & TTB_L2_TABLE_ADDR_MASK) | PTE_TYPE_TABLE;
+
+	__asm_flush_dcache_range((addr_t) pte, (addr_t) (pte + 1));
+	isb();
+}
+
+/**
+ * Get the stage-2 L3 entry which maps an IPA. Blocks are split on the way
+ * so that the IPA is always mapped by a 4 KB page.
+ *
+ * @param pgtable	stage-2 root page table of the domain
+ * @param ipa		IPA to look for
+ * @return the L3 entry or NULL if the IPA is not mapped
+ */
+static u64 *S2_l3pte(void *pgtable, addr_t ipa) {
+#ifdef CONFIG_VA_BITS_48
+	u64 *l0pte;
+#endif
+	u64 *l1pte, *l2pte;
+
+#ifdef CONFIG_VA_BITS_48
+	l0pte = l0pte_offset(pgtable, ipa);
+	if (!*l0pte)
+		return NULL;
+
+	l1pte = l1pte_offset(l0pte, ipa);
+#elif CONFIG_VA_BITS_39
+	l1pte = l1pte_offset(pgtable, ipa);
+#else
+#error "Wrong VA_BITS configuration."
+#endif
+	if (!*l1pte)
+		return NULL;
+
+	if (pte_type(l1pte) == PTE_TYPE_BLOCK)
+		S2_split_block(l1pte, 1, ipa);
+
+	l2pte = l2pte_offset(l1pte, ipa);
+	if (!*l2pte)
+		return NULL;
+
+	if (pte_type(l2pte) == PTE_TYPE_BLOCK)
+		S2_split_block(l2pte, 2, ipa);
+
+	return l3pte_offset(l2pte, ipa);
+}
+
+/**
+ * Change the guest write permission of an IPA range in the stage-2 page table.
+ * The range is remapped with 4 KB pages if necessary.
+ *
+ * The caller is responsible for the TLB invalidation (typically
+ * with __asm_invalidate_tlb_guest() once a batch of pages is processed).
+ *
+ * @param pgtable	stage-2 root page table of the domain
+ * @param ipa		start of the range
+ * @param size		size of the range
+ * @param writable	true to grant write access, false to make the range read-only
+ */
+void S2_set_write_access(void *pgtable, addr_t ipa, size_t size, bool writable) {
+	addr_t end = ipa + size;
+	u64 *l3pte;
+
+	for (ipa &= PAGE_MASK; ipa < end; ipa += PAGE_SIZE) {
+		l3pte = S2_l3pte(pgtable, ipa);
+		BUG_ON(!l3pte || !*l3pte);
+
+		if (writable)
+			*l3pte |= S2_PTE_ACCESS_RW;
+		else
+			*l3pte = (*l3pte & ~S2_PTE_ACCESS_RW) | S2_PTE_ACCESS_RO;
+
+		__asm_flush_dcache_range((addr_t) l3pte, (addr_t) (l3pte + 1));
+	}
+}
+
 #endif /* CONFIG_AVZ */
 
 #endif
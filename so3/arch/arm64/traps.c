@@ -32,10 +32,13 @@
 
 #ifdef CONFIG_SOO
 #include <soo/uapi/soo.h>
+
+#include <avz/capsule.h>
 #endif /* CONFIG_SOO */
 
 #else /* CONFIG_AVZ */
 #include <syscall.h>
+#include <process.h>
 #endif /* !CONFIG_AVZ */
 
 #include <asm/processor.h>
@@ -129,13 +132,50 @@ extern addr_t cpu_entrypoint;
 int dabt_handle(cpu_regs_t *regs, unsigned long esr) {
 
 #ifdef CONFIG_AVZ
+
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+	/* First access to a chunk of ME memory */
+	if (memslot_fault(current_domain, esr))
+		return 0;
+#endif
+
+#ifdef CONFIG_SOO
+	/* Write access to a page write-protected by a pre-copy migration */
+	if (precopy_dabt(current_domain, esr))
+		return 0;
+#endif
         return mmio_dabt_decode(regs, esr);
 #else
+#ifdef CONFIG_DEMAND_PAGING
+	/* First access to a page of the user heap or stacks */
+	if ((esr & ESR_ELx_FSC_TYPE) == ESR_ELx_FSC_FAULT)
+		return proc_demand_page(read_sysreg(far_el1));
+#endif
+
         return -1;
 #endif
 
 }
 
+#ifndef CONFIG_AVZ
+/**
+ * Synchronous exception raised by the kernel itself. The only recoverable
+ * case is an access to a user page which is not populated yet, typically
+ * when a syscall reads or writes a user buffer located in the heap.
+ *
+ * @param regs	Pointer to the stack frame
+ */
+void trap_handle_el1(cpu_regs_t *regs) {
+	unsigned long esr = read_sysreg(esr_el1);
+
+	if ((ESR_ELx_EC(esr) == ESR_ELx_EC_DABT_CUR) && !dabt_handle(regs, esr))
+		return ;
+
+	trap_handle_error(regs->lr);
+	kernel_panic();
+}
+#endif /* !CONFIG_AVZ */
+
 /**
  * This is the entry point for all exceptions currently managed by SO3.
  * 
@@ -147,10 +187,6 @@ int dabt_handle(cpu_regs_t *regs, unsigned long esr) {
 typedef void(*vector_fn_t)(cpu_regs_t *);
 
 void trap_handle(cpu_regs_t *regs) {
-#ifndef CONFIG_AVZ
-	syscall_args_t sys_args;
-#endif
-
 #ifdef CONFIG_ARM64VT
 
 	unsigned long esr = read_sysreg(esr_el2);
@@ -168,9 +204,29 @@ void trap_handle(cpu_regs_t *regs) {
 
 	case ESR_ELx_EC_DABT_LOW:
 
+#ifdef CONFIG_AVZ
                 dabt_handle(regs, esr);
+#else
+		if (dabt_handle(regs, esr) < 0) {
+			lprintk("### On CPU %d: user data abort at 0x%lx (pc: 0x%lx)\n", smp_processor_id(), read_sysreg(far_el1), regs->pc);
+			trap_handle_error(regs->lr);
+			kernel_panic();
+		}
+#endif
                 break;
 
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+	case ESR_ELx_EC_IABT_LOW:
+
+		/* Instruction fetch in a chunk of ME memory which is not populated yet */
+		if (memslot_fault(current_domain, esr))
+			break;
+
+		lprintk("### On CPU %d: instruction abort at IPA 0x%lx\n", smp_processor_id(), read_sysreg(hpfar_el2) << 8);
+		trap_handle_error(regs->lr);
+		kernel_panic();
+#endif
+
         /* SVC used for syscalls */
 	case ESR_ELx_EC_SVC64:
 
@@ -180,15 +236,8 @@ void trap_handle(cpu_regs_t *regs) {
 
 #else /* CONFIG_AVZ */
 
-		sys_args.args[0] = regs->x0;
-		sys_args.args[1] = regs->x1;
-		sys_args.args[2] = regs->x2;
-		sys_args.args[3] = regs->x3;
-		sys_args.args[4] = regs->x4;
-		sys_args.args[5] = regs->x5;
-
 		local_irq_enable();
-		regs->x0 = syscall_handle(&sys_args);
+		regs->x0 = syscall_handle(regs);
 		local_irq_disable();
 
 #endif /* !CONFIG_AVZ */
@@ -26,4 +26,10 @@ void inject_me(avz_hyp_t *args);
 void read_ME_snapshot(avz_hyp_t *args);
 void write_ME_snapshot(avz_hyp_t *args);
 
+struct domain;
+
+void precopy_op(avz_hyp_t *args);
+bool precopy_dabt(struct domain *d, unsigned long esr);
+void precopy_release(struct domain *d);
+
 #endif /* AVZ_CAPSULE_H */
\ No newline at end of file
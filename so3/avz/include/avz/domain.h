@@ -133,6 +133,9 @@ struct domain {
 
 	/* Hypervisor stack for this domain */
 	void *domain_stack;
+
+	/* Dirty page tracking during a pre-copy migration (NULL otherwise) */
+	struct dirty_log *dirty_log;
 };
 
 #define USE_NORMAL_PGTABLE	0
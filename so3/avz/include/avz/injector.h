@@ -64,6 +64,88 @@ struct dom_context
 };
 
 
+/*
+ * Compressed ME snapshot
+ *
+ * When CONFIG_AVZ_ME_LZO is enabled, the ME memslot which follows the dom_context
+ * in the snapshot is made of a snapshot_hdr_t followed by a sequence of records.
+ * Each record starts with a 32-bit descriptor giving its type and either the
+ * number of zero pages (SNAPSHOT_REC_ZERO) or the size in bytes of the payload
+ * which follows (SNAPSHOT_REC_RAW and SNAPSHOT_REC_LZO). Payloads are padded
+ * to 32-bit so that the next descriptor remains aligned.
+ */
+
+#define SNAPSHOT_MAGIC		0x534f4f5a	/* "SOOZ" */
+
+/* Maximal number of pages compressed as one block */
+#define SNAPSHOT_CHUNK_PAGES	16
+#define SNAPSHOT_CHUNK_SIZE	(SNAPSHOT_CHUNK_PAGES * PAGE_SIZE)
+
+#define SNAPSHOT_REC_ZERO	0
+#define SNAPSHOT_REC_RAW	1
+#define SNAPSHOT_REC_LZO	2
+
+#define SNAPSHOT_REC_SHIFT	30
+#define SNAPSHOT_REC_LEN_MASK	((1 << SNAPSHOT_REC_SHIFT) - 1)
+
+#define SNAPSHOT_REC(type, len)	(((uint32_t) (type) << SNAPSHOT_REC_SHIFT) | ((len) & SNAPSHOT_REC_LEN_MASK))
+#define SNAPSHOT_REC_TYPE(desc)	((desc) >> SNAPSHOT_REC_SHIFT)
+#define SNAPSHOT_REC_LEN(desc)	((desc) & SNAPSHOT_REC_LEN_MASK)
+
+typedef struct {
+	uint32_t magic;
+
+	/* Size of the ME memslot once uncompressed */
+	uint32_t ME_size;
+
+	/* Size of the records following this header */
+	uint32_t payload_size;
+
+	uint32_t reserved;
+} snapshot_hdr_t;
+
+/*
+ * Pre-copy round buffer
+ *
+ * A round buffer starts with a precopy_hdr_t followed by <nr_pages> 32-bit
+ * page indexes (relative to the beginning of the memslot), then by the content
+ * of the pages in the same order. Zero pages are flagged with PRECOPY_PAGE_ZERO
+ * and have no content.
+ */
+
+#define PRECOPY_MAGIC		0x534f4f50	/* "SOOP" */
+
+#define PRECOPY_PAGE_ZERO	(1U << 31)
+
+typedef struct {
+	uint32_t magic;
+	uint32_t round;
+	uint32_t nr_pages;
+	uint32_t reserved;
+} precopy_hdr_t;
+
+/* Dirty page tracking of a ME during its pre-copy migration */
+struct dirty_log {
+	spinlock_t lock;
+
+	/* One bit per page of the memslot */
+	unsigned long *dirty;
+
+	unsigned int nr_pages;
+	unsigned int nr_dirty;
+
+	/* Pages dirtied again by the ME since the beginning of the round */
+	unsigned int nr_redirtied;
+
+	precopy_stats_t stats;
+
+	/* Beginning of the current round */
+	u64 round_start;
+
+	/* Average time needed to transfer one page (ns) */
+	u64 page_copy_ns;
+};
+
 void mig_restore_domain_migration_info(unsigned int ME_slotID, struct domain *me);
 void after_migrate_to_user(void);
 
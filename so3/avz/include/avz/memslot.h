@@ -18,6 +18,8 @@
 #ifndef MEMSLOT_H
 #define MEMSLOT_H
 
+#include <types.h>
+
 /* Number of possible MEs in the local SOO */
 #define MEMSLOT_BASE	  2
 #define MEMSLOT_NR	  (MEMSLOT_BASE + MAX_ME_DOMAINS)
@@ -26,6 +28,10 @@
 #define MEMSLOT_AVZ	  0
 #define MEMSLOT_AGENCY	  1
 
+/* ME memory is allocated by chunks of 2 MB */
+#define ME_MEMCHUNK_SIZE	(2 * 1024 * 1024)
+#define ME_MEMCHUNK_NR		256    /* 256 chunks of 2 MB */
+
 #define DOM_TO_MEMSLOT(domid) (((domid == DOMID_AGENCY) || (domid == DOMID_AGENCY_RT)) ? MEMSLOT_AGENCY : domid)
 
 /*
@@ -47,6 +53,11 @@ typedef struct {
 	/* Intermediate physical address (address of the virtual RAM as exposed to the guest) */
 	unsigned long ipa_addr;
 
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+	/* Chunks of the slot which have been cleared and mapped in the stage-2 page table */
+	DECLARE_BITMAP(populated, ME_MEMCHUNK_NR);
+#endif
+
 } memslot_entry_t;
 
 extern memslot_entry_t memslot[];
@@ -60,4 +71,15 @@ void loadME(unsigned int slotID, void *itb);
 
 void memslot_init(void);
 
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+struct domain;
+
+void memchunk_init(void);
+bool memchunk_scrub(void);
+
+int memslot_populate(unsigned int slotID, addr_t offset, size_t size);
+void memslot_set_populated(unsigned int slotID);
+bool memslot_fault(struct domain *d, unsigned long esr);
+#endif
+
 #endif /* MEMSLOT_H */
@@ -41,10 +41,21 @@ struct scheduler {
 
 	struct task_slice (*do_schedule) (void);
 
+	/* Optional: set the scheduling parameters of a domain */
+	int (*adjust) (struct domain *, unsigned int weight, unsigned int cap);
+
 	struct schedule_data sched_data;
 };
 
 extern struct scheduler sched_flip;
 extern struct scheduler sched_agency;
 
+#ifdef CONFIG_AVZ_SCHED_CREDIT
+
+/* Weight given to a domain by the credit scheduler if not adjusted */
+#define CSCHED_DEFAULT_WEIGHT	256
+
+extern struct scheduler sched_credit;
+#endif
+
 #endif /* __SCHED_IF_H__ */
@@ -118,7 +118,11 @@ struct domain *domain_create(domid_t domid, int cpu_id)
 
 		if (cpu_id == ME_CPU) {
 
+#ifdef CONFIG_AVZ_SCHED_CREDIT
+			d->sched = &sched_credit;
+#else
 			d->sched = &sched_flip;
+#endif
 			d->need_periodic_timer = true;
 
 		} else if (cpu_id == AGENCY_CPU) {
@@ -258,6 +262,11 @@ static void continue_cpu_idle_loop(void)
 
 		local_irq_enable();
 
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+		/* Clear free ME memory chunks as long as there is nothing else to do */
+		if (memchunk_scrub())
+			continue;
+#endif
 		cpu_do_idle();
 	}
 }
@@ -315,6 +324,13 @@ void do_domctl(domctl_t *args)
                         args->avz_shared_paddr =
                             memslot[current_domain->avz_shared->domID].ipa_addr + memslot[current_domain->avz_shared->domID].size;
                 break;
+
+	case DOMCTL_sched_adjust:
+		if (d && d->sched->adjust)
+			args->result = d->sched->adjust(d, args->weight, args->cap);
+		else
+			args->result = -EINVAL;
+		break;
         }
 
 	spin_unlock(&domctl_lock);
@@ -18,6 +18,7 @@
 
 #include <memory.h>
 #include <sizes.h>
+#include <lzo.h>
 
 #include <libfdt/fdt_support.h>
 #include <libfdt/image.h>
@@ -278,6 +279,10 @@ void loadME(unsigned int slotID, void *itb) {
 	int ret;
 	const char *propstring;
 	mem_info_t guest_mem_info;
+	uint8_t comp;
+#ifdef CONFIG_AVZ_ME_LZO
+	size_t dest_size;
+#endif
 
 	/* Look for a node of ME type in the fit image */
 	nodeoffset = 0;
@@ -307,8 +312,13 @@ void loadME(unsigned int slotID, void *itb) {
 			if (ret) {
 				lprintk("!! The properties in the ME node does not look good !!\n");
 				BUG();
-			} else
-				break;
+			}
+
+			/* The compression property is optional */
+			if (fit_image_get_comp(itb, nodeoffset, &comp))
+				comp = IH_COMP_NONE;
+
+			break;
 		}
 
 		nodeoffset = next_node;
@@ -388,10 +398,51 @@ void loadME(unsigned int slotID, void *itb) {
         dest_ME_vaddr += L_TEXT_OFFSET;
 
         /* Move the kernel binary within the domain slotID. */
-	memcpy(dest_ME_vaddr, ME_vaddr, ME_size);
+	switch (comp) {
+	case IH_COMP_NONE:
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+		/* Only the image and a boot area are cleared, the rest of the ME memory is populated on demand. */
+		memslot_populate(slotID, L_TEXT_OFFSET, ME_size + CONFIG_AVZ_ME_BOOT_AREA * SZ_1K);
+#endif
+		memcpy(dest_ME_vaddr, ME_vaddr, ME_size);
+		break;
+
+#ifdef CONFIG_AVZ_ME_LZO
+	case IH_COMP_LZO:
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+		dest_size = lzop_uncompressed_size(ME_vaddr, ME_size);
+		if (!dest_size) {
+			lprintk("!! The compressed ME image is not valid !!\n");
+			BUG();
+		}
+
+		memslot_populate(slotID, L_TEXT_OFFSET, dest_size + CONFIG_AVZ_ME_BOOT_AREA * SZ_1K);
+#else
+		dest_size = memslot[slotID].size - L_TEXT_OFFSET;
+#endif
+
+		ret = lzop_decompress(ME_vaddr, ME_size, dest_ME_vaddr, &dest_size);
+		if (ret != LZO_E_OK) {
+			lprintk("!! Failed to uncompress the ME image (err %d) !!\n", ret);
+			BUG();
+		}
+
+		lprintk("ITB: ME image uncompressed from %d to %d bytes\n", ME_size, dest_size);
+		break;
+#endif
+
+	default:
+		lprintk("!! Unsupported compression (%d) for the ME image !!\n", comp);
+		BUG();
+	}
 
         memslot[slotID].fdt_paddr = ipa_to_pa(slotID, fdt_paddr);
 
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+	/* The device tree may be expanded (see below) */
+	memslot_populate(slotID, memslot[slotID].fdt_paddr - memslot[slotID].base_paddr, fdt_size + 128);
+#endif
+
         memcpy((void *) __xva(slotID, memslot[slotID].fdt_paddr), fdt_vaddr, fdt_size);
 
 	/* <ret> still has the result of the ramdisk presence (see above). */
@@ -412,6 +463,9 @@ void loadME(unsigned int slotID, void *itb) {
 		ret = fdt_setprop_u64((void *) __xva(slotID, memslot[slotID].fdt_paddr), nodeoffset, "linux,initrd-end", (uint32_t) initrd_end);
 		BUG_ON(ret != 0);
 
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+		memslot_populate(slotID, initrd_start - memslot[slotID].ipa_addr, initrd_size);
+#endif
 		memcpy((void *) ipa_to_va(slotID, initrd_start), initrd_vaddr, initrd_size);
         }
 }
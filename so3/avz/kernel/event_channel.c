@@ -19,6 +19,7 @@
 #include <common.h>
 #include <errno.h>
 #include <spinlock.h>
+#include <trace.h>
 
 #include <avz/evtchn.h>
 #include <avz/sched.h>
@@ -341,6 +342,8 @@ static void evtchn_set_pending(struct domain *d, int evtchn) {
 	 */
 	ASSERT(local_irq_is_disabled());
 
+	trace(TRACE_EVTCHN_SEND, evtchn, d->avz_shared->domID);
+
 	d->avz_shared->evtchn_pending[evtchn] = true;
 	d->avz_shared->evtchn_upcall_pending = 1;
 
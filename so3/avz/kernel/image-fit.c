@@ -243,6 +243,30 @@ int fit_image_get_type(const void *fit, int noffset, uint8_t *type)
 	return 0;
 }
 
+static const struct {
+	uint8_t id;
+	const char *name;
+} fit_comp_names[] = {
+	{ IH_COMP_NONE,		"none" },
+	{ IH_COMP_GZIP,		"gzip" },
+	{ IH_COMP_BZIP2,	"bzip2" },
+	{ IH_COMP_LZMA,		"lzma" },
+	{ IH_COMP_LZO,		"lzo" },
+	{ IH_COMP_LZ4,		"lz4" },
+};
+
+/* Simplified version of U-boot genimg_get_comp_id() */
+static uint8_t fit_get_comp_id(const char *name)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(fit_comp_names); i++)
+		if (!strcmp(fit_comp_names[i].name, name))
+			return fit_comp_names[i].id;
+
+	return -1;
+}
+
 /**
  * fit_image_get_comp - get comp id for a given component image node
  * @fit: pointer to the FIT format image header
@@ -271,9 +295,8 @@ int fit_image_get_comp(const void *fit, int noffset, uint8_t *comp)
 	}
 
 	/* Translate compression name to id */
-#if 0
-	*comp = genimg_get_comp_id(data);
-#endif
+	*comp = fit_get_comp_id(data);
+
 	return 0;
 }
 
@@ -25,6 +25,8 @@
 #include <crc.h>
 #include <softirq.h>
 #include <ptrace.h>
+#include <lzo.h>
+#include <bitops.h>
 
 #include <avz/memslot.h>
 #include <avz/domain.h>
@@ -32,11 +34,13 @@
 #include <avz/injector.h>
 #include <avz/evtchn.h>
 #include <avz/gnttab.h>
+#include <avz/capsule.h>
 
 #include <soo/uapi/soo.h>
 
 #include <asm/cacheflush.h>
 #include <asm/processor.h>
+#include <asm/mmu.h>
 
 #include <libfdt/image.h>
 
@@ -48,6 +52,179 @@
  */
 static struct dom_context domain_context = {0};
 
+static bool page_is_zero(void *page)
+{
+	unsigned long *p = page;
+	int i;
+
+	for (i = 0; i < PAGE_SIZE / sizeof(unsigned long); i++)
+		if (p[i])
+			return false;
+
+	return true;
+}
+
+#ifdef CONFIG_AVZ_ME_LZO
+
+/* Work memory and output buffer used by the LZO compressor */
+static void *snapshot_lzo_wrkmem = NULL;
+static void *snapshot_lzo_buf = NULL;
+
+/*
+ * Maximal size of a compressed snapshot payload. Chunks which do not compress
+ * are stored raw, so the payload never exceeds the memslot size plus the
+ * record descriptors.
+ */
+static size_t snapshot_max_payload(size_t ME_size)
+{
+	return sizeof(snapshot_hdr_t) + ME_size +
+		((ME_size >> PAGE_SHIFT) + 1) * 2 * sizeof(uint32_t);
+}
+
+/**
+ * Compress the ME memory into the snapshot buffer.
+ *
+ * Runs of zero pages are only described by a record, other pages are grouped
+ * by at most SNAPSHOT_CHUNK_PAGES pages and compressed with LZO1X.
+ *
+ * @param dst	snapshot buffer (right after the dom_context)
+ * @param src	ME memory
+ * @param size	ME memory size
+ * @return the size of the compressed payload including the header
+ */
+static size_t snapshot_compress(void *dst, void *src, size_t size)
+{
+	snapshot_hdr_t *hdr = (snapshot_hdr_t *) dst;
+	void *pos = dst + sizeof(snapshot_hdr_t);
+	uint32_t *desc;
+	unsigned int i, n, nr_pages = size >> PAGE_SHIFT;
+	size_t len;
+
+	if (!snapshot_lzo_wrkmem) {
+		snapshot_lzo_wrkmem = malloc(LZO1X_1_MEM_COMPRESS);
+		BUG_ON(!snapshot_lzo_wrkmem);
+
+		snapshot_lzo_buf = malloc(lzo1x_worst_compress(SNAPSHOT_CHUNK_SIZE));
+		BUG_ON(!snapshot_lzo_buf);
+	}
+
+	for (i = 0; i < nr_pages; i += n) {
+		desc = (uint32_t *) pos;
+		pos += sizeof(uint32_t);
+
+		if (page_is_zero(src + (i << PAGE_SHIFT))) {
+			for (n = 1; (i + n < nr_pages) && page_is_zero(src + ((i + n) << PAGE_SHIFT)); n++) ;
+
+			*desc = SNAPSHOT_REC(SNAPSHOT_REC_ZERO, n);
+			continue;
+		}
+
+		for (n = 1; (n < SNAPSHOT_CHUNK_PAGES) && (i + n < nr_pages) &&
+			    !page_is_zero(src + ((i + n) << PAGE_SHIFT)); n++) ;
+
+		lzo1x_1_compress(src + (i << PAGE_SHIFT), n << PAGE_SHIFT, snapshot_lzo_buf, &len, snapshot_lzo_wrkmem);
+
+		if (len < (n << PAGE_SHIFT)) {
+			*desc = SNAPSHOT_REC(SNAPSHOT_REC_LZO, len);
+			memcpy(pos, snapshot_lzo_buf, len);
+		} else {
+			len = n << PAGE_SHIFT;
+			*desc = SNAPSHOT_REC(SNAPSHOT_REC_RAW, len);
+			memcpy(pos, src + (i << PAGE_SHIFT), len);
+		}
+
+		pos += ALIGN(len, sizeof(uint32_t));
+	}
+
+	hdr->magic = SNAPSHOT_MAGIC;
+	hdr->ME_size = size;
+	hdr->payload_size = pos - (dst + sizeof(snapshot_hdr_t));
+	hdr->reserved = 0;
+
+	DBG("%s: ME of %d bytes compressed into %d bytes\n", __func__, size, hdr->payload_size);
+
+	return pos - dst;
+}
+
+/**
+ * Restore the ME memory from a compressed snapshot payload.
+ *
+ * @param dst	ME memory
+ * @param src	compressed payload starting with its snapshot_hdr_t
+ * @param size	ME memory size
+ */
+static void snapshot_uncompress(void *dst, void *src, size_t size)
+{
+	snapshot_hdr_t *hdr = (snapshot_hdr_t *) src;
+	void *pos = src + sizeof(snapshot_hdr_t);
+	void *end = pos + hdr->payload_size;
+	void *dst_end = dst + size;
+	uint32_t desc;
+	size_t len;
+	int ret;
+
+	BUG_ON(hdr->ME_size > size);
+
+	while (pos < end) {
+		desc = *((uint32_t *) pos);
+		pos += sizeof(uint32_t);
+
+		len = SNAPSHOT_REC_LEN(desc);
+
+		switch (SNAPSHOT_REC_TYPE(desc)) {
+		case SNAPSHOT_REC_ZERO:
+			BUG_ON(dst + (len << PAGE_SHIFT) > dst_end);
+
+			memset(dst, 0, len << PAGE_SHIFT);
+			dst += len << PAGE_SHIFT;
+			continue;
+
+		case SNAPSHOT_REC_RAW:
+			BUG_ON(dst + len > dst_end);
+
+			memcpy(dst, pos, len);
+			dst += len;
+			break;
+
+		case SNAPSHOT_REC_LZO:
+			size = dst_end - dst;
+
+			ret = lzo1x_decompress_safe(pos, len, dst, &size);
+			if (ret != LZO_E_OK)
+				panic("%s: corrupted snapshot (LZO err %d)\n", __func__, ret);
+
+			dst += size;
+			break;
+
+		default:
+			panic("%s: unknown snapshot record 0x%x\n", __func__, desc);
+		}
+
+		pos += ALIGN(len, sizeof(uint32_t));
+	}
+}
+
+#endif /* CONFIG_AVZ_ME_LZO */
+
+/*
+ * Retrieve the size of the ME memory transported by a snapshot.
+ * A compressed snapshot carries it in its header.
+ */
+static size_t snapshot_ME_size(avz_hyp_t *args)
+{
+	snapshot_hdr_t *hdr;
+
+	if (args->u.avz_snapshot_args.snapshot_paddr) {
+		hdr = (snapshot_hdr_t *) ((void *) ipa_to_va(MEMSLOT_AGENCY, args->u.avz_snapshot_args.snapshot_paddr) +
+					  sizeof(uint32_t) + sizeof(struct dom_context));
+
+		if (hdr->magic == SNAPSHOT_MAGIC)
+			return hdr->ME_size;
+	}
+
+	return args->u.avz_snapshot_args.size - sizeof(uint32_t) - sizeof(struct dom_context);
+}
+
 /**
  * @brief  Inject a SO3 container (capsule) as guest domain.
  *
@@ -57,8 +234,8 @@ static struct dom_context domain_context = {0};
  *  To get rid of the way how the page tables are managed by Linux, we perform a copy of the ME ITB in the
  *  AVZ heap, assuming that the 8-MB heap is sufficient to host the ITB ME (< 2 MB in most cases).
  *
- *  If the ITB should become larger, it is still possible to compress (and enhance AVZ with a uncompressor invoked
- *  at loading time). Wouldn't be still not enough, a temporary fixmap mapping combined with get_free_pages should be envisaged
+ *  If the ITB should become larger, the ME image can be lzo-compressed (CONFIG_AVZ_ME_LZO) and is uncompressed
+ *  by loadME(). Wouldn't be still not enough, a temporary fixmap mapping combined with get_free_pages should be envisaged
  *  to have the ME ITB accessible from the AVZ user space area.
  * 
  * @param args args received from the guest
@@ -105,8 +282,10 @@ void inject_me(avz_hyp_t *args)
 
         __current = current_domain;
 
+#ifndef CONFIG_AVZ_ME_LAZY_MEM
 	/* Clear the RAM allocated to this ME */
 	memset((void *) __xva(slotID, memslot[slotID].base_paddr), 0, memslot[slotID].size);
+#endif
 
 	loadME(slotID, itb_vaddr);
 
@@ -175,6 +354,336 @@ static void build_domain_context(unsigned int ME_slotID, struct domain *me, stru
 		sizeof(struct cpu_regs));
 }
 
+/*
+ * Live (pre-copy) migration
+ *
+ * While the ME keeps running, its memslot is transferred in rounds. A page
+ * which has been sent is write-protected in the stage-2 page table so that
+ * the next write access of the ME traps into AVZ and marks the page as dirty
+ * again (see precopy_dabt()). A page is therefore writable if and only if
+ * its dirty bit is set.
+ *
+ * The agency decides when the stop-and-copy phase is started according to
+ * the statistics returned after each round. The residual dirty pages are
+ * then transferred along with the domain context by read_ME_snapshot().
+ */
+
+#define DIRTY_WORD(pfn)		((pfn) / BITS_PER_LONG)
+#define DIRTY_MASK(pfn)		(1UL << ((pfn) % BITS_PER_LONG))
+
+static inline void dirty_log_mark(struct dirty_log *log, unsigned int pfn)
+{
+	if (!(log->dirty[DIRTY_WORD(pfn)] & DIRTY_MASK(pfn))) {
+		log->dirty[DIRTY_WORD(pfn)] |= DIRTY_MASK(pfn);
+		log->nr_dirty++;
+		log->nr_redirtied++;
+	}
+}
+
+static void precopy_start(unsigned int slotID)
+{
+	struct domain *d = domains[slotID];
+	struct dirty_log *log;
+	size_t bitmap_size;
+
+	BUG_ON(d->dirty_log != NULL);
+
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+	/* All pages must be mapped so that they can be write-protected */
+	memslot_populate(slotID, 0, memslot[slotID].size);
+#endif
+
+	log = malloc(sizeof(struct dirty_log));
+	BUG_ON(!log);
+
+	memset(log, 0, sizeof(struct dirty_log));
+
+	spin_lock_init(&log->lock);
+
+	log->nr_pages = memslot[slotID].size >> PAGE_SHIFT;
+
+	bitmap_size = BITS_TO_LONGS(log->nr_pages) * sizeof(unsigned long);
+
+	log->dirty = malloc(bitmap_size);
+	BUG_ON(!log->dirty);
+
+	/* All pages have to be sent during the first round; they are still writable. */
+	memset(log->dirty, 0xff, bitmap_size);
+	log->nr_dirty = log->nr_pages;
+
+	log->stats.pages_total = log->nr_pages;
+	log->round_start = NOW();
+
+	d->dirty_log = log;
+
+	DBG("%s: dirty logging started for ME slotID %d (%d pages)\n", __func__, slotID, log->nr_pages);
+}
+
+/**
+ * Collect at most <max_pages> dirty pages and copy them into a round buffer.
+ * The collected pages are write-protected before being copied so that any
+ * further modification is caught for the next round.
+ *
+ * @return the number of bytes written into the buffer
+ */
+static size_t precopy_fill(unsigned int slotID, void *buffer, unsigned int max_pages)
+{
+	struct domain *d = domains[slotID];
+	struct dirty_log *log = d->dirty_log;
+	precopy_hdr_t *hdr = (precopy_hdr_t *) buffer;
+	uint32_t *idx = buffer + sizeof(precopy_hdr_t);
+	void *data, *src;
+	unsigned int pfn, n = 0, i;
+
+	spin_lock(&log->lock);
+
+	for (pfn = find_next_bit(log->dirty, log->nr_pages, 0);
+	     (pfn < log->nr_pages) && (n < max_pages);
+	     pfn = find_next_bit(log->dirty, log->nr_pages, pfn + 1)) {
+
+		log->dirty[DIRTY_WORD(pfn)] &= ~DIRTY_MASK(pfn);
+
+		S2_set_write_access((void *) d->pagetable_vaddr, memslot[slotID].ipa_addr + (pfn << PAGE_SHIFT),
+				    PAGE_SIZE, false);
+
+		idx[n++] = pfn;
+	}
+
+	log->nr_dirty -= n;
+
+	/* One single invalidation for the whole batch */
+	if (n)
+		__asm_invalidate_tlb_guest();
+
+	spin_unlock(&log->lock);
+
+	/*
+	 * The pages can now be copied without holding the lock. A write access
+	 * from the ME will fault and will be sent again in the next round.
+	 */
+	data = idx + n;
+	for (i = 0; i < n; i++) {
+		src = (void *) __xva(slotID, memslot[slotID].base_paddr + (idx[i] << PAGE_SHIFT));
+
+		if (page_is_zero(src)) {
+			idx[i] |= PRECOPY_PAGE_ZERO;
+			continue;
+		}
+
+		memcpy(data, src, PAGE_SIZE);
+		data += PAGE_SIZE;
+	}
+
+	hdr->magic = PRECOPY_MAGIC;
+	hdr->round = log->stats.round;
+	hdr->nr_pages = n;
+	hdr->reserved = 0;
+
+	return data - buffer;
+}
+
+static void precopy_round(avz_precopy_t *args)
+{
+	struct domain *d = domains[args->slotID];
+	struct dirty_log *log = d->dirty_log;
+	precopy_stats_t *stats = &log->stats;
+	unsigned int max_pages;
+	u64 now, elapsed;
+
+	BUG_ON(!log);
+	BUG_ON(args->size < sizeof(precopy_hdr_t));
+
+	max_pages = (args->size - sizeof(precopy_hdr_t)) / (sizeof(uint32_t) + PAGE_SIZE);
+
+	now = NOW();
+	elapsed = now - log->round_start;
+
+	/*
+	 * The time elapsed since the previous round includes the transfer of the
+	 * previous buffer by the agency, which gives the cost of a page.
+	 */
+	if (stats->pages_sent)
+		log->page_copy_ns = elapsed / stats->pages_sent;
+
+	stats->dirty_rate = (elapsed ? (log->nr_redirtied * 1000000000ull) / elapsed : 0);
+	stats->round_ns = elapsed;
+
+	log->nr_redirtied = 0;
+	log->round_start = now;
+
+	args->size = precopy_fill(args->slotID, (void *) ipa_to_va(MEMSLOT_AGENCY, args->buffer_paddr), max_pages);
+
+	stats->round++;
+	stats->pages_sent = ((precopy_hdr_t *) ipa_to_va(MEMSLOT_AGENCY, args->buffer_paddr))->nr_pages;
+	stats->total_sent += stats->pages_sent;
+	stats->pages_dirty = log->nr_dirty;
+	stats->downtime_ns = log->nr_dirty * log->page_copy_ns;
+
+	args->stats = *stats;
+
+	DBG("%s: round %d: %d pages sent, %d dirty, rate %lld pages/s\n", __func__,
+	    stats->round, stats->pages_sent, stats->pages_dirty, stats->dirty_rate);
+}
+
+/*
+ * Apply a round buffer to the memslot of the ME being received.
+ */
+static void precopy_apply(unsigned int slotID, void *buffer)
+{
+	precopy_hdr_t *hdr = (precopy_hdr_t *) buffer;
+	uint32_t *idx = buffer + sizeof(precopy_hdr_t);
+	void *data = idx + hdr->nr_pages;
+	void *dst;
+	unsigned int i, pfn;
+
+	if (hdr->magic != PRECOPY_MAGIC)
+		panic("%s: wrong pre-copy buffer (magic 0x%x)\n", __func__, hdr->magic);
+
+	for (i = 0; i < hdr->nr_pages; i++) {
+		pfn = idx[i] & ~PRECOPY_PAGE_ZERO;
+
+		BUG_ON(pfn >= (memslot[slotID].size >> PAGE_SHIFT));
+
+		dst = (void *) __xva(slotID, memslot[slotID].base_paddr + (pfn << PAGE_SHIFT));
+
+		if (idx[i] & PRECOPY_PAGE_ZERO) {
+			memset(dst, 0, PAGE_SIZE);
+		} else {
+			memcpy(dst, data, PAGE_SIZE);
+			data += PAGE_SIZE;
+		}
+	}
+}
+
+/**
+ * Stop the dirty logging and free the related resources. The stage-2
+ * write permission is given back to the whole memslot.
+ */
+void precopy_release(struct domain *d)
+{
+	struct dirty_log *log = d->dirty_log;
+	unsigned int slotID = d->avz_shared->domID;
+
+	if (!log)
+		return;
+
+	spin_lock(&log->lock);
+
+	S2_set_write_access((void *) d->pagetable_vaddr, memslot[slotID].ipa_addr, memslot[slotID].size, true);
+	__asm_invalidate_tlb_guest();
+
+	d->dirty_log = NULL;
+
+	spin_unlock(&log->lock);
+
+	free(log->dirty);
+	free(log);
+}
+
+/**
+ * Handle a data abort raised by a ME during its pre-copy migration.
+ *
+ * @param d	domain which raised the abort
+ * @param esr	exception syndrome
+ * @return true if the abort was due to a write-protected page (which is now
+ *	   writable again), false if the abort has to be processed as usual.
+ */
+bool precopy_dabt(struct domain *d, unsigned long esr)
+{
+	struct dirty_log *log = d->dirty_log;
+	unsigned int slotID, pfn;
+	addr_t ipa;
+
+	if (!log)
+		return false;
+
+	if (((esr & ESR_ELx_FSC_TYPE) != ESR_ELx_FSC_PERM) || !(esr & (ESR_ELx_WNR | ESR_ELx_S1PTW)))
+		return false;
+
+	slotID = d->avz_shared->domID;
+	ipa = read_sysreg(hpfar_el2) << 8;
+
+	if ((ipa < memslot[slotID].ipa_addr) || (ipa >= memslot[slotID].ipa_addr + memslot[slotID].size))
+		return false;
+
+	pfn = (ipa - memslot[slotID].ipa_addr) >> PAGE_SHIFT;
+
+	spin_lock(&log->lock);
+
+	/* Another CPU may have already processed a fault on this page. */
+	if (!(log->dirty[DIRTY_WORD(pfn)] & DIRTY_MASK(pfn))) {
+		S2_set_write_access((void *) d->pagetable_vaddr, ipa, PAGE_SIZE, true);
+		__asm_invalidate_tlb_ipa(ipa);
+
+		dirty_log_mark(log, pfn);
+	}
+
+	spin_unlock(&log->lock);
+
+	/* The faulting instruction is simply replayed. */
+	return true;
+}
+
+/*
+ * The pages granted by the ME are written by the backends through the
+ * page table of the agency and are therefore not tracked; they are
+ * sent anyway during the stop-and-copy phase.
+ */
+static void precopy_mark_granted(unsigned int slotID)
+{
+	struct domain *d = domains[slotID];
+	struct dirty_log *log = d->dirty_log;
+	gnttab_t *cur;
+	addr_t paddr;
+
+	spin_lock(&log->lock);
+
+	list_for_each_entry(cur, &d->gnttab, list) {
+		paddr = pfn_to_phys(cur->pfn);
+
+		if ((paddr >= memslot[slotID].base_paddr) && (paddr < memslot[slotID].base_paddr + memslot[slotID].size))
+			dirty_log_mark(log, (paddr - memslot[slotID].base_paddr) >> PAGE_SHIFT);
+	}
+
+	spin_unlock(&log->lock);
+}
+
+/**
+ * Hypercall entry for the pre-copy migration operations.
+ *
+ * @param args	args received from the agency
+ */
+void precopy_op(avz_hyp_t *args)
+{
+	avz_precopy_t *precopy = &args->u.avz_precopy_args;
+	struct domain *d = domains[precopy->slotID];
+
+	BUG_ON(!d);
+
+	switch (precopy->op) {
+	case PRECOPY_START:
+		precopy_start(precopy->slotID);
+		precopy->stats = d->dirty_log->stats;
+		break;
+
+	case PRECOPY_ROUND:
+		precopy_round(precopy);
+		break;
+
+	case PRECOPY_WRITE:
+		precopy_apply(precopy->slotID, (void *) ipa_to_va(MEMSLOT_AGENCY, precopy->buffer_paddr));
+		break;
+
+	case PRECOPY_ABORT:
+		precopy_release(d);
+		break;
+
+	default:
+		printk("%s: unknown operation %d\n", __func__, precopy->op);
+		BUG();
+	}
+}
+
 /**
  * Read the ME snapshot.
  */
@@ -183,9 +692,18 @@ void read_ME_snapshot(avz_hyp_t *args) {
         struct domain *domME = domains[slotID];
         void *snapshot_buffer = (void *) ipa_to_va(MEMSLOT_AGENCY, args->u.avz_snapshot_args.snapshot_paddr);
 
-	/* If the size is 0, we return the snapshot size. */
+	/* If the size is 0, we return the (maximal) snapshot size. */
 	if (args->u.avz_snapshot_args.size == 0) {
+		if (domME->dirty_log) {
+			args->u.avz_snapshot_args.size = sizeof(uint32_t) + sizeof(domain_context) + sizeof(precopy_hdr_t) +
+				domME->dirty_log->nr_pages * (sizeof(uint32_t) + PAGE_SIZE);
+			return;
+		}
+#ifdef CONFIG_AVZ_ME_LZO
+                args->u.avz_snapshot_args.size = sizeof(uint32_t) + snapshot_max_payload(memslot[slotID].size) + sizeof(domain_context);
+#else
                 args->u.avz_snapshot_args.size = sizeof(uint32_t) + memslot[slotID].size + sizeof(domain_context);
+#endif
                 return;
         }
 
@@ -194,20 +712,42 @@ void read_ME_snapshot(avz_hyp_t *args) {
 	/* Pause the ME */
 	domain_pause_by_systemcontroller(domME);
 
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+	/* The chunks never accessed by the ME must be sent as zero */
+	memslot_populate(slotID, 0, memslot[slotID].size);
+#endif
+
         /* Gather all the info we need into structures */
         build_domain_context(slotID, domME, &domain_context);
 
-	/* Copy the size of the payload which is made of the dom_info structure and the ME */
-        args->u.avz_snapshot_args.size = memslot[slotID].size + sizeof(domain_context);
-
-        memcpy(snapshot_buffer, &args->u.avz_snapshot_args.size, sizeof(uint32_t));
-	args->u.avz_snapshot_args.size += sizeof(uint32_t);
-
 	/* Copy the dom_info structure */
         memcpy(snapshot_buffer + sizeof(uint32_t), &domain_context, sizeof(domain_context));
 
 	/* Finally copy the ME */
-        memcpy(snapshot_buffer + sizeof(uint32_t) + sizeof(domain_context), (void *) __xva(slotID, memslot[slotID].base_paddr), memslot[slotID].size);
+	if (domME->dirty_log) {
+		/* Stop-and-copy phase of a pre-copy migration: only the residual dirty pages are sent. */
+		precopy_mark_granted(slotID);
+
+		args->u.avz_snapshot_args.size = sizeof(domain_context) +
+			precopy_fill(slotID, snapshot_buffer + sizeof(uint32_t) + sizeof(domain_context), domME->dirty_log->nr_pages);
+
+		precopy_release(domME);
+	} else {
+#ifdef CONFIG_AVZ_ME_LZO
+		args->u.avz_snapshot_args.size = sizeof(domain_context) +
+			snapshot_compress(snapshot_buffer + sizeof(uint32_t) + sizeof(domain_context),
+					  (void *) __xva(slotID, memslot[slotID].base_paddr), memslot[slotID].size);
+#else
+		memcpy(snapshot_buffer + sizeof(uint32_t) + sizeof(domain_context),
+		       (void *) __xva(slotID, memslot[slotID].base_paddr), memslot[slotID].size);
+
+		args->u.avz_snapshot_args.size = memslot[slotID].size + sizeof(domain_context);
+#endif
+	}
+
+	/* Copy the size of the payload which is made of the dom_info structure and the ME */
+        memcpy(snapshot_buffer, &args->u.avz_snapshot_args.size, sizeof(uint32_t));
+	args->u.avz_snapshot_args.size += sizeof(uint32_t);
 
 	/* Now, this ME is suspended and must be resumed by the agency */
         domME->avz_shared->dom_desc.u.ME.state = ME_state_resuming;
@@ -275,7 +815,6 @@ void restore_domain_context(unsigned int ME_slotID, struct domain *me, struct do
 }
 
 void write_ME_snapshot(avz_hyp_t *args) {
-        uint32_t snapshot_size;
         void *snapshot_buffer;
         uint32_t slotID;
         struct domain *domME;
@@ -284,11 +823,10 @@ void write_ME_snapshot(avz_hyp_t *args) {
         struct cpu_regs *frame;
    
         slotID = args->u.avz_snapshot_args.slotID;
-        snapshot_size = args->u.avz_snapshot_args.size;
 
         /* Ask for available slot and perform the reservation */
 	if (slotID == 0) {
-		slotID = get_ME_free_slot(snapshot_size - sizeof(uint32_t) - sizeof(struct dom_context));
+		slotID = get_ME_free_slot(snapshot_ME_size(args));
                 if (slotID > 0) 
                         args->u.avz_snapshot_args.slotID = slotID;
                 return ;
@@ -301,11 +839,27 @@ void write_ME_snapshot(avz_hyp_t *args) {
 
         restore_domain_context(slotID, domME, domctxt);
 
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+	/* The whole memslot is restored from the snapshot */
+	memslot_set_populated(slotID);
+#endif
+
 	__setup_dom_pgtable(domME, memslot[slotID].base_paddr, memslot[slotID].size);
 
         /* Copy the ME content */
-        memcpy((void *) __xva(slotID, memslot[slotID].base_paddr), snapshot_buffer + sizeof(uint32_t) + sizeof(struct dom_context),
-		memslot[slotID].size);
+	if (((precopy_hdr_t *) (snapshot_buffer + sizeof(uint32_t) + sizeof(struct dom_context)))->magic == PRECOPY_MAGIC) {
+		/* The memslot has already been filled by the pre-copy rounds. */
+		precopy_apply(slotID, snapshot_buffer + sizeof(uint32_t) + sizeof(struct dom_context));
+	} else if (((snapshot_hdr_t *) (snapshot_buffer + sizeof(uint32_t) + sizeof(struct dom_context)))->magic == SNAPSHOT_MAGIC) {
+#ifdef CONFIG_AVZ_ME_LZO
+		snapshot_uncompress((void *) __xva(slotID, memslot[slotID].base_paddr),
+				    snapshot_buffer + sizeof(uint32_t) + sizeof(struct dom_context), memslot[slotID].size);
+#else
+		panic("%s: compressed snapshot received but CONFIG_AVZ_ME_LZO is disabled\n", __func__);
+#endif
+	} else
+		memcpy((void *) __xva(slotID, memslot[slotID].base_paddr), snapshot_buffer + sizeof(uint32_t) + sizeof(struct dom_context),
+		       memslot[slotID].size);
 	 
 	/* Create a stack devoted to this restored domain */
 
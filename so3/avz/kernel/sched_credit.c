@@ -0,0 +1,371 @@
+/*
+ * Copyright (C) 2025 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Weighted credit scheduler
+ *
+ * Every accounting period, the CPU time of a physical CPU is distributed as
+ * credits (in ns) to the domains which are awake on it, proportionally to
+ * their weight. Running domains burn their credits; domains with remaining
+ * credits (UNDER) are picked before domains which have exhausted them (OVER).
+ *
+ * A domain which is woken up by an event while it still has credits gets
+ * the BOOST priority for one time slice, so that event-driven MEs are served
+ * with a low latency even if a CPU-bound ME is running.
+ *
+ * A cap (in percent of a CPU) limits the CPU time a domain may consume during
+ * one accounting period, even if the CPU would be idle otherwise.
+ */
+
+#if 0
+#define DEBUG
+#endif
+
+#include <common.h>
+#include <timer.h>
+#include <softirq.h>
+#include <list.h>
+#include <errno.h>
+
+#include <avz/sched.h>
+#include <avz/sched-if.h>
+#include <avz/debug.h>
+
+#define CSCHED_PRIO_BOOST	0
+#define CSCHED_PRIO_UNDER	1
+#define CSCHED_PRIO_OVER	2
+
+#define CSCHED_PERIOD		MILLISECS(CONFIG_AVZ_SCHED_CREDIT_PERIOD)
+
+struct csched_dom {
+	struct domain *d;
+
+	/* Element of the runqueue of the CPU the domain is attached to */
+	struct list_head runq_elem;
+	bool queued;
+
+	/* Domain is awake (runnable or running) */
+	bool active;
+
+	int prio;
+
+	unsigned int weight;
+	unsigned int cap;
+
+	/* Remaining credits (ns) */
+	s64 credit;
+
+	/* CPU time consumed during the current accounting period */
+	u64 consumed;
+
+	/* Cap reached, the domain is not eligible until the next accounting */
+	bool parked;
+
+	/* Beginning of the current time slice */
+	u64 start;
+};
+
+struct scheduler sched_credit;
+
+static DEFINE_SPINLOCK(csched_lock);
+
+static struct csched_dom csched_doms[MAX_DOMAINS];
+
+/* Per-CPU runqueues ordered by priority */
+static struct list_head csched_runq[CONFIG_NR_CPUS];
+
+static struct timer csched_acct_timer;
+
+static inline struct csched_dom *CSCHED_DOM(struct domain *d) {
+	return &csched_doms[d->avz_shared->domID];
+}
+
+static void csched_dom_init(struct csched_dom *scd, struct domain *d)
+{
+	scd->d = d;
+	scd->queued = false;
+	scd->active = false;
+	scd->prio = CSCHED_PRIO_UNDER;
+	scd->credit = 0;
+	scd->consumed = 0;
+	scd->parked = false;
+
+	if (!scd->weight)
+		scd->weight = CSCHED_DEFAULT_WEIGHT;
+}
+
+/*
+ * Insert a domain at the tail of its priority class so that domains with
+ * the same priority are served in a round-robin way.
+ */
+static void runq_insert(struct csched_dom *scd)
+{
+	struct list_head *runq = &csched_runq[scd->d->processor];
+	struct csched_dom *iter;
+
+	if (scd->queued)
+		return;
+
+	list_for_each_entry(iter, runq, runq_elem) {
+		if (iter->prio > scd->prio) {
+			list_add_tail(&scd->runq_elem, &iter->runq_elem);
+			scd->queued = true;
+			return;
+		}
+	}
+
+	list_add_tail(&scd->runq_elem, runq);
+	scd->queued = true;
+}
+
+static void runq_remove(struct csched_dom *scd)
+{
+	if (!scd->queued)
+		return;
+
+	list_del(&scd->runq_elem);
+	scd->queued = false;
+}
+
+static void csched_update_prio(struct csched_dom *scd)
+{
+	scd->prio = ((scd->credit > 0) ? CSCHED_PRIO_UNDER : CSCHED_PRIO_OVER);
+}
+
+/*
+ * Account the CPU time used by the domain since the beginning of its slice.
+ */
+static void csched_burn(struct csched_dom *scd, u64 now)
+{
+	u64 delta = now - scd->start;
+
+	scd->credit -= delta;
+	scd->consumed += delta;
+	scd->start = now;
+
+	/* The boost only lasts one time slice */
+	csched_update_prio(scd);
+
+	if (scd->cap && (scd->consumed >= (CSCHED_PERIOD * scd->cap) / 100))
+		scd->parked = true;
+}
+
+/*
+ * Accounting: distribute the credits of the period according to the weights
+ * and reset the caps.
+ */
+static void csched_acct(void *unused)
+{
+	struct csched_dom *scd;
+	unsigned int weight_total[CONFIG_NR_CPUS] = { 0 };
+	unsigned long flags;
+	int i;
+
+	flags = spin_lock_irqsave(&csched_lock);
+
+	for (i = 0; i < MAX_DOMAINS; i++) {
+		scd = &csched_doms[i];
+
+		if (scd->d && scd->active)
+			weight_total[scd->d->processor] += scd->weight;
+	}
+
+	for (i = 0; i < MAX_DOMAINS; i++) {
+		scd = &csched_doms[i];
+
+		if (!scd->d || !scd->active)
+			continue;
+
+		scd->credit += (CSCHED_PERIOD * scd->weight) / weight_total[scd->d->processor];
+
+		/* Idle domains must not hoard credits */
+		if (scd->credit > (s64) CSCHED_PERIOD)
+			scd->credit = CSCHED_PERIOD;
+
+		scd->consumed = 0;
+		scd->parked = false;
+
+		csched_update_prio(scd);
+
+		/* Re-sort the runqueue */
+		if (scd->queued) {
+			runq_remove(scd);
+			runq_insert(scd);
+		}
+	}
+
+	spin_unlock_irqrestore(&csched_lock, flags);
+
+	/* Let the new priorities be taken into account */
+	cpu_raise_softirq(ME_CPU, SCHEDULE_SOFTIRQ);
+
+	set_timer(&csched_acct_timer, NOW() + CSCHED_PERIOD);
+}
+
+/*
+ * Main scheduling function
+ */
+static struct task_slice csched_do_schedule(void)
+{
+	struct task_slice ret;
+	struct domain *prev = current_domain;
+	struct csched_dom *scd, *next = NULL;
+	unsigned int cpu = smp_processor_id();
+	u64 now = NOW();
+
+	spin_lock(&csched_lock);
+
+	/* Account the time of the domain which is being descheduled */
+	if ((prev->sched == &sched_credit) && !is_idle_domain(prev)) {
+		scd = CSCHED_DOM(prev);
+
+		csched_burn(scd, now);
+
+		if (scd->active)
+			runq_insert(scd);
+	}
+
+	list_for_each_entry(scd, &csched_runq[cpu], runq_elem) {
+		if (!scd->parked) {
+			next = scd;
+			break;
+		}
+	}
+
+	if (next) {
+		runq_remove(next);
+		next->start = now;
+
+		ret.d = next->d;
+
+		/* A time slice is only needed if some other domain is waiting or the domain is capped */
+		ret.time = ((!list_empty(&csched_runq[cpu]) || next->cap) ? CONFIG_AVZ_SCHED_CREDIT_TSLICE : 0);
+	} else {
+		ret.d = idle_domain[cpu];
+		ret.time = 0;
+	}
+
+	spin_unlock(&csched_lock);
+
+	DBG("%s: on cpu %d picking now: %d\n", __func__, cpu, ret.d->avz_shared->domID);
+
+	return ret;
+}
+
+/*
+ * schedule_lock is acquired.
+ */
+static void csched_sleep(struct domain *d)
+{
+	struct csched_dom *scd;
+
+	DBG("%s: domain-id %i\n", __func__, d->avz_shared->domID);
+
+	if (is_idle_domain(d))
+		return;
+
+	scd = CSCHED_DOM(d);
+
+	spin_lock(&csched_lock);
+
+	scd->active = false;
+	runq_remove(scd);
+
+	spin_unlock(&csched_lock);
+
+	if (d->is_running)
+		cpu_raise_softirq(d->processor, SCHEDULE_SOFTIRQ);
+}
+
+static void csched_wake(struct domain *d)
+{
+	struct csched_dom *scd = CSCHED_DOM(d);
+
+	DBG("%s: domain-id %i\n", __func__, d->avz_shared->domID);
+
+	spin_lock(&csched_lock);
+
+	if (scd->d != d)
+		csched_dom_init(scd, d);
+
+	scd->active = true;
+
+	/* Boost an event-driven domain which did not exhaust its credits */
+	if (scd->prio == CSCHED_PRIO_UNDER)
+		scd->prio = CSCHED_PRIO_BOOST;
+
+	runq_insert(scd);
+
+	spin_unlock(&csched_lock);
+
+	/* Let the scheduler preempt the running domain if required */
+	cpu_raise_softirq(d->processor, SCHEDULE_SOFTIRQ);
+}
+
+static int csched_adjust(struct domain *d, unsigned int weight, unsigned int cap)
+{
+	struct csched_dom *scd = CSCHED_DOM(d);
+
+	if (!weight || (cap > 100))
+		return -EINVAL;
+
+	spin_lock(&csched_lock);
+
+	scd->weight = weight;
+	scd->cap = cap;
+
+	spin_unlock(&csched_lock);
+
+	return 0;
+}
+
+/* The scheduler timer: force a run through the scheduler */
+static void s_timer_fn(void *unused)
+{
+	raise_softirq(SCHEDULE_SOFTIRQ);
+}
+
+void sched_credit_init(void) {
+	int i;
+
+	for (i = 0; i < CONFIG_NR_CPUS; i++)
+		INIT_LIST_HEAD(&csched_runq[i]);
+
+	memset(csched_doms, 0, sizeof(csched_doms));
+
+	sched_credit.sched_data.current_dom = 0;
+
+	spin_lock_init(&sched_credit.sched_data.schedule_lock);
+
+	init_timer(&sched_credit.sched_data.s_timer, s_timer_fn, NULL, ME_CPU);
+
+	init_timer(&csched_acct_timer, csched_acct, NULL, ME_CPU);
+	set_timer(&csched_acct_timer, NOW() + CSCHED_PERIOD);
+}
+
+struct scheduler sched_credit = {
+	.name = "SOO AVZ credit scheduler",
+
+	.init = sched_credit_init,
+
+	.do_schedule = csched_do_schedule,
+
+	.sleep = csched_sleep,
+	.wake = csched_wake,
+	.adjust = csched_adjust,
+};
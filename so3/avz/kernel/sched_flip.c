@@ -31,8 +31,6 @@
 
 DEFINE_SPINLOCK(schedflip_lock);
 
-extern spinlock_t softirq_pending_lock;
-
 static struct domain *domains_runnable[MAX_DOMAINS];
 struct scheduler sched_flip;
 
@@ -307,6 +307,10 @@ void domain_scheduler_init(void)
 	register_softirq(SCHEDULE_SOFTIRQ, domain_schedule);
 
 	sched_agency.init();
+#ifdef CONFIG_AVZ_SCHED_CREDIT
+	sched_credit.init();
+#else
 	sched_flip.init();
+#endif
 }
 
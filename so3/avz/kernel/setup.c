@@ -86,6 +86,10 @@ void avz_start(void)
 	/* Memory manager subsystem initialization */
 	memory_init();
 
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+	memchunk_init();
+#endif
+
 	percpu_init_areas();
 
 	/* allocate pages for per-cpu areas */
@@ -69,12 +69,17 @@ void shutdown_ME(unsigned int ME_slotID)
 
 	vcpu_pause(dom);
 
+	/* Stop a pending pre-copy migration */
+	precopy_release(dom);
+
         DBG("Destroy evtchn if necessary - state: %d\n", get_ME_state(ME_slotID));
         evtchn_destroy(dom);
 
+#ifndef CONFIG_AVZ_ME_LAZY_MEM
 	DBG("Wiping domain area...\n");
 
 	memset((void *) memslot[ME_slotID].base_vaddr, 0, memslot[ME_slotID].size);
+#endif /* CONFIG_AVZ_ME_LAZY_MEM: the chunks are cleared in the background once released */
 
 	DBG("Destroying domain structure ...\n");
 
@@ -109,10 +114,11 @@ void get_dom_desc(uint32_t slotID, dom_desc_t *dom_desc) {
 
 }
 
-/**
- * SOO hypercall processing.
+/*
+ * Dispatch one hypercall to its handler.
+ * Return -ENOSYS if the hypercall is unknown.
  */
-void do_avz_hypercall(avz_hyp_t *args) {
+static int __do_avz_hypercall(avz_hyp_t *args) {
 	struct domain *dom;
 
         /* Dispatch the hypercall to the appropriate handler
@@ -153,6 +159,10 @@ void do_avz_hypercall(avz_hyp_t *args) {
 		inject_me(args);
 		break;
 
+	case AVZ_ME_PRECOPY:
+		precopy_op(args);
+		break;
+
 	case AVZ_DC_EVENT_SET:
 		/*
 		 * AVZ_DC_SET is used to assign a new dc_event number in the (target) domain shared info page.
@@ -188,11 +198,60 @@ void do_avz_hypercall(avz_hyp_t *args) {
         }
  
 	default:
+		return -ENOSYS;
+        }
+
+	return 0;
+}
+
+/*
+ * Process a batch of hypercalls. The entries are located in the memory of
+ * the calling domain and are executed in order; a rejected entry does not
+ * prevent the following ones from being processed.
+ */
+static void do_multicall(avz_multicall_t *mc) {
+	multicall_entry_t *entries;
+	unsigned int memslotID;
+	int i;
+
+	mc->nr_failed = 0;
+
+	if (mc->nr > MULTICALL_MAX_ENTRIES) {
+		printk("%s: too many entries (%d)\n", __func__, mc->nr);
+		mc->nr_failed = mc->nr;
+		return;
+	}
+
+	memslotID = DOM_TO_MEMSLOT(current_domain->avz_shared->domID);
+	entries = (multicall_entry_t *) ipa_to_va(memslotID, mc->entries_paddr);
+
+	for (i = 0; i < mc->nr; i++) {
+
+		/* No nesting */
+		if (entries[i].args.cmd == AVZ_MULTICALL)
+			entries[i].result = -EINVAL;
+		else
+			entries[i].result = __do_avz_hypercall(&entries[i].args);
+
+		if (entries[i].result)
+			mc->nr_failed++;
+	}
+}
+
+/**
+ * SOO hypercall processing.
+ */
+void do_avz_hypercall(avz_hyp_t *args) {
+
+	if (args->cmd == AVZ_MULTICALL) {
+		do_multicall(&args->u.avz_multicall_args);
+
+	} else if (__do_avz_hypercall(args) == -ENOSYS) {
 		printk("%s: Unrecognized hypercall: %d\n", __func__, args->cmd);
 		BUG();
-		break;
-        }
+	}
 
+	/* Done once for the whole batch in case of multicall */
 	flush_dcache_all();
 }
 
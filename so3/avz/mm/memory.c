@@ -34,9 +34,6 @@
 
 #include <avz/sched.h>
 
-#define ME_MEMCHUNK_SIZE	2 * 1024 * 1024
-#define ME_MEMCHUNK_NR		256    /* 256 chunks of 2 MB */
-
 /*
  * Set of memslots in the RAM memory (do not confuse with memchunk !)
  * In the memslot table, the index 0 is for AVZ, the index 1 is for the two agency domains (domain 0 (non-RT) and domain 1 (RT))
@@ -49,6 +46,48 @@ memslot_entry_t memslot[MEMSLOT_NR];
 /* 8 bits per int int */
 unsigned int memchunk_bitmap[ME_MEMCHUNK_NR/32];
 
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+
+/*
+ * Lazy clearing of ME memory
+ *
+ * The memory of a ME is not cleared when the ME is injected. Only the chunks
+ * which receive the ME image are cleared and mapped in the stage-2 page table;
+ * the other chunks are cleared and mapped on the first access of the ME
+ * (see memslot_fault()).
+ *
+ * Free chunks are cleared in the background by the idle loop and are
+ * tracked in memchunk_zeroed so that they do not need to be cleared again.
+ */
+
+#define MEMCHUNK_SCRUB_STEP	SZ_64K
+
+static DEFINE_SPINLOCK(memchunk_lock);
+
+/* Chunks which are known to contain zeros only */
+static DECLARE_BITMAP(memchunk_zeroed, ME_MEMCHUNK_NR);
+
+/* Number of chunks available in RAM */
+static unsigned int memchunk_nr;
+
+/* Chunk currently cleared by memchunk_scrub() (-1 if none) and its progress */
+static int scrub_pos = -1;
+static unsigned int scrub_offset;
+
+#define memchunk_test(map, pos)		((map)[(pos) / BITS_PER_LONG] & (1UL << ((pos) % BITS_PER_LONG)))
+#define memchunk_set(map, pos)		((map)[(pos) / BITS_PER_LONG] |= (1UL << ((pos) % BITS_PER_LONG)))
+#define memchunk_clear(map, pos)	((map)[(pos) / BITS_PER_LONG] &= ~(1UL << ((pos) % BITS_PER_LONG)))
+
+static inline addr_t memchunk_base(void) {
+	return memslot[MEMSLOT_AGENCY].base_paddr + memslot[MEMSLOT_AGENCY].size;
+}
+
+static inline void *memchunk_vaddr(unsigned int pos) {
+	return (void *) (MEMCHUNK_VADDR + (addr_t) pos * ME_MEMCHUNK_SIZE);
+}
+
+#endif /* CONFIG_AVZ_ME_LAZY_MEM */
+
 /*
  * Returns the power of 2 (order) which matches the size
  */
@@ -74,7 +113,14 @@ unsigned int get_power_from_size(unsigned int bits_NR) {
 static unsigned int allocate_memslot(unsigned int order) {
 	int pos;
 
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+	/* Prevent the background clearing from touching chunks being allocated */
+	spin_lock(&memchunk_lock);
 	pos = bitmap_find_free_region((unsigned long *) &memchunk_bitmap, ME_MEMCHUNK_NR, order);
+	spin_unlock(&memchunk_lock);
+#else
+	pos = bitmap_find_free_region((unsigned long *) &memchunk_bitmap, ME_MEMCHUNK_NR, order);
+#endif
 	if (pos < 0)
 		return 0;
 
@@ -87,7 +133,13 @@ static void release_memslot(unsigned int addr, unsigned int order) {
 	pos = addr - memslot[1].base_paddr - memslot[1].size;
 	pos /= ME_MEMCHUNK_SIZE;
 
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+	spin_lock(&memchunk_lock);
+        bitmap_release_region((unsigned long *) &memchunk_bitmap, pos, order);
+	spin_unlock(&memchunk_lock);
+#else
         bitmap_release_region((unsigned long *) &memchunk_bitmap, pos, order);
+#endif
 }
 
 /*
@@ -149,6 +201,10 @@ int get_ME_free_slot(unsigned int size) {
         memslot[slotID].size = (1 << order) * ME_MEMCHUNK_SIZE;  /* Readjust size */
 	memslot[slotID].busy = true;
 
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+	bitmap_zero(memslot[slotID].populated, ME_MEMCHUNK_NR);
+#endif
+
 	/* Map the L2 virtual address space of ME #(slotID-1) to the physical RAM */
         create_mapping(NULL, memslot[slotID].base_vaddr, memslot[slotID].base_paddr, memslot[slotID].size, false);
 
@@ -194,3 +250,159 @@ void memslot_init(void) {
 	memset(memslot, 0, sizeof(memslot));
 }
 
+#ifdef CONFIG_AVZ_ME_LAZY_MEM
+
+/*
+ * Map the whole ME chunk area so that free chunks can be cleared.
+ * The agency memslot must be known at this point.
+ */
+void memchunk_init(void) {
+	addr_t base = memchunk_base();
+
+	memchunk_nr = min((unsigned long) ME_MEMCHUNK_NR, (mem_info.phys_base + mem_info.size - base) / ME_MEMCHUNK_SIZE);
+
+	create_mapping(NULL, MEMCHUNK_VADDR, base, memchunk_nr * ME_MEMCHUNK_SIZE, false);
+
+	bitmap_zero(memchunk_zeroed, ME_MEMCHUNK_NR);
+
+	printk("%s: %d chunks of ME memory available\n", __func__, memchunk_nr);
+}
+
+/**
+ * Clear a piece of a free chunk. This function is called from the idle loop.
+ *
+ * @return true if there are still free chunks to clear.
+ */
+bool memchunk_scrub(void) {
+	unsigned long flags;
+	unsigned int pos;
+
+	flags = spin_lock_irqsave(&memchunk_lock);
+
+	/* The chunk may have been allocated in the meanwhile. */
+	if ((scrub_pos >= 0) && test_bit(scrub_pos, (unsigned long *) memchunk_bitmap))
+		scrub_pos = -1;
+
+	if (scrub_pos < 0) {
+		for (pos = 0; pos < memchunk_nr; pos++)
+			if (!test_bit(pos, (unsigned long *) memchunk_bitmap) && !memchunk_test(memchunk_zeroed, pos))
+				break;
+
+		if (pos == memchunk_nr) {
+			spin_unlock_irqrestore(&memchunk_lock, flags);
+			return false;
+		}
+
+		scrub_pos = pos;
+		scrub_offset = 0;
+	}
+
+	memset(memchunk_vaddr(scrub_pos) + scrub_offset, 0, MEMCHUNK_SCRUB_STEP);
+	scrub_offset += MEMCHUNK_SCRUB_STEP;
+
+	if (scrub_offset == ME_MEMCHUNK_SIZE) {
+		memchunk_set(memchunk_zeroed, scrub_pos);
+		scrub_pos = -1;
+	}
+
+	spin_unlock_irqrestore(&memchunk_lock, flags);
+
+	return true;
+}
+
+/**
+ * Make a range of a ME memslot available: the chunks which are not populated
+ * yet are cleared (unless they are already known as zero) and mapped in the
+ * stage-2 page table of the ME if it exists.
+ *
+ * @param slotID	ME slot
+ * @param offset	offset of the range in the slot
+ * @param size		size of the range
+ * @return the number of chunks which have been populated
+ */
+int memslot_populate(unsigned int slotID, addr_t offset, size_t size) {
+	struct domain *d = domains[slotID];
+	unsigned int i, first, last, pos;
+	int count = 0;
+
+	if (!size)
+		return 0;
+
+	first = offset / ME_MEMCHUNK_SIZE;
+	last = (offset + size - 1) / ME_MEMCHUNK_SIZE;
+
+	BUG_ON((last + 1) * ME_MEMCHUNK_SIZE > memslot[slotID].size);
+
+	spin_lock(&memchunk_lock);
+
+	for (i = first; i <= last; i++) {
+		if (memchunk_test(memslot[slotID].populated, i))
+			continue;
+
+		pos = (memslot[slotID].base_paddr - memchunk_base()) / ME_MEMCHUNK_SIZE + i;
+
+		if (!memchunk_test(memchunk_zeroed, pos))
+			memset(memchunk_vaddr(pos), 0, ME_MEMCHUNK_SIZE);
+
+		/* The ME will write into it from now on */
+		memchunk_clear(memchunk_zeroed, pos);
+
+		memchunk_set(memslot[slotID].populated, i);
+
+		if (d && d->pagetable_vaddr)
+			__create_mapping((void *) d->pagetable_vaddr, memslot[slotID].ipa_addr + i * ME_MEMCHUNK_SIZE,
+					 memslot[slotID].base_paddr + i * ME_MEMCHUNK_SIZE, ME_MEMCHUNK_SIZE, false, S2);
+
+		count++;
+	}
+
+	spin_unlock(&memchunk_lock);
+
+	return count;
+}
+
+/*
+ * The whole slot is about to be overwritten (snapshot restore); there is
+ * no need to clear it.
+ */
+void memslot_set_populated(unsigned int slotID) {
+	unsigned int i, pos;
+
+	spin_lock(&memchunk_lock);
+
+	for (i = 0; i < memslot[slotID].size / ME_MEMCHUNK_SIZE; i++) {
+		pos = (memslot[slotID].base_paddr - memchunk_base()) / ME_MEMCHUNK_SIZE + i;
+
+		memchunk_clear(memchunk_zeroed, pos);
+		memchunk_set(memslot[slotID].populated, i);
+	}
+
+	spin_unlock(&memchunk_lock);
+}
+
+/**
+ * Handle a stage-2 translation fault raised by a ME on a chunk which has
+ * not been populated yet.
+ *
+ * @return true if the fault has been processed and the access can be replayed.
+ */
+bool memslot_fault(struct domain *d, unsigned long esr) {
+	unsigned int slotID = d->avz_shared->domID;
+	addr_t ipa;
+
+	if ((slotID < MEMSLOT_BASE) || (slotID >= MEMSLOT_NR) || is_idle_domain(d))
+		return false;
+
+	if ((esr & ESR_ELx_FSC_TYPE) != ESR_ELx_FSC_FAULT)
+		return false;
+
+	ipa = read_sysreg(hpfar_el2) << 8;
+
+	if ((ipa < memslot[slotID].ipa_addr) || (ipa >= memslot[slotID].ipa_addr + memslot[slotID].size))
+		return false;
+
+	return (memslot_populate(slotID, ipa - memslot[slotID].ipa_addr, PAGE_SIZE) > 0);
+}
+
+#endif /* CONFIG_AVZ_ME_LAZY_MEM */
+
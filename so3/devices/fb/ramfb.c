@@ -14,6 +14,7 @@
 #include <heap.h>
 #include <memory.h>
 #include <errno.h>
+#include <process.h>
 
 #include <asm/mmu.h>
 
@@ -70,6 +71,9 @@ typedef struct {
 	unsigned long screen_size;
 	uint8_t *screen_buffer;
 
+	/* Physical address of the (contiguous) screen buffer */
+	addr_t screen_phys;
+
 	struct ramfb_mode mode;
 
 	uint32_t xres;
@@ -220,15 +224,17 @@ static int ramfb_alloc(void *fw_cfg_base, ramfb_t *fbi)
 
 	fbi->screen_size = RAMFB_DRIVER_VIDEO_WIDTH * RAMFB_DRIVER_VIDEO_HEIGHT * (fbi->mode.bpp / 8);
 
-	fbi->screen_buffer = (void *) get_contig_free_vpages(fbi->screen_size / PAGE_SIZE);
+	fbi->screen_phys = get_contig_free_pages(fbi->screen_size / PAGE_SIZE);
 
-	if (!fbi->screen_buffer) {
+	if (!fbi->screen_phys) {
 		printk("QEMU-ramfb: Unable to use FB\n");
 
 		return -1;
 	}
 
-	etc_ramfb.addr = (uintptr_t) __pa(fbi->screen_buffer);
+	fbi->screen_buffer = (void *) io_map(fbi->screen_phys, fbi->screen_size);
+
+	etc_ramfb.addr = (uintptr_t) fbi->screen_phys;
 
 	etc_ramfb.addr = __builtin_bswap64(etc_ramfb.addr);
 	etc_ramfb.fourcc = __builtin_bswap32(fb_mode.drm_format);
@@ -258,22 +264,18 @@ int check_fw_cfg_dma(void *fw_cfg_base) {
 
 void *fb_mmap(int fd, addr_t virt_addr, uint32_t page_count)
 {
-	uint32_t i, page;
 	pcb_t *pcb = current()->pcb;
 
-#if 0
-	virt_addr = malloc(page_count*PAGE_SIZE);
-	BUG_ON(!virt_addr);
-#endif
-
-#if 1
-	for (i = 0; i < page_count; i++) {
-		/* Map a process' virtual page to the physical one (here the VRAM). */
-		page = (addr_t) __pa(__fbi->screen_buffer + i * PAGE_SIZE);
-
-		create_mapping(pcb->pgtable, virt_addr + (i * PAGE_SIZE), page, PAGE_SIZE, false);
+	/* The mapping may not go beyond the framebuffer */
+	if (!page_count || (page_count > (ALIGN_UP(__fbi->screen_size, PAGE_SIZE) >> PAGE_SHIFT))) {
+		set_errno(EINVAL);
+		return NULL;
 	}
-#endif
+
+	/* The whole VRAM is mapped at once so that 2 MB blocks and contiguous
+	 * PTEs are used whenever the addresses allow it.
+	 */
+	create_mapping(pcb->pgtable, virt_addr, __fbi->screen_phys, page_count * PAGE_SIZE, false);
 
 	return (void *) virt_addr;
 }
@@ -21,6 +21,7 @@
 #include <thread.h>
 #include <heap.h>
 #include <string.h>
+#include <trace.h>
 #include <thread.h>
 
 #include <device/irq.h>
@@ -88,9 +89,13 @@ void irq_process(uint32_t irq) {
 
 	/* Immediate (top half) processing */
 
+	trace(TRACE_IRQ_ENTRY, irq, 0);
+
 	if (irqdesc[irq].action != NULL)
 		ret = irqdesc[irq].action(irq, irqdesc[irq].data);
 
+	trace(TRACE_IRQ_EXIT, irq, 0);
+
 	/*
 	 * Deferred (bottom half) processing.
 	 * A thread is created and started if it is the case.
@@ -173,7 +178,15 @@ void irq_disable(int irq) {
 		irq_to_desc(irq)->irq_ops->disable(irq);
 }
 
+/* Registers of the context interrupted by the IRQ being processed */
+static DEFINE_PER_CPU(cpu_regs_t *, irq_regs);
+
+cpu_regs_t *get_irq_regs(void) {
+	return this_cpu(irq_regs);
+}
+
 void irq_handle(cpu_regs_t *regs) {
+	cpu_regs_t *old_regs;
 
 	/* The following boolean indicates we are currently in the interrupt call path.
 	 * It will be reset at the end of the softirq processing.
@@ -181,8 +194,13 @@ void irq_handle(cpu_regs_t *regs) {
 
 	__in_interrupt = true;
 
+	old_regs = this_cpu(irq_regs);
+	this_cpu(irq_regs) = regs;
+
 	irq_ops.handle_low(regs);
 
+	this_cpu(irq_regs) = old_regs;
+
 	/* Out of this interrupt routine, IRQs must be enabled otherwise the thread
 	 * will block all interrupts.
 	 */
@@ -17,8 +17,17 @@
  */
 
 
+#include <printk.h>
+
 #include <device/net.h>
 
+#include <net/lwip/netif.h>
+#include <net/lwip/pbuf.h>
+#include <net/lwip/ip.h>
+#include <net/lwip/udp.h>
+#include <net/lwip/inet_chksum.h>
+#include <net/lwip/prot/ethernet.h>
+
 struct list_head eth_dev_list = LIST_HEAD_INIT(eth_dev_list);
 
 /*
@@ -42,3 +51,75 @@ void network_devices_init(void){
 void network_devices_register(eth_dev_t *eth_dev){
         list_add_tail(&eth_dev->list, &eth_dev_list);
 }
+
+/*
+ * Let lwIP skip the checksums the device takes care of. To be called from the
+ * netif init callback, netif_add() enabling all checksums beforehand.
+ */
+void eth_dev_setup_netif(eth_dev_t *eth_dev, struct netif *netif)
+{
+        u16_t flags = NETIF_CHECKSUM_ENABLE_ALL;
+
+        if (eth_dev->features & ETH_DEV_F_TX_CSUM)
+                flags &= ~(NETIF_CHECKSUM_GEN_TCP | NETIF_CHECKSUM_GEN_UDP);
+
+        if (eth_dev->features & ETH_DEV_F_RX_CSUM)
+                flags &= ~(NETIF_CHECKSUM_CHECK_TCP | NETIF_CHECKSUM_CHECK_UDP);
+
+        NETIF_SET_CHECKSUM_CTRL(netif, flags);
+
+        printk("%s:%s%s%s%s\n", eth_dev->name,
+               ((eth_dev->features & ETH_DEV_F_TX_CSUM) ? " tx-csum" : ""),
+               ((eth_dev->features & ETH_DEV_F_RX_CSUM) ? " rx-csum" : ""),
+               ((eth_dev->features & ETH_DEV_F_SG) ? " sg" : ""),
+               ((eth_dev->features & ETH_DEV_F_RX_PREPOST) ? " rx-prepost" : ""));
+}
+
+/*
+ * Verify the TCP/UDP checksum of a received Ethernet frame in software.
+ * Used by an ETH_DEV_F_RX_CSUM device for the frames it could not validate,
+ * since lwIP does not check them anymore on this netif. Frames which are not
+ * TCP/UDP over IPv4, and IP fragments, are accepted as is.
+ */
+bool eth_dev_rx_csum_ok(struct pbuf *p)
+{
+        struct eth_hdr *ethhdr = (struct eth_hdr *) p->payload;
+        struct ip_hdr *iphdr;
+        ip4_addr_t src, dest;
+        u16_t iphlen, len;
+        u8_t proto;
+        bool ok;
+
+        if ((p->len < SIZEOF_ETH_HDR + IP_HLEN) || (ethhdr->type != PP_HTONS(ETHTYPE_IP)))
+                return true;
+
+        iphdr = (struct ip_hdr *) ((u8_t *) p->payload + SIZEOF_ETH_HDR);
+        iphlen = IPH_HL_BYTES(iphdr);
+        proto = IPH_PROTO(iphdr);
+
+        if ((proto != IP_PROTO_TCP) && (proto != IP_PROTO_UDP))
+                return true;
+
+        if (IPH_OFFSET(iphdr) & PP_HTONS(IP_OFFMASK | IP_MF))
+                return true;
+
+        len = lwip_ntohs(IPH_LEN(iphdr));
+        if ((len < iphlen) || (p->len < SIZEOF_ETH_HDR + iphlen) || (p->tot_len < SIZEOF_ETH_HDR + len))
+                return false;
+
+        len -= iphlen;
+
+        /* No checksum */
+        if ((proto == IP_PROTO_UDP) && (len >= UDP_HLEN) &&
+            !((struct udp_hdr *) ((u8_t *) iphdr + iphlen))->chksum)
+                return true;
+
+        ip4_addr_copy(src, iphdr->src);
+        ip4_addr_copy(dest, iphdr->dest);
+
+        pbuf_remove_header(p, SIZEOF_ETH_HDR + iphlen);
+        ok = (inet_chksum_pseudo_partial(p, proto, len, len, &src, &dest) == 0);
+        pbuf_add_header(p, SIZEOF_ETH_HDR + iphlen);
+
+        return ok;
+}
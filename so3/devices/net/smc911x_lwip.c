@@ -54,6 +54,10 @@
 
 #include <net/netif/ethernet.h>
 
+#ifdef CONFIG_NET_ZEROCOPY_RX
+#include <net/zerocopy.h>
+#endif
+
 #define ETHERNET_LAYER_2_MAX_LENGTH 1522
 
 /* Basic mode control register. */
@@ -229,6 +233,11 @@ static int smc911x_rx(struct netif *netif)
 
                 tmplen = (pktlen + 3) / 4;
 
+#ifdef CONFIG_NET_ZEROCOPY_RX
+                /* Into the zero-copy pool when possible, so that the frame can be mapped by the receiver */
+                buf = net_zc_pbuf_alloc(pktlen);
+                if (!buf)
+#endif
                 /* Wait until a buffer is available. */
                 while((buf = pbuf_alloc(PBUF_RAW, pktlen, PBUF_RAM)) == NULL){
                         /* Wait a little bit to hopefully get a buffer */
@@ -436,6 +445,8 @@ err_t smc911x_lwip_init(struct netif *netif)
 
         netif->linkoutput = smc911x_lwip_send;
 
+        /* No offload; frames are copied through the FIFO in both directions */
+        eth_dev_setup_netif(eth_dev, netif);
 
         printk(DRIVERNAME ": detected %s controller\n", id->name);
 
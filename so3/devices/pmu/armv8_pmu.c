@@ -0,0 +1,274 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Sampling profiler based on the ARMv8 PMU.
+ *
+ * The cycle counter (or event counter 0 if another event is selected) is loaded
+ * so that it overflows after <period> events. On the overflow interrupt, the PC
+ * and LR of the interrupted context are recorded along with the current thread
+ * into a per-CPU buffer, which is read from /dev/profile.
+ *
+ * Sampling is programmed on the CPU which issues PROFILE_IOCTL_START.
+ */
+
+#include <common.h>
+#include <compiler.h>
+#include <process.h>
+#include <smp.h>
+#include <vfs.h>
+#include <profile.h>
+
+#include <device/device.h>
+#include <device/driver.h>
+#include <device/irq.h>
+
+#include <asm/processor.h>
+
+#define ARMV8_PMCR_E		(1 << 0)	/* Enable all counters */
+#define ARMV8_PMCR_P		(1 << 1)	/* Reset the event counters */
+#define ARMV8_PMCR_C		(1 << 2)	/* Reset the cycle counter */
+#define ARMV8_PMCR_LC		(1 << 6)	/* 64-bit cycle counter overflow */
+#define ARMV8_PMCR_N_SHIFT	11
+#define ARMV8_PMCR_N_MASK	0x1f
+
+#define ARMV8_CYCLE_COUNTER	31
+
+#define PROFILE_DEFAULT_PERIOD	100000
+
+#define PROFILE_BUF_SIZE	(1 << CONFIG_PROFILE_BUF_SHIFT)
+#define PROFILE_BUF_MASK	(PROFILE_BUF_SIZE - 1)
+
+struct profile_buf {
+	struct profile_sample samples[PROFILE_BUF_SIZE];
+
+	/* Written by the PMU interrupt of the CPU */
+	unsigned long head;
+
+	/* Written by the reader of /dev/profile */
+	unsigned long tail;
+
+	unsigned long lost;
+} __attribute__((aligned(64)));
+
+static struct profile_buf profile_bufs[CONFIG_NR_CPUS];
+
+static struct {
+	irq_def_t irq_def;
+
+	/* Number of event counters besides the cycle counter */
+	unsigned int nr_counters;
+
+	u32 period;
+	int event;
+} armv8_pmu = {
+	.event = PROFILE_EVENT_CYCLES,
+};
+
+static inline u32 pmu_counter_mask(void)
+{
+	return ((armv8_pmu.event == PROFILE_EVENT_CYCLES) ? (1 << ARMV8_CYCLE_COUNTER) : (1 << 0));
+}
+
+/*
+ * Load the counter so that it overflows after <period> events.
+ * The cycle counter overflows on bit 31 as long as PMCR.LC is cleared.
+ */
+static void pmu_load_counter(void)
+{
+	u32 val = 0 - armv8_pmu.period;
+
+	if (armv8_pmu.event == PROFILE_EVENT_CYCLES)
+		write_sysreg(val, pmccntr_el0);
+	else
+		write_sysreg(val, pmevcntr0_el0);
+}
+
+static void pmu_stop(void)
+{
+	write_sysreg(0xffffffff, pmcntenclr_el0);
+	write_sysreg(0xffffffff, pmintenclr_el1);
+	write_sysreg(0xffffffff, pmovsclr_el0);
+	isb();
+}
+
+static void pmu_start(u32 period)
+{
+	unsigned long flags;
+
+	flags = local_irq_save();
+
+	pmu_stop();
+
+	armv8_pmu.period = (period ? period : PROFILE_DEFAULT_PERIOD);
+
+	/* Count at EL0 and EL1 */
+	if (armv8_pmu.event == PROFILE_EVENT_CYCLES)
+		write_sysreg(0, pmccfiltr_el0);
+	else
+		write_sysreg(armv8_pmu.event & 0xffff, pmevtyper0_el0);
+
+	pmu_load_counter();
+
+	write_sysreg(pmu_counter_mask(), pmintenset_el1);
+	write_sysreg(pmu_counter_mask(), pmcntenset_el0);
+
+	write_sysreg((read_sysreg(pmcr_el0) & ~ARMV8_PMCR_LC) | ARMV8_PMCR_E, pmcr_el0);
+	isb();
+
+	local_irq_restore(flags);
+}
+
+static void profile_record(cpu_regs_t *regs)
+{
+	struct profile_buf *buf = &profile_bufs[smp_processor_id()];
+	struct profile_sample *s;
+	tcb_t *tcb = current();
+
+	if (buf->head - __atomic_load_n(&buf->tail, __ATOMIC_ACQUIRE) == PROFILE_BUF_SIZE) {
+		buf->lost++;
+		return;
+	}
+
+	s = &buf->samples[buf->head & PROFILE_BUF_MASK];
+
+	s->pc = regs->pc;
+	s->lr = regs->lr;
+	s->tid = (tcb ? tcb->tid : 0);
+	s->pid = ((tcb && tcb->pcb) ? tcb->pcb->pid : 0);
+	s->cpu = smp_processor_id();
+	s->flags = (((regs->pstate & PSR_MODE_MASK) == PSR_MODE_EL0t) ? PROFILE_SAMPLE_USER : 0);
+
+	__atomic_store_n(&buf->head, buf->head + 1, __ATOMIC_RELEASE);
+}
+
+static irq_return_t armv8_pmu_isr(int irq, void *dummy)
+{
+	u32 ovs = read_sysreg(pmovsclr_el0);
+
+	write_sysreg(ovs, pmovsclr_el0);
+
+	if (ovs & pmu_counter_mask()) {
+		profile_record(get_irq_regs());
+		pmu_load_counter();
+	}
+
+	return IRQ_COMPLETED;
+}
+
+/*
+ * Return as many samples as <count> bytes can hold, CPU after CPU.
+ */
+static int profile_read(int fd, void *buffer, int count)
+{
+	struct profile_sample *out = buffer;
+	struct profile_buf *buf;
+	unsigned long head;
+	int cpu, n = 0;
+
+	for (cpu = 0; cpu < CONFIG_NR_CPUS; cpu++) {
+		buf = &profile_bufs[cpu];
+		head = __atomic_load_n(&buf->head, __ATOMIC_ACQUIRE);
+
+		while ((buf->tail != head) && ((n + 1) * sizeof(struct profile_sample) <= count)) {
+			out[n++] = buf->samples[buf->tail & PROFILE_BUF_MASK];
+			__atomic_store_n(&buf->tail, buf->tail + 1, __ATOMIC_RELEASE);
+		}
+	}
+
+	return n * sizeof(struct profile_sample);
+}
+
+static int profile_ioctl(int fd, unsigned long cmd, unsigned long args)
+{
+	unsigned long lost = 0;
+	int cpu;
+
+	switch (cmd) {
+
+	case PROFILE_IOCTL_START:
+		pmu_start(args);
+		return 0;
+
+	case PROFILE_IOCTL_STOP:
+		pmu_stop();
+		return 0;
+
+	case PROFILE_IOCTL_RESET:
+		for (cpu = 0; cpu < CONFIG_NR_CPUS; cpu++) {
+			profile_bufs[cpu].tail = READ_ONCE(profile_bufs[cpu].head);
+			profile_bufs[cpu].lost = 0;
+		}
+		return 0;
+
+	case PROFILE_IOCTL_EVENT:
+		if (((int) args != PROFILE_EVENT_CYCLES) && !armv8_pmu.nr_counters)
+			return -1;
+
+		pmu_stop();
+		armv8_pmu.event = (int) args;
+		return 0;
+
+	case PROFILE_IOCTL_LOST:
+		for (cpu = 0; cpu < CONFIG_NR_CPUS; cpu++)
+			lost += profile_bufs[cpu].lost;
+		return lost;
+
+	default:
+		/* Unknown command. */
+		return -1;
+	}
+}
+
+struct file_operations profile_fops = {
+	.read = profile_read,
+	.ioctl = profile_ioctl
+};
+
+struct devclass profile_dev = {
+	.class = "profile",
+	.type = VFS_TYPE_DEV_CHAR,
+	.fops = &profile_fops,
+};
+
+static int armv8_pmu_init(dev_t *dev, int fdt_offset)
+{
+	unsigned int pmuver;
+
+	pmuver = (read_sysreg(id_aa64dfr0_el1) >> ID_AA64DFR0_PMUVER_SHIFT) & 0xf;
+
+	/* 0xf is an IMPLEMENTATION DEFINED PMU */
+	if (!pmuver || (pmuver == 0xf)) {
+		lprintk("%s: no ARMv8 PMU on this CPU\n", __func__);
+		return -1;
+	}
+
+	armv8_pmu.nr_counters = (read_sysreg(pmcr_el0) >> ARMV8_PMCR_N_SHIFT) & ARMV8_PMCR_N_MASK;
+
+	pmu_stop();
+	write_sysreg(ARMV8_PMCR_P | ARMV8_PMCR_C, pmcr_el0);
+
+	fdt_interrupt_node(fdt_offset, &armv8_pmu.irq_def);
+	irq_bind(armv8_pmu.irq_def.irqnr, armv8_pmu_isr, NULL, NULL);
+
+	devclass_register(dev, &profile_dev);
+
+	return 0;
+}
+
+REGISTER_DRIVER_POSTCORE("arm,armv8-pmuv3", armv8_pmu_init);
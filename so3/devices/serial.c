@@ -135,6 +135,19 @@ int serial_write(char *str, int len) {
 	return len;
 }
 
+/*
+ * Called by the UART driver when its TX FIFO has room again.
+ */
+void serial_tx_interrupt(void) {
+#ifdef CONFIG_PRINTK_RING
+	console_flush();
+#else
+	/* Nobody is waiting for the FIFO */
+	if (serial_ops.tx_irq)
+		serial_ops.tx_irq(false);
+#endif
+}
+
 /* This function will query the size of the serial terminal*/
 int serial_gwinsize(struct winsize *wsz)
 {
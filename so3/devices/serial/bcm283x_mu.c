@@ -36,6 +36,10 @@ void *__uart_vaddr = (void *) CONFIG_UART_LL_PADDR;
 typedef struct {
 	addr_t base;
 	bcm283x_mu_t *dev;
+	irq_def_t irq_def;
+
+	/* Bytes which can still be pushed to the TX FIFO without checking LSR */
+	int tx_room;
 } bcm283x_mu_dev_t;
 
 static bcm283x_mu_dev_t bcm283x_mu_dev =
@@ -58,9 +62,68 @@ static int bcm283x_mu_put_byte(char c)
 		iowrite8(&bcm283x_mu->io, '\r');	/* Carriage return */
 	}
 
+	/* The FIFO level is not known anymore */
+	bcm283x_mu_dev.tx_room = 0;
+
 	return 0;
 }
 
+/*
+ * Push a byte to the TX FIFO without waiting. The whole FIFO is free once
+ * the transmitter is idle; otherwise, only one byte is guaranteed to fit.
+ */
+static int bcm283x_mu_tx_put_byte(char c)
+{
+	bcm283x_mu_t *bcm283x_mu = (bcm283x_mu_t *) bcm283x_mu_dev.base;
+	int needed = ((c == '\n') ? 2 : 1);
+	u32 lsr;
+
+	if (bcm283x_mu_dev.tx_room < needed) {
+		lsr = ioread32(&bcm283x_mu->lsr);
+
+		if (lsr & UART_LSR_TX_IDLE)
+			bcm283x_mu_dev.tx_room = UART_FIFO_SIZE;
+		else if (lsr & UART_LSR_TX_READY)
+			bcm283x_mu_dev.tx_room = 1;
+
+		if (bcm283x_mu_dev.tx_room < needed)
+			return 0;
+	}
+
+	iowrite32(&bcm283x_mu->io, (uint32_t) c);
+
+	if (c == '\n')
+		iowrite32(&bcm283x_mu->io, '\r');
+
+	bcm283x_mu_dev.tx_room -= needed;
+
+	return 1;
+}
+
+static void bcm283x_mu_tx_irq(bool enable)
+{
+	bcm283x_mu_t *bcm283x_mu = (bcm283x_mu_t *) bcm283x_mu_dev.base;
+
+	if (enable)
+		iowrite32(&bcm283x_mu->ier, ioread32(&bcm283x_mu->ier) | UART_IER_TX);
+	else
+		iowrite32(&bcm283x_mu->ier, ioread32(&bcm283x_mu->ier) & ~UART_IER_TX);
+}
+
+/*
+ * The AUX interrupt is shared with the SPI1/SPI2 controllers.
+ */
+static irq_return_t bcm283x_mu_int(int irq, void *dummy)
+{
+	bcm283x_mu_t *bcm283x_mu = (bcm283x_mu_t *) bcm283x_mu_dev.base;
+	u32 iir = ioread32(&bcm283x_mu->iir);
+
+	if (!(iir & UART_IIR_NO_INT) && ((iir & UART_IIR_ID) == UART_IIR_TX))
+		serial_tx_interrupt();
+
+	return IRQ_COMPLETED;
+}
+
 void printch(char c) {
 	bcm283x_mu_put_byte(c);
 	
@@ -104,6 +167,17 @@ static int bcm283x_mu_init(dev_t *dev, int fdt_offset)
 	serial_ops.put_byte = bcm283x_mu_put_byte;
 	serial_ops.get_byte = bcm283x_mu_get_byte;
 
+	/* Interrupt-driven transmit if the AUX interrupt is described */
+	if (fdt_getprop(__fdt_addr, fdt_offset, "interrupts", NULL)) {
+
+		fdt_interrupt_node(fdt_offset, &bcm283x_mu_dev.irq_def);
+		irq_bind(bcm283x_mu_dev.irq_def.irqnr, bcm283x_mu_int, NULL, NULL);
+		irq_ops.enable(bcm283x_mu_dev.irq_def.irqnr);
+
+		serial_ops.tx_put_byte = bcm283x_mu_tx_put_byte;
+		serial_ops.tx_irq = bcm283x_mu_tx_irq;
+	}
+
 	return 0;
 
 }
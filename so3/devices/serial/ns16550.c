@@ -35,6 +35,9 @@ typedef struct {
 
 	ns16550_t *io;
 
+	/* Bytes which can still be pushed to the TX FIFO without checking LSR */
+	int tx_room;
+
 } ns16550_dev_t;
 
 static ns16550_dev_t ns16550_dev =
@@ -75,9 +78,55 @@ static int ns16550_put_byte(char c)
 		iowrite8(&ns16550_dev.io->rbr, c); /* Transmit char */
 	}
 
+	/* The FIFO level is not known anymore */
+	ns16550_dev.tx_room = 0;
+
 	return 0;
 }
 
+/*
+ * Push a byte to the TX FIFO without waiting. THRE tells that the whole FIFO is empty,
+ * so it is only checked once the room known from the previous check is used up.
+ */
+static int ns16550_tx_put_byte(char c)
+{
+	int needed = ((c == '\n') ? 2 : 1);
+
+	if (ns16550_dev.tx_room < needed) {
+		if ((ioread32(&ns16550_dev.io->lsr) & UART_LSR_THRE) == 0)
+			return 0;
+
+		ns16550_dev.tx_room = UART_FIFO_SIZE;
+	}
+
+	iowrite8(&ns16550_dev.io->rbr, c);
+
+	if (c == '\n')
+		iowrite8(&ns16550_dev.io->rbr, '\r');
+
+	ns16550_dev.tx_room -= needed;
+
+	return 1;
+}
+
+static void ns16550_tx_irq(bool enable)
+{
+	if (enable)
+		iowrite32(&ns16550_dev.io->ier, ioread32(&ns16550_dev.io->ier) | UART_IER_THRI);
+	else
+		iowrite32(&ns16550_dev.io->ier, ioread32(&ns16550_dev.io->ier) & ~UART_IER_THRI);
+}
+
+static irq_return_t ns16550_int(int irq, void *dummy)
+{
+	u32 iir = ioread32(&ns16550_dev.io->iir);
+
+	if (!(iir & UART_IIR_NO_INT) && ((iir & UART_IIR_ID) == UART_IIR_THRI))
+		serial_tx_interrupt();
+
+	return IRQ_COMPLETED;
+}
+
 void __ll_put_byte(char c) {
 	ns16550_put_byte(c);
 }
@@ -135,6 +184,19 @@ static int ns16550_init(dev_t *dev, int fdt_offset)
 	/* Force RTS and DTR lines */
 	iowrite32(&ns16550_dev.io->mcr, UART_RTS | UART_DTR);
 
+	/* Interrupt-driven transmit if the UART interrupt is described */
+	if (fdt_getprop(__fdt_addr, fdt_offset, "interrupts", NULL)) {
+
+		iowrite32(&ns16550_dev.io->fcr, UART_FCR_ENABLE_FIFO | UART_FCR_CLEAR_RCVR | UART_FCR_CLEAR_XMIT);
+
+		fdt_interrupt_node(fdt_offset, &ns16550_dev.irq_def);
+		irq_bind(ns16550_dev.irq_def.irqnr, ns16550_int, NULL, NULL);
+		irq_ops.enable(ns16550_dev.irq_def.irqnr);
+
+		serial_ops.tx_put_byte = ns16550_tx_put_byte;
+		serial_ops.tx_irq = ns16550_tx_irq;
+	}
+
 	return 0;
 
 }
@@ -61,6 +61,26 @@ static int pl011_put_byte(char c) {
 	return 1;
 }
 
+/*
+ * Push a byte to the TX FIFO without waiting for room.
+ */
+static int pl011_tx_put_byte(char c) {
+
+	if (ioread16(pl011.base + UART01x_FR) & UART01x_FR_TXFF)
+		return 0;
+
+	iowrite16(pl011.base + UART01x_DR, c);
+
+	return 1;
+}
+
+static void pl011_tx_irq(bool enable) {
+	if (enable)
+		iowrite16(pl011.base + UART011_IMSC, ioread16(pl011.base + UART011_IMSC) | UART011_TXIM);
+	else
+		iowrite16(pl011.base + UART011_IMSC, ioread16(pl011.base + UART011_IMSC) & ~UART011_TXIM);
+}
+
 static char pl011_get_byte(bool polling) {
 	char tmp;
 
@@ -127,6 +147,13 @@ static irq_return_t pl011_int(int irq, void *dummy)
 
 				prod = (prod + 1) % SERIAL_BUFFER_SIZE;
 			}
+
+			/* The TX FIFO went below its trigger level, go on with the pending output */
+			if (status & UART011_TXIS) {
+				iowrite16(pl011.base + UART011_ICR, UART011_TXIS);
+				serial_tx_interrupt();
+			}
+
 			if (pass_counter-- == 0)
 				break;
 
@@ -182,6 +209,10 @@ static int pl011_init(dev_t *dev, int fdt_offset) {
 
 	serial_ops.enable_irq();
 
+	/* The TX interrupt is enabled only when the FIFO gets full */
+	serial_ops.tx_put_byte = pl011_tx_put_byte;
+	serial_ops.tx_irq = pl011_tx_irq;
+
 	return 0;
 }
 
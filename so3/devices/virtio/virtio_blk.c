@@ -0,0 +1,476 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * virtio block device.
+ *
+ * A transfer is split into requests of at most max_sectors sectors which are
+ * all submitted before the first one is waited for, so that the device keeps
+ * several of them in flight. Each request uses an indirect descriptor table
+ * (header, data segments, status) and therefore a single ring entry.
+ *
+ * The requests complete in the interrupt handler. Before the IRQs are enabled
+ * (the rootfs is mounted by vfs_init()), the device is polled instead.
+ */
+
+#include <common.h>
+#include <heap.h>
+#include <memory.h>
+#include <string.h>
+#include <compiler.h>
+#include <completion.h>
+#include <process.h>
+#include <part.h>
+
+#include <device/irq.h>
+#include <device/virtio.h>
+
+#include <asm/mmu.h>
+#include <asm/processor.h>
+
+/* Feature bits */
+#define VIRTIO_BLK_F_SIZE_MAX	1
+#define VIRTIO_BLK_F_SEG_MAX	2
+#define VIRTIO_BLK_F_RO		5
+
+/* Configuration space */
+#define VIRTIO_BLK_CFG_CAPACITY	0
+#define VIRTIO_BLK_CFG_SIZE_MAX	8
+#define VIRTIO_BLK_CFG_SEG_MAX	12
+
+/* Request types and status */
+#define VIRTIO_BLK_T_IN		0
+#define VIRTIO_BLK_T_OUT	1
+
+#define VIRTIO_BLK_S_OK		0
+
+#define VIRTIO_BLK_SECTOR_SIZE	512
+
+#define VIRTIO_BLK_QUEUE_SIZE	128
+
+/* Number of requests which can be in flight */
+#define VIRTIO_BLK_NR_REQS	32
+
+/* Maximum number of requests submitted at once by a single transfer */
+#define VIRTIO_BLK_BATCH	8
+
+/* Data segments of a request, and the largest request (64 KB) */
+#define VIRTIO_BLK_MAX_SEGS	32
+#define VIRTIO_BLK_MAX_SECTORS	128
+
+struct virtio_blk_outhdr {
+	u32 type;
+	u32 reserved;
+	u64 sector;
+};
+
+struct virtio_blk_req {
+	struct list_head list;
+
+	struct virtio_blk_outhdr hdr;
+	u8 status;
+
+	/* Set when the device has used the request */
+	volatile bool done;
+
+	/* The submitter polls the device instead of sleeping */
+	bool polled;
+	completion_t wait;
+
+	/* Header, data segments and status */
+	struct virtio_sg sg[VIRTIO_BLK_MAX_SEGS + 2];
+	struct virtq_desc table[VIRTIO_BLK_MAX_SEGS + 2];
+};
+
+struct virtio_blk {
+	struct virtio_device *vdev;
+	struct virtqueue *vq;
+
+	block_dev_desc_t block_dev;
+
+	bool ro;
+
+	/* Limits of a single request */
+	unsigned int max_segs;
+	u32 size_max;
+	unsigned int max_sectors;
+
+	/* Free requests */
+	struct list_head free_reqs;
+	unsigned int req_waiters;
+	completion_t req_avail;
+	spinlock_t lock;
+};
+
+/* The (first) virtio block device is used for the rootfs */
+static struct virtio_blk *virtio_blk;
+
+static struct virtio_blk_req *virtio_blk_get_req(struct virtio_blk *vblk, bool wait) {
+	struct virtio_blk_req *req;
+	unsigned long flags;
+
+	flags = spin_lock_irqsave(&vblk->lock);
+
+	while (list_empty(&vblk->free_reqs)) {
+		if (!wait) {
+			spin_unlock_irqrestore(&vblk->lock, flags);
+			return NULL;
+		}
+
+		vblk->req_waiters++;
+		spin_unlock_irqrestore(&vblk->lock, flags);
+
+		wait_for_completion(&vblk->req_avail);
+
+		flags = spin_lock_irqsave(&vblk->lock);
+		vblk->req_waiters--;
+	}
+
+	req = list_first_entry(&vblk->free_reqs, struct virtio_blk_req, list);
+	list_del(&req->list);
+
+	spin_unlock_irqrestore(&vblk->lock, flags);
+
+	return req;
+}
+
+static void virtio_blk_put_req(struct virtio_blk *vblk, struct virtio_blk_req *req) {
+	unsigned long flags;
+	bool waiters;
+
+	flags = spin_lock_irqsave(&vblk->lock);
+
+	list_add(&req->list, &vblk->free_reqs);
+	waiters = (vblk->req_waiters > 0);
+
+	spin_unlock_irqrestore(&vblk->lock, flags);
+
+	if (waiters)
+		complete(&vblk->req_avail);
+}
+
+/*
+ * Used buffers notification, in interrupt context or from the polling loop.
+ */
+static void virtio_blk_done(struct virtqueue *vq) {
+	struct virtio_blk_req *req;
+
+	while ((req = virtqueue_get_buf(vq, NULL)) != NULL) {
+		WRITE_ONCE(req->done, true);
+
+		if (!req->polled)
+			complete(&req->wait);
+	}
+}
+
+static void virtio_blk_wait(struct virtio_blk *vblk, struct virtio_blk_req *req) {
+	if (req->polled) {
+		while (!READ_ONCE(req->done))
+			virtio_interrupt(vblk->vdev);
+	} else
+		wait_for_completion(&req->wait);
+}
+
+/*
+ * Physical address of a byte of the buffer. A user buffer may not be
+ * populated yet (demand paging), the device cannot fault on it.
+ */
+static addr_t virtio_blk_phys(addr_t vaddr) {
+	if (user_space_vaddr(vaddr) && !user_page_mapped(current_pgtable(), vaddr & PAGE_MASK))
+		if (proc_demand_page(vaddr))
+			return 0;
+
+	return virt_to_phys_pt(vaddr);
+}
+
+/*
+ * Describe a virtually contiguous buffer with physically contiguous segments.
+ *
+ * @return	the number of segments, -1 on error
+ */
+static int virtio_blk_map(struct virtio_blk *vblk, addr_t vaddr, size_t len, struct virtio_sg *sg) {
+	unsigned int nr = 0;
+	addr_t paddr;
+	size_t chunk;
+
+	while (len) {
+		chunk = PAGE_SIZE - (vaddr & ~PAGE_MASK);
+		if (chunk > len)
+			chunk = len;
+
+		paddr = virtio_blk_phys(vaddr);
+		if (!paddr)
+			return -1;
+
+		if (nr && (sg[nr-1].paddr + sg[nr-1].len == paddr) && (sg[nr-1].len + chunk <= vblk->size_max))
+			sg[nr-1].len += chunk;
+		else {
+			if (nr == vblk->max_segs)
+				return -1;
+
+			sg[nr].paddr = paddr;
+			sg[nr].len = chunk;
+			nr++;
+		}
+
+		vaddr += chunk;
+		len -= chunk;
+	}
+
+	return nr;
+}
+
+/*
+ * Prepare and queue a request for <count> sectors. The device is not notified.
+ *
+ * @return	0 on success, -1 if the buffer cannot be mapped, 1 if the ring is full
+ */
+static int virtio_blk_queue(struct virtio_blk *vblk, struct virtio_blk_req *req, u32 type,
+			    lbaint_t sector, lbaint_t count, addr_t buffer, bool polled) {
+	unsigned int out, in;
+	int nr, ret;
+
+	req->hdr.type = type;
+	req->hdr.reserved = 0;
+	req->hdr.sector = sector;
+	req->status = 0xff;
+	req->done = false;
+	req->polled = polled;
+
+	init_completion(&req->wait);
+
+	req->sg[0].paddr = __pa(&req->hdr);
+	req->sg[0].len = sizeof(struct virtio_blk_outhdr);
+
+	nr = virtio_blk_map(vblk, buffer, count * VIRTIO_BLK_SECTOR_SIZE, &req->sg[1]);
+	if (nr < 0)
+		return -1;
+
+	req->sg[nr + 1].paddr = __pa(&req->status);
+	req->sg[nr + 1].len = 1;
+
+	if (type == VIRTIO_BLK_T_OUT) {
+		out = nr + 1;
+		in = 1;
+	} else {
+		out = 1;
+		in = nr + 1;
+	}
+
+	if (virtio_has_feature(vblk->vdev, VIRTIO_RING_F_INDIRECT_DESC))
+		ret = virtqueue_add_indirect(vblk->vq, req->table, req->sg, out, in, req);
+	else
+		ret = virtqueue_add(vblk->vq, req->sg, out, in, req);
+
+	return (ret ? 1 : 0);
+}
+
+/*
+ * Transfer <blkcnt> sectors from/to <buffer>.
+ *
+ * @return	the number of transferred sectors, 0 on error
+ */
+static unsigned long virtio_blk_rw(struct virtio_blk *vblk, u32 type, lbaint_t start, lbaint_t blkcnt, addr_t buffer) {
+	struct virtio_blk_req *batch[VIRTIO_BLK_BATCH], *req;
+	lbaint_t done = 0, submitted, count;
+	unsigned int nr, i;
+	bool polled, error;
+	int ret;
+
+	/* Sleeping is only possible with IRQs on, in a thread context */
+	polled = (local_irq_is_disabled() || __in_interrupt);
+
+	while (done < blkcnt) {
+		nr = 0;
+		submitted = done;
+		error = false;
+
+		while ((nr < VIRTIO_BLK_BATCH) && (submitted < blkcnt)) {
+
+			/* Only block for the first request: the following ones would wait for ours */
+			req = virtio_blk_get_req(vblk, !nr && !polled);
+			if (!req)
+				break;
+
+			count = blkcnt - submitted;
+			if (count > vblk->max_sectors)
+				count = vblk->max_sectors;
+
+			ret = virtio_blk_queue(vblk, req, type, start + submitted, count,
+					       buffer + submitted * VIRTIO_BLK_SECTOR_SIZE, polled);
+			if (ret) {
+				virtio_blk_put_req(vblk, req);
+
+				if (ret < 0) {
+					error = true;
+					break;
+				}
+
+				/* Ring full (no indirect descriptors): give a chance to other transfers to complete */
+				if (!nr) {
+					if (polled)
+						virtio_interrupt(vblk->vdev);
+					else
+						schedule();
+					continue;
+				}
+				break;
+			}
+
+			batch[nr++] = req;
+			submitted += count;
+		}
+
+		if (nr)
+			virtqueue_kick(vblk->vq);
+
+		for (i = 0; i < nr; i++) {
+			virtio_blk_wait(vblk, batch[i]);
+
+			if (batch[i]->status != VIRTIO_BLK_S_OK)
+				error = true;
+
+			virtio_blk_put_req(vblk, batch[i]);
+		}
+
+		if (error) {
+			printk("virtio-blk: %s error at sector %lu\n", ((type == VIRTIO_BLK_T_IN) ? "read" : "write"), start + done);
+			return 0;
+		}
+
+		done = submitted;
+	}
+
+	return blkcnt;
+}
+
+static unsigned long virtio_blk_read(int dev, lbaint_t start, lbaint_t blkcnt, void *buffer) {
+	return virtio_blk_rw(virtio_blk, VIRTIO_BLK_T_IN, start, blkcnt, (addr_t) buffer);
+}
+
+static unsigned long virtio_blk_write(int dev, lbaint_t start, lbaint_t blkcnt, const void *buffer) {
+	if (virtio_blk->ro)
+		return 0;
+
+	return virtio_blk_rw(virtio_blk, VIRTIO_BLK_T_OUT, start, blkcnt, (addr_t) buffer);
+}
+
+static unsigned long virtio_blk_erase(int dev, lbaint_t start, lbaint_t blkcnt) {
+	return blkcnt;
+}
+
+block_dev_desc_t *virtio_blk_get_dev(int dev) {
+	return (virtio_blk ? &virtio_blk->block_dev : NULL);
+}
+
+int virtio_blk_probe(struct virtio_device *vdev) {
+	struct virtio_blk *vblk;
+	struct virtio_blk_req *reqs;
+	u64 capacity;
+	u32 seg_max;
+	int i;
+
+	if (virtio_blk) {
+		printk("virtio-blk: only one device is supported\n");
+		return -1;
+	}
+
+	if (virtio_negotiate_features(vdev, (1ull << VIRTIO_BLK_F_SIZE_MAX) | (1ull << VIRTIO_BLK_F_SEG_MAX) |
+					    (1ull << VIRTIO_BLK_F_RO) | (1ull << VIRTIO_RING_F_INDIRECT_DESC)))
+		return -1;
+
+	vblk = malloc(sizeof(struct virtio_blk));
+	BUG_ON(!vblk);
+	memset(vblk, 0, sizeof(struct virtio_blk));
+
+	vblk->vdev = vdev;
+	vdev->priv = vblk;
+
+	vblk->vq = virtio_setup_vq(vdev, 0, VIRTIO_BLK_QUEUE_SIZE, virtio_blk_done);
+	if (!vblk->vq) {
+		free(vblk);
+		return -1;
+	}
+
+	capacity = virtio_cread64(vdev, VIRTIO_BLK_CFG_CAPACITY);
+
+	vblk->ro = virtio_has_feature(vdev, VIRTIO_BLK_F_RO);
+
+	vblk->max_segs = VIRTIO_BLK_MAX_SEGS;
+	if (virtio_has_feature(vdev, VIRTIO_BLK_F_SEG_MAX)) {
+		seg_max = virtio_cread32(vdev, VIRTIO_BLK_CFG_SEG_MAX);
+		if (seg_max && (seg_max < vblk->max_segs))
+			vblk->max_segs = seg_max;
+	}
+
+	/* Without indirect descriptors, a request must also fit in the ring */
+	if (!virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC) && (vblk->max_segs > vblk->vq->num - 2))
+		vblk->max_segs = vblk->vq->num - 2;
+
+	vblk->size_max = 0xffffffff;
+	if (virtio_has_feature(vdev, VIRTIO_BLK_F_SIZE_MAX)) {
+		vblk->size_max = virtio_cread32(vdev, VIRTIO_BLK_CFG_SIZE_MAX);
+		if (vblk->size_max < PAGE_SIZE)
+			vblk->size_max = PAGE_SIZE;
+	}
+
+	/* A buffer which is not page aligned spans one more page than its size */
+	vblk->max_sectors = VIRTIO_BLK_MAX_SECTORS;
+	if ((vblk->max_segs - 1) * (PAGE_SIZE / VIRTIO_BLK_SECTOR_SIZE) < vblk->max_sectors)
+		vblk->max_sectors = (vblk->max_segs - 1) * (PAGE_SIZE / VIRTIO_BLK_SECTOR_SIZE);
+
+	BUG_ON(!vblk->max_sectors);
+
+	INIT_LIST_HEAD(&vblk->free_reqs);
+	init_completion(&vblk->req_avail);
+	spin_lock_init(&vblk->lock);
+
+	/* The requests are in the heap, hence in the linear mapping */
+	reqs = calloc(VIRTIO_BLK_NR_REQS, sizeof(struct virtio_blk_req));
+	BUG_ON(!reqs);
+
+	for (i = 0; i < VIRTIO_BLK_NR_REQS; i++)
+		list_add_tail(&reqs[i].list, &vblk->free_reqs);
+
+	vblk->block_dev.if_type = IF_TYPE_VIRTIO;
+	vblk->block_dev.dev = 0;
+	vblk->block_dev.removable = 0;
+	vblk->block_dev.type = DEV_TYPE_HARDDISK;
+	vblk->block_dev.blksz = VIRTIO_BLK_SECTOR_SIZE;
+	vblk->block_dev.log2blksz = LOG2(vblk->block_dev.blksz);
+	vblk->block_dev.lba = capacity;
+
+	vblk->block_dev.block_read = virtio_blk_read;
+	vblk->block_dev.block_write = virtio_blk_write;
+	vblk->block_dev.block_erase = virtio_blk_erase;
+
+	vblk->block_dev.priv = vblk;
+
+	strcpy(vblk->block_dev.vendor, "virtio");
+	strcpy(vblk->block_dev.product, "virtio-blk");
+
+	virtio_blk = vblk;
+
+	virtio_device_ready(vdev);
+
+	printk("virtio-blk: %llu sectors (%llu MB)%s, %d segments/request, indirect descriptors %s\n",
+	       capacity, (capacity * VIRTIO_BLK_SECTOR_SIZE) >> 20, (vblk->ro ? " read-only" : ""), vblk->max_segs,
+	       (virtio_has_feature(vdev, VIRTIO_RING_F_INDIRECT_DESC) ? "on" : "off"));
+
+	return 0;
+}
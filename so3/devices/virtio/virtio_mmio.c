@@ -0,0 +1,536 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * virtio-mmio transport and split virtqueues.
+ *
+ * Both the legacy (version 1, default of QEMU) and the version 2 register
+ * layouts are supported. The rings of a queue are always allocated in the
+ * contiguous legacy layout so that the same memory suits both versions.
+ * The device is assumed to be cache coherent, which is the case of QEMU.
+ */
+
+#include <common.h>
+#include <heap.h>
+#include <memory.h>
+#include <string.h>
+#include <compiler.h>
+
+#include <device/device.h>
+#include <device/driver.h>
+#include <device/irq.h>
+#include <device/virtio.h>
+
+#include <asm/io.h>
+#include <asm/processor.h>
+
+/* Drivers of the virtio devices, bound according to the device ID */
+static struct virtio_driver virtio_drivers[] = {
+#ifdef CONFIG_VIRTIO_BLK
+	{ .device_id = VIRTIO_ID_BLOCK, .probe = virtio_blk_probe, },
+#endif
+#ifdef CONFIG_VIRTIO_NET
+	{ .device_id = VIRTIO_ID_NET, .probe = virtio_net_probe, },
+#endif
+	{ },
+};
+
+static inline u32 vm_read(struct virtio_device *vdev, unsigned int reg) {
+	return ioread32(vdev->base + reg);
+}
+
+static inline void vm_write(struct virtio_device *vdev, unsigned int reg, u32 val) {
+	iowrite32(vdev->base + reg, val);
+}
+
+static void vm_set_status(struct virtio_device *vdev, u32 status) {
+	vm_write(vdev, VIRTIO_MMIO_STATUS, vm_read(vdev, VIRTIO_MMIO_STATUS) | status);
+}
+
+u8 virtio_cread8(struct virtio_device *vdev, unsigned int offset) {
+	return ioread8(vdev->base + VIRTIO_MMIO_CONFIG + offset);
+}
+
+u32 virtio_cread32(struct virtio_device *vdev, unsigned int offset) {
+	return ioread32(vdev->base + VIRTIO_MMIO_CONFIG + offset);
+}
+
+u64 virtio_cread64(struct virtio_device *vdev, unsigned int offset) {
+	return (u64) virtio_cread32(vdev, offset) | ((u64) virtio_cread32(vdev, offset + 4) << 32);
+}
+
+/**
+ * Agree on the features supported by the device and by its driver.
+ * VIRTIO_F_VERSION_1 is mandatory with a version 2 transport.
+ *
+ * @return	0 on success, -1 if the device refused the features
+ */
+int virtio_negotiate_features(struct virtio_device *vdev, u64 driver_features) {
+	u64 device_features;
+
+	vm_write(vdev, VIRTIO_MMIO_DEVICE_FEATURES_SEL, 1);
+	device_features = (u64) vm_read(vdev, VIRTIO_MMIO_DEVICE_FEATURES) << 32;
+
+	vm_write(vdev, VIRTIO_MMIO_DEVICE_FEATURES_SEL, 0);
+	device_features |= vm_read(vdev, VIRTIO_MMIO_DEVICE_FEATURES);
+
+	if (vdev->version == 1)
+		/* Only the 32 lower bits exist for a legacy device */
+		driver_features &= 0xffffffffull;
+	else
+		driver_features |= (1ull << VIRTIO_F_VERSION_1);
+
+	vdev->features = device_features & driver_features;
+
+	if ((vdev->version > 1) && !virtio_has_feature(vdev, VIRTIO_F_VERSION_1)) {
+		lprintk("%s: the device does not support VIRTIO_F_VERSION_1\n", __func__);
+		goto failed;
+	}
+
+	vm_write(vdev, VIRTIO_MMIO_DRIVER_FEATURES_SEL, 1);
+	vm_write(vdev, VIRTIO_MMIO_DRIVER_FEATURES, vdev->features >> 32);
+
+	vm_write(vdev, VIRTIO_MMIO_DRIVER_FEATURES_SEL, 0);
+	vm_write(vdev, VIRTIO_MMIO_DRIVER_FEATURES, (u32) vdev->features);
+
+	if (vdev->version == 1)
+		return 0;
+
+	vm_set_status(vdev, VIRTIO_STATUS_FEATURES_OK);
+
+	if (!(vm_read(vdev, VIRTIO_MMIO_STATUS) & VIRTIO_STATUS_FEATURES_OK)) {
+		lprintk("%s: features 0x%llx not accepted by the device\n", __func__, vdev->features);
+		goto failed;
+	}
+
+	return 0;
+
+failed:
+	vm_set_status(vdev, VIRTIO_STATUS_FAILED);
+
+	return -1;
+}
+
+/*
+ * The driver is ready to use the device (the queues are set up).
+ */
+void virtio_device_ready(struct virtio_device *vdev) {
+	vm_set_status(vdev, VIRTIO_STATUS_DRIVER_OK);
+}
+
+/*
+ * Size of the rings of a queue of <num> descriptors in the legacy layout.
+ */
+static size_t vring_size(unsigned int num) {
+	return ALIGN_UP(sizeof(struct virtq_desc) * num + sizeof(u16) * (3 + num), VIRTQ_LEGACY_ALIGN) +
+	       ALIGN_UP(sizeof(u16) * 3 + sizeof(struct virtq_used_elem) * num, VIRTQ_LEGACY_ALIGN);
+}
+
+/**
+ * Allocate and register the virtqueue <index> of the device.
+ *
+ * @num		requested number of descriptors (power of 2), reduced to the device maximum
+ * @callback	invoked in interrupt context when the device has used some buffers
+ * @return	the virtqueue or NULL on failure
+ */
+struct virtqueue *virtio_setup_vq(struct virtio_device *vdev, unsigned int index, unsigned int num,
+				  void (*callback)(struct virtqueue *vq)) {
+	struct virtqueue *vq;
+	unsigned int max, i;
+	addr_t paddr, desc, avail, used;
+	size_t size;
+
+	BUG_ON(index >= VIRTIO_MAX_QUEUES);
+
+	vm_write(vdev, VIRTIO_MMIO_QUEUE_SEL, index);
+
+	if (vm_read(vdev, (vdev->version == 1) ? VIRTIO_MMIO_QUEUE_PFN : VIRTIO_MMIO_QUEUE_READY)) {
+		lprintk("%s: queue %d already in use\n", __func__, index);
+		return NULL;
+	}
+
+	max = vm_read(vdev, VIRTIO_MMIO_QUEUE_NUM_MAX);
+	if (!max) {
+		lprintk("%s: queue %d not available\n", __func__, index);
+		return NULL;
+	}
+
+	while (num > max)
+		num >>= 1;
+
+	vq = malloc(sizeof(struct virtqueue));
+	BUG_ON(!vq);
+	memset(vq, 0, sizeof(struct virtqueue));
+
+	vq->data = calloc(num, sizeof(void *));
+	BUG_ON(!vq->data);
+
+	size = vring_size(num);
+
+	paddr = get_contig_free_pages(ALIGN_UP(size, PAGE_SIZE) >> PAGE_SHIFT);
+	BUG_ON(!paddr);
+
+	memset((void *) __va(paddr), 0, size);
+
+	desc = paddr;
+	avail = desc + sizeof(struct virtq_desc) * num;
+	used = ALIGN_UP(avail + sizeof(u16) * (3 + num), VIRTQ_LEGACY_ALIGN);
+
+	vq->vdev = vdev;
+	vq->index = index;
+	vq->num = num;
+	vq->desc = (struct virtq_desc *) __va(desc);
+	vq->avail = (struct virtq_avail *) __va(avail);
+	vq->used = (struct virtq_used *) __va(used);
+	vq->callback = callback;
+
+	spin_lock_init(&vq->lock);
+
+	/* Chain all descriptors in the free list */
+	for (i = 0; i < num - 1; i++)
+		vq->desc[i].next = i + 1;
+
+	vq->free_head = 0;
+	vq->num_free = num;
+
+	vm_write(vdev, VIRTIO_MMIO_QUEUE_NUM, num);
+
+	if (vdev->version == 1) {
+		vm_write(vdev, VIRTIO_MMIO_QUEUE_ALIGN, VIRTQ_LEGACY_ALIGN);
+		vm_write(vdev, VIRTIO_MMIO_QUEUE_PFN, paddr >> PAGE_SHIFT);
+	} else {
+		vm_write(vdev, VIRTIO_MMIO_QUEUE_DESC_LOW, (u32) desc);
+		vm_write(vdev, VIRTIO_MMIO_QUEUE_DESC_HIGH, (u64) desc >> 32);
+		vm_write(vdev, VIRTIO_MMIO_QUEUE_AVAIL_LOW, (u32) avail);
+		vm_write(vdev, VIRTIO_MMIO_QUEUE_AVAIL_HIGH, (u64) avail >> 32);
+		vm_write(vdev, VIRTIO_MMIO_QUEUE_USED_LOW, (u32) used);
+		vm_write(vdev, VIRTIO_MMIO_QUEUE_USED_HIGH, (u64) used >> 32);
+
+		vm_write(vdev, VIRTIO_MMIO_QUEUE_READY, 1);
+	}
+
+	vdev->vqs[index] = vq;
+
+	return vq;
+}
+
+/*
+ * Fill <nr> consecutive descriptors of an indirect table; the <in> last ones
+ * are written by the device.
+ */
+static void virtqueue_fill_table(struct virtq_desc *table, struct virtio_sg *sg, unsigned int out, unsigned int in) {
+	unsigned int i, nr = out + in;
+
+	for (i = 0; i < nr; i++) {
+		table[i].addr = sg[i].paddr;
+		table[i].len = sg[i].len;
+		table[i].flags = ((i < out) ? 0 : VIRTQ_DESC_F_WRITE) | ((i < nr - 1) ? VIRTQ_DESC_F_NEXT : 0);
+		table[i].next = i + 1;
+	}
+}
+
+/*
+ * Make the chain starting at <head> available to the device.
+ * The queue lock is held.
+ */
+static void virtqueue_publish(struct virtqueue *vq, u16 head, void *data) {
+	u16 idx = vq->avail->idx;
+
+	vq->data[head] = data;
+	vq->avail->ring[idx & (vq->num - 1)] = head;
+
+	/* The descriptors must be visible before the index */
+	wmb();
+
+	WRITE_ONCE(vq->avail->idx, idx + 1);
+}
+
+/**
+ * Add a buffer made of <out> segments read by the device followed by <in>
+ * segments written by the device. One descriptor per segment is used.
+ * <data> is returned by virtqueue_get_buf() once the device is done.
+ *
+ * @return	0 on success, -1 if there are not enough free descriptors
+ */
+int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sg, unsigned int out, unsigned int in, void *data) {
+	unsigned int i, nr = out + in;
+	unsigned long flags;
+	u16 head, cur;
+
+	BUG_ON(!nr);
+
+	flags = spin_lock_irqsave(&vq->lock);
+
+	if (vq->num_free < nr) {
+		spin_unlock_irqrestore(&vq->lock, flags);
+		return -1;
+	}
+
+	head = cur = vq->free_head;
+
+	for (i = 0; i < nr; i++) {
+		vq->desc[cur].addr = sg[i].paddr;
+		vq->desc[cur].len = sg[i].len;
+		vq->desc[cur].flags = ((i < out) ? 0 : VIRTQ_DESC_F_WRITE) | ((i < nr - 1) ? VIRTQ_DESC_F_NEXT : 0);
+
+		cur = vq->desc[cur].next;
+	}
+
+	/* The next field of the last descriptor keeps the rest of the free list */
+	vq->free_head = cur;
+	vq->num_free -= nr;
+
+	virtqueue_publish(vq, head, data);
+
+	spin_unlock_irqrestore(&vq->lock, flags);
+
+	return 0;
+}
+
+/**
+ * Same as virtqueue_add(), but the segments are described in <table> which
+ * is referred by a single descriptor of the ring. Hence, a queue can keep
+ * as many buffers in flight as it has descriptors, whatever their number of
+ * segments. <table> must be in the linear mapping and must not be modified
+ * until the buffer is returned by virtqueue_get_buf().
+ *
+ * @return	0 on success, -1 if the ring is full
+ */
+int virtqueue_add_indirect(struct virtqueue *vq, struct virtq_desc *table, struct virtio_sg *sg,
+			   unsigned int out, unsigned int in, void *data) {
+	unsigned long flags;
+	u16 head;
+
+	BUG_ON(!virtio_has_feature(vq->vdev, VIRTIO_RING_F_INDIRECT_DESC));
+
+	virtqueue_fill_table(table, sg, out, in);
+
+	flags = spin_lock_irqsave(&vq->lock);
+
+	if (!vq->num_free) {
+		spin_unlock_irqrestore(&vq->lock, flags);
+		return -1;
+	}
+
+	head = vq->free_head;
+
+	vq->desc[head].addr = __pa(table);
+	vq->desc[head].len = (out + in) * sizeof(struct virtq_desc);
+	vq->desc[head].flags = VIRTQ_DESC_F_INDIRECT;
+
+	vq->free_head = vq->desc[head].next;
+	vq->num_free--;
+
+	virtqueue_publish(vq, head, data);
+
+	spin_unlock_irqrestore(&vq->lock, flags);
+
+	return 0;
+}
+
+/*
+ * Notify the device about the new available buffers, unless it asked not to.
+ * Several buffers may be added before a single kick.
+ */
+void virtqueue_kick(struct virtqueue *vq) {
+
+	/* The available index must be visible before the flags are read and the device notified */
+	mb();
+
+	if (!(READ_ONCE(vq->used->flags) & VIRTQ_USED_F_NO_NOTIFY))
+		vm_write(vq->vdev, VIRTIO_MMIO_QUEUE_NOTIFY, vq->index);
+}
+
+/**
+ * Get the next buffer used by the device, if any, and release its descriptors.
+ *
+ * @len		number of bytes written by the device into the buffer
+ * @return	the token given when the buffer was added, NULL if there is none
+ */
+void *virtqueue_get_buf(struct virtqueue *vq, u32 *len) {
+	struct virtq_used_elem *e;
+	unsigned long flags;
+	void *data;
+	u16 head, cur;
+
+	flags = spin_lock_irqsave(&vq->lock);
+
+	if (vq->last_used_idx == READ_ONCE(vq->used->idx)) {
+		spin_unlock_irqrestore(&vq->lock, flags);
+		return NULL;
+	}
+
+	/* Read the entry after the index */
+	rmb();
+
+	e = &vq->used->ring[vq->last_used_idx & (vq->num - 1)];
+	head = e->id;
+	if (len)
+		*len = e->len;
+
+	vq->last_used_idx++;
+
+	data = vq->data[head];
+	vq->data[head] = NULL;
+
+	/* Give the chain back to the free list */
+	cur = head;
+	vq->num_free++;
+
+	while (vq->desc[cur].flags & VIRTQ_DESC_F_NEXT) {
+		cur = vq->desc[cur].next;
+		vq->num_free++;
+	}
+
+	vq->desc[cur].next = vq->free_head;
+	vq->free_head = head;
+
+	spin_unlock_irqrestore(&vq->lock, flags);
+
+	return data;
+}
+
+/*
+ * Check if the device has used buffers which have not been retrieved yet.
+ */
+bool virtqueue_pending(struct virtqueue *vq) {
+	return (vq->last_used_idx != READ_ONCE(vq->used->idx));
+}
+
+/*
+ * Ask the device not to interrupt when it uses buffers of this queue.
+ * This is only a hint, the device may still do it.
+ */
+void virtqueue_disable_cb(struct virtqueue *vq) {
+	WRITE_ONCE(vq->avail->flags, vq->avail->flags | VIRTQ_AVAIL_F_NO_INTERRUPT);
+}
+
+/**
+ * Re-enable the interrupts of the queue.
+ *
+ * @return	false if some buffers were used in the meanwhile; they will not
+ *		raise any interrupt and must be processed by the caller.
+ */
+bool virtqueue_enable_cb(struct virtqueue *vq) {
+	WRITE_ONCE(vq->avail->flags, vq->avail->flags & ~VIRTQ_AVAIL_F_NO_INTERRUPT);
+
+	/* The flags must be visible before the used index is checked */
+	mb();
+
+	return !virtqueue_pending(vq);
+}
+
+/*
+ * Acknowledge the interrupt of the device and let the drivers process their
+ * used buffers. It may also be called with IRQs off to poll the device.
+ */
+void virtio_interrupt(struct virtio_device *vdev) {
+	u32 status;
+	int i;
+
+	status = vm_read(vdev, VIRTIO_MMIO_INTERRUPT_STATUS);
+	if (status)
+		vm_write(vdev, VIRTIO_MMIO_INTERRUPT_ACK, status);
+
+	for (i = 0; i < VIRTIO_MAX_QUEUES; i++)
+		if (vdev->vqs[i] && vdev->vqs[i]->callback)
+			vdev->vqs[i]->callback(vdev->vqs[i]);
+}
+
+static irq_return_t virtio_mmio_isr(int irq, void *dummy) {
+	virtio_interrupt((struct virtio_device *) dummy);
+
+	return IRQ_COMPLETED;
+}
+
+/*
+ * Probe a virtio-mmio transport. QEMU instantiates many transports, most of
+ * them without any device behind (device ID 0).
+ */
+static int virtio_mmio_init(dev_t *dev, int fdt_offset) {
+	const struct fdt_property *prop;
+	struct virtio_device *vdev;
+	struct virtio_driver *drv;
+	int prop_len;
+	void *base;
+
+	prop = fdt_get_property(__fdt_addr, fdt_offset, "reg", &prop_len);
+	BUG_ON(!prop);
+
+	BUG_ON(prop_len != 2 * sizeof(unsigned long));
+
+	base = (void *) io_map(fdt64_to_cpu(((const fdt64_t *) prop->data)[0]), fdt64_to_cpu(((const fdt64_t *) prop->data)[1]));
+
+	if (ioread32(base + VIRTIO_MMIO_MAGIC_VALUE) != VIRTIO_MMIO_MAGIC) {
+		lprintk("%s: %s is not a virtio-mmio transport\n", __func__, dev->nodename);
+		return 0;
+	}
+
+	if (!ioread32(base + VIRTIO_MMIO_DEVICE_ID))
+		/* Empty slot */
+		return 0;
+
+	vdev = malloc(sizeof(struct virtio_device));
+	BUG_ON(!vdev);
+	memset(vdev, 0, sizeof(struct virtio_device));
+
+	vdev->base = base;
+	vdev->version = vm_read(vdev, VIRTIO_MMIO_VERSION);
+	vdev->id = vm_read(vdev, VIRTIO_MMIO_DEVICE_ID);
+
+	if ((vdev->version < 1) || (vdev->version > 2)) {
+		lprintk("%s: unsupported virtio-mmio version %d\n", __func__, vdev->version);
+		goto out;
+	}
+
+	for (drv = virtio_drivers; drv->probe; drv++)
+		if (drv->device_id == vdev->id)
+			break;
+
+	if (!drv->probe) {
+		printk("virtio-mmio: no driver for device ID %d\n", vdev->id);
+		goto out;
+	}
+
+	fdt_interrupt_node(fdt_offset, &vdev->irq_def);
+
+	/* Reset the device and tell it we found it */
+	vm_write(vdev, VIRTIO_MMIO_STATUS, 0);
+	vm_set_status(vdev, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+	if (vdev->version == 1)
+		vm_write(vdev, VIRTIO_MMIO_GUEST_PAGE_SIZE, PAGE_SIZE);
+
+	if (drv->probe(vdev)) {
+		vm_set_status(vdev, VIRTIO_STATUS_FAILED);
+		goto out;
+	}
+
+	dev->driver_data = vdev;
+
+	irq_bind(vdev->irq_def.irqnr, virtio_mmio_isr, NULL, vdev);
+
+	return 0;
+
+out:
+	free(vdev);
+
+	return 0;
+}
+
+REGISTER_DRIVER_POSTCORE("virtio,mmio", virtio_mmio_init);
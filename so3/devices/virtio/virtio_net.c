@@ -0,0 +1,754 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * virtio network device as a lwIP netif.
+ *
+ * Receive: the RX ring is filled with preallocated buffers which are handed
+ * to lwIP as custom pbufs, the frame is never copied. When lwIP releases
+ * the pbuf, the buffer goes back to the ring. With CONFIG_NET_ZEROCOPY_RX,
+ * the frames are received into the zero-copy pool instead: the buffer leaves
+ * with its pbuf and the slot is refilled from the pool.
+ *
+ * Transmit: each pbuf of a chain becomes a descriptor of the TX ring, the
+ * chain is referenced until the device has sent it. The chains which hold
+ * data that may change meanwhile (PBUF_REF) are copied into a single pbuf
+ * first. The TX queue does not interrupt; the sent chains are reclaimed along
+ * the next transmissions and by the poll thread. With CONFIG_NET_ZEROCOPY_TX,
+ * the frames which refer to user buffers enable the TX interrupt, so that
+ * their completion does not wait for the next transmission.
+ *
+ * Checksum offload: with VIRTIO_NET_F_CSUM, lwIP leaves the TCP/UDP checksums
+ * to the device; with VIRTIO_NET_F_GUEST_CSUM, it does not verify those the
+ * device reports as valid.
+ *
+ * Interrupt mitigation (NAPI-like): the RX interrupt only wakes up the poll
+ * thread and masks further RX interrupts. The thread processes up to a budget
+ * of frames at once and unmasks the interrupt when the ring is empty.
+ */
+
+#include <common.h>
+#include <heap.h>
+#include <memory.h>
+#include <string.h>
+#include <compiler.h>
+#include <completion.h>
+#include <schedule.h>
+#include <thread.h>
+
+#include <device/net.h>
+#include <device/virtio.h>
+
+#include <asm/mmu.h>
+#include <asm/processor.h>
+
+#include <net/lwip/opt.h>
+#include <net/lwip/def.h>
+#include <net/lwip/pbuf.h>
+#include <net/lwip/stats.h>
+#include <net/lwip/snmp.h>
+#include <net/lwip/ip.h>
+#include <net/lwip/inet_chksum.h>
+#include <net/lwip/etharp.h>
+#include <net/lwip/dhcp.h>
+#include <net/lwip/tcpip.h>
+#include <net/netif/ethernet.h>
+
+#ifdef CONFIG_NET_ZEROCOPY_RX
+#include <net/zerocopy.h>
+#endif
+
+/* Feature bits */
+#define VIRTIO_NET_F_CSUM	0
+#define VIRTIO_NET_F_GUEST_CSUM	1
+#define VIRTIO_NET_F_MAC	5
+
+/* Configuration space */
+#define VIRTIO_NET_CFG_MAC	0
+
+#define VIRTIO_NET_RXQ		0
+#define VIRTIO_NET_TXQ		1
+
+#define VIRTIO_NET_QUEUE_SIZE	256
+
+/* Each RX buffer uses two descriptors (header and frame) */
+#define VIRTIO_NET_NR_RX_BUFS	(VIRTIO_NET_QUEUE_SIZE / 2)
+#define VIRTIO_NET_RX_BUFSIZE	1536
+
+/* Frames received before the poll thread yields the CPU */
+#define VIRTIO_NET_BUDGET	64
+
+/* Descriptors of a transmitted frame (header included) */
+#define VIRTIO_NET_TX_SEGS	16
+
+/*
+ * Header preceding each frame. num_buffers is only present with
+ * VIRTIO_F_VERSION_1 (we do not use VIRTIO_NET_F_MRG_RXBUF).
+ */
+struct virtio_net_hdr {
+	u8 flags;
+	u8 gso_type;
+	u16 hdr_len;
+	u16 gso_size;
+	u16 csum_start;
+	u16 csum_offset;
+	u16 num_buffers;
+};
+
+#define VIRTIO_NET_HDR_LEGACY_LEN	10
+
+#define VIRTIO_NET_HDR_F_NEEDS_CSUM	1
+#define VIRTIO_NET_HDR_F_DATA_VALID	2
+
+struct virtio_net_rxbuf {
+	struct pbuf_custom pc;
+	struct virtio_net *vnet;
+
+	struct virtio_net_hdr hdr;
+
+	/* data[] or a buffer of the zero-copy pool */
+	u8 *buf;
+	u8 data[VIRTIO_NET_RX_BUFSIZE];
+};
+
+struct virtio_net {
+	struct virtio_device *vdev;
+	struct virtqueue *rxvq, *txvq;
+
+	struct netif *netif;
+	eth_dev_t *eth_dev;
+
+	unsigned int hdr_len;
+
+	struct virtio_net_rxbuf *rxbufs;
+
+	/*
+	 * Headers of the transmitted frames, used in turn. A frame takes at least
+	 * two descriptors, so a header is not reused while its frame is in the ring.
+	 */
+	struct virtio_net_hdr tx_hdrs[VIRTIO_NET_QUEUE_SIZE];
+	unsigned int tx_hdr_next;
+
+#ifdef CONFIG_NET_ZEROCOPY_TX
+	/* Frames of the TX ring which refer to user buffers */
+	unsigned int tx_zc;
+#endif
+
+	/* The poll thread is running, the RX interrupt is masked */
+	bool polling;
+	completion_t rx_event;
+	spinlock_t lock;
+};
+
+/*
+ * Give a buffer to the device.
+ */
+static void virtio_net_post_rx(struct virtio_net *vnet, struct virtio_net_rxbuf *rxbuf) {
+	struct virtio_sg sg[2];
+
+	sg[0].paddr = __pa(&rxbuf->hdr);
+	sg[0].len = vnet->hdr_len;
+	sg[1].paddr = __pa(rxbuf->buf);
+	sg[1].len = VIRTIO_NET_RX_BUFSIZE;
+
+	/* There is always room since the ring is sized for all buffers */
+	BUG_ON(virtqueue_add(vnet->rxvq, sg, 0, 2, rxbuf));
+}
+
+/*
+ * Called by pbuf_free() when lwIP releases a received frame.
+ */
+static void virtio_net_rx_free(struct pbuf *p) {
+	struct virtio_net_rxbuf *rxbuf = (struct virtio_net_rxbuf *) p;
+
+	virtio_net_post_rx(rxbuf->vnet, rxbuf);
+	virtqueue_kick(rxbuf->vnet->rxvq);
+}
+
+/*
+ * Pass up to <budget> received frames to lwIP.
+ *
+ * @return	the number of processed frames
+ */
+static int virtio_net_rx(struct virtio_net *vnet, int budget) {
+	struct virtio_net_rxbuf *rxbuf;
+	struct pbuf *p;
+	int work = 0;
+	u16 hdr_flags;
+	u32 len;
+#ifdef CONFIG_NET_ZEROCOPY_RX
+	void *zc;
+#endif
+
+	while ((work < budget) && (rxbuf = virtqueue_get_buf(vnet->rxvq, &len)) != NULL) {
+		work++;
+
+		if (len <= vnet->hdr_len) {
+			LINK_STATS_INC(link.lenerr);
+			virtio_net_post_rx(vnet, rxbuf);
+			continue;
+		}
+
+		len -= vnet->hdr_len;
+		hdr_flags = rxbuf->hdr.flags;
+
+#ifdef CONFIG_NET_ZEROCOPY_RX
+		/* The pool buffer leaves with the frame, the slot gets a new one */
+		if ((rxbuf->buf != rxbuf->data) && (zc = net_zc_buf_alloc()) != NULL) {
+			p = net_zc_pbuf(rxbuf->buf, len);
+			BUG_ON(!p);
+
+			rxbuf->buf = zc;
+			virtio_net_post_rx(vnet, rxbuf);
+		} else
+#endif
+		{
+			rxbuf->pc.custom_free_function = virtio_net_rx_free;
+
+			p = pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &rxbuf->pc, rxbuf->buf, VIRTIO_NET_RX_BUFSIZE);
+			BUG_ON(!p);
+		}
+
+		/* Neither validated nor partially checksummed by the device */
+		if ((vnet->eth_dev->features & ETH_DEV_F_RX_CSUM) &&
+		    !(hdr_flags & (VIRTIO_NET_HDR_F_DATA_VALID | VIRTIO_NET_HDR_F_NEEDS_CSUM)) &&
+		    !eth_dev_rx_csum_ok(p)) {
+			LINK_STATS_INC(link.chkerr);
+			pbuf_free(p);
+			continue;
+		}
+
+		LINK_STATS_INC(link.recv);
+		MIB2_STATS_NETIF_ADD(vnet->netif, ifinoctets, len);
+
+		if (vnet->netif->input(p, vnet->netif) != ERR_OK) {
+			LINK_STATS_INC(link.drop);
+			pbuf_free(p);
+		}
+	}
+
+	/* The buffers reposted above */
+	if (work)
+		virtqueue_kick(vnet->rxvq);
+
+	return work;
+}
+
+/*
+ * The chain is still used after linkoutput returns: the data which may change
+ * meanwhile (PBUF_REF, e.g. the buffer of sendto()) has to be copied.
+ */
+static bool virtio_net_tx_volatile(struct pbuf *p) {
+	for (; p != NULL; p = p->next)
+		if (PBUF_NEEDS_COPY(p))
+			return true;
+
+	return false;
+}
+
+/*
+ * Copy the chain into a single pbuf, which is released once sent.
+ */
+static struct pbuf *virtio_net_tx_copy(struct pbuf *p) {
+	struct pbuf *copy;
+
+	copy = pbuf_clone(PBUF_RAW, PBUF_RAM, p);
+	if (!copy)
+		LINK_STATS_INC(link.memerr);
+
+	return copy;
+}
+
+#ifdef CONFIG_NET_ZEROCOPY_TX
+/*
+ * The custom pbufs sent as they are refer to user buffers (zero-copy send).
+ */
+static bool virtio_net_tx_zc(struct pbuf *p) {
+	for (; p != NULL; p = p->next)
+		if (p->flags & PBUF_FLAG_IS_CUSTOM)
+			return true;
+
+	return false;
+}
+#endif
+
+/*
+ * Release the frames which have been sent by the device.
+ */
+static void virtio_net_tx_reclaim(struct virtio_net *vnet) {
+	struct pbuf *p;
+#ifdef CONFIG_NET_ZEROCOPY_TX
+	unsigned long flags;
+#endif
+
+	while ((p = virtqueue_get_buf(vnet->txvq, NULL)) != NULL) {
+#ifdef CONFIG_NET_ZEROCOPY_TX
+		if (virtio_net_tx_zc(p)) {
+			flags = spin_lock_irqsave(&vnet->lock);
+			vnet->tx_zc--;
+			spin_unlock_irqrestore(&vnet->lock, flags);
+		}
+#endif
+		pbuf_free(p);
+	}
+}
+
+/*
+ * Wake up the poll thread unless it is running.
+ */
+static void virtio_net_schedule_poll(struct virtio_net *vnet) {
+	unsigned long flags;
+
+	flags = spin_lock_irqsave(&vnet->lock);
+
+	if (!vnet->polling) {
+		vnet->polling = true;
+		virtqueue_disable_cb(vnet->rxvq);
+
+		complete(&vnet->rx_event);
+	}
+
+	spin_unlock_irqrestore(&vnet->lock, flags);
+}
+
+/*
+ * RX interrupt (in interrupt context): defer the processing to the poll thread.
+ */
+static void virtio_net_rx_done(struct virtqueue *vq) {
+	if (!virtqueue_pending(vq))
+		return ;
+
+	virtio_net_schedule_poll(vq->vdev->priv);
+}
+
+#ifdef CONFIG_NET_ZEROCOPY_TX
+/*
+ * TX interrupt, enabled while zero-copy frames are in the ring: the poll
+ * thread reclaims them, which completes their messages.
+ */
+static void virtio_net_tx_done(struct virtqueue *vq) {
+	if (!virtqueue_pending(vq))
+		return ;
+
+	virtqueue_disable_cb(vq);
+
+	virtio_net_schedule_poll(vq->vdev->priv);
+}
+#endif
+
+static void *virtio_net_poll(void *args) {
+	struct virtio_net *vnet = (struct virtio_net *) args;
+	unsigned long flags;
+	int work;
+
+	while (true) {
+		wait_for_completion(&vnet->rx_event);
+
+		while (true) {
+			work = virtio_net_rx(vnet, VIRTIO_NET_BUDGET);
+
+			virtio_net_tx_reclaim(vnet);
+
+			if (work == VIRTIO_NET_BUDGET) {
+				/* More frames are probably pending; let the other threads (tcpip) run first */
+				schedule();
+				continue;
+			}
+
+			flags = spin_lock_irqsave(&vnet->lock);
+
+#ifdef CONFIG_NET_ZEROCOPY_TX
+			/* Zero-copy frames still in the ring: wait for their completion */
+			if (vnet->tx_zc && !virtqueue_enable_cb(vnet->txvq)) {
+				spin_unlock_irqrestore(&vnet->lock, flags);
+				continue;
+			}
+#endif
+
+			if (virtqueue_enable_cb(vnet->rxvq)) {
+				vnet->polling = false;
+				spin_unlock_irqrestore(&vnet->lock, flags);
+				break;
+			}
+
+			/* Frames arrived while the interrupt was masked */
+			virtqueue_disable_cb(vnet->rxvq);
+
+			spin_unlock_irqrestore(&vnet->lock, flags);
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Describe a piece of a pbuf with physically contiguous segments.
+ * The kernel buffers (lwIP heap and pools) are in the linear mapping.
+ *
+ * @return	the number of segments, -1 if more than <max> are needed
+ */
+static int virtio_net_map(addr_t vaddr, size_t len, struct virtio_sg *sg, int max) {
+	size_t chunk;
+	int nr = 0;
+
+	if (!user_space_vaddr(vaddr)) {
+		if (!max)
+			return -1;
+
+		sg[0].paddr = __pa(vaddr);
+		sg[0].len = len;
+
+		return 1;
+	}
+
+	while (len) {
+		if (nr == max)
+			return -1;
+
+		chunk = PAGE_SIZE - (vaddr & ~PAGE_MASK);
+		if (chunk > len)
+			chunk = len;
+
+		sg[nr].paddr = virt_to_phys_pt(vaddr);
+		sg[nr].len = chunk;
+		nr++;
+
+		vaddr += chunk;
+		len -= chunk;
+	}
+
+	return nr;
+}
+
+/*
+ * Let the device compute the TCP/UDP checksum of a frame, which lwIP left to 0.
+ * As expected by the device, the checksum field is set to the sum of the
+ * pseudo-header. Fragmented UDP datagrams are sent without checksum.
+ *
+ * @return	-1 if the headers are not in the first pbuf, 0 otherwise
+ */
+static int virtio_net_tx_csum(struct pbuf *p, struct virtio_net_hdr *hdr) {
+	struct eth_hdr *ethhdr = (struct eth_hdr *) p->payload;
+	struct ip_hdr *iphdr;
+	ip4_addr_t src, dest;
+	u16_t iphlen, csum_start, csum_offset;
+	u8_t proto;
+
+	if (p->len < SIZEOF_ETH_HDR + IP_HLEN)
+		return ((p->len < p->tot_len) ? -1 : 0);
+
+	if (ethhdr->type != PP_HTONS(ETHTYPE_IP))
+		return 0;
+
+	iphdr = (struct ip_hdr *) ((u8_t *) p->payload + SIZEOF_ETH_HDR);
+	iphlen = IPH_HL_BYTES(iphdr);
+	proto = IPH_PROTO(iphdr);
+
+	if (proto == IP_PROTO_TCP)
+		csum_offset = 16;
+	else if (proto == IP_PROTO_UDP)
+		csum_offset = 6;
+	else
+		return 0;
+
+	if (IPH_OFFSET(iphdr) & PP_HTONS(IP_OFFMASK | IP_MF))
+		return 0;
+
+	csum_start = SIZEOF_ETH_HDR + iphlen;
+
+	if (p->len < csum_start + csum_offset + 2)
+		return ((p->len < p->tot_len) ? -1 : 0);
+
+	ip4_addr_copy(src, iphdr->src);
+	ip4_addr_copy(dest, iphdr->dest);
+
+	*(u16_t *) ((u8_t *) p->payload + csum_start + csum_offset) =
+		~inet_chksum_pseudo_partial(p, proto, lwip_ntohs(IPH_LEN(iphdr)) - iphlen, 0, &src, &dest);
+
+	hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+	hdr->csum_start = csum_start;
+	hdr->csum_offset = csum_offset;
+
+	return 0;
+}
+
+static err_t virtio_net_linkoutput(struct netif *netif, struct pbuf *p) {
+	struct virtio_net *vnet = ((eth_dev_t *) netif->state)->priv;
+	struct virtio_sg sg[VIRTIO_NET_TX_SEGS];
+	struct virtio_net_hdr *hdr;
+	struct pbuf *q, *copy = NULL;
+	u16_t tot_len;
+	int nr, n;
+#ifdef CONFIG_NET_ZEROCOPY_TX
+	unsigned long flags;
+	bool zc;
+#endif
+
+	virtio_net_tx_reclaim(vnet);
+
+	hdr = &vnet->tx_hdrs[vnet->tx_hdr_next];
+	vnet->tx_hdr_next = (vnet->tx_hdr_next + 1) % VIRTIO_NET_QUEUE_SIZE;
+
+	/* The zero-copy send gives non-volatile pbufs which are kept as they are */
+	if (virtio_net_tx_volatile(p)) {
+		copy = virtio_net_tx_copy(p);
+		if (!copy)
+			return ERR_MEM;
+		p = copy;
+	}
+
+again:
+	memset(hdr, 0, sizeof(struct virtio_net_hdr));
+
+	if ((vnet->eth_dev->features & ETH_DEV_F_TX_CSUM) && virtio_net_tx_csum(p, hdr)) {
+		/* The headers are split: fall back to a copy into a single pbuf */
+		BUG_ON(copy != NULL);
+
+		copy = virtio_net_tx_copy(p);
+		if (!copy)
+			return ERR_MEM;
+		p = copy;
+		goto again;
+	}
+
+	sg[0].paddr = __pa(hdr);
+	sg[0].len = vnet->hdr_len;
+	nr = 1;
+
+	for (q = p; q != NULL; q = q->next) {
+		if (!q->len)
+			continue;
+
+		n = virtio_net_map((addr_t) q->payload, q->len, &sg[nr], VIRTIO_NET_TX_SEGS - nr);
+		if (n < 0) {
+			/* Too many segments: fall back to a copy into a single pbuf */
+			BUG_ON(copy != NULL);
+
+			copy = virtio_net_tx_copy(p);
+			if (!copy)
+				return ERR_MEM;
+			p = copy;
+			goto again;
+		}
+		nr += n;
+	}
+
+	/* Released once the device has sent the frame */
+	if (!copy)
+		pbuf_ref(p);
+
+	/* The frame may be reclaimed as soon as it is queued */
+	tot_len = p->tot_len;
+
+#ifdef CONFIG_NET_ZEROCOPY_TX
+	zc = virtio_net_tx_zc(p);
+	if (zc) {
+		flags = spin_lock_irqsave(&vnet->lock);
+		vnet->tx_zc++;
+		spin_unlock_irqrestore(&vnet->lock, flags);
+	}
+#endif
+
+	if (virtqueue_add(vnet->txvq, sg, nr, 0, p)) {
+		virtio_net_tx_reclaim(vnet);
+
+		if (virtqueue_add(vnet->txvq, sg, nr, 0, p)) {
+#ifdef CONFIG_NET_ZEROCOPY_TX
+			if (zc) {
+				flags = spin_lock_irqsave(&vnet->lock);
+				vnet->tx_zc--;
+				spin_unlock_irqrestore(&vnet->lock, flags);
+			}
+#endif
+			pbuf_free(p);
+			LINK_STATS_INC(link.drop);
+			return ERR_MEM;
+		}
+	}
+
+	virtqueue_kick(vnet->txvq);
+
+#ifdef CONFIG_NET_ZEROCOPY_TX
+	/* Frames sent in the meanwhile raise no interrupt */
+	if (zc && !virtqueue_enable_cb(vnet->txvq))
+		virtio_net_schedule_poll(vnet);
+#endif
+
+	LINK_STATS_INC(link.xmit);
+	MIB2_STATS_NETIF_ADD(netif, ifoutoctets, tot_len);
+
+	return ERR_OK;
+}
+
+static err_t virtio_net_lwip_init(struct netif *netif) {
+	eth_dev_t *eth_dev = netif->state;
+	struct virtio_net *vnet = eth_dev->priv;
+	int i;
+
+	LWIP_ASSERT("netif != NULL", (netif != NULL));
+
+	MIB2_INIT_NETIF(netif, snmp_ifType_ethernet_csmacd, 1000 * 1000 * 1000);
+
+	netif->name[0] = 'e';
+	netif->name[1] = 'n';
+
+	netif->hwaddr_len = ARP_HLEN;
+	for (i = 0; i < ARP_HLEN; i++)
+		netif->hwaddr[i] = eth_dev->enetaddr[i];
+
+	netif->mtu = 1500;
+	netif->flags = NETIF_FLAG_BROADCAST | NETIF_FLAG_ETHARP | NETIF_FLAG_LINK_UP;
+
+#if LWIP_IPV4
+	netif->output = etharp_output;
+#endif
+	netif->linkoutput = virtio_net_linkoutput;
+
+	eth_dev_setup_netif(eth_dev, netif);
+
+	vnet->netif = netif;
+
+	netif_set_default(netif);
+	netif_set_link_up(netif);
+	netif_set_up(netif);
+
+	kernel_thread(virtio_net_poll, "virtio-net", vnet, TCPIP_THREAD_PRIO);
+
+	/* Process the frames which may have been received so far */
+	virtqueue_kick(vnet->rxvq);
+	virtio_net_rx_done(vnet->rxvq);
+
+	dhcp_start(netif);
+
+	return ERR_OK;
+}
+
+/*
+ * Called once lwIP is initialized.
+ */
+static int virtio_net_init(eth_dev_t *eth_dev) {
+	struct netif *netif;
+
+	netif = malloc(sizeof(struct netif));
+	BUG_ON(!netif);
+	memset(netif, 0, sizeof(struct netif));
+
+	netif_add(netif, NULL, NULL, NULL, eth_dev, virtio_net_lwip_init, tcpip_input);
+
+	return 0;
+}
+
+int virtio_net_probe(struct virtio_device *vdev) {
+	struct virtio_net *vnet;
+	eth_dev_t *eth_dev;
+	addr_t paddr;
+	size_t size;
+	int i;
+#ifdef CONFIG_NET_ZEROCOPY_RX
+	void *zc;
+#endif
+
+	if (virtio_negotiate_features(vdev, (1ull << VIRTIO_NET_F_MAC) | (1ull << VIRTIO_NET_F_CSUM) |
+					    (1ull << VIRTIO_NET_F_GUEST_CSUM)))
+		return -1;
+
+	vnet = malloc(sizeof(struct virtio_net));
+	BUG_ON(!vnet);
+	memset(vnet, 0, sizeof(struct virtio_net));
+
+	vnet->vdev = vdev;
+	vdev->priv = vnet;
+
+	vnet->hdr_len = (virtio_has_feature(vdev, VIRTIO_F_VERSION_1) ? sizeof(struct virtio_net_hdr) : VIRTIO_NET_HDR_LEGACY_LEN);
+
+	init_completion(&vnet->rx_event);
+	spin_lock_init(&vnet->lock);
+
+	vnet->rxvq = virtio_setup_vq(vdev, VIRTIO_NET_RXQ, VIRTIO_NET_QUEUE_SIZE, virtio_net_rx_done);
+#ifdef CONFIG_NET_ZEROCOPY_TX
+	vnet->txvq = virtio_setup_vq(vdev, VIRTIO_NET_TXQ, VIRTIO_NET_QUEUE_SIZE, virtio_net_tx_done);
+#else
+	vnet->txvq = virtio_setup_vq(vdev, VIRTIO_NET_TXQ, VIRTIO_NET_QUEUE_SIZE, NULL);
+#endif
+
+	if (!vnet->rxvq || !vnet->txvq) {
+		free(vnet);
+		return -1;
+	}
+
+	/* Sent frames are reclaimed by the driver, the device need not interrupt */
+	virtqueue_disable_cb(vnet->txvq);
+
+	eth_dev = malloc(sizeof(eth_dev_t));
+	BUG_ON(!eth_dev);
+	memset(eth_dev, 0, sizeof(eth_dev_t));
+
+	strcpy(eth_dev->name, "virtio-net");
+
+	if (virtio_has_feature(vdev, VIRTIO_NET_F_MAC)) {
+		for (i = 0; i < ARP_HLEN; i++)
+			eth_dev->enetaddr[i] = virtio_cread8(vdev, VIRTIO_NET_CFG_MAC + i);
+	} else {
+		/* Locally administered address */
+		eth_dev->enetaddr[0] = 0x02;
+		eth_dev->enetaddr[5] = 0x01;
+	}
+
+	eth_dev->irq_def = vdev->irq_def;
+	eth_dev->init = virtio_net_init;
+	eth_dev->priv = vnet;
+
+	eth_dev->features = ETH_DEV_F_SG | ETH_DEV_F_RX_PREPOST;
+
+	if (virtio_has_feature(vdev, VIRTIO_NET_F_CSUM))
+		eth_dev->features |= ETH_DEV_F_TX_CSUM;
+	if (virtio_has_feature(vdev, VIRTIO_NET_F_GUEST_CSUM))
+		eth_dev->features |= ETH_DEV_F_RX_CSUM;
+
+	vnet->eth_dev = eth_dev;
+
+	/* The receive buffers, as many as the ring can hold */
+	size = ALIGN_UP(VIRTIO_NET_NR_RX_BUFS * sizeof(struct virtio_net_rxbuf), PAGE_SIZE);
+
+	paddr = get_contig_free_pages(size >> PAGE_SHIFT);
+	BUG_ON(!paddr);
+
+	vnet->rxbufs = (struct virtio_net_rxbuf *) __va(paddr);
+	memset(vnet->rxbufs, 0, size);
+
+	for (i = 0; i < VIRTIO_NET_NR_RX_BUFS; i++) {
+		vnet->rxbufs[i].vnet = vnet;
+		vnet->rxbufs[i].buf = vnet->rxbufs[i].data;
+#ifdef CONFIG_NET_ZEROCOPY_RX
+		zc = net_zc_buf_alloc();
+		if (zc)
+			vnet->rxbufs[i].buf = zc;
+#endif
+		virtio_net_post_rx(vnet, &vnet->rxbufs[i]);
+	}
+
+	virtio_device_ready(vdev);
+
+	network_devices_register(eth_dev);
+
+	printk("virtio-net: MAC %02x:%02x:%02x:%02x:%02x:%02x, %d RX buffers\n",
+	       eth_dev->enetaddr[0], eth_dev->enetaddr[1], eth_dev->enetaddr[2],
+	       eth_dev->enetaddr[3], eth_dev->enetaddr[4], eth_dev->enetaddr[5], VIRTIO_NET_NR_RX_BUFS);
+
+	return 0;
+}
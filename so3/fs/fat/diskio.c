@@ -24,7 +24,7 @@ struct block_drvr {
 };
 
 /*
- * Basically, we manage either a rootfs in a MMC - or - in a ramdev (in RAM).
+ * Basically, we manage either a rootfs in a MMC, in a ramdev (in RAM) - or - in a virtio block device.
  * This is exclusve. We are currently not able to manage the two.
  */
 static struct block_drvr block_drvr[] = {
@@ -33,6 +33,9 @@ static struct block_drvr block_drvr[] = {
 #endif
 #ifdef CONFIG_ROOTFS_RAMDEV
 	{ .name = "ramdev", .get_dev = ramdev_get_dev, },
+#endif
+#ifdef CONFIG_ROOTFS_VIRTIO_BLK
+	{ .name = "virtio-blk", .get_dev = virtio_blk_get_dev, },
 #endif
 	{ },
 };
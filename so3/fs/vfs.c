@@ -32,10 +32,18 @@
 #include <string.h>
 #include <dirent.h>
 #include <console.h>
+#include <vma.h>
 
 #include <fat/fat.h>
 #include <devfs/devfs.h>
 
+#ifdef CONFIG_IPC_PIPE
+#include <pipe.h>
+#endif
+
+/* Size of the kernel buffer used by sendfile() */
+#define SENDFILE_CHUNK		(4 * PAGE_SIZE)
+
 /* The VFS abstract subsystem manages a table of open file descriptors where indexes are known as gfd (global file descriptor).
  * Every process has its own file descriptor table. A local file descriptor (belonging to a process) must be linked to a global file descriptor
  * according to the fd type.
@@ -477,6 +485,289 @@ int do_write(int fd, const void *buffer, int count)
 	return ret;
 }
 
+/*
+ * Check the arguments of readv()/writev() and get the gfd.
+ */
+static int vfs_iov_gfd(int fd, const struct iovec *iov, int iovcnt)
+{
+	int gfd;
+
+	if (!iov || (iovcnt <= 0) || (iovcnt > IOV_MAX)) {
+		set_errno(EINVAL);
+		return -1;
+	}
+
+	mutex_lock(&vfs_lock);
+
+	gfd = vfs_get_gfd(fd);
+
+	if (!vfs_is_valid_gfd(gfd)) {
+		set_errno(EBADF);
+		mutex_unlock(&vfs_lock);
+		return -1;
+	}
+
+	if (open_fds[gfd]->type == VFS_TYPE_DIR) {
+		set_errno(EISDIR);
+		mutex_unlock(&vfs_lock);
+		return -1;
+	}
+
+	mutex_unlock(&vfs_lock);
+
+	return gfd;
+}
+
+/**
+ * @brief Scatter read. The callback of the file is used if any, otherwise the
+ *	segments are read one after the other until a short read.
+ */
+int do_readv(int fd, const struct iovec *iov, int iovcnt)
+{
+	struct file_operations *fops;
+	int gfd, i, ret, total = 0;
+
+	gfd = vfs_iov_gfd(fd, iov, iovcnt);
+	if (gfd < 0)
+		return -1;
+
+	fops = open_fds[gfd]->fops;
+
+	if (fops->readv)
+		return fops->readv(gfd, iov, iovcnt);
+
+	if (!fops->read) {
+		set_errno(EBADF);
+		return -1;
+	}
+
+	for (i = 0; i < iovcnt; i++) {
+		if (!iov[i].iov_len)
+			continue;
+
+		ret = fops->read(gfd, iov[i].iov_base, iov[i].iov_len);
+		if (ret < 0)
+			return (total ? total : ret);
+
+		total += ret;
+
+		if (ret < iov[i].iov_len)
+			break;
+	}
+
+	return total;
+}
+
+/**
+ * @brief Gather write. The callback of the file is used if any, otherwise the
+ *	segments are written one after the other until a short write.
+ */
+int do_writev(int fd, const struct iovec *iov, int iovcnt)
+{
+	struct file_operations *fops;
+	int gfd, i, ret, total = 0;
+
+	gfd = vfs_iov_gfd(fd, iov, iovcnt);
+	if (gfd < 0)
+		return -1;
+
+	fops = open_fds[gfd]->fops;
+
+	if (fops->writev)
+		return fops->writev(gfd, iov, iovcnt);
+
+	if (!fops->write) {
+		set_errno(EBADF);
+		return -1;
+	}
+
+	for (i = 0; i < iovcnt; i++) {
+		if (!iov[i].iov_len)
+			continue;
+
+		ret = fops->write(gfd, iov[i].iov_base, iov[i].iov_len);
+		if (ret < 0)
+			return (total ? total : ret);
+
+		total += ret;
+
+		if (ret < iov[i].iov_len)
+			break;
+	}
+
+	return total;
+}
+
+/**
+ * @brief Copy <count> bytes from <in_fd> (typically a file) to <out_fd> (typically
+ *	a socket) within the kernel, without going through a user space buffer.
+ *	If <offset> is not NULL, the data is read from this offset which is updated
+ *	and the file position of <in_fd> is left unchanged.
+ */
+int do_sendfile(int out_fd, int in_fd, off_t *offset, size_t count)
+{
+	struct file_operations *in_fops, *out_fops;
+	int gfd_in, gfd_out;
+	off_t pos = 0;
+	size_t total = 0;
+	int n, written;
+	bool err = false;
+	void *buf;
+
+	mutex_lock(&vfs_lock);
+
+	gfd_in = vfs_get_gfd(in_fd);
+	gfd_out = vfs_get_gfd(out_fd);
+
+	if (!vfs_is_valid_gfd(gfd_in) || !vfs_is_valid_gfd(gfd_out)) {
+		set_errno(EBADF);
+		mutex_unlock(&vfs_lock);
+		return -1;
+	}
+
+	in_fops = open_fds[gfd_in]->fops;
+	out_fops = open_fds[gfd_out]->fops;
+
+	mutex_unlock(&vfs_lock);
+
+	if (!in_fops->read || !out_fops->write) {
+		set_errno(EINVAL);
+		return -1;
+	}
+
+	if (offset) {
+		if (!in_fops->lseek) {
+			set_errno(ESPIPE);
+			return -1;
+		}
+
+		pos = in_fops->lseek(gfd_in, 0, SEEK_CUR);
+		if ((pos < 0) || (in_fops->lseek(gfd_in, *offset, SEEK_SET) < 0)) {
+			set_errno(EINVAL);
+			return -1;
+		}
+	}
+
+	buf = malloc(SENDFILE_CHUNK);
+	if (!buf) {
+		if (offset)
+			in_fops->lseek(gfd_in, pos, SEEK_SET);
+		set_errno(ENOMEM);
+		return -1;
+	}
+
+	while (total < count) {
+		n = in_fops->read(gfd_in, buf, ((count - total < SENDFILE_CHUNK) ? count - total : SENDFILE_CHUNK));
+		if (n <= 0) {
+			err = (n < 0);
+			break;
+		}
+
+		written = out_fops->write(gfd_out, buf, n);
+		if (written < 0) {
+			err = true;
+			written = 0;
+		}
+
+		total += written;
+
+		if (written < n) {
+			/* Give the bytes which could not be sent back to the input */
+			if (in_fops->lseek && !offset)
+				in_fops->lseek(gfd_in, written - n, SEEK_CUR);
+			break;
+		}
+	}
+
+	free(buf);
+
+	if (offset) {
+		*offset += total;
+		in_fops->lseek(gfd_in, pos, SEEK_SET);
+	}
+
+	if (!total && err)
+		return -1;
+
+	return total;
+}
+
+#ifdef CONFIG_IPC_PIPE
+
+/*
+ * Move data between a pipe and another file without going through user space.
+ * At least one end must be a pipe; offsets are not supported.
+ */
+int do_splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len, unsigned int flags)
+{
+	struct file_operations *in_fops, *out_fops;
+	int gfd_in, gfd_out;
+
+	if (off_in || off_out) {
+		set_errno(ESPIPE);
+		return -1;
+	}
+
+	if (!len)
+		return 0;
+
+	mutex_lock(&vfs_lock);
+
+	gfd_in = vfs_get_gfd(fd_in);
+	gfd_out = vfs_get_gfd(fd_out);
+
+	if (!vfs_is_valid_gfd(gfd_in) || !vfs_is_valid_gfd(gfd_out)) {
+		set_errno(EBADF);
+		mutex_unlock(&vfs_lock);
+		return -1;
+	}
+
+	in_fops = open_fds[gfd_in]->fops;
+	out_fops = open_fds[gfd_out]->fops;
+
+	mutex_unlock(&vfs_lock);
+
+	if ((in_fops == &pipe_fops) && (vfs_get_access_mode(gfd_in) != O_RDONLY)) {
+		set_errno(EBADF);
+		return -1;
+	}
+
+	if ((out_fops == &pipe_fops) && (vfs_get_access_mode(gfd_out) != O_WRONLY)) {
+		set_errno(EBADF);
+		return -1;
+	}
+
+	if ((in_fops == &pipe_fops) && (out_fops == &pipe_fops)) {
+		/* Pipe to pipe: not worth a dedicated path */
+		set_errno(EINVAL);
+		return -1;
+	}
+
+	if (in_fops == &pipe_fops) {
+		if (!out_fops->write) {
+			set_errno(EINVAL);
+			return -1;
+		}
+
+		return pipe_splice_read(gfd_in, out_fops, gfd_out, len);
+	}
+
+	if (out_fops == &pipe_fops) {
+		if (!in_fops->read) {
+			set_errno(EINVAL);
+			return -1;
+		}
+
+		return pipe_splice_write(gfd_out, in_fops, gfd_in, len);
+	}
+
+	set_errno(EINVAL);
+
+	return -1;
+}
+
+#endif /* CONFIG_IPC_PIPE */
+
 /**
  * @brief This function opens a file. Not all file types are supported.
  */
@@ -745,41 +1036,59 @@ int do_stat(const char *path, struct stat *st)
 }
 
 /**
- * An mmap() implementation in VFS.
+ * Map a device (e.g. framebuffer) at @virt_addr in the current process.
+ * The memory area is managed by do_mmap().
  */
-void *do_mmap(addr_t start, size_t length, int prot, int fd, off_t offset)
+void *vfs_mmap(int fd, addr_t virt_addr, uint32_t page_count)
 {
 	int gfd;
-	uint32_t page_count;
 	struct file_operations *fops;
 
 	/* Get the fops associated to the file descriptor. */
 
 	gfd = vfs_get_gfd(fd);
 	if (-1 == gfd) {
-		printk("%s: could not get global fd.", __func__);
+		set_errno(EBADF);
 		return NULL;
 	}
 
 	mutex_lock(&vfs_lock);
 	fops = vfs_get_fops(gfd);
-	if (!fops) {
-		printk("%s: could not get the framebuffer fops.", __func__);
-		mutex_unlock(&vfs_lock);
+	mutex_unlock(&vfs_lock);
+
+	if (!fops || !fops->mmap) {
+		set_errno(ENODEV);
 		return NULL;
 	}
 
-	mutex_unlock(&vfs_lock);
+	/* Call the mmap fops that will do the actual mapping. */
+	return fops->mmap(fd, virt_addr, page_count);
+}
 
-	/* Page count to allocate to the current process to be able to map the desired region. */
-	page_count = length / PAGE_SIZE;
-	if (length % PAGE_SIZE != 0) {
-		page_count++;
+#ifndef CONFIG_VMA
+/**
+ * An mmap() implementation in VFS, used when the processes have no memory
+ * areas (see mm/vma.c): only devices can be mapped. Without a hint, the
+ * mapping is placed right above the heap reservation.
+ */
+void *do_mmap(addr_t start, size_t length, int prot, int flags, int fd, off_t offset)
+{
+	pcb_t *pcb = current()->pcb;
+	void *addr;
+
+	if (!length || (flags & MAP_ANONYMOUS)) {
+		set_errno(EINVAL);
+		return MAP_FAILED;
 	}
 
-	/* Call the mmap fops that will do the actual mapping. */
-	return fops->mmap(fd, start, page_count);
+	if (!start)
+		start = ALIGN_UP(pcb->heap_base + HEAP_SIZE, PAGE_SIZE);
+
+	addr = vfs_mmap(fd, start, ALIGN_UP(length, PAGE_SIZE) >> PAGE_SHIFT);
+
+	return (addr ? addr : MAP_FAILED);
 }
+#endif /* !CONFIG_VMA */
 
 int do_ioctl(int fd, unsigned long cmd, unsigned long args)
 {
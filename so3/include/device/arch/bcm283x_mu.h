@@ -48,5 +48,14 @@ typedef struct {
 /* LSR register bits */
 #define UART_LSR_RX_READY  (1 << 0)
 #define UART_LSR_TX_READY  (1 << 5)
+#define UART_LSR_TX_IDLE   (1 << 6)	/* TX FIFO empty and transmitter idle */
+
+/* IER/IIR bits (8250-compatible) */
+#define UART_IER_TX        (1 << 1)
+#define UART_IIR_NO_INT    (1 << 0)
+#define UART_IIR_ID        0x06
+#define UART_IIR_TX        0x02
+
+#define UART_FIFO_SIZE     8
 
 #endif /* BCM28x_MU_H */
@@ -87,4 +87,16 @@ typedef struct {
 #define UART_LSR_DR     (1 << 0)
 #define UART_LSR_THRE   (1 << 5)
 
+#define UART_IER_THRI   (1 << 1)	/* TX holding register empty interrupt */
+
+#define UART_IIR_NO_INT 0x01
+#define UART_IIR_ID     0x0e
+#define UART_IIR_THRI   0x02
+
+#define UART_FCR_ENABLE_FIFO	(1 << 0)
+#define UART_FCR_CLEAR_RCVR	(1 << 1)
+#define UART_FCR_CLEAR_XMIT	(1 << 2)
+
+#define UART_FIFO_SIZE  16
+
 #endif /* NS16550_H */
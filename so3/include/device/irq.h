@@ -97,6 +97,8 @@ extern irq_ops_t irq_ops;
 
 void irq_process(uint32_t irq);
 
+cpu_regs_t *get_irq_regs(void);
+
 void irq_init(void);
 
 irqdesc_t *irq_to_desc(uint32_t irq);
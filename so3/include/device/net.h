@@ -29,6 +29,26 @@
 
 #define ETH_NAME_LEN 20
 
+/*
+ * Capabilities declared by a driver in eth_dev->features
+ */
+
+/* The device computes the TCP/UDP checksums of the sent frames */
+#define ETH_DEV_F_TX_CSUM	(1 << 0)
+
+/* The device validates the TCP/UDP checksums of the received frames */
+#define ETH_DEV_F_RX_CSUM	(1 << 1)
+
+/* linkoutput accepts pbuf chains, which are not linearized */
+#define ETH_DEV_F_SG		(1 << 2)
+
+/* Frames are received into buffers posted in advance by the driver and
+ * passed to lwIP without copy (custom pbufs), not from the pbuf pool. */
+#define ETH_DEV_F_RX_PREPOST	(1 << 3)
+
+struct netif;
+struct pbuf;
+
 struct eth_dev {
     struct list_head list;
 
@@ -40,6 +60,9 @@ struct eth_dev {
 
     int state;
 
+    /* ETH_DEV_F_* */
+    unsigned int features;
+
     int (*init)(struct eth_dev *);
     int (*send)(struct eth_dev *, void *packet, int length);
     int (*recv)(struct eth_dev *);
@@ -59,4 +82,7 @@ void network_devices_init(void);
 
 void network_devices_register(eth_dev_t *eth_dev);
 
+void eth_dev_setup_netif(eth_dev_t *eth_dev, struct netif *netif);
+bool eth_dev_rx_csum_ok(struct pbuf *p);
+
 #endif /* NETWORK_H */
@@ -41,6 +41,14 @@ typedef struct {
 	char (*get_byte)(bool polling);
 	void (*enable_irq)(void);
 	void (*disable_irq)(void);
+
+	/*
+	 * Optional, for drivers with a TX interrupt: push a byte to the TX FIFO
+	 * without waiting (0 if the FIFO is full) and enable/disable the interrupt
+	 * raised when the FIFO has room again.
+	 */
+	int (*tx_put_byte)(char c);
+	void (*tx_irq)(bool enable);
 } serial_ops_t;
 
 extern serial_ops_t serial_ops;
@@ -61,6 +69,8 @@ int serial_gwinsize(struct winsize *wsz);
 
 int ll_serial_write(char *str, int len);
 
+void serial_tx_interrupt(void);
+
 void serial_init(void);
 void serial_cleanup(void);
 
@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef VIRTIO_H
+#define VIRTIO_H
+
+#include <types.h>
+#include <spinlock.h>
+
+#include <device/irq.h>
+
+/* virtio-mmio registers (legacy and version 2 layouts) */
+#define VIRTIO_MMIO_MAGIC_VALUE		0x000
+#define VIRTIO_MMIO_VERSION		0x004
+#define VIRTIO_MMIO_DEVICE_ID		0x008
+#define VIRTIO_MMIO_VENDOR_ID		0x00c
+#define VIRTIO_MMIO_DEVICE_FEATURES	0x010
+#define VIRTIO_MMIO_DEVICE_FEATURES_SEL	0x014
+#define VIRTIO_MMIO_DRIVER_FEATURES	0x020
+#define VIRTIO_MMIO_DRIVER_FEATURES_SEL	0x024
+#define VIRTIO_MMIO_GUEST_PAGE_SIZE	0x028	/* Legacy only */
+#define VIRTIO_MMIO_QUEUE_SEL		0x030
+#define VIRTIO_MMIO_QUEUE_NUM_MAX	0x034
+#define VIRTIO_MMIO_QUEUE_NUM		0x038
+#define VIRTIO_MMIO_QUEUE_ALIGN		0x03c	/* Legacy only */
+#define VIRTIO_MMIO_QUEUE_PFN		0x040	/* Legacy only */
+#define VIRTIO_MMIO_QUEUE_READY		0x044
+#define VIRTIO_MMIO_QUEUE_NOTIFY	0x050
+#define VIRTIO_MMIO_INTERRUPT_STATUS	0x060
+#define VIRTIO_MMIO_INTERRUPT_ACK	0x064
+#define VIRTIO_MMIO_STATUS		0x070
+#define VIRTIO_MMIO_QUEUE_DESC_LOW	0x080
+#define VIRTIO_MMIO_QUEUE_DESC_HIGH	0x084
+#define VIRTIO_MMIO_QUEUE_AVAIL_LOW	0x090
+#define VIRTIO_MMIO_QUEUE_AVAIL_HIGH	0x094
+#define VIRTIO_MMIO_QUEUE_USED_LOW	0x0a0
+#define VIRTIO_MMIO_QUEUE_USED_HIGH	0x0a4
+#define VIRTIO_MMIO_CONFIG		0x100
+
+#define VIRTIO_MMIO_MAGIC		0x74726976	/* "virt" */
+
+#define VIRTIO_MMIO_INT_VRING		(1 << 0)
+#define VIRTIO_MMIO_INT_CONFIG		(1 << 1)
+
+/* Device status */
+#define VIRTIO_STATUS_ACKNOWLEDGE	1
+#define VIRTIO_STATUS_DRIVER		2
+#define VIRTIO_STATUS_DRIVER_OK		4
+#define VIRTIO_STATUS_FEATURES_OK	8
+#define VIRTIO_STATUS_FAILED		128
+
+/* Device IDs */
+#define VIRTIO_ID_NET			1
+#define VIRTIO_ID_BLOCK			2
+
+/* Device-independent feature bits */
+#define VIRTIO_RING_F_INDIRECT_DESC	28
+#define VIRTIO_F_VERSION_1		32
+
+/* Descriptor flags */
+#define VIRTQ_DESC_F_NEXT		1
+#define VIRTQ_DESC_F_WRITE		2
+#define VIRTQ_DESC_F_INDIRECT		4
+
+#define VIRTQ_AVAIL_F_NO_INTERRUPT	1
+#define VIRTQ_USED_F_NO_NOTIFY		1
+
+/* Alignment of the used ring in the legacy (contiguous) layout */
+#define VIRTQ_LEGACY_ALIGN		PAGE_SIZE
+
+struct virtq_desc {
+	u64 addr;
+	u32 len;
+	u16 flags;
+	u16 next;
+};
+
+struct virtq_avail {
+	u16 flags;
+	u16 idx;
+	u16 ring[];
+};
+
+struct virtq_used_elem {
+	u32 id;
+	u32 len;
+};
+
+struct virtq_used {
+	u16 flags;
+	u16 idx;
+	struct virtq_used_elem ring[];
+};
+
+/* Physically contiguous piece of a buffer given to the device */
+struct virtio_sg {
+	addr_t paddr;
+	u32 len;
+};
+
+struct virtio_device;
+
+struct virtqueue {
+	struct virtio_device *vdev;
+	unsigned int index;
+
+	/* Number of descriptors, a power of 2 */
+	unsigned int num;
+
+	struct virtq_desc *desc;
+	struct virtq_avail *avail;
+	struct virtq_used *used;
+
+	/* Head of the chain of free descriptors */
+	u16 free_head;
+	unsigned int num_free;
+
+	/* Next used entry to be processed by the driver */
+	u16 last_used_idx;
+
+	/* Token given along with a buffer, indexed by its head descriptor */
+	void **data;
+
+	/* Called from the interrupt handler when the device has used buffers */
+	void (*callback)(struct virtqueue *vq);
+
+	spinlock_t lock;
+};
+
+#define VIRTIO_MAX_QUEUES	4
+
+struct virtio_device {
+	void *base;
+	unsigned int version;
+	unsigned int id;
+
+	irq_def_t irq_def;
+
+	/* Features accepted by both the device and the driver */
+	u64 features;
+
+	struct virtqueue *vqs[VIRTIO_MAX_QUEUES];
+
+	/* Private data of the device driver (virtio-blk, virtio-net) */
+	void *priv;
+};
+
+/*
+ * A virtio device driver is bound to a transport according to the device ID.
+ */
+struct virtio_driver {
+	unsigned int device_id;
+	int (*probe)(struct virtio_device *vdev);
+};
+
+static inline bool virtio_has_feature(struct virtio_device *vdev, unsigned int bit) {
+	return !!(vdev->features & (1ull << bit));
+}
+
+u8 virtio_cread8(struct virtio_device *vdev, unsigned int offset);
+u32 virtio_cread32(struct virtio_device *vdev, unsigned int offset);
+u64 virtio_cread64(struct virtio_device *vdev, unsigned int offset);
+
+int virtio_negotiate_features(struct virtio_device *vdev, u64 driver_features);
+void virtio_device_ready(struct virtio_device *vdev);
+
+struct virtqueue *virtio_setup_vq(struct virtio_device *vdev, unsigned int index, unsigned int num,
+				  void (*callback)(struct virtqueue *vq));
+
+int virtqueue_add(struct virtqueue *vq, struct virtio_sg *sg, unsigned int out, unsigned int in, void *data);
+int virtqueue_add_indirect(struct virtqueue *vq, struct virtq_desc *table, struct virtio_sg *sg,
+			   unsigned int out, unsigned int in, void *data);
+void virtqueue_kick(struct virtqueue *vq);
+void *virtqueue_get_buf(struct virtqueue *vq, u32 *len);
+
+bool virtqueue_pending(struct virtqueue *vq);
+void virtqueue_disable_cb(struct virtqueue *vq);
+bool virtqueue_enable_cb(struct virtqueue *vq);
+
+void virtio_interrupt(struct virtio_device *vdev);
+
+#ifdef CONFIG_VIRTIO_BLK
+int virtio_blk_probe(struct virtio_device *vdev);
+#endif
+
+#ifdef CONFIG_VIRTIO_NET
+int virtio_net_probe(struct virtio_device *vdev);
+#endif
+
+#endif /* VIRTIO_H */
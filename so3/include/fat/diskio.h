@@ -81,6 +81,7 @@ DRESULT disk_ioctl (BYTE pdrv, BYTE cmd, void* buff);
 
 extern block_dev_desc_t *mmc_get_dev(int dev);
 extern block_dev_desc_t *ramdev_get_dev(int dev);
+extern block_dev_desc_t *virtio_blk_get_dev(int dev);
 
 #endif /* DISKIO_DEFINED */
 
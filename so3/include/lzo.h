@@ -15,6 +15,8 @@
  *  Richard Purdie <rpurdie@openedhand.com>
  */
 
+#include <types.h>
+
 #define LZO1X_MEM_COMPRESS (16384 * sizeof(unsigned char *))
 #define LZO1X_1_MEM_COMPRESS LZO1X_MEM_COMPRESS
 
@@ -28,6 +30,13 @@ int lzo1x_1_compress(const unsigned char *src, size_t src_len,
 int lzo1x_decompress_safe(const unsigned char *src, size_t src_len,
                           unsigned char *dst, size_t *dst_len);
 
+/* decompression of a lzop file image (FIT components with compression = "lzo") */
+int lzop_decompress(const unsigned char *src, size_t src_len,
+                    unsigned char *dst, size_t *dst_len);
+
+/* size of a lzop file image once uncompressed (0 if the image is not valid) */
+size_t lzop_uncompressed_size(const unsigned char *src, size_t src_len);
+
 /*
  * Return values (< 0 = Error)
  */
@@ -125,6 +125,9 @@ int get_ME_free_slot(unsigned int size);
 #define page_to_phys(page) (pfn_to_phys(page_to_pfn(page)))
 #define phys_to_page(phys) (pfn_to_page(phys_to_pfn(phys)))
 
+/* The frame table does not cover the low kernel region */
+#define pfn_valid(pfn) (((pfn) >= pfn_start) && ((pfn) < pfn_start + mem_info.avail_pages))
+
 void clear_bss(void);
 void init_mmu(void);
 void memory_init(void);
@@ -143,6 +146,10 @@ void dump_frame_table(void);
 addr_t get_free_page(void);
 void free_page(addr_t paddr);
 
+void get_page(page_t *page);
+bool get_page_unless_zero(page_t *page);
+void put_page(page_t *page);
+
 addr_t get_free_vpage(void);
 void free_vpage(addr_t vaddr);
 
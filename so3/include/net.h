@@ -65,8 +65,139 @@
 #define SIOCSIFHWBROADCAST 0x8937
 #define SIOCGIFCOUNT    0x8938
 
+/* SO3 specific, in the SIOCDEVPRIVATE range */
+#define SIOCGNETSTATS   0x89f0
+#define SIOCGZCSIZE     0x89f1
+#define SIOCZCRECV      0x89f2
+#define SIOCZCRECYCLE   0x89f3
+#define SIOCZCSENDDONE  0x89f4
+#define SIOCZCENABLE    0x89f5
+
+/*
+ * lwIP statistics returned by SIOCGNETSTATS (CONFIG_LWIP_STATS)
+ */
+
+#define NET_STATS_MAX_POOLS	32
+
+struct net_stats_proto {
+	u32 xmit;
+	u32 recv;
+	u32 drop;
+	u32 chkerr;
+	u32 lenerr;
+	u32 memerr;
+	u32 rterr;
+	u32 proterr;
+	u32 err;
+};
+
+struct net_stats_mem {
+	char name[16];
+	u32 avail;
+	u32 used;
+	u32 max;
+	u32 err;
+};
+
+struct net_stats {
+	struct net_stats_proto link;
+	struct net_stats_proto etharp;
+	struct net_stats_proto ip;
+	struct net_stats_proto icmp;
+	struct net_stats_proto udp;
+	struct net_stats_proto tcp;
+
+	/* lwIP heap */
+	struct net_stats_mem heap;
+
+	u32 nr_pools;
+	struct net_stats_mem pools[NET_STATS_MAX_POOLS];
+};
+
+/* MSG_* flags of the user space (libc), which differ from the lwIP ones */
+#define MSG_USR_PEEK		0x02
+#define MSG_USR_TRUNC		0x20
+#define MSG_USR_DONTWAIT	0x40
+#define MSG_USR_WAITFORONE	0x10000
+#define MSG_USR_ZEROCOPY	0x4000000
+
+/* Largest number of messages handled by a sendmmsg()/recvmmsg() call */
+#define NET_MMSG_MAX		1024
+
+/*
+ * Message headers of the user space (sendmmsg/recvmmsg), whose msg_iovlen and
+ * msg_controllen fields are larger than the lwIP ones.
+ */
+struct msghdr_usr {
+	void *msg_name;
+	socklen_t msg_namelen;
+	struct iovec *msg_iov;
+	size_t msg_iovlen;
+	void *msg_control;
+	size_t msg_controllen;
+	int msg_flags;
+};
+
+struct mmsghdr_usr {
+	struct msghdr_usr msg_hdr;
+	unsigned int msg_len;
+};
+
+/*
+ * Zero-copy receive (CONFIG_NET_ZEROCOPY_RX)
+ *
+ * A TCP socket opts in with SIOCZCENABLE; the sockets accepted on a listening
+ * socket inherit it. A window of the size of the receive pool (SIOCGZCSIZE) is
+ * then reserved read-only with mmap() on the socket, once per process. SIOCZCRECV
+ * maps the buffers of the next received data into the window of the calling
+ * process and returns where the data lies; each segment stays valid until its
+ * buffer is given back with SIOCZCRECYCLE, which unmaps it. The buffers still
+ * held are released on close(). The window is not inherited along fork().
+ */
+
+#define NET_ZC_MAX_SEGS		32
+
+struct net_zc_seg {
+	u32 offset;	/* Offset of the data in the mapping */
+	u32 len;
+	u32 id;		/* Buffer to recycle */
+};
+
+struct net_zc_recv {
+	u32 max_segs;	/* in: number of entries of segs[] */
+	u32 flags;	/* in: MSG_DONTWAIT */
+	u32 nr_segs;	/* out */
+	u32 len;	/* out: total length, 0 at the end of the stream */
+	struct net_zc_seg segs[NET_ZC_MAX_SEGS];
+};
+
+struct net_zc_recycle {
+	u32 nr_ids;
+	u32 ids[NET_ZC_MAX_SEGS];
+};
+
+/*
+ * Zero-copy send (CONFIG_NET_ZEROCOPY_TX)
+ *
+ * A datagram sent with MSG_ZEROCOPY refers to the user buffer, which must not
+ * be modified until SIOCZCSENDDONE returns the id of the message. The ids of a
+ * socket follow the order of the zero-copy sends, starting at 0.
+ */
+
+/* The data has been copied: the buffer was already reusable */
+#define NET_ZC_TX_COPIED	0x80000000
+
+struct net_zc_txdone {
+	u32 nr_ids;	/* out */
+	u32 ids[NET_ZC_MAX_SEGS];
+};
+
+struct timespec;
+
 void net_init(void);
 
+int user_to_lwip_msg_flags(int flags);
+
 int do_socket(int domain, int type, int protocol);
 int do_connect(int sockfd, const struct sockaddr *name, socklen_t namelen);
 int do_bind(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
@@ -76,6 +207,8 @@ int do_recv(int sockfd, void *mem, size_t len, int flags);
 int do_recvfrom(int sockfd, void *mem, size_t len, int flags, struct sockaddr *from, socklen_t *fromlen);
 int do_send(int sockfd, const void *dataptr, size_t size, int flags);
 int do_sendto(int sockfd, const void *dataptr, size_t size, int flags, const struct sockaddr *to, socklen_t tolen);
+int do_sendmmsg(int sockfd, struct mmsghdr_usr *msgvec, unsigned int vlen, int flags);
+int do_recvmmsg(int sockfd, struct mmsghdr_usr *msgvec, unsigned int vlen, int flags, struct timespec *timeout);
 int do_setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t optlen);
 
 #endif /* NET_H */
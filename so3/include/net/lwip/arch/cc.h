@@ -68,7 +68,16 @@ typedef s32     s32_t;
 
 typedef unsigned long int  mem_ptr_t;
 
+#ifdef CONFIG_ARCH_ARM64
+/* Checksum with 64-bit loads, see arch/arm64/lib/csum.c */
+u16_t arm64_inet_chksum(const void *dataptr, int len);
+#define LWIP_CHKSUM arm64_inet_chksum
+#endif
+
 #include <timer.h>
 #define LWIP_TIMEVAL_PRIVATE 0
 
+/* struct iovec is shared with the VFS */
+#include <uio.h>
+
 #endif /* CC_H */
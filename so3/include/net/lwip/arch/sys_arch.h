@@ -50,14 +50,33 @@ typedef struct _sys_sem sys_sem_t;
 #define sys_sem_set_invalid(_sema) do { if((_sema) != NULL) (_sema)->sem = NULL; }while(0)
 
 
+/*
+ * Mailboxes are lock-free rings. A producer claims a slot by moving <head> forward
+ * and publishes the message with the slot sequence number; there is a single
+ * consumer, the thread owning the tcpip mailbox or the socket receiving from a
+ * netconn mailbox. The semaphores are only used when a side has to sleep.
+ */
 #define SYS_MBOX_SIZE 128
+
+struct _mbox_slot {
+        u32_t seq;
+        void *msg;
+};
+
 struct _mbox  {
-        u32_t first, last;
-        sem_t *not_empty;
-        sem_t *not_full;
-        void *mutex;
-        int *wait_send;
-        void *msgs[SYS_MBOX_SIZE];
+        u32_t head;
+        u32_t tail;
+
+        /* Set while the consumer sleeps on not_empty */
+        int wait_fetch;
+
+        /* Number of producers sleeping on not_full */
+        int wait_post;
+
+        sem_t not_empty;
+        sem_t not_full;
+
+        struct _mbox_slot slots[SYS_MBOX_SIZE];
 };
 typedef struct _mbox _mbox_t;
 
@@ -36,6 +36,7 @@
 #define __LWIPOPTS_H__
 
 #define TCPIP_THREAD_NAME               "tcp/ip"
+/* Not used: the tcpip thread is a kernel thread with the usual kernel stack */
 #define TCPIP_THREAD_STACKSIZE          350
 #define TCPIP_THREAD_PRIO               2
 
@@ -96,6 +97,20 @@
  */
 #define SYS_LIGHTWEIGHT_PROT            1
 
+/**
+ * LWIP_TCPIP_CORE_LOCKING==1: the socket calls run the stack in the calling
+ * thread with the core lock held, instead of posting a message to the tcpip
+ * thread and waiting for it.
+ */
+#define LWIP_TCPIP_CORE_LOCKING         1
+
+/**
+ * LWIP_TCPIP_CORE_LOCKING_INPUT==1: the received frames are processed in the
+ * RX thread of the netif driver under the core lock, without going through
+ * the tcpip mailbox. netif->input must not be called from an interrupt handler.
+ */
+#define LWIP_TCPIP_CORE_LOCKING_INPUT   1
+
 /*
    ------------------------------------
    ---------- Memory options ----------
@@ -113,7 +128,7 @@
  * MEM_SIZE: the size of the heap memory. If the application will send
  * a lot of data that needs to be copied, this should be set high.
  */
-#define MEM_SIZE                        (8*1024)
+#define MEM_SIZE                        (CONFIG_LWIP_MEM_SIZE*1024)
 
 /*
    ------------------------------------------------
@@ -131,13 +146,14 @@
  * MEMP_NUM_TCP_PCB: the number of simulatenously active TCP connections.
  * (requires the LWIP_TCP option)
  */
-#define MEMP_NUM_TCP_PCB                10
+#define MEMP_NUM_TCP_PCB                CONFIG_LWIP_MEMP_NUM_TCP_PCB
 
 /**
  * MEMP_NUM_TCP_SEG: the number of simultaneously queued TCP segments.
  * (requires the LWIP_TCP option)
+ * A full send buffer must not run out of segments.
  */
-#define MEMP_NUM_TCP_SEG                64
+#define MEMP_NUM_TCP_SEG                TCP_SND_QUEUELEN
 
 /**
  * MEMP_NUM_SYS_TIMEOUT: the number of simulateously active timeouts.
@@ -154,7 +170,7 @@
 /**
  * PBUF_POOL_SIZE: the number of buffers in the pbuf pool.
  */
-#define PBUF_POOL_SIZE                  64
+#define PBUF_POOL_SIZE                  CONFIG_LWIP_PBUF_POOL_SIZE
 
 
 /*
@@ -170,6 +186,12 @@
  */
 #define PBUF_POOL_BUFSIZE               1500
 
+/**
+ * LWIP_SUPPORT_CUSTOM_PBUF: the virtio-net driver gives its receive buffers
+ * to the stack as custom pbufs, without copy.
+ */
+#define LWIP_SUPPORT_CUSTOM_PBUF        1
+
 /*
  ---------------------------------
  ---------- TCP options ----------
@@ -184,12 +206,12 @@
 #define TCP_MSS                         1500
 
 /* TCP sender buffer space (bytes). */
-#define TCP_SND_BUF                     TCP_MSS * 16
+#define TCP_SND_BUF                     (TCP_MSS * CONFIG_LWIP_TCP_SND_BUF_MSS)
 
 /**
  * TCP_WND: The size of a TCP window.
  */
-#define TCP_WND                         TCP_MSS * 16
+#define TCP_WND                         (TCP_MSS * CONFIG_LWIP_TCP_WND_MSS)
 
 /**
  * TCP_SYNMAXRTX: Maximum number of retransmissions of SYN segments.
@@ -218,6 +240,17 @@
 #define LWIP_SOCKET                     1
 
 
+/*
+   --------------------------------------
+   ---------- Checksum options ----------
+   --------------------------------------
+*/
+/**
+ * LWIP_CHECKSUM_CTRL_PER_NETIF==1: the TCP/UDP checksums are left to the
+ * devices which declare ETH_DEV_F_TX_CSUM/ETH_DEV_F_RX_CSUM (see eth_dev_setup_netif()).
+ */
+#define LWIP_CHECKSUM_CTRL_PER_NETIF    1
+
 /*
    ----------------------------------------
    ---------- Statistics options ----------
@@ -225,8 +258,14 @@
 */
 /**
  * LWIP_STATS==1: Enable statistics collection in lwip_stats.
+ * They are read with the SIOCGNETSTATS ioctl.
  */
+#ifdef CONFIG_LWIP_STATS
+#define LWIP_STATS                      1
+#define LWIP_STATS_LARGE                1
+#else
 #define LWIP_STATS                      0
+#endif
 
 /*
    ----------------------------------
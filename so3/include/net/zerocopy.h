@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef NET_ZEROCOPY_H
+#define NET_ZEROCOPY_H
+
+#include <types.h>
+
+/* One buffer per page, so that a page only shows the frame of the process it is mapped into */
+#define NET_ZC_BUF_SIZE		4096
+
+struct pbuf;
+struct iovec;
+struct net_zc_recv;
+struct net_zc_recycle;
+struct net_zc_txmsg;
+struct net_zc_txdone;
+
+/* Used by the network drivers to receive into the pool */
+void *net_zc_buf_alloc(void);
+void net_zc_buf_free(void *buf);
+struct pbuf *net_zc_pbuf(void *buf, u16 len);
+struct pbuf *net_zc_pbuf_alloc(u16 len);
+
+/* Zero-copy receive, used by the socket layer */
+void net_zc_enable(int gfd);
+bool net_zc_enabled(int gfd);
+u32 net_zc_size(void);
+void *net_zc_mmap(addr_t virt_addr, uint32_t page_count);
+int net_zc_recv(int gfd, int lwip_fd, struct net_zc_recv *req);
+int net_zc_recycle(int gfd, struct net_zc_recycle *req);
+void net_zc_release(int gfd);
+
+/* Zero-copy send (CONFIG_NET_ZEROCOPY_TX) */
+struct net_zc_txmsg *net_zc_tx_prepare(int gfd, const struct iovec *iov, int iovcnt, size_t len, struct pbuf **p);
+void net_zc_tx_complete(int gfd, struct net_zc_txmsg *msg, bool sent);
+int net_zc_tx_done(int gfd, struct net_zc_txdone *req);
+void net_zc_tx_release(int gfd);
+
+#endif /* NET_ZEROCOPY_H */
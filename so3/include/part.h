@@ -70,7 +70,8 @@ typedef struct block_dev_desc {
 #define IF_TYPE_SATA		8
 #define IF_TYPE_HOST		9
 #define IF_TYPE_RAMDEV		10
-#define IF_TYPE_MAX		11	/* Max number of IF_TYPE_* supported */
+#define IF_TYPE_VIRTIO		11
+#define IF_TYPE_MAX		12	/* Max number of IF_TYPE_* supported */
 
 /* Part types */
 #define PART_TYPE_UNKNOWN	0x00
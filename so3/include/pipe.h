@@ -22,6 +22,7 @@
 #include <memory.h>
 #include <mutex.h>
 #include <completion.h>
+#include <vfs.h>
 
 #define PIPE_READER	0
 #define PIPE_WRITER	0
@@ -53,6 +54,13 @@ struct pipe_desc {
 };
 typedef struct pipe_desc pipe_desc_t;
 
+extern struct file_operations pipe_fops;
+
 int do_pipe(int pipefd[2]);
 
+int pipe_splice_read(int gfd, struct file_operations *out_fops, int out_gfd, size_t len);
+int pipe_splice_write(int gfd, struct file_operations *in_fops, int in_gfd, size_t len);
+
+int do_splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len, unsigned int flags);
+
 #endif /* PIPE_H */
@@ -29,6 +29,20 @@ void lprintk_buffer(void *buffer, uint32_t n);
 
 void printk(const char *fmt, ...);
 
+#ifdef CONFIG_PRINTK_RING
+
+void log_store(const char *text, int len);
+
+void console_flush(void);
+void console_flush_emergency(void);
+
+#else
+
+static inline void console_flush(void) { }
+static inline void console_flush_emergency(void) { }
+
+#endif /* CONFIG_PRINTK_RING */
+
 #ifndef __ASSEMBLY__
 
 struct va_format {
@@ -30,6 +30,7 @@
 #include <signal.h>
 #include <ptrace.h>
 #include <mutex.h>
+#include <spinlock.h>
 
 #define PROC_MAX 64
 #define PROC_THREAD_MAX 32
@@ -45,11 +46,21 @@ typedef unsigned int thread_t;
 
 #define PROC_NAME_LEN 80
 
-/* A page might be linked to several processes, hence this type */
+/*
+ * Range of user pages mapped on physically contiguous frames. The frames of
+ * a process are accounted per extent rather than per page; a frame might
+ * still be referenced by several processes (shared memory) through its
+ * page refcount.
+ */
 typedef struct {
 	struct list_head list;
-	page_t *page;
-} page_list_t;
+
+	/* First virtual page and its frame */
+	addr_t vaddr;
+	addr_t paddr;
+
+	unsigned long nr_pages;
+} extent_t;
 
 typedef struct {
 	bool tracee;
@@ -78,12 +89,27 @@ struct pcb {
 	/* Number of pages required by this process (including binary image) */
 	size_t page_count;
 
-	/* List of frames (physical pages) belonging to this process */
-	struct list_head page_list;
+	/* Extents of frames (physical pages) belonging to this process, sorted by address */
+	struct list_head extents;
+
+	/* Last extent which has been extended, most pages are added next to it */
+	extent_t *extent_hint;
 
 	/* Process 1st-level page table */
 	void *pgtable;
 
+	/* Address space identifier tagging the TLB entries of the process (with its generation) */
+	u64 asid;
+
+	/* Memory areas created by mmap(), sorted by address */
+	struct list_head vmas;
+
+	/* Last area found by vma_find() */
+	struct vma *vma_cache;
+
+	/* Serializes the population of pages and the changes of memory areas */
+	spinlock_t mm_lock;
+
 	uint32_t exit_status;
 
 	/* Reference to the parent process */
@@ -130,7 +156,8 @@ extern struct list_head proc_list;
 int get_user_stack_slot(pcb_t *pcb);
 void free_user_stack_slot(pcb_t *pcb, int slotID);
 
-void add_page_to_proc(pcb_t *pcb, page_t *page);
+void add_page_to_proc(pcb_t *pcb, addr_t vaddr, page_t *page);
+void remove_page_from_proc(pcb_t *pcb, addr_t vaddr);
 
 void create_root_process(void);
 
@@ -152,4 +179,6 @@ extern int __write(int fd, char *buffer, int count);
 
 int do_sbrk(int increment);
 
+int proc_demand_page(addr_t vaddr);
+
 #endif /* PROCESS_H */
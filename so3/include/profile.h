@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <types.h>
+
+/*
+ * Samples of the PMU-based profiler, exported through /dev/profile.
+ * The layout is shared with the prof user application.
+ */
+
+#define PROFILE_SAMPLE_USER	(1 << 0)	/* The CPU was running in user mode */
+
+struct profile_sample {
+	uint64_t pc;
+	uint64_t lr;
+	uint32_t tid;
+	uint32_t pid;		/* 0 for kernel threads */
+	uint16_t cpu;
+	uint16_t flags;
+	uint32_t reserved;
+};
+
+/* Start sampling every <args> events (cycles by default) on the calling CPU */
+#define PROFILE_IOCTL_START	0
+
+#define PROFILE_IOCTL_STOP	1
+
+/* Discard the samples */
+#define PROFILE_IOCTL_RESET	2
+
+/* Count the PMU event <args> instead of cycles; -1 goes back to cycles */
+#define PROFILE_IOCTL_EVENT	3
+
+/* Return the number of samples lost because the buffer was full */
+#define PROFILE_IOCTL_LOST	4
+
+#define PROFILE_EVENT_CYCLES	(-1)
+
+#endif /* PROFILE_H */
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef SHM_H
+#define SHM_H
+
+#include <types.h>
+#include <list.h>
+#include <dirent.h>
+
+#define SHM_NAME_MAX	32
+
+/*
+ * Memory object shared between processes. It backs the MAP_SHARED anonymous
+ * mappings as well as the named objects created with shm_open().
+ * The frames are allocated on first access; each frame keeps one reference
+ * held by the object, in addition to the references of the processes
+ * mapping it.
+ */
+struct shm_object {
+
+	/* Named objects are linked in a global list */
+	struct list_head list;
+	char name[SHM_NAME_MAX];
+
+	/* Size in pages */
+	unsigned long nr_pages;
+
+	/* Physical address of each page, 0 if not populated yet */
+	addr_t *frames;
+
+	/* References held by the mappings, the open fds and the name */
+	int refcount;
+};
+typedef struct shm_object shm_object_t;
+
+shm_object_t *shm_create(unsigned long nr_pages);
+void shm_get(shm_object_t *shm);
+void shm_put(shm_object_t *shm);
+
+addr_t shm_get_frame(shm_object_t *shm, unsigned long pgoff);
+
+shm_object_t *shm_from_fd(int fd);
+
+int do_shm_open(const char *name, int oflag, int mode);
+int do_shm_unlink(const char *name);
+int do_ftruncate(int fd, off_t length);
+
+#endif /* SHM_H */
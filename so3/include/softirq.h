@@ -21,6 +21,7 @@
 
 /* Low-latency softirqs come first in the following list.
  * SCHEDULE_SOFTIRQ must remain the last in the list.
+ * The pending softirqs of a CPU are kept in one word (at most 64 entries).
  */
 enum {
 	TIMER_SOFTIRQ = 0,
@@ -41,6 +42,7 @@ void softirq_init(void);
 void do_softirq(void);
 
 void cpu_raise_softirq(unsigned int cpu, unsigned int nr);
-void raise_softirq(unsigned int nr);
+
+void dump_softirq(void);
 
 #endif /* SOFTIRQ_H */
@@ -26,6 +26,7 @@
 #define SYSINFO_TEST_MALLOC	2
 #define SYSINFO_PRINTK		3
 #define SYSINFO_DUMP_PROC	4
+#define SYSINFO_DUMP_SOFTIRQ	5
 
 /*
  * Syscall number definition
@@ -66,6 +67,8 @@
 #define SYSCALL_GETTIMEOFDAY	38
 #define SYSCALL_SETTIMEOFDAY	39
 #define SYSCALL_CLOCK_GETTIME	40
+#define SYSCALL_MUNMAP		41
+#define SYSCALL_MPROTECT	42
 
 #define SYSCALL_THREAD_YIELD	43
 
@@ -75,6 +78,13 @@
 #define SYSCALL_SIGRETURN	48
 
 #define SYSCALL_LSEEK		50
+#define SYSCALL_READV		51
+#define SYSCALL_WRITEV		52
+#define SYSCALL_SENDFILE	53
+#define SYSCALL_SPLICE		54
+#define SYSCALL_SHM_OPEN	55
+#define SYSCALL_SHM_UNLINK	56
+#define SYSCALL_FTRUNCATE	57
 
 #define SYSCALL_MUTEX_LOCK	60
 #define SYSCALL_MUTEX_UNLOCK	61
@@ -85,17 +95,21 @@
 
 #define SYSCALL_SETSOCKOPT	110
 #define SYSCALL_RECVFROM	111
+#define SYSCALL_SENDMMSG	112
+#define SYSCALL_RECVMMSG	113
+
+#define NR_SYSCALLS		114
 
 #ifndef __ASSEMBLY__
 
 #include <errno.h>
 #include <types.h>
 
-typedef struct {
-	unsigned long args[6];
-} syscall_args_t;
+#include <asm/processor.h>
+
+typedef long (*syscall_fn_t)(cpu_regs_t *regs);
 
-long syscall_handle(syscall_args_t *);
+long syscall_handle(cpu_regs_t *regs);
 
 void set_errno(uint32_t val);
 #endif /* __ASSEMBLY__ */
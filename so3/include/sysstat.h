@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef SYSSTAT_H
+#define SYSSTAT_H
+
+#include <types.h>
+
+/*
+ * Per-syscall statistics exported through /dev/sysstat.
+ * A read returns one record per syscall which has been issued at least once.
+ * The layout is shared with the sstat user application.
+ */
+
+#define SYSSTAT_HIST_BUCKETS	16
+
+/* Reset all counters */
+#define SYSSTAT_IOCTL_RESET	0
+
+struct sysstat_entry {
+	uint32_t nr;
+
+	/* Number of calls */
+	uint32_t count;
+
+	/* Time spent in the calls which returned (ns) */
+	uint64_t total_ns;
+	uint64_t max_ns;
+
+	/*
+	 * hist[0] counts the calls which lasted less than 1 us, hist[i] the calls
+	 * between 2^(i-1) and 2^i us. The last bucket gathers the longer calls.
+	 */
+	uint32_t hist[SYSSTAT_HIST_BUCKETS];
+};
+
+u64 sysstat_enter(unsigned int nr);
+void sysstat_exit(unsigned int nr, u64 start);
+
+#endif /* SYSSTAT_H */
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <types.h>
+#include <compiler.h>
+
+/*
+ * Static tracepoints recorded in per-CPU binary buffers, exported through /dev/trace.
+ * The event numbers and the record layout are shared with the tracedump user
+ * application and the trace2json host script.
+ */
+
+enum trace_event {
+	TRACE_SCHED_SWITCH,	/* a0: previous tid, a1: next tid */
+	TRACE_IRQ_ENTRY,	/* a0: irq */
+	TRACE_IRQ_EXIT,		/* a0: irq */
+	TRACE_SOFTIRQ_ENTRY,	/* a0: softirq */
+	TRACE_SOFTIRQ_EXIT,	/* a0: softirq */
+	TRACE_SYSCALL_ENTRY,	/* a0: syscall number */
+	TRACE_SYSCALL_EXIT,	/* a0: syscall number, a1: result */
+	TRACE_TIMER_EXPIRE,	/* a1: timer function */
+	TRACE_PAGE_ALLOC,	/* a0: number of pages, a1: physical address */
+	TRACE_PAGE_FREE,	/* a0: number of pages, a1: physical address */
+	TRACE_EVTCHN_SEND,	/* a0: event channel, a1: remote domain (AVZ only) */
+	NR_TRACE_EVENTS
+};
+
+struct trace_record {
+	/* Value of the system counter (CNTVCT) */
+	uint64_t ts;
+	uint16_t event;
+	uint16_t cpu;
+	uint32_t a0;
+	uint64_t a1;
+};
+
+/* Select the events to record (args is a mask of (1 << event)); 0 stops tracing */
+#define TRACE_IOCTL_ENABLE	0
+
+/* Discard the recorded events */
+#define TRACE_IOCTL_RESET	1
+
+/* Return the frequency of the timestamp counter (Hz) */
+#define TRACE_IOCTL_FREQ	2
+
+#ifdef CONFIG_TRACE
+
+extern unsigned long trace_mask;
+
+void __trace(unsigned int event, u32 a0, u64 a1);
+
+/*
+ * A disabled tracepoint only costs the test of trace_mask.
+ */
+static inline void trace(unsigned int event, u32 a0, u64 a1)
+{
+	if (unlikely(trace_mask & (1UL << event)))
+		__trace(event, a0, a1);
+}
+
+#else
+
+static inline void trace(unsigned int event, u32 a0, u64 a1) { }
+
+#endif /* CONFIG_TRACE */
+
+#endif /* TRACE_H */
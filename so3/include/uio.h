@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef UIO_H
+#define UIO_H
+
+#include <types.h>
+
+/* Max. number of segments of a readv()/writev() */
+#define IOV_MAX		1024
+
+/* Same layout as the libc; lwIP uses this definition as well */
+struct iovec {
+	void *iov_base;
+	size_t iov_len;
+};
+
+#define iovec iovec
+
+#endif /* UIO_H */
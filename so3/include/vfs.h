@@ -80,6 +80,7 @@
 #define VFS_TYPE_DEV_CHAR	6       /* Generic character device */
 #define VFS_TYPE_DEV_SOCK	7   	/* Sockets */
 #define VFS_TYPE_DEV_NIC	8   	/* Network Interface Cards (NIC) */
+#define VFS_TYPE_SHM		9	/* Shared memory object (shm_open) */
 
 /* Device type (borrowed from Linux) */
 #define DT_UNKNOWN	0
@@ -96,6 +97,7 @@
 #include <types.h>
 #include <stat.h>
 #include <dirent.h>
+#include <uio.h>
 
 #include <device/device.h>
 
@@ -104,6 +106,11 @@ struct file_operations {
 	int (*close)(int fd);
 	int (*read)(int fd, void *buffer, int count);
 	int (*write)(int fd, const void *buffer, int count);
+
+	/* Scatter-gather I/O; read/write are used segment per segment if not provided */
+	int (*readv)(int fd, const struct iovec *iov, int iovcnt);
+	int (*writev)(int fd, const struct iovec *iov, int iovcnt);
+
 	off_t (*lseek)(int fd, off_t off, int whence);
 	int (*ioctl)(int fd, unsigned long cmd, unsigned long args);
 	struct dirent *(*readdir)(int fd);
@@ -155,10 +162,12 @@ void do_close(int fd);
 int do_dup(int oldfd);
 int do_dup2(int oldfd, int newfd);
 int do_stat(const char *path , struct stat *st);
-void *do_mmap(addr_t start, size_t length, int prot, int fd, off_t offset);
 int do_ioctl(int fd, unsigned long cmd, unsigned long args);
 int do_fcntl(int fd, unsigned long cmd, unsigned long args);
 off_t do_lseek(int fd, off_t off, int whence);
+int do_readv(int fd, const struct iovec *iov, int iovcnt);
+int do_writev(int fd, const struct iovec *iov, int iovcnt);
+int do_sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
 
 /* VFS common interface */
 
@@ -171,7 +180,9 @@ int vfs_open(const char *filename, struct file_operations *fops, uint32_t type);
 int vfs_close(int gfd);
 void vfs_set_priv(int gfd, void *data);
 void *vfs_get_priv(int gfd);
+int vfs_get_type(int gfd);
 int vfs_clone_fd(int *gfd_src, int *gfd_dst);
+void *vfs_mmap(int fd, addr_t virt_addr, uint32_t page_count);
 
 uint32_t vfs_get_access_mode(int fd);
 uint32_t vfs_get_open_mode(int fd);
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#ifndef VMA_H
+#define VMA_H
+
+#include <types.h>
+#include <list.h>
+#include <dirent.h>
+
+/* mmap() protection and flags, same values as the libc */
+#define PROT_NONE	0x0
+#define PROT_READ	0x1
+#define PROT_WRITE	0x2
+#define PROT_EXEC	0x4
+
+#define MAP_SHARED	0x01
+#define MAP_PRIVATE	0x02
+#define MAP_FIXED	0x10
+#define MAP_ANONYMOUS	0x20
+
+#define MAP_FAILED	((void *) -1)
+
+/* Attributes of a memory area */
+#define VMA_READ	(1 << 0)
+#define VMA_WRITE	(1 << 1)
+#define VMA_EXEC	(1 << 2)
+#define VMA_SHARED	(1 << 3)	/* Frames are shared with the other mappings (and fork'd children) */
+#define VMA_IO		(1 << 4)	/* Mapped by a driver (e.g. framebuffer), no frame accounting */
+#define VMA_DONTCOPY	(1 << 5)	/* The pages are not inherited along fork() */
+#define VMA_NOWRITE	(1 << 6)	/* Object opened read-only, PROT_WRITE cannot be granted */
+
+#define VMA_PROT_MASK	(VMA_READ | VMA_WRITE | VMA_EXEC)
+
+struct pcb;
+struct shm_object;
+
+/*
+ * Memory area of a process created by mmap(). The areas of a process are
+ * kept in a list sorted by address; [start, end[ are page aligned.
+ */
+struct vma {
+	struct list_head list;
+
+	addr_t start;
+	addr_t end;
+
+	unsigned int flags;
+
+	/* Backing object of a shared mapping (NULL for a private or a device mapping) */
+	struct shm_object *shm;
+
+	/* Index of the first page of the area within the backing object */
+	unsigned long pgoff;
+};
+typedef struct vma vma_t;
+
+vma_t *vma_find(struct pcb *pcb, addr_t addr);
+
+int vma_fault(struct pcb *pcb, addr_t vaddr);
+
+void vma_clone(struct pcb *from, struct pcb *to);
+void vma_release_all(struct pcb *pcb);
+
+void *do_mmap(addr_t start, size_t length, int prot, int flags, int fd, off_t offset);
+int do_munmap(addr_t start, size_t length);
+int do_mprotect(addr_t start, size_t length, int prot);
+
+#endif /* VMA_H */
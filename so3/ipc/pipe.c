@@ -90,18 +90,17 @@ static int pipe_read_byte(int gfd, char *value, bool suspend)
 	return 1; /* One byte read successfully */
 }
 
-static int pipe_read(int gfd, void *buffer, int count)
+/*
+ * Read from the pipe into the segments of @iov. The thread is suspended only
+ * if there is no data at all.
+ */
+static int pipe_readv(int gfd, const struct iovec *iov, int iovcnt)
 {
-	int pos, ret;
+	int i, pos, ret;
+	size_t len;
 	bool first;
 	pipe_desc_t *pd = (pipe_desc_t *) vfs_get_priv(gfd);
 
-	/* Sanity checks*/
-	if (!buffer || (count <= 0)) {
-		set_errno(EPIPE);
-		return -1;
-	}
-
  	mutex_lock(&pd->lock);
 
  	if ((otherend(gfd) == -1) && pipe_empty(pd)) {
@@ -114,24 +113,28 @@ static int pipe_read(int gfd, void *buffer, int count)
 
 	first = true;
 	pos = 0;
-	do {
-		ret = pipe_read_byte(gfd, (char *) buffer + pos, first);
+	for (i = 0; i < iovcnt; i++) {
+		for (len = 0; len < iov[i].iov_len; len++) {
+			ret = pipe_read_byte(gfd, (char *) iov[i].iov_base + len, first);
 
-		if (ret < 0) {
-			set_errno(EPIPE);
-			mutex_unlock(&pd->lock);
+			if (ret < 0) {
+				set_errno(EPIPE);
+				mutex_unlock(&pd->lock);
 
-			/* According to Posix, read() will return 0 it the otherend is closed */
-			return 0;
-		}
+				/* According to Posix, read() will return 0 it the otherend is closed */
+				return 0;
+			}
 
-		first = false;
+			first = false;
 
-		if (ret)
-			pos++;
+			if (!ret)
+				goto out;
 
-	} while (ret && (pos < count));
+			pos++;
+		}
+	}
 
+out:
 	complete(&pd->wait_for_reader);
 
 	mutex_unlock(&pd->lock);
@@ -139,6 +142,19 @@ static int pipe_read(int gfd, void *buffer, int count)
 	return pos; /* Effective number of read bytes */
 }
 
+static int pipe_read(int gfd, void *buffer, int count)
+{
+	struct iovec iov = { .iov_base = buffer, .iov_len = count };
+
+	/* Sanity checks*/
+	if (!buffer || (count <= 0)) {
+		set_errno(EPIPE);
+		return -1;
+	}
+
+	return pipe_readv(gfd, &iov, 1);
+}
+
 
 /*
  * Write some bytes into the pipe associated to @gfd
@@ -172,31 +188,159 @@ static int pipe_write_byte(pipe_desc_t *pd, char value)
 	return 1; /* 1 bytes successfully written */
 }
 
-static int pipe_write(int gfd, const void *buffer, int count)
+/*
+ * Write the segments of @iov into the pipe.
+ */
+static int pipe_writev(int gfd, const struct iovec *iov, int iovcnt)
 {
-	int pos, ret;
+	int i, pos, ret;
+	size_t len;
 	pipe_desc_t *pd = (pipe_desc_t *) vfs_get_priv(gfd);
 
+	mutex_lock(&pd->lock);
+
+	if ((otherend(gfd) == -1) && pipe_full(pd)) {
+		/* No readers left, error no space left */
+		set_errno(EPIPE);
+		mutex_unlock(&pd->lock);
+
+		return -1;
+	}
+
+	pos = 0;
+	for (i = 0; i < iovcnt; i++) {
+		for (len = 0; len < iov[i].iov_len; len++, pos++) {
+			ret = pipe_write_byte(pd, *((char *) iov[i].iov_base + len));
+			if (ret < 0) {
+				set_errno(EPIPE);
+				mutex_unlock(&pd->lock);
+
+				return -1;
+			}
+		}
+	}
+
+	/* Waking up sleeping threads */
+	complete(&pd->wait_for_writer);
+
+	mutex_unlock(&pd->lock);
+
+	return pos; /* Effective number of written bytes */
+}
+
+static int pipe_write(int gfd, const void *buffer, int count)
+{
+	struct iovec iov = { .iov_base = (void *) buffer, .iov_len = count };
+
 	/* Do Sanity checks */
 	if (!buffer || (count <= 0)) {
 		set_errno(EPIPE);
 		return -1;
 	}
 
+	return pipe_writev(gfd, &iov, 1);
+}
+
+/*
+ * Number of bytes which can be read from the pipe buffer in one contiguous chunk.
+ */
+static int pipe_data_chunk(pipe_desc_t *pd)
+{
+	if (pd->pos_write >= pd->pos_read)
+		return pd->pos_write - pd->pos_read;
+
+	return PIPE_SIZE - pd->pos_read;
+}
+
+/*
+ * Number of bytes which can be written into the pipe buffer in one contiguous chunk.
+ * One location always remains free to distinguish a full pipe from an empty one.
+ */
+static int pipe_space_chunk(pipe_desc_t *pd)
+{
+	if (pd->pos_write < pd->pos_read)
+		return pd->pos_read - pd->pos_write - 1;
+
+	return PIPE_SIZE - pd->pos_write - (pd->pos_read == 0);
+}
+
+/*
+ * splice() from the pipe (@gfd is the read end) to another file:
+ * the data is given to the write callback of @out_gfd directly from the pipe buffer.
+ */
+int pipe_splice_read(int gfd, struct file_operations *out_fops, int out_gfd, size_t len)
+{
+	pipe_desc_t *pd = (pipe_desc_t *) vfs_get_priv(gfd);
+	int n, ret = 0;
+	size_t total = 0;
+
 	mutex_lock(&pd->lock);
 
-	if ((otherend(gfd) == -1) && pipe_full(pd)) {
-		/* No readers left, error no space left */
+	/* As for a read, wait for some data unless there is no writer anymore */
+	while (pipe_empty(pd)) {
+		if (otherend(gfd) == -1) {
+			mutex_unlock(&pd->lock);
+			return 0;
+		}
+
+		mutex_unlock(&pd->lock);
+
+		wait_for_completion(&pd->wait_for_writer);
+
+		mutex_lock(&pd->lock);
+	}
+
+	while ((total < len) && !pipe_empty(pd)) {
+		n = pipe_data_chunk(pd);
+		if (n > len - total)
+			n = len - total;
+
+		ret = out_fops->write(out_gfd, (char *) pd->pipe_buf + pd->pos_read, n);
+		if (ret <= 0)
+			break;
+
+		pd->pos_read = (pd->pos_read + ret) % PIPE_SIZE;
+		total += ret;
+
+		if (ret < n)
+			break;
+	}
+
+	complete(&pd->wait_for_reader);
+
+	mutex_unlock(&pd->lock);
+
+	return ((!total && (ret < 0)) ? -1 : total);
+}
+
+/*
+ * splice() from another file to the pipe (@gfd is the write end):
+ * the read callback of @in_gfd fills the pipe buffer directly.
+ */
+int pipe_splice_write(int gfd, struct file_operations *in_fops, int in_gfd, size_t len)
+{
+	pipe_desc_t *pd = (pipe_desc_t *) vfs_get_priv(gfd);
+	int n, ret;
+
+	mutex_lock(&pd->lock);
+
+	if (otherend(gfd) == -1) {
+		/* No readers left */
 		set_errno(EPIPE);
 		mutex_unlock(&pd->lock);
 
 		return -1;
 	}
 
-	for (pos = 0; pos < count; pos++) {
+	while (pipe_full(pd)) {
+		mutex_unlock(&pd->lock);
+
+		wait_for_completion(&pd->wait_for_reader);
+
+		mutex_lock(&pd->lock);
 
-		ret = pipe_write_byte(pd, *((char *) buffer + pos));
-		if (ret < 0) {
+		if (pipe_full(pd)) {
+			/* No readers left, error */
 			set_errno(EPIPE);
 			mutex_unlock(&pd->lock);
 
@@ -204,12 +348,21 @@ static int pipe_write(int gfd, const void *buffer, int count)
 		}
 	}
 
-	/* Waking up sleeping threads */
-	complete(&pd->wait_for_writer);
+	n = pipe_space_chunk(pd);
+	if (n > len)
+		n = len;
+
+	ret = in_fops->read(in_gfd, (char *) pd->pipe_buf + pd->pos_write, n);
+	if (ret > 0) {
+		pd->pos_write = (pd->pos_write + ret) % PIPE_SIZE;
+
+		/* Waking up sleeping threads */
+		complete(&pd->wait_for_writer);
+	}
 
 	mutex_unlock(&pd->lock);
 
-	return pos; /* Effective number of written bytes */
+	return ret;
 }
 
 /* 
@@ -257,6 +410,8 @@ static int pipe_close(int gfd)
 struct file_operations pipe_fops = {
 		.read = pipe_read,
 		.write = pipe_write,
+		.readv = pipe_readv,
+		.writev = pipe_writev,
 		.close = pipe_close
 };
 
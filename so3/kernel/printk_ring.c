@@ -0,0 +1,402 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Buffered printk.
+ *
+ * printk() stores its messages as records in a ring owned by the current CPU
+ * and returns without waiting for the UART. A ring has a single producer (its
+ * CPU, with IRQs off while a record is written), so the printk path takes no
+ * lock. Each record has a global sequence number and a timestamp; the console
+ * merges the rings in sequence order and feeds the UART TX FIFO, resuming from
+ * the TX interrupt when the FIFO is full.
+ *
+ * If the UART driver has no TX interrupt, during early boot and after a panic,
+ * the records are output synchronously as before.
+ *
+ * The records are also available in /dev/kmsg, one line per record:
+ * <seq>,<timestamp in us>,<cpu>;<text>
+ */
+
+#include <common.h>
+#include <compiler.h>
+#include <errno.h>
+#include <heap.h>
+#include <smp.h>
+#include <vfs.h>
+#include <timer.h>
+#include <initcall.h>
+
+#include <device/device.h>
+#include <device/serial.h>
+
+#include <asm/processor.h>
+
+#define LOG_RING_SIZE	(1 << CONFIG_PRINTK_RING_SHIFT)
+#define LOG_RING_MASK	(LOG_RING_SIZE - 1)
+
+/* Longer messages are split into several records */
+#define LOG_TEXT_MAX	108
+
+struct log_record {
+	/* 0 while the record is being written */
+	u64 seq;
+	u64 ts;
+	u16 len;
+	u16 cpu;
+	char text[LOG_TEXT_MAX];
+};
+
+struct log_ring {
+	struct log_record rec[LOG_RING_SIZE];
+
+	/* Number of records stored so far, only written by the owner CPU */
+	unsigned long head;
+
+	/* Number of records output on the console, only written by the console owner */
+	unsigned long tail;
+
+	/* Records lost because the console did not keep up */
+	unsigned long dropped;
+} __attribute__((aligned(64)));
+
+static struct log_ring log_rings[CONFIG_NR_CPUS];
+
+static u64 log_seq = 1;
+
+/* The console belongs to the CPU which set console_busy */
+static int console_busy;
+static struct log_ring *console_ring;
+static struct log_record *console_rec;
+static unsigned int console_off;
+
+/* Set after a panic; the console does not rely on interrupts anymore */
+static bool console_emergency;
+
+static void log_put(struct log_ring *ring, const char *text, int len)
+{
+	unsigned long head = ring->head;
+	struct log_record *rec = &ring->rec[head & LOG_RING_MASK];
+
+	/* Let the /dev/kmsg readers know that the record is being overwritten */
+	WRITE_ONCE(rec->seq, 0);
+	wmb();
+
+	rec->ts = NOW();
+	rec->cpu = smp_processor_id();
+	rec->len = len;
+	memcpy(rec->text, text, len);
+
+	wmb();
+	WRITE_ONCE(rec->seq, __atomic_fetch_add(&log_seq, 1, __ATOMIC_RELAXED));
+
+	__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+static inline unsigned long log_room(struct log_ring *ring)
+{
+	return LOG_RING_SIZE - (ring->head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE));
+}
+
+/*
+ * Store a message in the ring of the current CPU; console_flush() gets it output.
+ */
+void log_store(const char *text, int len)
+{
+	struct log_ring *ring;
+	char msg[48];
+	unsigned long flags;
+	int n;
+
+	flags = local_irq_save();
+
+	ring = &log_rings[smp_processor_id()];
+
+	if (ring->dropped && (log_room(ring) > 1)) {
+		n = snprintf(msg, sizeof(msg), "** %lu log records dropped **\n", ring->dropped);
+		log_put(ring, msg, n);
+		ring->dropped = 0;
+	}
+
+	while (len > 0) {
+		if (!log_room(ring)) {
+			ring->dropped++;
+			break;
+		}
+
+		n = ((len > LOG_TEXT_MAX) ? LOG_TEXT_MAX : len);
+		log_put(ring, text, n);
+
+		text += n;
+		len -= n;
+	}
+
+	local_irq_restore(flags);
+}
+
+static bool console_pending(void)
+{
+	int cpu;
+
+	for (cpu = 0; cpu < CONFIG_NR_CPUS; cpu++)
+		if (log_rings[cpu].tail != __atomic_load_n(&log_rings[cpu].head, __ATOMIC_ACQUIRE))
+			return true;
+
+	return false;
+}
+
+/*
+ * Oldest record which has not been output yet, across all rings.
+ */
+static struct log_record *console_next(struct log_ring **ringp)
+{
+	struct log_record *rec, *oldest = NULL;
+	struct log_ring *ring;
+	int cpu;
+
+	for (cpu = 0; cpu < CONFIG_NR_CPUS; cpu++) {
+		ring = &log_rings[cpu];
+
+		if (ring->tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))
+			continue;
+
+		rec = &ring->rec[ring->tail & LOG_RING_MASK];
+		if (!oldest || (rec->seq < oldest->seq)) {
+			oldest = rec;
+			*ringp = ring;
+		}
+	}
+
+	return oldest;
+}
+
+static bool console_sync(void)
+{
+	return console_emergency || !serial_ops.tx_put_byte || (boot_stage < BOOT_STAGE_IRQ_ENABLE);
+}
+
+/*
+ * Output the pending records. In asynchronous mode, the TX FIFO is filled as much
+ * as possible and the TX interrupt brings us back here when it has room again.
+ * A CPU which does not get the console leaves its records to the current owner.
+ */
+void console_flush(void)
+{
+	bool full;
+
+again:
+	if (__atomic_exchange_n(&console_busy, 1, __ATOMIC_ACQUIRE))
+		return;
+
+	full = false;
+
+	while (true) {
+		if (!console_rec) {
+			console_rec = console_next(&console_ring);
+			if (!console_rec)
+				break;
+
+			console_off = 0;
+		}
+
+		if (console_sync()) {
+			serial_write(console_rec->text + console_off, console_rec->len - console_off);
+			console_off = console_rec->len;
+		} else {
+			while ((console_off < console_rec->len) && serial_ops.tx_put_byte(console_rec->text[console_off]))
+				console_off++;
+
+			if (console_off < console_rec->len) {
+				full = true;
+				break;
+			}
+		}
+
+		__atomic_store_n(&console_ring->tail, console_ring->tail + 1, __ATOMIC_RELEASE);
+		console_rec = NULL;
+	}
+
+	/* The TX interrupt is only needed while some output is waiting for the FIFO */
+	if (serial_ops.tx_irq)
+		serial_ops.tx_irq(full);
+
+	__atomic_store_n(&console_busy, 0, __ATOMIC_RELEASE);
+	mb();
+
+	/* Records stored while we were owning the console must not be left behind */
+	if (!full && console_pending())
+		goto again;
+}
+
+/*
+ * Output everything synchronously, whatever the state of the console.
+ * Used on panic, when interrupts cannot be relied on anymore.
+ */
+void console_flush_emergency(void)
+{
+	console_emergency = true;
+
+	/* The owner may have been stopped while outputting; take the console over. */
+	__atomic_store_n(&console_busy, 0, __ATOMIC_RELEASE);
+
+	console_flush();
+}
+
+/*
+ * /dev/kmsg
+ */
+
+struct kmsg_reader {
+	/* Next record to read in each ring */
+	unsigned long pos[CONFIG_NR_CPUS];
+};
+
+/*
+ * Copy a record which may be overwritten concurrently by its CPU.
+ * Return false if this happened.
+ */
+static bool log_read(struct log_ring *ring, unsigned long pos, struct log_record *rec)
+{
+	struct log_record *src = &ring->rec[pos & LOG_RING_MASK];
+	u64 seq;
+
+	seq = READ_ONCE(src->seq);
+	rmb();
+
+	memcpy(rec, src, sizeof(*rec));
+
+	rmb();
+
+	return (seq != 0) && (READ_ONCE(src->seq) == seq) && (rec->seq == seq);
+}
+
+static int kmsg_open(int fd, const char *path)
+{
+	struct kmsg_reader *reader;
+
+	reader = malloc(sizeof(struct kmsg_reader));
+	if (!reader)
+		return -1;
+
+	/* Positions are moved to the oldest available record on the first read */
+	memset(reader, 0, sizeof(struct kmsg_reader));
+
+	vfs_set_priv(fd, reader);
+
+	return 0;
+}
+
+static int kmsg_close(int fd)
+{
+	free(vfs_get_priv(fd));
+
+	return 0;
+}
+
+/*
+ * Return as many records as <count> bytes can hold, in sequence order.
+ * 0 is returned once all records have been read, -1 (EINVAL) if the next
+ * record does not fit in <count> bytes.
+ */
+static int kmsg_read(int fd, void *buffer, int count)
+{
+	struct kmsg_reader *reader = vfs_get_priv(fd);
+	struct log_record rec, oldest = { 0 };
+	struct log_ring *ring;
+	char *out = buffer;
+	char prefix[48];
+	unsigned long head;
+	int cpu, oldest_cpu, n, len = 0;
+
+	while (true) {
+		oldest_cpu = -1;
+
+		for (cpu = 0; cpu < CONFIG_NR_CPUS; cpu++) {
+			ring = &log_rings[cpu];
+
+			while (true) {
+				head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+				/* Skip what has been overwritten since the last read */
+				if (head - reader->pos[cpu] > LOG_RING_SIZE)
+					reader->pos[cpu] = head - LOG_RING_SIZE;
+
+				if (reader->pos[cpu] == head)
+					break;
+
+				if (log_read(ring, reader->pos[cpu], &rec)) {
+					if ((oldest_cpu < 0) || (rec.seq < oldest.seq)) {
+						oldest = rec;
+						oldest_cpu = cpu;
+					}
+					break;
+				}
+
+				reader->pos[cpu]++;
+			}
+		}
+
+		if (oldest_cpu < 0)
+			break;
+
+		n = snprintf(prefix, sizeof(prefix), "%llu,%llu,%u;", (unsigned long long) oldest.seq,
+			     (unsigned long long) oldest.ts / 1000, oldest.cpu);
+
+		/* Room for the prefix, the text and a possible newline */
+		if (count - len < n + oldest.len + 1) {
+			/* As with Linux, a buffer which cannot hold a single record is an error */
+			if (!len) {
+				set_errno(EINVAL);
+				return -1;
+			}
+			break;
+		}
+
+		memcpy(out + len, prefix, n);
+		len += n;
+
+		memcpy(out + len, oldest.text, oldest.len);
+		len += oldest.len;
+
+		if (oldest.text[oldest.len - 1] != '\n')
+			out[len++] = '\n';
+
+		reader->pos[oldest_cpu]++;
+	}
+
+	return len;
+}
+
+struct file_operations kmsg_fops = {
+	.open = kmsg_open,
+	.close = kmsg_close,
+	.read = kmsg_read,
+};
+
+struct devclass kmsg_dev = {
+	.class = "kmsg",
+	.type = VFS_TYPE_DEV_CHAR,
+	.fops = &kmsg_fops,
+};
+
+static void kmsg_init(void)
+{
+	devclass_register(NULL, &kmsg_dev);
+}
+
+REGISTER_POSTINIT(kmsg_init);
@@ -35,6 +35,7 @@
 #include <thread.h>
 #include <types.h>
 #include <vfs.h>
+#include <vma.h>
 #include <wait.h>
 
 #include <device/serial.h>
@@ -190,8 +191,12 @@ pcb_t *new_process(void) {
         for (i = 0; i < N_MUTEX; i++)
                 mutex_init(&pcb->lock[i]);
 
-        /* Init the list of pages */
-        INIT_LIST_HEAD(&pcb->page_list);
+        /* Init the extents of pages */
+        INIT_LIST_HEAD(&pcb->extents);
+
+        /* No memory area yet */
+        INIT_LIST_HEAD(&pcb->vmas);
+        spin_lock_init(&pcb->mm_lock);
 
         pcb->pid = pid_current++;
 
@@ -243,30 +248,121 @@ void reset_process_stack(pcb_t *pcb) {
 }
 
 void dump_proc_pages(pcb_t *pcb) {
-        page_list_t *cur;
+        extent_t *cur;
 
         printk("----- Dump of pages belonging to proc: %d -----\n\n", pcb->pid);
-        list_for_each_entry(cur, &pcb->page_list, list)
-            printk("   -- page: %p  pfn: %x   refcount: %d\n", cur->page,
-                   page_to_pfn(cur->page), cur->page->refcount);
+        list_for_each_entry(cur, &pcb->extents, list)
+            printk("   -- vaddr: %lx  pfn: %lx  pages: %ld\n", cur->vaddr,
+                   phys_to_pfn(cur->paddr), cur->nr_pages);
         printk("\n");
 }
 
-void add_page_to_proc(pcb_t *pcb, page_t *page) {
-        page_list_t *page_list_entry;
+/*
+ * Drop the reference of the process on a range of contiguous frames.
+ */
+static void put_frames(addr_t paddr, unsigned long nr_pages) {
+        page_t *page = phys_to_page(paddr);
+        unsigned long i;
+
+        for (i = 0; i < nr_pages; i++)
+                put_page(&page[i]);
+}
+
+static inline addr_t extent_end(extent_t *ext) {
+        return ext->vaddr + (ext->nr_pages << PAGE_SHIFT);
+}
+
+/*
+ * Try to extend an extent with the range [vaddr, vaddr + nr_pages[ mapped
+ * on the frames starting at paddr.
+ */
+static bool extent_extend(extent_t *ext, addr_t vaddr, addr_t paddr,
+                          unsigned long nr_pages) {
+
+        if ((vaddr == extent_end(ext)) &&
+            (paddr == ext->paddr + (ext->nr_pages << PAGE_SHIFT))) {
+                ext->nr_pages += nr_pages;
+                return true;
+        }
+
+        if ((vaddr + (nr_pages << PAGE_SHIFT) == ext->vaddr) &&
+            (paddr + (nr_pages << PAGE_SHIFT) == ext->paddr)) {
+                ext->vaddr = vaddr;
+                ext->paddr = paddr;
+                ext->nr_pages += nr_pages;
+                return true;
+        }
+
+        return false;
+}
+
+/*
+ * Account a range of frames mapped at @vaddr in the process. A new extent
+ * is only allocated if the range is not contiguous to an existing one.
+ */
+static void add_extent_to_proc(pcb_t *pcb, addr_t vaddr, addr_t paddr,
+                               unsigned long nr_pages) {
+        extent_t *ext, *prev, *next, *new;
+
+        /* Pages are mostly populated next to each other */
+        ext = pcb->extent_hint;
+        if (ext && extent_extend(ext, vaddr, paddr, nr_pages))
+                goto merge;
+
+        list_for_each_entry(ext, &pcb->extents, list) {
+                if (extent_extend(ext, vaddr, paddr, nr_pages))
+                        goto merge;
+
+                if (ext->vaddr > vaddr)
+                        break;
+        }
 
-        page_list_entry = malloc(sizeof(page_list_t));
-        if (page_list_entry == NULL) {
+        new = malloc(sizeof(extent_t));
+        if (new == NULL) {
                 printk("%s: failed to allocate memory!\n", __func__);
                 kernel_panic();
         }
 
-        page_list_entry->page = page;
+        new->vaddr = vaddr;
+        new->paddr = paddr;
+        new->nr_pages = nr_pages;
+
+        /* Insert before the first extent above (or at the end of the list) */
+        list_add_tail(&new->list, &ext->list);
+
+        pcb->extent_hint = new;
+
+        return;
+
+merge:
+        /* The extent may now join its neighbours */
+        if (ext->list.prev != &pcb->extents) {
+                prev = list_entry(ext->list.prev, extent_t, list);
+
+                if (extent_extend(prev, ext->vaddr, ext->paddr, ext->nr_pages)) {
+                        list_del(&ext->list);
+                        free(ext);
+                        ext = prev;
+                }
+        }
 
-        page->refcount++;
+        if (!list_is_last(&ext->list, &pcb->extents)) {
+                next = list_entry(ext->list.next, extent_t, list);
 
-        /* Insert our page at the end of the list */
-        list_add_tail(&page_list_entry->list, &pcb->page_list);
+                if (extent_extend(ext, next->vaddr, next->paddr, next->nr_pages)) {
+                        list_del(&next->list);
+                        free(next);
+                }
+        }
+
+        pcb->extent_hint = ext;
+}
+
+void add_page_to_proc(pcb_t *pcb, addr_t vaddr, page_t *page) {
+
+        get_page(page);
+
+        add_extent_to_proc(pcb, vaddr & PAGE_MASK, page_to_phys(page), 1);
 }
 
 /*
@@ -286,10 +382,151 @@ static void allocate_page(pcb_t *pcb, addr_t virt_addr, int nr_pages,
                 create_mapping(pcb->pgtable, virt_addr + (i * PAGE_SIZE), page,
                                PAGE_SIZE, false);
 
-                add_page_to_proc(pcb, phys_to_page(page));
+                add_page_to_proc(pcb, virt_addr + (i * PAGE_SIZE),
+                                 phys_to_page(page));
+        }
+}
+
+/*
+ * Remove the page at @vaddr from the extents of a process and release the
+ * frame if it is not referenced anymore. The page must have been unmapped.
+ */
+void remove_page_from_proc(pcb_t *pcb, addr_t vaddr) {
+        extent_t *ext, *new;
+        addr_t paddr;
+
+        vaddr &= PAGE_MASK;
+
+        ext = pcb->extent_hint;
+        if (!ext || (vaddr < ext->vaddr) || (vaddr >= extent_end(ext))) {
+                list_for_each_entry(ext, &pcb->extents, list)
+                        if ((vaddr >= ext->vaddr) && (vaddr < extent_end(ext)))
+                                break;
+
+                BUG_ON(&ext->list == &pcb->extents);
         }
+
+        paddr = ext->paddr + (vaddr - ext->vaddr);
+
+        if (vaddr == ext->vaddr) {
+                ext->vaddr += PAGE_SIZE;
+                ext->paddr += PAGE_SIZE;
+                ext->nr_pages--;
+
+        } else if (vaddr + PAGE_SIZE == extent_end(ext)) {
+                ext->nr_pages--;
+
+        } else {
+                /* Split the extent around the page */
+                new = malloc(sizeof(extent_t));
+                if (new == NULL) {
+                        printk("%s: failed to allocate memory!\n", __func__);
+                        kernel_panic();
+                }
+
+                new->vaddr = vaddr + PAGE_SIZE;
+                new->paddr = paddr + PAGE_SIZE;
+                new->nr_pages = (extent_end(ext) - new->vaddr) >> PAGE_SHIFT;
+
+                ext->nr_pages = (vaddr - ext->vaddr) >> PAGE_SHIFT;
+
+                list_add(&new->list, &ext->list);
+        }
+
+        if (!ext->nr_pages) {
+                list_del(&ext->list);
+                free(ext);
+                ext = NULL;
+        }
+
+        pcb->extent_hint = ext;
+
+        put_frames(paddr, 1);
 }
 
+#ifdef CONFIG_DEMAND_PAGING
+
+/*
+ * The heap and the stacks of a process are only reserved in the user space
+ * when the image is set up. Their pages are populated with zeroed frames
+ * on first access (demand-zero paging).
+ */
+static bool proc_lazy_region(pcb_t *pcb, addr_t vaddr) {
+
+        /* The whole heap area is managed by the libc from sbrk(0) */
+        if (pcb->heap_base && (vaddr >= pcb->heap_base) &&
+            (vaddr < pcb->heap_base + HEAP_SIZE))
+                return true;
+
+        /* Stack area of all user threads */
+        if ((vaddr >= pcb->stack_top - PROC_STACK_SIZE) &&
+            (vaddr < pcb->stack_top))
+                return true;
+
+        return false;
+}
+
+/**
+ * Populate the page of the current process at @vaddr upon a translation
+ * fault. It may be raised by the process itself or by the kernel accessing
+ * a user buffer along a syscall.
+ *
+ * @param vaddr	Faulting (user space) address
+ * @return	0 if the page has been populated, -1 if the fault is not
+ *		related to a demand-zero region or a memory area
+ */
+int proc_demand_page(addr_t vaddr) {
+        pcb_t *pcb = current()->pcb;
+        unsigned long flags;
+        addr_t page;
+        int ret = 0;
+
+        if (!pcb)
+                return -1;
+
+        vaddr &= PAGE_MASK;
+
+        flags = spin_lock_irqsave(&pcb->mm_lock);
+
+        /* Another thread of the process may have raced on the same page */
+        if (user_page_mapped(pcb->pgtable, vaddr))
+                goto out;
+
+        if (!proc_lazy_region(pcb, vaddr)) {
+#ifdef CONFIG_VMA
+                /* mmap() area */
+                ret = vma_fault(pcb, vaddr);
+                if (!ret)
+                        user_try_cont_hint(pcb->pgtable, vaddr);
+#else
+                ret = -1;
+#endif
+                goto out;
+        }
+
+        page = get_free_page();
+        if (!page) {
+                printk("%s: no free page for pid %d\n", __func__, pcb->pid);
+                kernel_panic();
+        }
+
+        memset((void *) __va(page), 0, PAGE_SIZE);
+
+        create_mapping(pcb->pgtable, vaddr, page, PAGE_SIZE, false);
+
+        add_page_to_proc(pcb, vaddr, phys_to_page(page));
+
+        /* Consecutive frames may now be held by a single TLB entry */
+        user_try_cont_hint(pcb->pgtable, vaddr);
+
+out:
+        spin_unlock_irqrestore(&pcb->mm_lock, flags);
+
+        return ret;
+}
+
+#endif /* CONFIG_DEMAND_PAGING */
+
 /**
  *
  * Create a process from scratch, without fork'd. Typically used by the kernel
@@ -310,6 +547,13 @@ void create_root_process(void) {
 
         reset_process_stack(pcb);
 
+#ifdef CONFIG_DEMAND_PAGING
+        /* The user space process stack is populated on demand, and fork()
+         * will inherit from the pages which have been touched. */
+
+        DBG("Stack reserved at 0x%08x (size: %d bytes)\n",
+            pcb->stack_top - (pcb->page_count * PAGE_SIZE), PROC_STACK_SIZE);
+#else
         /* We map the initial user space process stack here, and fork() will
          * inherit from this mapping */
 
@@ -318,6 +562,7 @@ void create_root_process(void) {
 
         DBG("Stack mapped at 0x%08x (size: %d bytes)\n",
             pcb->stack_top - (pcb->page_count * PAGE_SIZE), PROC_STACK_SIZE);
+#endif /* !CONFIG_DEMAND_PAGING */
 
         /* First map the code in the user space so that
          * the initial code can run normally in user mode.
@@ -358,20 +603,17 @@ void create_root_process(void) {
  * Release all pages allocated to a process
  */
 static void release_proc_pages(pcb_t *pcb) {
-        struct list_head *pos, *q;
-        page_list_t *cur;
+        extent_t *cur, *tmp;
 
-        list_for_each_safe(pos, q, &pcb->page_list) {
-                cur = list_entry(pos, page_list_t, list);
+        list_for_each_entry_safe(cur, tmp, &pcb->extents, list) {
+                list_del(&cur->list);
 
-                list_del(pos);
-
-                cur->page->refcount--;
-                if (!cur->page->refcount)
-                        free_page(page_to_phys(cur->page));
+                put_frames(cur->paddr, cur->nr_pages);
 
                 free(cur);
         }
+
+        pcb->extent_hint = NULL;
 }
 
 /*
@@ -567,6 +809,18 @@ int setup_proc_image_replace(elf_img_info_t *elf_img_info, pcb_t *pcb, int argc,
         /* Release all allocated pages for user space. */
         release_proc_pages(pcb);
 
+#ifdef CONFIG_VMA
+        /* The mmap'd areas disappear as well */
+        vma_release_all(pcb);
+#endif
+
+#ifdef CONFIG_DEMAND_PAGING
+        /* The user space process stack is only reserved here; its pages are
+         * populated on first access (see proc_demand_page()). */
+
+        DBG("stack reserved at 0x%08x (size: %d bytes)\n",
+            pcb->stack_top - (pcb->page_count * PAGE_SIZE), PROC_STACK_SIZE);
+#else
         /* We re-init the user space process stack here, and fork() will inherit
          * from this mapping */
 
@@ -575,6 +829,7 @@ int setup_proc_image_replace(elf_img_info_t *elf_img_info, pcb_t *pcb, int argc,
 
         DBG("stack mapped at 0x%08x (size: %d bytes)\n",
             pcb->stack_top - (pcb->page_count * PAGE_SIZE), PROC_STACK_SIZE);
+#endif /* !CONFIG_DEMAND_PAGING */
 
         /* Initialize the pc register */
         pcb->bin_image_entry = (uint32_t) elf_img_info->header->e_entry;
@@ -600,10 +855,16 @@ int setup_proc_image_replace(elf_img_info_t *elf_img_info, pcb_t *pcb, int argc,
         pcb->heap_pointer = pcb->heap_base;
         pcb->page_count += page_count;
 
+#ifdef CONFIG_DEMAND_PAGING
+        /* Same for the heap, so that the exec time does not depend on its size */
+        DBG("heap reserved at 0x%08x (size: %d bytes)\n", pcb->heap_base,
+            HEAP_SIZE);
+#else
         allocate_page(pcb, pcb->heap_base, page_count, true);
 
         DBG("heap mapped at 0x%08x (size: %d bytes)\n", pcb->heap_base,
             HEAP_SIZE);
+#endif /* !CONFIG_DEMAND_PAGING */
 
         /* arguments (& env) will be stored in one more page */
         pcb->page_count++;
@@ -816,6 +1077,12 @@ pcb_t *duplicate_process(pcb_t *parent) {
         pcb->heap_base = parent->heap_base;
         pcb->heap_pointer = parent->heap_pointer;
 
+#ifdef CONFIG_VMA
+        /* The memory areas are inherited; the shared ones keep their frames
+         * (see duplicate_user_space()) */
+        vma_clone(parent, pcb);
+#endif
+
         /* Duplicate the array of allocated stack slots dedicated to user
          * threads */
         memcpy(pcb->stack_slotID, parent->stack_slotID,
@@ -951,6 +1218,9 @@ void do_exit(int exit_status) {
 
         /* Release all allocated pages for user space */
         release_proc_pages(pcb);
+#ifdef CONFIG_VMA
+        vma_release_all(pcb);
+#endif
 
 #ifdef CONFIG_IPC_SIGNAL
 
@@ -1109,6 +1379,10 @@ int do_sbrk(int increment) {
         int ret_pointer;
         int req_sz = 0;
         int cur_sz;
+#ifdef CONFIG_DEMAND_PAGING
+        addr_t vaddr, paddr;
+        unsigned long flags;
+#endif
 
         if (!pcb) {
                 /* case there is no pcb context */
@@ -1128,34 +1402,23 @@ int do_sbrk(int increment) {
                 return -1;
         }
 
-#if 0
-	/* This is the the code allocation will be done automatically*/
-	/* Case of the first page */
-	if (!cur_sz) {
-		if (req_sz) {
-			pcb->page_count += 1;
-			allocate_page(pcb, pcb->heap_base, page_count);
-			pcb->heap_pointer = pcb->heap_base + PAGE_SIZE;
-		} 
-		return -1;
-	}
-
-	int i;
-	int page_start;
-	req_nbr_pages = (int) (req_sz / PAGE_SIZE) - (int) (cur_sz / PAGE_SIZE);
-	/* Test if we need to allocate/free one more page on heap*/
-	pcb->page_count += req_nbr_pages;
-
-	if (req_nbr_pages < 0) {
-		page_start = pcb->heap_pointer / PAGE_SIZE + req_nbr_pages;
-		for (i = 0; i > req_nbr_pages; i++) {
-			release_page((page_start + i) * PAGE_SIZE);
-		}
-	} else if (req_nbr_pages > 0) {
-		page_start = pcb->heap_pointer / PAGE_SIZE + 1;
-		allocate_page(pcb, () (page_start * PAGE_SIZE), req_nbr_pages);
-	}
-#endif
+#ifdef CONFIG_DEMAND_PAGING
+        /* The heap is populated on demand; when it shrinks, the pages which are
+         * entirely above the new program break are given back. */
+        if (increment < 0) {
+                flags = spin_lock_irqsave(&pcb->mm_lock);
+
+                for (vaddr = ALIGN_UP(pcb->heap_pointer + increment, PAGE_SIZE);
+                     vaddr < ALIGN_UP(pcb->heap_pointer, PAGE_SIZE);
+                     vaddr += PAGE_SIZE) {
+                        paddr = release_user_page(pcb->pgtable, vaddr);
+                        if (paddr)
+                                remove_page_from_proc(pcb, vaddr);
+                }
+
+                spin_unlock_irqrestore(&pcb->mm_lock, flags);
+        }
+#endif /* CONFIG_DEMAND_PAGING */
 
         pcb->heap_pointer = pcb->heap_pointer + increment;
         return ret_pointer;
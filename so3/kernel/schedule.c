@@ -28,6 +28,7 @@
 #include <softirq.h>
 #include <mutex.h>
 #include <timer.h>
+#include <trace.h>
 
 #include <device/irq.h>
 
@@ -462,7 +463,7 @@ void schedule(void) {
 			if ((prev != NULL) && (prev->pcb != NULL) && (prev->pcb->state != PROC_STATE_ZOMBIE) && (prev->pcb->state != PROC_STATE_WAITING))
 				prev->pcb->state = PROC_STATE_READY;
 
-			mmu_switch((void *) __pa(next->pcb->pgtable));
+			mmu_switch(next->pcb);
 			set_pgtable(next->pcb->pgtable);
 
 		}
@@ -472,6 +473,8 @@ void schedule(void) {
 		__in_interrupt = false;
 		__in_scheduling = false;
 
+		trace(TRACE_SCHED_SWITCH, (prev ? prev->tid : 0), next->tid);
+
 		__switch_to(prev, next);
 
 	}
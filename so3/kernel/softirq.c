@@ -16,28 +16,108 @@
  *
  */
 
-#include <bitops.h>
 #include <types.h>
 #include <softirq.h>
 #include <string.h>
+#include <timer.h>
+#include <trace.h>
 
 #include <asm/processor.h>
 
 #include <device/irq.h>
 
-static volatile bool softirq_stat[CONFIG_NR_CPUS][NR_SOFTIRQS];
+/*
+ * Pending softirqs of a CPU, one bit per softirq. The word is only updated
+ * with atomic operations, so raising a softirq (possibly from another CPU)
+ * never takes a lock. Each CPU has its own cache line to avoid false sharing.
+ */
+struct softirq_pending {
+	volatile unsigned long mask;
+} __attribute__((aligned(64)));
+
+static struct softirq_pending softirq_pending[CONFIG_NR_CPUS];
 
 static softirq_handler softirq_handlers[NR_SOFTIRQS];
 
-DEFINE_SPINLOCK(softirq_pending_lock);
+#ifdef CONFIG_SOFTIRQ_STATS
+
+struct softirq_stat {
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+};
+
+static struct softirq_stat softirq_stats[CONFIG_NR_CPUS][NR_SOFTIRQS];
+
+static const char *softirq_names[NR_SOFTIRQS] = {
+	[TIMER_SOFTIRQ]		= "timer",
+	[SCHEDULE_SOFTIRQ]	= "schedule",
+};
+
+static void softirq_account(unsigned int nr, u64 start)
+{
+	struct softirq_stat *s;
+	u64 delta = NOW() - start;
+	unsigned long flags;
+
+	flags = local_irq_save();
+
+	s = &softirq_stats[smp_processor_id()][nr];
+
+	s->count++;
+	s->total_ns += delta;
+	if (delta > s->max_ns)
+		s->max_ns = delta;
+
+	local_irq_restore(flags);
+}
+
+/*
+ * Print the number of runs and the time spent in each softirq handler.
+ * The time of SCHEDULE_SOFTIRQ includes the time during which the other
+ * threads were running until the current one got the CPU back.
+ */
+void dump_softirq(void)
+{
+	struct softirq_stat *s;
+	unsigned int cpu, i;
+
+	lprintk("Softirq statistics:\n");
+
+	for (cpu = 0; cpu < CONFIG_NR_CPUS; cpu++)
+		for (i = 0; i < NR_SOFTIRQS; i++) {
+			s = &softirq_stats[cpu][i];
+			if (!s->count)
+				continue;
+
+			lprintk("  cpu %d %-10s count: %llu  avg: %llu ns  max: %llu ns\n", cpu,
+				(softirq_names[i] ? softirq_names[i] : "?"), s->count,
+				s->total_ns / s->count, s->max_ns);
+		}
+}
+
+#else /* CONFIG_SOFTIRQ_STATS */
+
+void dump_softirq(void)
+{
+	lprintk("Softirq statistics are not enabled (CONFIG_SOFTIRQ_STATS).\n");
+}
+
+#endif /* !CONFIG_SOFTIRQ_STATS */
 
 /*
  * Perform actions of related pending softirqs if any.
+ * The lowest pending bit is processed first, so that the low-latency softirqs
+ * are handled before SCHEDULE_SOFTIRQ.
  */
 void do_softirq(void)
 {
 	unsigned int i, cpu;
 	unsigned int loopmax;
+	unsigned long pending;
+#ifdef CONFIG_SOFTIRQ_STATS
+	u64 start;
+#endif
 
 	loopmax = 0;
 
@@ -45,26 +125,32 @@ void do_softirq(void)
 
 	while (true) {
 
-		spin_lock(&softirq_pending_lock);
-
-		for (i = 0; i < NR_SOFTIRQS; i++)
-			if (softirq_stat[cpu][i])
-				break;
-
-		if (i == NR_SOFTIRQS) {
-			spin_unlock(&softirq_pending_lock);
+		pending = __atomic_load_n(&softirq_pending[cpu].mask, __ATOMIC_ACQUIRE);
+		if (!pending)
 			break;
-		}
+
+		i = __builtin_ctzl(pending);
 
 		if (loopmax > 100)   /* Probably something wrong ;-) */
 			printk("%s: Warning trying to process softirq on cpu %d for quite a long time (i = %d)...\n", __func__, cpu, i);
 
-		softirq_stat[cpu][i] = false;
+		/* Clear the bit before running the handler so that a new raise is not lost */
+		__atomic_fetch_and(&softirq_pending[cpu].mask, ~(1UL << i), __ATOMIC_ACQ_REL);
 
-		spin_unlock(&softirq_pending_lock);
+#ifdef CONFIG_SOFTIRQ_STATS
+		start = NOW();
+#endif
+
+		trace(TRACE_SOFTIRQ_ENTRY, i, 0);
 
 		(*softirq_handlers[i])();
 
+		trace(TRACE_SOFTIRQ_EXIT, i, 0);
+
+#ifdef CONFIG_SOFTIRQ_STATS
+		softirq_account(i, start);
+#endif
+
 		/* If we left the interrupt context along a context switch... */
 		__in_interrupt = true;
 
@@ -87,10 +173,11 @@ void register_softirq(int nr, softirq_handler handler)
 /*
  * The softirq_pending mask (irqstat) must be coherent between the agency CPUs and MEs CPU
  * since they do not run in the same OS environment, the hardware cache coherency is not guaranteed.
+ * The release ordering makes the data prepared for the softirq visible before the bit.
  */
 void cpu_raise_softirq(unsigned int cpu, unsigned int nr)
 {
-	softirq_stat[cpu][nr] = true;
+	__atomic_fetch_or(&softirq_pending[cpu].mask, 1UL << nr, __ATOMIC_RELEASE);
 
 	smp_trigger_event(cpu);
 }
@@ -99,11 +186,10 @@ void cpu_raise_softirq(unsigned int cpu, unsigned int nr)
 
 void raise_softirq(unsigned int nr)
 {
-	softirq_stat[smp_processor_id()][nr] = true;
+	__atomic_fetch_or(&softirq_pending[smp_processor_id()].mask, 1UL << nr, __ATOMIC_RELEASE);
 }
 
-
 void softirq_init(void)
 {
-	memset((void *) softirq_stat, 0, sizeof(softirq_stat));
+	memset((void *) softirq_pending, 0, sizeof(softirq_pending));
 }
@@ -24,16 +24,19 @@
 #include <vfs.h>
 #include <pipe.h>
 #include <heap.h>
-#include <process.h>
 #include <signal.h>
 #include <timer.h>
 #include <net.h>
 #include <syscall.h>
+#include <sysstat.h>
+#include <vma.h>
+#include <shm.h>
+#include <softirq.h>
+#include <trace.h>
 
-static uint32_t *errno_addr = NULL;
+#include <asm/syscall.h>
 
-extern void __get_syscall_args_ext(uint32_t *syscall_no, uint32_t **__errno_addr);
-extern uint32_t __get_syscall_stack_arg(uint32_t nr);
+static uint32_t *errno_addr = NULL;
 
 extern void test_malloc(int test_no);
 
@@ -57,260 +60,401 @@ void set_errno(uint32_t val) {
 		*errno_addr = val;
 }
 
-/*
- * Process syscalls according to the syscall number passed in r7 on ARM and x8 on ARM64.
- * According to SO3 ABI, the syscall arguments are passed in r0-r5 on ARM and x0-x5 on ARM64.
- */
+#define ARG(n)	SYSCALL_ARG(regs, n)
 
-long syscall_handle(syscall_args_t *a)
-{
-	long result = -1;
-	uint32_t syscall_no, *__errno_addr;
+#ifdef CONFIG_MMU
+static long sys_getpid(cpu_regs_t *regs) {
+	return do_getpid();
+}
 
-	/* Get addtional args of the syscall according to the ARM & SO3 ABI */
-	__get_syscall_args_ext(&syscall_no, &__errno_addr);
+static long sys_gettimeofday(cpu_regs_t *regs) {
+	/* ARG(1) contains a pointer to the timezone structure. */
+	/* Currently, this is not supported yet. */
 
-	set_errno_addr(__errno_addr);
+	return do_get_time_of_day((struct timespec *) ARG(0));
+}
 
-        switch (syscall_no) {
+static long sys_clock_gettime(cpu_regs_t *regs) {
+	return do_get_clock_time(ARG(0), (struct timespec *) ARG(1));
+}
 
-#ifdef CONFIG_MMU
-		case SYSCALL_GETPID:
-			result = do_getpid();
-			break;
+static long sys_settimeofday(cpu_regs_t *regs) {
+	printk("## settimeofday not yet supported by so3\n");
+
+	set_errno(ENOSYS);
+	return -1;
+}
 
-		case SYSCALL_GETTIMEOFDAY:
-			/* a->args[1] contains a pointer to the timezone structure. */
-			/* Currently, this is not supported yet. */
+static long sys_exit(cpu_regs_t *regs) {
+	do_exit(ARG(0));
+	return -1;
+}
 
-			result = do_get_time_of_day((struct timespec *) a->args[0]);
-			break;
+static long sys_execve(cpu_regs_t *regs) {
+	return do_execve((const char *) ARG(0), (char **) ARG(1), (char **) ARG(2));
+}
 
-		case SYSCALL_CLOCK_GETTIME:
+static long sys_fork(cpu_regs_t *regs) {
+	return do_fork();
+}
 
-			result = do_get_clock_time(a->args[0], (struct timespec *) a->args[1]);
-			break;
+static long sys_waitpid(cpu_regs_t *regs) {
+	return do_waitpid(ARG(0), (uint32_t *) ARG(1), ARG(2));
+}
 
-		case SYSCALL_SETTIMEOFDAY:
+static long sys_ptrace(cpu_regs_t *regs) {
+	return do_ptrace((enum __ptrace_request) ARG(0), (uint32_t) ARG(1), (void *) ARG(2), (void *) ARG(3));
+}
 
-			printk("## settimeofday not yet supported by so3\n");
+static long sys_mmap(cpu_regs_t *regs) {
+	return (long) do_mmap((addr_t) ARG(0), (size_t) ARG(1), (int) ARG(2), (int) ARG(3), (int) ARG(4), (off_t) ARG(5));
+}
 
-			set_errno(-ENOSYS);
-			result = -1;
-			break;
+#ifdef CONFIG_VMA
+static long sys_munmap(cpu_regs_t *regs) {
+	return do_munmap((addr_t) ARG(0), (size_t) ARG(1));
+}
 
-		case SYSCALL_EXIT:
-			do_exit(a->args[0]);
-			break;
+static long sys_mprotect(cpu_regs_t *regs) {
+	return do_mprotect((addr_t) ARG(0), (size_t) ARG(1), (int) ARG(2));
+}
 
-		case SYSCALL_EXECVE:
-			result = do_execve((const char *) a->args[0], (char **) a->args[1], (char **) a->args[2]);
-			break;
+static long sys_shm_open(cpu_regs_t *regs) {
+	return do_shm_open((const char *) ARG(0), (int) ARG(1), (int) ARG(2));
+}
 
-		case SYSCALL_FORK:
-			result = do_fork();
-			break;
+static long sys_shm_unlink(cpu_regs_t *regs) {
+	return do_shm_unlink((const char *) ARG(0));
+}
 
-		case SYSCALL_WAITPID:
-			result = do_waitpid(a->args[0], (uint32_t *) a->args[1], a->args[2]);
-			break;
+static long sys_ftruncate(cpu_regs_t *regs) {
+	return do_ftruncate((int) ARG(0), (off_t) ARG(1));
+}
+#endif /* CONFIG_VMA */
 #endif /* CONFIG_MMU */
 
-		case SYSCALL_READ:
-			result = do_read(a->args[0], (void *) a->args[1], a->args[2]);
-			break;
+static long sys_read(cpu_regs_t *regs) {
+	return do_read(ARG(0), (void *) ARG(1), ARG(2));
+}
+
+static long sys_write(cpu_regs_t *regs) {
+	return do_write(ARG(0), (void *) ARG(1), ARG(2));
+}
+
+static long sys_open(cpu_regs_t *regs) {
+	return do_open((const char *) ARG(0), ARG(1));
+}
 
-		case SYSCALL_WRITE:
-			result = do_write(a->args[0], (void *) a->args[1], a->args[2]);
-			break;
+static long sys_close(cpu_regs_t *regs) {
+	do_close((int) ARG(0));
+	return 0;
+}
 
-		case SYSCALL_OPEN:
-			result = do_open((const char *) a->args[0], a->args[1]);
-			break;
+static long sys_thread_create(cpu_regs_t *regs) {
+	return do_thread_create((uint32_t *) ARG(0), ARG(1), ARG(2), ARG(3));
+}
 
-		case SYSCALL_CLOSE:
-			do_close((int) a->args[0]);
-			result = 0;
-			break;
+static long sys_thread_join(cpu_regs_t *regs) {
+	return do_thread_join(ARG(0), (int **) ARG(1));
+}
+
+static long sys_thread_exit(cpu_regs_t *regs) {
+	do_thread_exit((int *) ARG(0));
+	return 0;
+}
 
-		case SYSCALL_THREAD_CREATE:
-			result = do_thread_create((uint32_t *) a->args[0], a->args[1], a->args[2], a->args[3]);
-			break;
+static long sys_thread_yield(cpu_regs_t *regs) {
+	do_thread_yield();
+	return 0;
+}
 
-		case SYSCALL_THREAD_JOIN:
-			result = do_thread_join(a->args[0], (int **) a->args[1]);
-			break;
+static long sys_readdir(cpu_regs_t *regs) {
+	return do_readdir((int) ARG(0), (char *) ARG(1), ARG(2));
+}
 
-		case SYSCALL_THREAD_EXIT:
-			do_thread_exit((int *) a->args[0]);
-			result = 0;
-			break;
+static long sys_ioctl(cpu_regs_t *regs) {
+	return do_ioctl((int) ARG(0), (unsigned long) ARG(1), (unsigned long) ARG(2));
+}
 
-		case SYSCALL_THREAD_YIELD:
-			do_thread_yield();
-			result = 0;
-			break;
+static long sys_fcntl(cpu_regs_t *regs) {
+	return do_fcntl((int) ARG(0), (int) ARG(1), (unsigned long) ARG(2));
+}
 
-		case SYSCALL_READDIR:
-			result = do_readdir((int) a->args[0], (char *) a->args[1], a->args[2]);
-			break;
+static long sys_lseek(cpu_regs_t *regs) {
+	return do_lseek((int) ARG(0), (off_t) ARG(1), (int) ARG(2));
+}
 
-		case SYSCALL_IOCTL:
-			result = do_ioctl((int) a->args[0], (unsigned long) a->args[1], (unsigned long) a->args[2]);
-			break;
+static long sys_readv(cpu_regs_t *regs) {
+	return do_readv((int) ARG(0), (const struct iovec *) ARG(1), (int) ARG(2));
+}
 
-		case SYSCALL_FCNTL:
-			result = do_fcntl((int) a->args[0], (int) a->args[1], (unsigned long) a->args[2]);
-			break;
+static long sys_writev(cpu_regs_t *regs) {
+	return do_writev((int) ARG(0), (const struct iovec *) ARG(1), (int) ARG(2));
+}
 
-		case SYSCALL_LSEEK:
-			result = do_lseek((int) a->args[0], (off_t) a->args[1], (int) a->args[2]);
-			break;
+static long sys_sendfile(cpu_regs_t *regs) {
+	return do_sendfile((int) ARG(0), (int) ARG(1), (off_t *) ARG(2), (size_t) ARG(3));
+}
 
 #ifdef CONFIG_IPC_PIPE
-		case SYSCALL_PIPE:
-			result = do_pipe((int *) a->args[0]);
-			break;
-#endif /* CONFIG_IPC_PIPE */
+static long sys_pipe(cpu_regs_t *regs) {
+	return do_pipe((int *) ARG(0));
+}
 
-		case SYSCALL_DUP:
-			result = do_dup((int) a->args[0]);
-			break;
+static long sys_splice(cpu_regs_t *regs) {
+	return do_splice((int) ARG(0), (off_t *) ARG(1), (int) ARG(2), (off_t *) ARG(3),
+			 (size_t) ARG(4), (unsigned int) ARG(5));
+}
+#endif /* CONFIG_IPC_PIPE */
 
-		case SYSCALL_DUP2:
-			result = do_dup2((int) a->args[0], (int) a->args[1]);
-			break;
+static long sys_dup(cpu_regs_t *regs) {
+	return do_dup((int) ARG(0));
+}
 
-		case SYSCALL_STAT:
-			result = do_stat((char *) a->args[0], (struct stat *) a->args[1]);
-			break;
+static long sys_dup2(cpu_regs_t *regs) {
+	return do_dup2((int) ARG(0), (int) ARG(1));
+}
 
-		case SYSCALL_MMAP:
-			result = (long) do_mmap((addr_t) a->args[0], (size_t) a->args[1], (int) a->args[2], (int) a->args[3], (off_t) a->args[4]);
-			break;
+static long sys_stat(cpu_regs_t *regs) {
+	return do_stat((char *) ARG(0), (struct stat *) ARG(1));
+}
 
-		case SYSCALL_NANOSLEEP:
-			result = do_nanosleep((const struct timespec *) a->args[0], (struct timespec *) a->args[1]);
-			break;
+static long sys_nanosleep(cpu_regs_t *regs) {
+	return do_nanosleep((const struct timespec *) ARG(0), (struct timespec *) ARG(1));
+}
 
 #ifdef CONFIG_PROC_ENV
-		case SYSCALL_SBRK:
-			result = do_sbrk((unsigned long) a->args[0]);
-			break;
-
+static long sys_sbrk(cpu_regs_t *regs) {
+	return do_sbrk((unsigned long) ARG(0));
+}
 #endif /* CONFIG_PROC_ENV */
 
-	/* This is a first attempt of mutex syscall implementation.
-	 * Mainly used for debugging purposes (kernel mutex validation) at the moment ... */
+/* This is a first attempt of mutex syscall implementation.
+ * Mainly used for debugging purposes (kernel mutex validation) at the moment ... */
 
-		case SYSCALL_MUTEX_LOCK:
-			result = do_mutex_lock(&current()->pcb->lock[a->args[0]]);
-			break;
-
-		case SYSCALL_MUTEX_UNLOCK:
-			result = do_mutex_unlock(&current()->pcb->lock[a->args[0]]);
-			break;
+static long sys_mutex_lock(cpu_regs_t *regs) {
+	return do_mutex_lock(&current()->pcb->lock[ARG(0)]);
+}
 
-#ifdef CONFIG_MMU
-		case SYSCALL_PTRACE:
-			result = do_ptrace((enum __ptrace_request) a->args[0], (uint32_t) a->args[1], (void *) a->args[2], (void *) a->args[3]);
-			break;
-#endif
+static long sys_mutex_unlock(cpu_regs_t *regs) {
+	return do_mutex_unlock(&current()->pcb->lock[ARG(0)]);
+}
 
 #ifdef CONFIG_IPC_SIGNAL
-		case SYSCALL_SIGACTION:
-			result = do_sigaction((int) a->args[0], (sigaction_t *) a->args[1], (sigaction_t *) a->args[2]);
-			break;
-
-		case SYSCALL_KILL:
-			result = do_kill((int) a->args[0], (int) a->args[1]);
-			break;
+static long sys_sigaction(cpu_regs_t *regs) {
+	return do_sigaction((int) ARG(0), (sigaction_t *) ARG(1), (sigaction_t *) ARG(2));
+}
 
-		case SYSCALL_SIGRETURN:
-			do_sigreturn();
-			break;
+static long sys_kill(cpu_regs_t *regs) {
+	return do_kill((int) ARG(0), (int) ARG(1));
+}
 
+static long sys_sigreturn(cpu_regs_t *regs) {
+	do_sigreturn();
+	return -1;
+}
 #endif /* CONFIG_IPC_SIGNAL */
 
 #ifdef CONFIG_NET
-		case SYSCALL_SOCKET:
-			result = do_socket((int)a->args[0], (int)a->args[1], (int)a->args[2]);
-			break;
+static long sys_socket(cpu_regs_t *regs) {
+	return do_socket((int) ARG(0), (int) ARG(1), (int) ARG(2));
+}
 
-		case SYSCALL_BIND:
-			result = do_bind((int) a->args[0], (const struct sockaddr *) a->args[1], (socklen_t) a->args[2]);
-			break;
+static long sys_bind(cpu_regs_t *regs) {
+	return do_bind((int) ARG(0), (const struct sockaddr *) ARG(1), (socklen_t) ARG(2));
+}
 
-		case SYSCALL_LISTEN:
-			result = do_listen((int)a->args[0], (int) a->args[1]);
-			break;
+static long sys_listen(cpu_regs_t *regs) {
+	return do_listen((int) ARG(0), (int) ARG(1));
+}
 
-		case SYSCALL_ACCEPT:
-			result = do_accept((int) a->args[0], (struct sockaddr *) a->args[1], (socklen_t *) a->args[2]);
-			break;
+static long sys_accept(cpu_regs_t *regs) {
+	return do_accept((int) ARG(0), (struct sockaddr *) ARG(1), (socklen_t *) ARG(2));
+}
 
-		case SYSCALL_CONNECT:
-			result = do_connect((int) a->args[0], (const struct sockaddr *) a->args[1], (socklen_t) a->args[2]);
-			break;
+static long sys_connect(cpu_regs_t *regs) {
+	return do_connect((int) ARG(0), (const struct sockaddr *) ARG(1), (socklen_t) ARG(2));
+}
 
-		case SYSCALL_RECV:
-			result = do_recv((int)a->args[0], (void*) a->args[1], (size_t) a->args[2], (int) a->args[3]);
-			break;
+static long sys_recv(cpu_regs_t *regs) {
+	return do_recv((int) ARG(0), (void *) ARG(1), (size_t) ARG(2), (int) ARG(3));
+}
+
+static long sys_send(cpu_regs_t *regs) {
+	return do_send((int) ARG(0), (const void *) ARG(1), (size_t) ARG(2), (int) ARG(3));
+}
 
-		case SYSCALL_SEND:
-			result = do_send((int)a->args[0], (const void *) a->args[1], (size_t) a->args[2], (int) a->args[3]);
-			break;
+static long sys_sendto(cpu_regs_t *regs) {
+	return do_sendto((int) ARG(0), (const void *) ARG(1), (size_t) ARG(2), (int) ARG(3),
+			 (const struct sockaddr *) ARG(4), (socklen_t) ARG(5));
+}
 
-		case SYSCALL_SENDTO:
-			result = do_sendto((int)a->args[0], (const void *)a->args[1], (size_t)a->args[2], (int)a->args[3],
-					(const struct sockaddr *) a->args[4],
-					(socklen_t) a->args[5]);
-			break;
+static long sys_setsockopt(cpu_regs_t *regs) {
+	return do_setsockopt((int) ARG(0), (int) ARG(1), (int) ARG(2), (const void *) ARG(3), (socklen_t) ARG(4));
+}
 
-		case SYSCALL_SETSOCKOPT:
-			result = do_setsockopt((int) a->args[0], (int) a->args[1], (int) a->args[2], (const void *) a->args[3], (socklen_t) a->args[4]);
-			break;
+static long sys_recvfrom(cpu_regs_t *regs) {
+	return do_recvfrom((int) ARG(0), (void *) ARG(1), (size_t) ARG(2), (int) ARG(3),
+			   (struct sockaddr *) ARG(4), (socklen_t *) ARG(5));
+}
 
-		case SYSCALL_RECVFROM:
-			result = do_recvfrom((int) a->args[0], (void *) a->args[1], (size_t) a->args[2], (int) a->args[3], (struct sockaddr *) a->args[4],
-					(socklen_t *)a->args[5]);
-			break;
+static long sys_sendmmsg(cpu_regs_t *regs) {
+	return do_sendmmsg((int) ARG(0), (struct mmsghdr_usr *) ARG(1), (unsigned int) ARG(2), (int) ARG(3));
+}
 
+static long sys_recvmmsg(cpu_regs_t *regs) {
+	return do_recvmmsg((int) ARG(0), (struct mmsghdr_usr *) ARG(1), (unsigned int) ARG(2), (int) ARG(3),
+			   (struct timespec *) ARG(4));
+}
 #endif /* CONFIG_NET */
 
-		/* Sysinfo syscalls */
-		case SYSCALL_SYSINFO:
-			switch (a->args[0]) {
-			case SYSINFO_DUMP_HEAP:
-				dump_heap("Heap info asked from user.\n");
-				break;
+/* Sysinfo syscalls */
+static long sys_sysinfo(cpu_regs_t *regs) {
+	switch (ARG(0)) {
+	case SYSINFO_DUMP_HEAP:
+		dump_heap("Heap info asked from user.\n");
+		break;
 
-			case SYSINFO_DUMP_SCHED:
-				dump_sched();
-				break;
+	case SYSINFO_DUMP_SCHED:
+		dump_sched();
+		break;
 
 #ifdef CONFIG_MMU
-			case SYSINFO_DUMP_PROC:
-				dump_proc();
-				break;
+	case SYSINFO_DUMP_PROC:
+		dump_proc();
+		break;
 #endif
 
+	case SYSINFO_DUMP_SOFTIRQ:
+		dump_softirq();
+		break;
+
 #ifdef CONFIG_APP_TEST_MALLOC
-			case SYSINFO_TEST_MALLOC:
-				test_malloc(a->args[1]);
-				break;
+	case SYSINFO_TEST_MALLOC:
+		test_malloc(ARG(1));
+		break;
+#endif
+	case SYSINFO_PRINTK:
+		printk("%s", (char *) ARG(1));
+		break;
+	}
+
+	return 0;
+}
+
+/*
+ * Syscall table indexed by the syscall number. Unused entries are NULL.
+ */
+static const syscall_fn_t syscall_table[NR_SYSCALLS] = {
+#ifdef CONFIG_MMU
+	[SYSCALL_GETPID]	= sys_getpid,
+	[SYSCALL_GETTIMEOFDAY]	= sys_gettimeofday,
+	[SYSCALL_CLOCK_GETTIME]	= sys_clock_gettime,
+	[SYSCALL_SETTIMEOFDAY]	= sys_settimeofday,
+	[SYSCALL_EXIT]		= sys_exit,
+	[SYSCALL_EXECVE]	= sys_execve,
+	[SYSCALL_FORK]		= sys_fork,
+	[SYSCALL_WAITPID]	= sys_waitpid,
+	[SYSCALL_PTRACE]	= sys_ptrace,
+	[SYSCALL_MMAP]		= sys_mmap,
+#ifdef CONFIG_VMA
+	[SYSCALL_MUNMAP]	= sys_munmap,
+	[SYSCALL_MPROTECT]	= sys_mprotect,
+	[SYSCALL_SHM_OPEN]	= sys_shm_open,
+	[SYSCALL_SHM_UNLINK]	= sys_shm_unlink,
+	[SYSCALL_FTRUNCATE]	= sys_ftruncate,
+#endif /* CONFIG_VMA */
+#endif /* CONFIG_MMU */
+
+	[SYSCALL_READ]		= sys_read,
+	[SYSCALL_WRITE]		= sys_write,
+	[SYSCALL_OPEN]		= sys_open,
+	[SYSCALL_CLOSE]		= sys_close,
+	[SYSCALL_THREAD_CREATE]	= sys_thread_create,
+	[SYSCALL_THREAD_JOIN]	= sys_thread_join,
+	[SYSCALL_THREAD_EXIT]	= sys_thread_exit,
+	[SYSCALL_THREAD_YIELD]	= sys_thread_yield,
+	[SYSCALL_READDIR]	= sys_readdir,
+	[SYSCALL_IOCTL]		= sys_ioctl,
+	[SYSCALL_FCNTL]		= sys_fcntl,
+	[SYSCALL_LSEEK]		= sys_lseek,
+	[SYSCALL_READV]		= sys_readv,
+	[SYSCALL_WRITEV]	= sys_writev,
+	[SYSCALL_SENDFILE]	= sys_sendfile,
+#ifdef CONFIG_IPC_PIPE
+	[SYSCALL_PIPE]		= sys_pipe,
+	[SYSCALL_SPLICE]	= sys_splice,
+#endif
+	[SYSCALL_DUP]		= sys_dup,
+	[SYSCALL_DUP2]		= sys_dup2,
+	[SYSCALL_STAT]		= sys_stat,
+	[SYSCALL_NANOSLEEP]	= sys_nanosleep,
+#ifdef CONFIG_PROC_ENV
+	[SYSCALL_SBRK]		= sys_sbrk,
+#endif
+	[SYSCALL_MUTEX_LOCK]	= sys_mutex_lock,
+	[SYSCALL_MUTEX_UNLOCK]	= sys_mutex_unlock,
+
+#ifdef CONFIG_IPC_SIGNAL
+	[SYSCALL_SIGACTION]	= sys_sigaction,
+	[SYSCALL_KILL]		= sys_kill,
+	[SYSCALL_SIGRETURN]	= sys_sigreturn,
+#endif
+
+#ifdef CONFIG_NET
+	[SYSCALL_SOCKET]	= sys_socket,
+	[SYSCALL_BIND]		= sys_bind,
+	[SYSCALL_LISTEN]	= sys_listen,
+	[SYSCALL_ACCEPT]	= sys_accept,
+	[SYSCALL_CONNECT]	= sys_connect,
+	[SYSCALL_RECV]		= sys_recv,
+	[SYSCALL_SEND]		= sys_send,
+	[SYSCALL_SENDTO]	= sys_sendto,
+	[SYSCALL_SETSOCKOPT]	= sys_setsockopt,
+	[SYSCALL_RECVFROM]	= sys_recvfrom,
+	[SYSCALL_SENDMMSG]	= sys_sendmmsg,
+	[SYSCALL_RECVMMSG]	= sys_recvmmsg,
+#endif
+
+	[SYSCALL_SYSINFO]	= sys_sysinfo,
+};
+
+/*
+ * Process syscalls according to the syscall number passed in r7 on ARM and x8 on ARM64.
+ * According to SO3 ABI, the syscall arguments are passed in r0-r5 on ARM and x0-x5 on ARM64,
+ * and the address of errno in r10 on ARM and x9 on ARM64. They are read directly from
+ * the saved user context.
+ */
+long syscall_handle(cpu_regs_t *regs)
+{
+	unsigned long syscall_no = SYSCALL_NR(regs);
+	long result;
+#ifdef CONFIG_SYSCALL_STATS
+	u64 start;
+#endif
+
+	errno_addr = SYSCALL_ERRNO_ADDR(regs);
+
+	if (unlikely((syscall_no >= NR_SYSCALLS) || !syscall_table[syscall_no])) {
+		printk("%s: unhandled syscall: %lu\n", __func__, syscall_no);
+
+		set_errno(ENOSYS);
+		return -1;
+	}
+
+#ifdef CONFIG_SYSCALL_STATS
+	start = sysstat_enter(syscall_no);
+#endif
+
+	trace(TRACE_SYSCALL_ENTRY, syscall_no, 0);
+
+	result = syscall_table[syscall_no](regs);
+
+	trace(TRACE_SYSCALL_EXIT, syscall_no, result);
+
+#ifdef CONFIG_SYSCALL_STATS
+	sysstat_exit(syscall_no, start);
 #endif
-			case SYSINFO_PRINTK:
-				printk("%s", (char *) a->args[1]);
-				break;
-			}
-			result = 0;
-			break;
-
-		default:
-			printk("%s: unhandled syscall: %d\n", __func__, syscall_no);
-			break;
-                }
 
 #warning do_softirq?
 
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Per-syscall counters and latency histograms.
+ *
+ * The statistics are kept per CPU so that the syscall path never contends
+ * on a lock; they are summed up when /dev/sysstat is read.
+ */
+
+#include <common.h>
+#include <heap.h>
+#include <smp.h>
+#include <vfs.h>
+#include <timer.h>
+#include <syscall.h>
+#include <sysstat.h>
+#include <initcall.h>
+
+#include <device/device.h>
+
+#include <asm/processor.h>
+
+static struct sysstat_entry sysstat[CONFIG_NR_CPUS][NR_SYSCALLS];
+
+u64 sysstat_enter(unsigned int nr)
+{
+	unsigned long flags;
+
+	flags = local_irq_save();
+	sysstat[smp_processor_id()][nr].count++;
+	local_irq_restore(flags);
+
+	return NOW();
+}
+
+void sysstat_exit(unsigned int nr, u64 start)
+{
+	struct sysstat_entry *e;
+	u64 delta = NOW() - start;
+	u64 us = delta / 1000;
+	unsigned int bucket;
+	unsigned long flags;
+
+	bucket = ((us >= (1ull << (SYSSTAT_HIST_BUCKETS - 2))) ? SYSSTAT_HIST_BUCKETS - 1 :
+		  (us ? 32 - __builtin_clz((uint32_t) us) : 0));
+
+	flags = local_irq_save();
+
+	e = &sysstat[smp_processor_id()][nr];
+
+	e->total_ns += delta;
+	if (delta > e->max_ns)
+		e->max_ns = delta;
+	e->hist[bucket]++;
+
+	local_irq_restore(flags);
+}
+
+struct sysstat_reader {
+	/* Next syscall to report */
+	int pos;
+};
+
+static int sysstat_open(int fd, const char *path)
+{
+	struct sysstat_reader *reader;
+
+	reader = malloc(sizeof(struct sysstat_reader));
+	if (!reader)
+		return -1;
+
+	reader->pos = 0;
+
+	vfs_set_priv(fd, reader);
+
+	return 0;
+}
+
+static int sysstat_close(int fd)
+{
+	free(vfs_get_priv(fd));
+
+	return 0;
+}
+
+/*
+ * Return the statistics of the syscalls which have been issued at least once,
+ * as many records as <count> bytes can hold, following the previous read.
+ * 0 is returned once all syscalls have been reported.
+ */
+static int sysstat_read(int fd, void *buffer, int count)
+{
+	struct sysstat_reader *reader = vfs_get_priv(fd);
+	struct sysstat_entry e, *out = buffer;
+	int nr, cpu, i, n = 0;
+
+	for (nr = reader->pos; (nr < NR_SYSCALLS) && ((n + 1) * sizeof(e) <= count); nr++) {
+		memset(&e, 0, sizeof(e));
+		e.nr = nr;
+
+		for (cpu = 0; cpu < CONFIG_NR_CPUS; cpu++) {
+			e.count += sysstat[cpu][nr].count;
+			e.total_ns += sysstat[cpu][nr].total_ns;
+			if (sysstat[cpu][nr].max_ns > e.max_ns)
+				e.max_ns = sysstat[cpu][nr].max_ns;
+
+			for (i = 0; i < SYSSTAT_HIST_BUCKETS; i++)
+				e.hist[i] += sysstat[cpu][nr].hist[i];
+		}
+
+		if (e.count)
+			out[n++] = e;
+	}
+
+	reader->pos = nr;
+
+	return n * sizeof(e);
+}
+
+static int sysstat_ioctl(int fd, unsigned long cmd, unsigned long args)
+{
+	switch (cmd) {
+
+	case SYSSTAT_IOCTL_RESET:
+		memset(sysstat, 0, sizeof(sysstat));
+		return 0;
+
+	default:
+		/* Unknown command. */
+		return -1;
+	}
+}
+
+struct file_operations sysstat_fops = {
+	.open = sysstat_open,
+	.close = sysstat_close,
+	.read = sysstat_read,
+	.ioctl = sysstat_ioctl
+};
+
+struct devclass sysstat_dev = {
+	.class = "sysstat",
+	.type = VFS_TYPE_DEV_CHAR,
+	.fops = &sysstat_fops,
+};
+
+static void sysstat_init(void)
+{
+	devclass_register(NULL, &sysstat_dev);
+}
+
+REGISTER_POSTINIT(sysstat_init);
@@ -29,6 +29,7 @@
 #include <errno.h>
 #include <smp.h>
 #include <timer.h>
+#include <trace.h>
 #include <percpu.h>
 #include <heap.h>
 
@@ -275,6 +276,9 @@ static void execute_timer(struct timers *ts, struct timer *t) {
 	ts->running = t;
 
 	spin_unlock(&ts->lock);
+
+	trace(TRACE_TIMER_EXPIRE, 0, (addr_t) fn);
+
 	(*fn)(data);
 	spin_lock(&ts->lock);
 
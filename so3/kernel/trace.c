@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Tracepoint buffers.
+ *
+ * Each CPU records its events in its own buffer, so that a tracepoint never
+ * contends on a lock. The buffers work as flight recorders: the oldest records
+ * are overwritten when a buffer is full.
+ *
+ * Tracing should be stopped (TRACE_IOCTL_ENABLE with 0) before /dev/trace is read,
+ * otherwise the records being overwritten meanwhile may be inconsistent.
+ */
+
+#include <common.h>
+#include <smp.h>
+#include <vfs.h>
+#include <trace.h>
+#include <initcall.h>
+
+#include <device/device.h>
+
+#include <asm/processor.h>
+#include <asm/arm_timer.h>
+
+#define TRACE_BUF_SIZE	(1 << CONFIG_TRACE_BUF_SHIFT)
+#define TRACE_BUF_MASK	(TRACE_BUF_SIZE - 1)
+
+struct trace_buf {
+	struct trace_record rec[TRACE_BUF_SIZE];
+
+	/* Number of records written so far */
+	unsigned long head;
+
+	/* Number of records already read from /dev/trace */
+	unsigned long tail;
+} __attribute__((aligned(64)));
+
+static struct trace_buf trace_bufs[CONFIG_NR_CPUS];
+
+unsigned long trace_mask;
+
+void __trace(unsigned int event, u32 a0, u64 a1)
+{
+	struct trace_buf *buf;
+	struct trace_record *rec;
+	unsigned long flags;
+
+	flags = local_irq_save();
+
+	buf = &trace_bufs[smp_processor_id()];
+	rec = &buf->rec[buf->head & TRACE_BUF_MASK];
+
+	rec->ts = arch_counter_get_cntvct();
+	rec->event = event;
+	rec->cpu = smp_processor_id();
+	rec->a0 = a0;
+	rec->a1 = a1;
+
+	buf->head++;
+
+	local_irq_restore(flags);
+}
+
+/*
+ * Return as many records as <count> bytes can hold, CPU after CPU.
+ * The records are not sorted by timestamp across CPUs.
+ */
+static int trace_read(int fd, void *buffer, int count)
+{
+	struct trace_record *out = buffer;
+	struct trace_buf *buf;
+	unsigned long head;
+	int cpu, n = 0;
+
+	for (cpu = 0; cpu < CONFIG_NR_CPUS; cpu++) {
+		buf = &trace_bufs[cpu];
+		head = READ_ONCE(buf->head);
+
+		/* Overwritten records are lost */
+		if (head - buf->tail > TRACE_BUF_SIZE)
+			buf->tail = head - TRACE_BUF_SIZE;
+
+		while ((buf->tail != head) && ((n + 1) * sizeof(struct trace_record) <= count))
+			out[n++] = buf->rec[buf->tail++ & TRACE_BUF_MASK];
+	}
+
+	return n * sizeof(struct trace_record);
+}
+
+static int trace_ioctl(int fd, unsigned long cmd, unsigned long args)
+{
+	int cpu;
+
+	switch (cmd) {
+
+	case TRACE_IOCTL_ENABLE:
+		WRITE_ONCE(trace_mask, args & ((1UL << NR_TRACE_EVENTS) - 1));
+		return 0;
+
+	case TRACE_IOCTL_RESET:
+		for (cpu = 0; cpu < CONFIG_NR_CPUS; cpu++)
+			trace_bufs[cpu].tail = READ_ONCE(trace_bufs[cpu].head);
+		return 0;
+
+	case TRACE_IOCTL_FREQ:
+		return arch_timer_get_cntfrq();
+
+	default:
+		/* Unknown command. */
+		return -1;
+	}
+}
+
+struct file_operations trace_fops = {
+	.read = trace_read,
+	.ioctl = trace_ioctl
+};
+
+struct devclass trace_dev = {
+	.class = "trace",
+	.type = VFS_TYPE_DEV_CHAR,
+	.fops = &trace_fops,
+};
+
+static void trace_init(void)
+{
+	devclass_register(NULL, &trace_dev);
+}
+
+REGISTER_POSTINIT(trace_init);
@@ -0,0 +1,322 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ *  LZO1X Decompressor from LZO
+ *
+ *  Copyright (C) 1996-2012 Markus F.X.J. Oberhumer <markus@oberhumer.com>
+ *
+ *  The full LZO package can be found at:
+ *  http://www.oberhumer.com/opensource/lzo/
+ *
+ *  Changed for Linux kernel use by:
+ *  Nitin Gupta <nitingupta910@gmail.com>
+ *  Richard Purdie <rpurdie@openedhand.com>
+ *
+ *  lzop container handling taken from U-boot.
+ */
+
+#include <compiler.h>
+#include <string.h>
+#include <lzo.h>
+
+#include "lzodefs.h"
+
+#define HAVE_IP(x)	((size_t) (ip_end - ip) >= (size_t) (x))
+#define HAVE_OP(x)	((size_t) (op_end - op) >= (size_t) (x))
+#define NEED_IP(x)	if (!HAVE_IP(x)) goto input_overrun
+#define NEED_OP(x)	if (!HAVE_OP(x)) goto output_overrun
+#define TEST_LB(m_pos)	if ((m_pos) < out) goto lookbehind_overrun
+
+/**
+ * Decompress a raw LZO1X stream. <out_len> gives the size of the output
+ * buffer on entry and is updated with the number of decompressed bytes.
+ */
+int lzo1x_decompress_safe(const unsigned char *in, size_t in_len,
+			  unsigned char *out, size_t *out_len)
+{
+	unsigned char *op;
+	const unsigned char *ip;
+	size_t t, next;
+	size_t state = 0;
+	const unsigned char *m_pos;
+	const unsigned char * const ip_end = in + in_len;
+	unsigned char * const op_end = out + *out_len;
+
+	op = out;
+	ip = in;
+
+	if (unlikely(in_len < 3))
+		goto input_overrun;
+
+	if (*ip > 17) {
+		t = *ip++ - 17;
+		if (t < 4) {
+			next = t;
+			goto match_next;
+		}
+		goto copy_literal_run;
+	}
+
+	for (;;) {
+		t = *ip++;
+		if (t < 16) {
+			if (likely(state == 0)) {
+				if (unlikely(t == 0)) {
+					while (unlikely(*ip == 0)) {
+						t += 255;
+						ip++;
+						NEED_IP(1);
+					}
+					t += 15 + *ip++;
+				}
+				t += 3;
+copy_literal_run:
+				NEED_OP(t);
+				NEED_IP(t + 3);
+				memcpy(op, ip, t);
+				op += t;
+				ip += t;
+				state = 4;
+				continue;
+			} else if (state != 4) {
+				next = t & 3;
+				m_pos = op - 1;
+				m_pos -= t >> 2;
+				m_pos -= *ip++ << 2;
+				TEST_LB(m_pos);
+				NEED_OP(2);
+				op[0] = m_pos[0];
+				op[1] = m_pos[1];
+				op += 2;
+				goto match_next;
+			} else {
+				next = t & 3;
+				m_pos = op - (1 + M2_MAX_OFFSET);
+				m_pos -= t >> 2;
+				m_pos -= *ip++ << 2;
+				t = 3;
+			}
+		} else if (t >= 64) {
+			next = t & 3;
+			m_pos = op - 1;
+			m_pos -= (t >> 2) & 7;
+			m_pos -= *ip++ << 3;
+			t = (t >> 5) - 1 + (3 - 1);
+		} else if (t >= 32) {
+			t = (t & 31) + (3 - 1);
+			if (unlikely(t == 2)) {
+				while (unlikely(*ip == 0)) {
+					t += 255;
+					ip++;
+					NEED_IP(1);
+				}
+				t += 31 + *ip++;
+				NEED_IP(2);
+			}
+			m_pos = op - 1;
+			next = lzo_get_le16(ip);
+			ip += 2;
+			m_pos -= next >> 2;
+			next &= 3;
+		} else {
+			m_pos = op;
+			m_pos -= (t & 8) << 11;
+			t = (t & 7) + (3 - 1);
+			if (unlikely(t == 2)) {
+				while (unlikely(*ip == 0)) {
+					t += 255;
+					ip++;
+					NEED_IP(1);
+				}
+				t += 7 + *ip++;
+				NEED_IP(2);
+			}
+			next = lzo_get_le16(ip);
+			ip += 2;
+			m_pos -= next >> 2;
+			next &= 3;
+			if (m_pos == op)
+				goto eof_found;
+			m_pos -= 0x4000;
+		}
+		TEST_LB(m_pos);
+		NEED_OP(t);
+
+		/* Overlapping copy, must be done byte per byte */
+		{
+			unsigned char *oe = op + t;
+
+			op[0] = m_pos[0];
+			op[1] = m_pos[1];
+			op += 2;
+			m_pos += 2;
+			do {
+				*op++ = *m_pos++;
+			} while (op < oe);
+		}
+match_next:
+		state = next;
+		t = next;
+		NEED_IP(t + 3);
+		NEED_OP(t);
+		while (t > 0) {
+			*op++ = *ip++;
+			t--;
+		}
+	}
+
+eof_found:
+	*out_len = op - out;
+	return (t != 3 ? LZO_E_ERROR :
+		ip == ip_end ? LZO_E_OK :
+		ip < ip_end ? LZO_E_INPUT_NOT_CONSUMED : LZO_E_INPUT_OVERRUN);
+
+input_overrun:
+	*out_len = op - out;
+	return LZO_E_INPUT_OVERRUN;
+
+output_overrun:
+	*out_len = op - out;
+	return LZO_E_OUTPUT_OVERRUN;
+
+lookbehind_overrun:
+	*out_len = op - out;
+	return LZO_E_LOOKBEHIND_OVERRUN;
+}
+
+/*
+ * lzop container format, as produced by the lzop tool (and used by
+ * mkimage for FIT components with compression = "lzo").
+ */
+
+static const unsigned char lzop_magic[] = {
+	0x89, 0x4c, 0x5a, 0x4f, 0x00, 0x0d, 0x0a, 0x1a, 0x0a
+};
+
+#define HEADER_HAS_FILTER	0x00000800L
+
+static const unsigned char *parse_header(const unsigned char *src)
+{
+	u16 version;
+	int i;
+
+	/* read magic: 9 first bytes */
+	for (i = 0; i < ARRAY_SIZE(lzop_magic); i++) {
+		if (*src++ != lzop_magic[i])
+			return NULL;
+	}
+
+	/*
+	 * get version (2 bytes), skip library version (2),
+	 * 'need to be extracted' version (2) and method (1)
+	 */
+	version = lzo_get_be16(src);
+	src += 7;
+	if (version >= 0x0940)
+		src++;
+	if (lzo_get_be32(src) & HEADER_HAS_FILTER)
+		src += 4; /* filter info */
+
+	/* skip flags, mode and mtime_low */
+	src += 12;
+	if (version >= 0x0940)
+		src += 4;	/* skip mtime_high */
+
+	i = *src++;
+
+	/* don't care about the file name, and skip checksum */
+	src += i + 4;
+
+	return src;
+}
+
+/**
+ * Decompress a lzop file image. <dst_len> gives the size of the output
+ * buffer on entry and is updated with the number of decompressed bytes.
+ */
+int lzop_decompress(const unsigned char *src, size_t src_len,
+		    unsigned char *dst, size_t *dst_len)
+{
+	unsigned char *start = dst;
+	const unsigned char *send = src + src_len;
+	u32 slen, dlen;
+	size_t tmp, remaining;
+	int r;
+
+	src = parse_header(src);
+	if (!src)
+		return LZO_E_ERROR;
+
+	remaining = *dst_len;
+	while (src < send) {
+		/* read uncompressed block size */
+		dlen = lzo_get_be32(src);
+		src += 4;
+
+		/* exit if last block */
+		if (dlen == 0) {
+			*dst_len = dst - start;
+			return LZO_E_OK;
+		}
+
+		/* read compressed block size, and skip block checksum info */
+		slen = lzo_get_be32(src);
+		src += 8;
+
+		if (slen == 0 || slen > dlen)
+			return LZO_E_ERROR;
+
+		/* abort if buffer ran out of room */
+		if (dlen > remaining)
+			return LZO_E_OUTPUT_OVERRUN;
+
+		/* Uncompressed blocks are stored as is */
+		if (dlen == slen) {
+			memcpy(dst, src, slen);
+		} else {
+			tmp = dlen;
+			r = lzo1x_decompress_safe(src, slen, dst, &tmp);
+
+			if (r != LZO_E_OK) {
+				*dst_len = dst - start;
+				return r;
+			}
+
+			if (dlen != tmp)
+				return LZO_E_ERROR;
+		}
+
+		src += slen;
+		dst += dlen;
+		remaining -= dlen;
+	}
+
+	return LZO_E_INPUT_OVERRUN;
+}
+
+/**
+ * Get the size of a lzop file image once uncompressed by walking the block
+ * headers, without decompressing anything.
+ */
+size_t lzop_uncompressed_size(const unsigned char *src, size_t src_len)
+{
+	const unsigned char *send = src + src_len;
+	size_t size = 0;
+	u32 slen, dlen;
+
+	src = parse_header(src);
+	if (!src)
+		return 0;
+
+	while (src + 12 <= send) {
+		dlen = lzo_get_be32(src);
+		if (dlen == 0)
+			return size;
+
+		slen = lzo_get_be32(src + 4);
+		src += 12 + slen;
+
+		size += dlen;
+	}
+
+	return 0;
+}
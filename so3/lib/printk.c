@@ -21,9 +21,43 @@
 #include <stdarg.h>
 #include <process.h>
 #include <vfs.h>
+#include <smp.h>
 
 #include <device/serial.h>
 
+#ifdef CONFIG_PRINTK_RING
+
+/*
+ * Standard version of printk to be used.
+ * The message goes to the log ring and the console outputs it asynchronously.
+ */
+void printk(const char *fmt, ...)
+{
+	static char   buf[CONFIG_NR_CPUS][1024];
+
+	va_list       args;
+	unsigned long flags;
+	int           len;
+
+	/* The buffer of the CPU is used until the message is stored */
+	flags = local_irq_save();
+
+	va_start(args, fmt);
+	len = vsnprintf(buf[smp_processor_id()], sizeof(buf[0]), fmt, args);
+	va_end(args);
+
+	if (len > sizeof(buf[0]) - 1)
+		len = sizeof(buf[0]) - 1;
+
+	log_store(buf[smp_processor_id()], len);
+
+	local_irq_restore(flags);
+
+	console_flush();
+}
+
+#else /* CONFIG_PRINTK_RING */
+
 /*
  * Standard version of printk to be used.
  */
@@ -55,3 +89,4 @@ void printk(const char *fmt, ...)
 
 }
 
+#endif /* !CONFIG_PRINTK_RING */
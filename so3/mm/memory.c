@@ -25,6 +25,7 @@
 #include <process.h>
 #include <heap.h>
 #include <bitmap.h>
+#include <trace.h>
 
 #include <device/ramdev.h>
 #include <device/fdt.h>
@@ -89,6 +90,8 @@ addr_t get_free_page(void) {
 
 			spin_unlock(&ft_lock);
 
+			trace(TRACE_PAGE_ALLOC, 1, page_to_phys(&frame_table[__next_free_page]));
+
 			/* Found an available page */
 			return page_to_phys(&frame_table[__next_free_page]);
 		}
@@ -124,6 +127,8 @@ addr_t get_free_vpage(void) {
 void free_page(addr_t paddr) {
 	page_t *page;
 
+	trace(TRACE_PAGE_FREE, 1, paddr);
+
 	spin_lock(&ft_lock);
 
 	page = (page_t *) phys_to_page(paddr);
@@ -132,6 +137,58 @@ void free_page(addr_t paddr) {
 	spin_unlock(&ft_lock);
 }
 
+/* The reference counters of the frames are updated by all the processes
+ * sharing a frame, and by the network stack (zero-copy send). */
+static DEFINE_SPINLOCK(page_ref_lock);
+
+/*
+ * Take a reference on a frame.
+ */
+void get_page(page_t *page) {
+	unsigned long flags;
+
+	flags = spin_lock_irqsave(&page_ref_lock);
+	page->refcount++;
+	spin_unlock_irqrestore(&page_ref_lock, flags);
+}
+
+/*
+ * Take a reference on a frame only if it is already referenced, i.e. owned
+ * by a process or a shared memory object. The other frames (kernel, drivers)
+ * are not released along with a process.
+ *
+ * @return	true if the reference has been taken
+ */
+bool get_page_unless_zero(page_t *page) {
+	unsigned long flags;
+	bool ret;
+
+	flags = spin_lock_irqsave(&page_ref_lock);
+
+	ret = (page->refcount != 0);
+	if (ret)
+		page->refcount++;
+
+	spin_unlock_irqrestore(&page_ref_lock, flags);
+
+	return ret;
+}
+
+/*
+ * Drop a reference on a frame, which is freed along with the last one.
+ */
+void put_page(page_t *page) {
+	unsigned long flags;
+	bool last;
+
+	flags = spin_lock_irqsave(&page_ref_lock);
+	last = !--page->refcount;
+	spin_unlock_irqrestore(&page_ref_lock, flags);
+
+	if (last)
+		free_page(page_to_phys(page));
+}
+
 void free_vpage(addr_t vaddr) {
 	addr_t paddr;
 
@@ -159,6 +216,8 @@ addr_t get_contig_free_pages(uint32_t nrpages) {
 
 				spin_unlock(&ft_lock);
 
+				trace(TRACE_PAGE_ALLOC, nrpages, page_to_phys(&frame_table[base]));
+
 				/* Returns the block base */
 				return page_to_phys(&frame_table[base]);
 			}
@@ -191,6 +250,8 @@ void free_contig_pages(addr_t paddr, uint32_t nrpages) {
 	uint32_t i;
 	page_t *page;
 
+	trace(TRACE_PAGE_FREE, nrpages, paddr);
+
 	spin_lock(&ft_lock);
 
 	page = (page_t *) phys_to_page(paddr);
@@ -0,0 +1,366 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+#include <common.h>
+#include <memory.h>
+#include <heap.h>
+#include <errno.h>
+#include <string.h>
+#include <spinlock.h>
+#include <process.h>
+#include <vfs.h>
+#include <shm.h>
+
+/* Named objects (shm_open) */
+static LIST_HEAD(shm_list);
+
+/* Protects the list, the reference counters and the frames of all objects.
+ * The close() callback is invoked with the vfs lock held, hence a spinlock.
+ */
+static DEFINE_SPINLOCK(shm_lock);
+
+/*
+ * Drop the reference of the object on a frame.
+ */
+static void shm_release_frame(addr_t frame) {
+	put_page(phys_to_page(frame));
+}
+
+/*
+ * Create an object of @nr_pages pages with one reference.
+ */
+shm_object_t *shm_create(unsigned long nr_pages) {
+	shm_object_t *shm;
+
+	shm = malloc(sizeof(shm_object_t));
+	if (!shm) {
+		set_errno(ENOMEM);
+		return NULL;
+	}
+	memset(shm, 0, sizeof(shm_object_t));
+
+	INIT_LIST_HEAD(&shm->list);
+
+	if (nr_pages) {
+		shm->frames = calloc(nr_pages, sizeof(addr_t));
+		if (!shm->frames) {
+			free(shm);
+			set_errno(ENOMEM);
+			return NULL;
+		}
+	}
+
+	shm->nr_pages = nr_pages;
+	shm->refcount = 1;
+
+	return shm;
+}
+
+void shm_get(shm_object_t *shm) {
+	unsigned long flags;
+
+	flags = spin_lock_irqsave(&shm_lock);
+	shm->refcount++;
+	spin_unlock_irqrestore(&shm_lock, flags);
+}
+
+/*
+ * Release a reference; the frames are given back with the last one
+ * (the processes still mapping them have their own reference).
+ */
+void shm_put(shm_object_t *shm) {
+	unsigned long flags, i;
+
+	flags = spin_lock_irqsave(&shm_lock);
+
+	BUG_ON(shm->refcount <= 0);
+
+	if (--shm->refcount) {
+		spin_unlock_irqrestore(&shm_lock, flags);
+		return ;
+	}
+
+	for (i = 0; i < shm->nr_pages; i++)
+		if (shm->frames[i])
+			shm_release_frame(shm->frames[i]);
+
+	spin_unlock_irqrestore(&shm_lock, flags);
+
+	if (shm->frames)
+		free(shm->frames);
+
+	free(shm);
+}
+
+/**
+ * Get the frame backing the page @pgoff of the object. The frame is
+ * allocated and zeroed on first access.
+ *
+ * @return	the physical address of the frame, 0 if @pgoff is beyond the object
+ */
+addr_t shm_get_frame(shm_object_t *shm, unsigned long pgoff) {
+	unsigned long flags;
+	addr_t frame = 0;
+
+	flags = spin_lock_irqsave(&shm_lock);
+
+	if (pgoff >= shm->nr_pages)
+		goto out;
+
+	if (!shm->frames[pgoff]) {
+		frame = get_free_page();
+		if (!frame) {
+			printk("%s: no free page\n", __func__);
+			kernel_panic();
+		}
+
+		memset((void *) __va(frame), 0, PAGE_SIZE);
+
+		/* Reference held by the object */
+		get_page(phys_to_page(frame));
+
+		shm->frames[pgoff] = frame;
+	}
+
+	frame = shm->frames[pgoff];
+
+out:
+	spin_unlock_irqrestore(&shm_lock, flags);
+
+	return frame;
+}
+
+/*
+ * Change the size of an object. The frames beyond the new size are released
+ * by the object; they stay allocated as long as a process maps them.
+ */
+static int shm_resize(shm_object_t *shm, unsigned long nr_pages) {
+	unsigned long flags, i;
+	addr_t *frames, *old = NULL;
+
+	frames = (nr_pages ? calloc(nr_pages, sizeof(addr_t)) : NULL);
+	if (nr_pages && !frames) {
+		set_errno(ENOMEM);
+		return -1;
+	}
+
+	flags = spin_lock_irqsave(&shm_lock);
+
+	for (i = 0; i < shm->nr_pages; i++) {
+		if (i < nr_pages)
+			frames[i] = shm->frames[i];
+		else if (shm->frames[i])
+			shm_release_frame(shm->frames[i]);
+	}
+
+	old = shm->frames;
+	shm->frames = frames;
+	shm->nr_pages = nr_pages;
+
+	spin_unlock_irqrestore(&shm_lock, flags);
+
+	if (old)
+		free(old);
+
+	return 0;
+}
+
+/*
+ * Get the object referred by a (local) file descriptor, if any.
+ */
+shm_object_t *shm_from_fd(int fd) {
+	int gfd;
+
+	if ((fd < 0) || (fd >= FD_MAX))
+		return NULL;
+
+	gfd = vfs_get_gfd(fd);
+	if ((gfd < 0) || (vfs_get_type(gfd) != VFS_TYPE_SHM))
+		return NULL;
+
+	return (shm_object_t *) vfs_get_priv(gfd);
+}
+
+/*
+ * The last fd referring to the object is closed.
+ */
+static int shm_close(int gfd) {
+	shm_put((shm_object_t *) vfs_get_priv(gfd));
+
+	return 0;
+}
+
+static struct file_operations shm_fops = {
+	.close = shm_close
+};
+
+static shm_object_t *shm_lookup(const char *name) {
+	shm_object_t *shm;
+
+	list_for_each_entry(shm, &shm_list, list)
+		if (!strcmp(shm->name, name))
+			return shm;
+
+	return NULL;
+}
+
+/*
+ * Check a name as given to shm_open()/shm_unlink() and skip the leading slashes.
+ */
+static const char *shm_name(const char *name) {
+
+	if (!name) {
+		set_errno(EINVAL);
+		return NULL;
+	}
+
+	while (*name == '/')
+		name++;
+
+	if (!*name || strchr(name, '/')) {
+		set_errno(EINVAL);
+		return NULL;
+	}
+
+	if (strlen(name) >= SHM_NAME_MAX) {
+		set_errno(ENAMETOOLONG);
+		return NULL;
+	}
+
+	return name;
+}
+
+/**
+ * Open (or create) a named shared memory object. A new object is empty,
+ * its size is set with ftruncate().
+ *
+ * @return	a file descriptor which can be given to mmap(), -1 on error
+ */
+int do_shm_open(const char *name, int oflag, int mode) {
+	shm_object_t *shm, *new = NULL;
+	unsigned long flags;
+	int fd;
+
+	name = shm_name(name);
+	if (!name)
+		return -1;
+
+	/* Prepare the object outside the lock in case it does not exist */
+	if (oflag & O_CREAT) {
+		new = shm_create(0);
+		if (!new)
+			return -1;
+
+		strcpy(new->name, name);
+	}
+
+	flags = spin_lock_irqsave(&shm_lock);
+
+	shm = shm_lookup(name);
+
+	if (shm && (oflag & O_CREAT) && (oflag & O_EXCL)) {
+		spin_unlock_irqrestore(&shm_lock, flags);
+		set_errno(EEXIST);
+		goto err;
+	}
+
+	if (!shm) {
+		if (!new) {
+			spin_unlock_irqrestore(&shm_lock, flags);
+			set_errno(ENOENT);
+			return -1;
+		}
+
+		/* The name keeps the initial reference of the object */
+		list_add_tail(&new->list, &shm_list);
+		shm = new;
+		new = NULL;
+	}
+
+	/* Reference of the file descriptor */
+	shm->refcount++;
+
+	spin_unlock_irqrestore(&shm_lock, flags);
+
+	if (new)
+		shm_put(new);
+
+	if ((oflag & O_TRUNC) && ((oflag & O_ACCMODE) != O_RDONLY))
+		shm_resize(shm, 0);
+
+	fd = vfs_open(shm->name, &shm_fops, VFS_TYPE_SHM);
+	if (fd < 0) {
+		shm_put(shm);
+		return -1;
+	}
+
+	vfs_set_priv(vfs_get_gfd(fd), shm);
+	vfs_set_access_mode(vfs_get_gfd(fd), oflag & O_ACCMODE);
+
+	return fd;
+
+err:
+	shm_put(new);
+
+	return -1;
+}
+
+/*
+ * Remove the name of an object. It disappears when it is no longer open nor mapped.
+ */
+int do_shm_unlink(const char *name) {
+	shm_object_t *shm;
+	unsigned long flags;
+
+	name = shm_name(name);
+	if (!name)
+		return -1;
+
+	flags = spin_lock_irqsave(&shm_lock);
+
+	shm = shm_lookup(name);
+	if (!shm) {
+		spin_unlock_irqrestore(&shm_lock, flags);
+		set_errno(ENOENT);
+		return -1;
+	}
+
+	list_del_init(&shm->list);
+
+	spin_unlock_irqrestore(&shm_lock, flags);
+
+	/* Reference of the name */
+	shm_put(shm);
+
+	return 0;
+}
+
+/*
+ * Set the size of a shared memory object. Regular files cannot be truncated.
+ */
+int do_ftruncate(int fd, off_t length) {
+	shm_object_t *shm;
+
+	shm = shm_from_fd(fd);
+	if (!shm || (length < 0)) {
+		set_errno(EINVAL);
+		return -1;
+	}
+
+	return shm_resize(shm, ALIGN_UP(length, PAGE_SIZE) >> PAGE_SHIFT);
+}
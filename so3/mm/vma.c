@@ -0,0 +1,597 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Memory areas of user processes created with mmap().
+ *
+ * The areas are placed top-down between the end of the heap reservation
+ * and the bottom of the stacks. Anonymous private areas are populated with
+ * zeroed frames on first access. Shared areas are backed by a shm object,
+ * so that the same frames are found by all processes mapping it, including
+ * the children after a fork(). Device areas (e.g. framebuffer) are mapped
+ * by the driver when they are created.
+ */
+
+#include <common.h>
+#include <memory.h>
+#include <heap.h>
+#include <sizes.h>
+#include <errno.h>
+#include <string.h>
+#include <process.h>
+#include <vfs.h>
+#include <vma.h>
+#include <shm.h>
+
+#include <asm/mmu.h>
+
+/* Lowest address of the mmap area, above the heap reservation and a guard page */
+static addr_t vma_area_base(pcb_t *pcb) {
+	return ALIGN_UP(pcb->heap_base + HEAP_SIZE, PAGE_SIZE) + PAGE_SIZE;
+}
+
+/* Top of the mmap area, under the stacks of all threads and a guard page */
+static addr_t vma_area_top(pcb_t *pcb) {
+	return pcb->stack_top - PROC_STACK_SIZE - PAGE_SIZE;
+}
+
+static vma_t *vma_alloc(void) {
+	vma_t *vma;
+
+	vma = malloc(sizeof(vma_t));
+	if (vma)
+		memset(vma, 0, sizeof(vma_t));
+
+	return vma;
+}
+
+static void vma_free(vma_t *vma) {
+	if (vma->shm)
+		shm_put(vma->shm);
+
+	free(vma);
+}
+
+/**
+ * Find the area containing @addr.
+ * The caller must hold pcb->mm_lock.
+ */
+vma_t *vma_find(pcb_t *pcb, addr_t addr) {
+	vma_t *vma;
+
+	vma = pcb->vma_cache;
+	if (vma && (addr >= vma->start) && (addr < vma->end))
+		return vma;
+
+	list_for_each_entry(vma, &pcb->vmas, list) {
+		if (addr < vma->start)
+			break;
+
+		if (addr < vma->end) {
+			pcb->vma_cache = vma;
+			return vma;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Check that no area overlaps [start, end[.
+ */
+static bool vma_range_free(pcb_t *pcb, addr_t start, addr_t end) {
+	vma_t *vma;
+
+	list_for_each_entry(vma, &pcb->vmas, list)
+		if ((vma->start < end) && (vma->end > start))
+			return false;
+
+	return true;
+}
+
+/*
+ * Find a free range of @len bytes, as high as possible in the mmap area.
+ * Large areas are aligned so that they can be mapped with 2 MB blocks or
+ * contiguous PTEs (64 KB).
+ *
+ * @return	the start address, 0 if there is no room
+ */
+static addr_t vma_get_unmapped_area(pcb_t *pcb, size_t len) {
+	addr_t base = vma_area_base(pcb);
+	addr_t end = vma_area_top(pcb);
+	addr_t align, addr;
+	vma_t *vma;
+
+	if (len >= SZ_2M)
+		align = SZ_2M;
+	else if (len >= SZ_64K)
+		align = SZ_64K;
+	else
+		align = PAGE_SIZE;
+
+	list_for_each_entry_reverse(vma, &pcb->vmas, list) {
+		if ((vma->end <= end) && (end - vma->end >= len)) {
+			addr = ALIGN_DOWN(end - len, align);
+			if (addr >= vma->end)
+				return addr;
+		}
+
+		if (vma->start < end)
+			end = vma->start;
+	}
+
+	if ((end > base) && (end - base >= len)) {
+		addr = ALIGN_DOWN(end - len, align);
+		if (addr >= base)
+			return addr;
+	}
+
+	return 0;
+}
+
+/*
+ * Insert an area in the list sorted by address.
+ */
+static void vma_insert(pcb_t *pcb, vma_t *new) {
+	vma_t *vma;
+
+	list_for_each_entry(vma, &pcb->vmas, list) {
+		if (vma->start > new->start) {
+			list_add_tail(&new->list, &vma->list);
+			return ;
+		}
+	}
+
+	list_add_tail(&new->list, &pcb->vmas);
+}
+
+/*
+ * Split the area containing @addr so that an area starts at @addr.
+ * @spare is used for the upper part and set to NULL if consumed.
+ */
+static void vma_split(pcb_t *pcb, addr_t addr, vma_t **spare) {
+	vma_t *vma, *new;
+
+	vma = vma_find(pcb, addr);
+	if (!vma || (vma->start == addr))
+		return ;
+
+	new = *spare;
+	*spare = NULL;
+
+	BUG_ON(!new);
+
+	*new = *vma;
+
+	new->start = addr;
+	new->pgoff = vma->pgoff + ((addr - vma->start) >> PAGE_SHIFT);
+	vma->end = addr;
+
+	if (new->shm)
+		shm_get(new->shm);
+
+	list_add(&new->list, &vma->list);
+}
+
+/*
+ * Update the access permissions of the pages of an area which are populated.
+ */
+static void vma_update_prot(pcb_t *pcb, vma_t *vma) {
+	addr_t vaddr;
+
+	for (vaddr = vma->start; vaddr < vma->end; vaddr += PAGE_SIZE)
+		if (user_page_mapped(pcb->pgtable, vaddr))
+			set_user_page_prot(pcb->pgtable, vaddr, vma->flags & VMA_PROT_MASK,
+					   vma->flags & VMA_WRITE, vma->flags & VMA_EXEC);
+}
+
+/*
+ * Unmap the pages of [start, end[ within an area and drop the references on their frames.
+ */
+static void vma_unmap_pages(pcb_t *pcb, vma_t *vma, addr_t start, addr_t end) {
+	addr_t vaddr, paddr;
+
+	for (vaddr = start; vaddr < end; vaddr += PAGE_SIZE) {
+		paddr = release_user_page(pcb->pgtable, vaddr);
+
+		if (paddr && !(vma->flags & VMA_IO))
+			remove_page_from_proc(pcb, vaddr);
+	}
+}
+
+/**
+ * Populate the page at @vaddr of an area upon a translation fault.
+ * The caller must hold pcb->mm_lock.
+ *
+ * @return	0 if the page has been populated, -1 if there is no accessible area
+ */
+int vma_fault(pcb_t *pcb, addr_t vaddr) {
+	vma_t *vma;
+	addr_t frame;
+
+	vaddr &= PAGE_MASK;
+
+	vma = vma_find(pcb, vaddr);
+
+	if (!vma || !(vma->flags & VMA_PROT_MASK) || (vma->flags & VMA_IO))
+		return -1;
+
+	if (vma->shm) {
+		frame = shm_get_frame(vma->shm, vma->pgoff + ((vaddr - vma->start) >> PAGE_SHIFT));
+
+		/* Beyond the end of the object */
+		if (!frame)
+			return -1;
+	} else {
+		frame = get_free_page();
+		if (!frame) {
+			printk("%s: no free page for pid %d\n", __func__, pcb->pid);
+			kernel_panic();
+		}
+
+		memset((void *) __va(frame), 0, PAGE_SIZE);
+	}
+
+	create_mapping(pcb->pgtable, vaddr, frame, PAGE_SIZE, false);
+
+	set_user_page_prot(pcb->pgtable, vaddr, true, vma->flags & VMA_WRITE, vma->flags & VMA_EXEC);
+
+	add_page_to_proc(pcb, vaddr, phys_to_page(frame));
+
+	return 0;
+}
+
+/**
+ * Copy the areas of a process being fork'd. The shared areas keep
+ * their object; the frames are handled by duplicate_user_space().
+ */
+void vma_clone(pcb_t *from, pcb_t *to) {
+	vma_t *vma, *new;
+
+	list_for_each_entry(vma, &from->vmas, list) {
+		new = vma_alloc();
+		if (!new) {
+			printk("%s: failed to allocate memory\n", __func__);
+			kernel_panic();
+		}
+
+		*new = *vma;
+
+		if (new->shm)
+			shm_get(new->shm);
+
+		list_add_tail(&new->list, &to->vmas);
+	}
+}
+
+/**
+ * Remove all areas of a process (exec or exit). The frames are released
+ * with the other pages of the process.
+ */
+void vma_release_all(pcb_t *pcb) {
+	vma_t *vma, *tmp;
+
+	list_for_each_entry_safe(vma, tmp, &pcb->vmas, list) {
+		list_del(&vma->list);
+		vma_free(vma);
+	}
+
+	pcb->vma_cache = NULL;
+}
+
+/*
+ * Remove [start, end[ from the address space, the lock being held.
+ * Two spare areas must be provided in case of split.
+ */
+static void __vma_unmap(pcb_t *pcb, addr_t start, addr_t end, vma_t **spare) {
+	vma_t *vma, *tmp;
+
+	vma_split(pcb, start, &spare[0]);
+	vma_split(pcb, end, &spare[1]);
+
+	list_for_each_entry_safe(vma, tmp, &pcb->vmas, list) {
+		if (vma->start >= end)
+			break;
+
+		if (vma->end <= start)
+			continue;
+
+		vma_unmap_pages(pcb, vma, vma->start, vma->end);
+
+		list_del(&vma->list);
+		vma_free(vma);
+	}
+
+	pcb->vma_cache = NULL;
+}
+
+/*
+ * Devices which may only be mapped read-only: the zero-copy receive pool
+ * mapped on a socket holds the frames of all the sockets.
+ */
+static bool vma_read_only_dev(int fd) {
+	int gfd = vfs_get_gfd(fd);
+
+	return ((gfd >= 0) && (vfs_get_type(gfd) == VFS_TYPE_DEV_SOCK));
+}
+
+/**
+ * Create a new mapping in the address space of the current process.
+ *
+ * @param start		Address hint, or the exact address with MAP_FIXED
+ * @param length	Size of the mapping
+ * @param prot		PROT_* access permissions
+ * @param flags		MAP_SHARED or MAP_PRIVATE, and MAP_ANONYMOUS or MAP_FIXED
+ * @param fd		shm object or device to be mapped (not used with MAP_ANONYMOUS)
+ * @param offset	Offset in the object, page aligned
+ * @return		the address of the mapping, MAP_FAILED on error
+ */
+void *do_mmap(addr_t start, size_t length, int prot, int flags, int fd, off_t offset) {
+	pcb_t *pcb = current()->pcb;
+	vma_t *vma, *spare[2] = { NULL, NULL };
+	shm_object_t *shm = NULL;
+	unsigned long lflags;
+	size_t len;
+	addr_t addr;
+
+	if (!length || (offset & ~PAGE_MASK)) {
+		set_errno(EINVAL);
+		return MAP_FAILED;
+	}
+
+	len = ALIGN_UP(length, PAGE_SIZE);
+
+	vma = vma_alloc();
+	if (!vma) {
+		set_errno(ENOMEM);
+		return MAP_FAILED;
+	}
+
+	vma->flags = prot & VMA_PROT_MASK;
+
+	if (flags & MAP_ANONYMOUS) {
+
+		if (!(flags & (MAP_SHARED | MAP_PRIVATE))) {
+			set_errno(EINVAL);
+			goto err;
+		}
+
+		if (flags & MAP_SHARED) {
+			shm = shm_create(len >> PAGE_SHIFT);
+			if (!shm)
+				goto err;
+
+			vma->flags |= VMA_SHARED;
+		}
+
+	} else {
+
+		shm = shm_from_fd(fd);
+
+		if (shm) {
+			/* A private copy of a shm object is not supported */
+			if (!(flags & MAP_SHARED)) {
+				shm = NULL;
+				set_errno(EINVAL);
+				goto err;
+			}
+
+			/* The object may only be written through a descriptor opened for writing */
+			if (vfs_get_access_mode(vfs_get_gfd(fd)) == O_RDONLY) {
+				if (prot & PROT_WRITE) {
+					shm = NULL;
+					set_errno(EACCES);
+					goto err;
+				}
+
+				vma->flags |= VMA_NOWRITE;
+			}
+
+			shm_get(shm);
+			vma->pgoff = offset >> PAGE_SHIFT;
+			vma->flags |= VMA_SHARED;
+		} else {
+			/* Device memory is always shared */
+			vma->flags |= VMA_SHARED | VMA_IO;
+
+			/* The zero-copy receive window of a socket only shows the buffers held by
+			 * the process; they are mapped and unmapped by the socket layer. */
+			if (vma_read_only_dev(fd)) {
+				if (prot & (PROT_WRITE | PROT_EXEC)) {
+					set_errno(EACCES);
+					goto err;
+				}
+
+				vma->flags |= VMA_DONTCOPY;
+			}
+		}
+	}
+
+	vma->shm = shm;
+
+	if (flags & MAP_FIXED) {
+		if ((start & ~PAGE_MASK) || (start < vma_area_base(pcb)) || (start + len > vma_area_top(pcb))) {
+			set_errno(EINVAL);
+			goto err;
+		}
+
+		spare[0] = vma_alloc();
+		spare[1] = vma_alloc();
+		if (!spare[0] || !spare[1]) {
+			set_errno(ENOMEM);
+			goto err;
+		}
+	}
+
+	lflags = spin_lock_irqsave(&pcb->mm_lock);
+
+	if (flags & MAP_FIXED) {
+		/* The previous mappings of the range are replaced */
+		__vma_unmap(pcb, start, start + len, spare);
+		addr = start;
+
+	} else if (start && !(start & ~PAGE_MASK) && (start >= vma_area_base(pcb)) &&
+		   (start + len <= vma_area_top(pcb)) && vma_range_free(pcb, start, start + len)) {
+		/* The hint can be honoured */
+		addr = start;
+
+	} else {
+		addr = vma_get_unmapped_area(pcb, len);
+		if (!addr) {
+			spin_unlock_irqrestore(&pcb->mm_lock, lflags);
+			set_errno(ENOMEM);
+			goto err;
+		}
+	}
+
+	vma->start = addr;
+	vma->end = addr + len;
+
+	vma_insert(pcb, vma);
+
+	spin_unlock_irqrestore(&pcb->mm_lock, lflags);
+
+	if (spare[0])
+		free(spare[0]);
+	if (spare[1])
+		free(spare[1]);
+
+	/* The driver maps its memory by itself */
+	if ((vma->flags & VMA_IO) && !vfs_mmap(fd, addr, len >> PAGE_SHIFT)) {
+		do_munmap(addr, len);
+		return MAP_FAILED;
+	}
+
+	return (void *) addr;
+
+err:
+	if (spare[0])
+		free(spare[0]);
+	if (spare[1])
+		free(spare[1]);
+
+	vma_free(vma);
+
+	return MAP_FAILED;
+}
+
+/**
+ * Remove the mappings of [start, start + length[. The frames are released
+ * when they are no longer referenced.
+ */
+int do_munmap(addr_t start, size_t length) {
+	pcb_t *pcb = current()->pcb;
+	vma_t *spare[2];
+	unsigned long flags;
+
+	if (!length || (start & ~PAGE_MASK)) {
+		set_errno(EINVAL);
+		return -1;
+	}
+
+	spare[0] = vma_alloc();
+	spare[1] = vma_alloc();
+	if (!spare[0] || !spare[1]) {
+		if (spare[0])
+			free(spare[0]);
+
+		set_errno(ENOMEM);
+		return -1;
+	}
+
+	flags = spin_lock_irqsave(&pcb->mm_lock);
+
+	__vma_unmap(pcb, start, start + ALIGN_UP(length, PAGE_SIZE), spare);
+
+	spin_unlock_irqrestore(&pcb->mm_lock, flags);
+
+	if (spare[0])
+		free(spare[0]);
+	if (spare[1])
+		free(spare[1]);
+
+	return 0;
+}
+
+/**
+ * Change the access permissions of the mappings of [start, start + length[.
+ * The whole range must be mapped.
+ */
+int do_mprotect(addr_t start, size_t length, int prot) {
+	pcb_t *pcb = current()->pcb;
+	vma_t *vma, *spare[2];
+	unsigned long flags;
+	addr_t end, addr;
+
+	if (start & ~PAGE_MASK) {
+		set_errno(EINVAL);
+		return -1;
+	}
+
+	end = start + ALIGN_UP(length, PAGE_SIZE);
+
+	spare[0] = vma_alloc();
+	spare[1] = vma_alloc();
+	if (!spare[0] || !spare[1]) {
+		if (spare[0])
+			free(spare[0]);
+
+		set_errno(ENOMEM);
+		return -1;
+	}
+
+	flags = spin_lock_irqsave(&pcb->mm_lock);
+
+	/*
+	 * Check that there is no hole in the range, that no device mapping gets more rights
+	 * and that an object opened read-only does not become writable.
+	 */
+	for (addr = start; addr < end; addr = vma->end) {
+		vma = vma_find(pcb, addr);
+		if (!vma || ((vma->flags & VMA_IO) && (prot & VMA_PROT_MASK & ~vma->flags)) ||
+		    ((vma->flags & VMA_NOWRITE) && (prot & PROT_WRITE))) {
+			spin_unlock_irqrestore(&pcb->mm_lock, flags);
+
+			free(spare[0]);
+			free(spare[1]);
+
+			set_errno(vma ? EACCES : ENOMEM);
+			return -1;
+		}
+	}
+
+	vma_split(pcb, start, &spare[0]);
+	vma_split(pcb, end, &spare[1]);
+
+	for (addr = start; addr < end; addr = vma->end) {
+		vma = vma_find(pcb, addr);
+
+		vma->flags = (vma->flags & ~VMA_PROT_MASK) | (prot & VMA_PROT_MASK);
+
+		vma_update_prot(pcb, vma);
+	}
+
+	spin_unlock_irqrestore(&pcb->mm_lock, flags);
+
+	if (spare[0])
+		free(spare[0]);
+	if (spare[1])
+		free(spare[1]);
+
+	return 0;
+}
@@ -53,6 +53,7 @@
 #include "lwip/pbuf.h"
 #include "lwip/netif.h"
 #include "lwip/priv/tcpip_priv.h"
+#include "lwip/priv/api_msg.h"
 #include "lwip/mld6.h"
 #if LWIP_CHECKSUM_ON_COPY
 #include "lwip/inet_chksum.h"
@@ -1315,6 +1316,63 @@ lwip_recv(int s, void *mem, size_t len, int flags)
   return lwip_recvfrom(s, mem, len, flags, NULL, NULL);
 }
 
+#if LWIP_TCP
+/**
+ * SO3: take the next received pbuf chain of a TCP socket without copying it
+ * (zero-copy receive). The caller owns the chain and must free it.
+ * The receive window is updated right away.
+ *
+ * @return the length of the chain, 0 at the end of the stream, -1 on error
+ */
+ssize_t
+lwip_recv_pbuf(int s, struct pbuf **p, int flags)
+{
+  struct lwip_sock *sock;
+  u8_t apiflags = NETCONN_NOAUTORCVD;
+  ssize_t len;
+  err_t err;
+
+  sock = get_socket(s);
+  if (!sock) {
+    return -1;
+  }
+
+  if (NETCONNTYPE_GROUP(netconn_type(sock->conn)) != NETCONN_TCP) {
+    done_socket(sock);
+    set_errno(EOPNOTSUPP);
+    return -1;
+  }
+
+  if (flags & MSG_DONTWAIT) {
+    apiflags |= NETCONN_DONTBLOCK;
+  }
+
+  /* Data left by a previous recv() comes first */
+  if (sock->lastdata.pbuf) {
+    *p = sock->lastdata.pbuf;
+    sock->lastdata.pbuf = NULL;
+  } else {
+    err = netconn_recv_tcp_pbuf_flags(sock->conn, p, apiflags);
+    if (err != ERR_OK) {
+      done_socket(sock);
+      if (err == ERR_CLSD) {
+        set_errno(0);
+        return 0;
+      }
+      set_errno(err_to_errno(err));
+      return -1;
+    }
+  }
+
+  len = (*p)->tot_len;
+  netconn_tcp_recvd(sock->conn, (size_t)len);
+
+  done_socket(sock);
+  set_errno(0);
+  return len;
+}
+#endif /* LWIP_TCP */
+
 ssize_t
 lwip_recvmsg(int s, struct msghdr *message, int flags)
 {
@@ -1719,6 +1777,98 @@ lwip_sendto(int s, const void *data, size_t size, int flags,
   return (err == ERR_OK ? short_size : -1);
 }
 
+#if LWIP_UDP || LWIP_RAW
+/**
+ * SO3: send several datagrams on a UDP or RAW socket (sendmmsg()).
+ * With LWIP_TCPIP_CORE_LOCKING, the core lock is taken once for the whole
+ * batch instead of once per datagram. The datagrams are sent in order and
+ * the sending stops at the first error.
+ * The pbufs are always freed; they are referenced by the stack (or the
+ * driver) as long as the data is needed.
+ *
+ * @return the number of datagrams sent, -1 on error if none has been sent
+ */
+int
+lwip_sendpbufs(int s, struct lwip_pbuf_msg *msgs, int count)
+{
+  struct lwip_sock *sock;
+  struct netbuf buf;
+#if LWIP_TCPIP_CORE_LOCKING
+  struct api_msg msg;
+#endif
+  u16_t remote_port;
+  err_t err = ERR_OK;
+  int i, sent = 0;
+
+  sock = get_socket(s);
+  if (!sock) {
+    goto sendpbufs_free;
+  }
+
+  if (NETCONNTYPE_GROUP(netconn_type(sock->conn)) == NETCONN_TCP) {
+    done_socket(sock);
+    set_errno(EOPNOTSUPP);
+    goto sendpbufs_free;
+  }
+
+#if LWIP_TCPIP_CORE_LOCKING
+  LOCK_TCPIP_CORE();
+#endif
+  for (i = 0; i < count; i++) {
+    const struct sockaddr *to = msgs[i].to;
+
+    if (!(((to == NULL) && (msgs[i].tolen == 0)) ||
+          (IS_SOCK_ADDR_LEN_VALID(msgs[i].tolen) &&
+           ((to != NULL) && (IS_SOCK_ADDR_TYPE_VALID(to) && IS_SOCK_ADDR_ALIGNED(to)))))) {
+      err = ERR_ARG;
+      break;
+    }
+
+    memset(&buf, 0, sizeof(struct netbuf));
+    buf.p = buf.ptr = msgs[i].p;
+    if (to) {
+      SOCKADDR_TO_IPADDR_PORT(to, &buf.addr, remote_port);
+    } else {
+      remote_port = 0;
+      ip_addr_set_any(NETCONNTYPE_ISIPV6(netconn_type(sock->conn)), &buf.addr);
+    }
+    netbuf_fromport(&buf) = remote_port;
+
+#if LWIP_TCPIP_CORE_LOCKING
+    /* What netconn_send() does, without releasing the lock */
+    msg.conn = sock->conn;
+    msg.msg.b = &buf;
+    lwip_netconn_do_send(&msg);
+    err = msg.err;
+#else
+    err = netconn_send(sock->conn, &buf);
+#endif
+    if (err != ERR_OK) {
+      break;
+    }
+    sent++;
+  }
+#if LWIP_TCPIP_CORE_LOCKING
+  UNLOCK_TCPIP_CORE();
+#endif
+
+  done_socket(sock);
+
+  for (i = 0; i < count; i++) {
+    pbuf_free(msgs[i].p);
+  }
+
+  set_errno(err_to_errno(err));
+  return ((sent || (err == ERR_OK)) ? sent : -1);
+
+sendpbufs_free:
+  for (i = 0; i < count; i++) {
+    pbuf_free(msgs[i].p);
+  }
+  return -1;
+}
+#endif /* LWIP_UDP || LWIP_RAW */
+
 int
 lwip_socket(int domain, int type, int protocol)
 {
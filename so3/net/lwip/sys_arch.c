@@ -60,6 +60,7 @@
 #include <semaphore.h>
 #include <heap.h>
 #include <timer.h>
+#include <spinlock.h>
 
 
 mutex_t light_protect_mutex;
@@ -111,6 +112,51 @@ void sys_arch_msleep(u32_t delay_ms)
     msleep(delay_ms);
 }
 
+/*
+ * The sys objects are recycled through free lists instead of going back to
+ * the heap, since a netconn (and each select()) creates and frees some of them.
+ */
+struct sys_pool {
+    spinlock_t lock;
+    void *free;
+    size_t size;
+};
+
+static struct sys_pool sys_mutex_pool = { .size = sizeof(mutex_t) };
+static struct sys_pool sys_sem_pool = { .size = sizeof(sem_t) };
+static struct sys_pool sys_mbox_pool = { .size = sizeof(_mbox_t) };
+
+static void *sys_pool_get(struct sys_pool *pool)
+{
+    unsigned long flags;
+    void *obj;
+
+    flags = spin_lock_irqsave(&pool->lock);
+
+    obj = pool->free;
+    if (obj)
+        pool->free = *(void **) obj;
+
+    spin_unlock_irqrestore(&pool->lock, flags);
+
+    if (!obj)
+        obj = malloc(pool->size);
+
+    return obj;
+}
+
+static void sys_pool_put(struct sys_pool *pool, void *obj)
+{
+    unsigned long flags;
+
+    flags = spin_lock_irqsave(&pool->lock);
+
+    *(void **) obj = pool->free;
+    pool->free = obj;
+
+    spin_unlock_irqrestore(&pool->lock, flags);
+}
+
 /*
  * create a new mutex
  */
@@ -119,14 +165,16 @@ err_t sys_mutex_new(sys_mutex_t *mutex)
     mutex_t *so3_mutex;
     LWIP_ASSERT("mutex != NULL", mutex != NULL);
 
-    so3_mutex = (mutex_t*)malloc(sizeof(mutex_t));
-    mutex_init(so3_mutex);
+    so3_mutex = (mutex_t*)sys_pool_get(&sys_mutex_pool);
 
     mutex->mut = (void*)so3_mutex;
 
     if(mutex->mut == NULL) {
         return ERR_MEM;
     }
+
+    mutex_init(so3_mutex);
+
     return ERR_OK;
 }
 
@@ -154,7 +202,7 @@ void sys_mutex_free(sys_mutex_t *mutex)
     LWIP_ASSERT("mutex != NULL", mutex != NULL);
     LWIP_ASSERT("mutex->mut != NULL", mutex->mut != NULL);
 
-    free(mutex->mut);
+    sys_pool_put(&sys_mutex_pool, mutex->mut);
 
     mutex->mut = NULL;
 }
@@ -165,7 +213,7 @@ err_t sys_sem_new(sys_sem_t *sem, u8_t initial_count)
     LWIP_ASSERT("sem != NULL", sem != NULL);
     LWIP_ASSERT("initial_count invalid (count >= 0)", (initial_count >= 0));
 
-    sem->sem = (sem_t*)malloc(sizeof(sem_t));
+    sem->sem = (sem_t*)sys_pool_get(&sys_sem_pool);
 
     if(sem->sem == NULL) {
         return ERR_MEM;
@@ -212,46 +260,112 @@ void sys_sem_free(sys_sem_t *sem)
     LWIP_ASSERT("sem != NULL", sem != NULL);
     LWIP_ASSERT("sem->mut != NULL", sem->sem != NULL);
 
-    free(sem->sem);
+    sys_pool_put(&sys_sem_pool, sem->sem);
 
     sem->sem = NULL;
 }
 
 
+/*
+ * Lock-free mailbox
+ *
+ * Each slot carries a sequence number: a slot at position <pos> is free when its
+ * sequence is <pos>, and holds a message when it is <pos> + 1. A producer claims
+ * a slot with a CAS on <head>, which never fails on the netconn mailboxes since
+ * their producer runs with the core lock held. Only the consumer moves <tail>.
+ */
+
+static bool mbox_enqueue(_mbox_t *mbox, void *msg)
+{
+    struct _mbox_slot *slot;
+    u32_t pos;
+    int diff;
+
+    pos = __atomic_load_n(&mbox->head, __ATOMIC_RELAXED);
+
+    while (1) {
+        slot = &mbox->slots[pos % SYS_MBOX_SIZE];
+        diff = (int) (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+
+        if (diff == 0) {
+            /* On failure, pos is updated with the current head */
+            if (__atomic_compare_exchange_n(&mbox->head, &pos, pos + 1, false, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+        } else if (diff < 0) {
+            /* The consumer has not released this slot yet: full */
+            return false;
+        } else {
+            pos = __atomic_load_n(&mbox->head, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->msg = msg;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+static bool mbox_dequeue(_mbox_t *mbox, void **msg)
+{
+    u32_t pos = mbox->tail;
+    struct _mbox_slot *slot = &mbox->slots[pos % SYS_MBOX_SIZE];
+
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1)
+        return false;
+
+    if (msg != NULL)
+        *msg = slot->msg;
+
+    mbox->tail = pos + 1;
+    __atomic_store_n(&slot->seq, pos + SYS_MBOX_SIZE, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/*
+ * The sleeping side publishes its wait flag before checking the ring again, and
+ * the other side checks the flag after updating the ring, so that a wakeup cannot
+ * be lost. A spurious semaphore count only costs an extra round in the loops.
+ */
+
+static void mbox_wake_consumer(_mbox_t *mbox)
+{
+    smp_mb();
 
+    if (__atomic_load_n(&mbox->wait_fetch, __ATOMIC_RELAXED))
+        sem_up(&mbox->not_empty);
+}
 
+static void mbox_wake_producers(_mbox_t *mbox)
+{
+    smp_mb();
+
+    if (__atomic_load_n(&mbox->wait_post, __ATOMIC_RELAXED))
+        sem_up(&mbox->not_full);
+}
 
 err_t sys_mbox_new(sys_mbox_t *sys_mbox, int size)
 {
     _mbox_t *mbox;
-    sem_t *not_empty;
-    sem_t *not_full;
-    mutex_t *mutex;
+    int i;
     LWIP_UNUSED_ARG(size);
 
-    mbox = (_mbox_t *)malloc(sizeof(_mbox_t));
-    not_empty = (sem_t*)malloc(sizeof(sem_t));
-    not_full = (sem_t*)malloc(sizeof(sem_t));
-    mutex = (mutex_t*)malloc(sizeof(mutex_t));
+    mbox = (_mbox_t *)sys_pool_get(&sys_mbox_pool);
 
-    if (mbox == NULL || not_empty == NULL || not_full == NULL || mutex == NULL) {
+    if (mbox == NULL) {
         return ERR_MEM;
     }
 
+    sem_init(&mbox->not_empty);
+    sem_init(&mbox->not_full);
+    sem_down(&mbox->not_empty);
+    sem_down(&mbox->not_full);
 
-    sem_init(not_empty);
-    sem_init(not_full);
-    sem_down(not_empty);
-    sem_down(not_full);
-
-
-    mutex_init(mutex);
+    mbox->head = mbox->tail = 0;
+    mbox->wait_fetch = mbox->wait_post = 0;
 
-    mbox->first = mbox->last = 0;
-    mbox->not_empty = not_empty;
-    mbox->not_full = not_full;
-    mbox->mutex = mutex;
-    mbox->wait_send = 0;
+    for (i = 0; i < SYS_MBOX_SIZE; i++)
+        mbox->slots[i].seq = i;
 
     SYS_STATS_INC_USED(mbox);
     sys_mbox->mbox = mbox;
@@ -261,77 +375,43 @@ err_t sys_mbox_new(sys_mbox_t *sys_mbox, int size)
 void sys_mbox_post(sys_mbox_t *sys_mbox, void *msg)
 {
     _mbox_t* mbox;
-    uint32_t first = 0;
-
-    LWIP_ASSERT("invalid mbox", (sys_mbox_t != NULL) && (sys_mbox->mbox != NULL));
 
+    LWIP_ASSERT("invalid mbox", (sys_mbox != NULL) && (sys_mbox->mbox != NULL));
 
     mbox = sys_mbox->mbox;
 
-    mutex_lock(mbox->mutex);
+    while (!mbox_enqueue(mbox, msg)) {
+        __atomic_add_fetch(&mbox->wait_post, 1, __ATOMIC_RELAXED);
+        smp_mb();
 
-    while ((mbox->last + 1) >= (mbox->first + SYS_MBOX_SIZE)) {
-        mbox->wait_send++;
-        mutex_unlock(mbox->mutex);
-        sem_down(mbox->not_full);
-        mutex_lock(mbox->mutex);
-        mbox->wait_send--;
-    }
-
-    mbox->msgs[mbox->last % SYS_MBOX_SIZE] = msg;
-
-    if (mbox->last == mbox->first) {
-        first = 1;
-    } else {
-        first = 0;
-    }
-
-    mbox->last++;
+        if (mbox_enqueue(mbox, msg)) {
+            __atomic_sub_fetch(&mbox->wait_post, 1, __ATOMIC_RELAXED);
+            break;
+        }
 
-    if (first) {
-        sem_up(mbox->not_empty);
+        sem_down(&mbox->not_full);
+        __atomic_sub_fetch(&mbox->wait_post, 1, __ATOMIC_RELAXED);
     }
 
-    mutex_unlock(mbox->mutex);
-
+    mbox_wake_consumer(mbox);
 }
 
 err_t sys_mbox_trypost(sys_mbox_t *sys_mbox, void *msg)
 {
-    u8_t first;
     _mbox_t* mbox;
 
     LWIP_ASSERT("invalid mbox", (sys_mbox != NULL) && (sys_mbox->mbox != NULL));
 
     mbox = sys_mbox->mbox;
 
-    mutex_lock(mbox->mutex);
-
     LWIP_DEBUGF(SYS_DEBUG, ("sys_mbox_trypost: mbox %p msg %p\n", (void *)mbox, (void *)msg));
 
-    if ((mbox->last + 1) >= (mbox->first + SYS_MBOX_SIZE)) {
-        mutex_unlock(mbox->mutex);
+    if (!mbox_enqueue(mbox, msg))
         return ERR_MEM;
-    }
 
-    mbox->msgs[mbox->last % SYS_MBOX_SIZE] = msg;
-
-    if (mbox->last == mbox->first) {
-        first = 1;
-    } else {
-        first = 0;
-    }
-
-    mbox->last++;
-
-    if (first) {
-        sem_up(mbox->not_empty);
-    }
-
-    mutex_unlock(mbox->mutex);
+    mbox_wake_consumer(mbox);
 
     return ERR_OK;
-
 }
 
 err_t sys_mbox_trypost_fromisr(sys_mbox_t *sys_mbox, void *msg)
@@ -343,46 +423,41 @@ u32_t sys_arch_mbox_fetch(sys_mbox_t *sys_mbox, void **msg, u32_t timeout_ms)
 {
     int start_time = sys_now();
     _mbox_t* mbox;
+    u64 deadline = NOW() + timeout_ms * 1000000ull;
+    s64 remaining;
 
     LWIP_ASSERT("invalid mbox", (sys_mbox != NULL) && (sys_mbox->mbox != NULL));
 
     mbox = sys_mbox->mbox;
 
-    /* The mutex lock is quick so we don't bother with the timeout
-       stuff here. */
-    mutex_lock(mbox->mutex);
+    while (!mbox_dequeue(mbox, msg)) {
+        __atomic_store_n(&mbox->wait_fetch, 1, __ATOMIC_RELAXED);
+        smp_mb();
 
-    while (mbox->first == mbox->last) {
-        mutex_unlock(mbox->mutex);
+        if (mbox_dequeue(mbox, msg)) {
+            __atomic_store_n(&mbox->wait_fetch, 0, __ATOMIC_RELAXED);
+            break;
+        }
 
         /* We block while waiting for a mail to arrive in the mailbox. We
            must be prepared to timeout. */
         if (timeout_ms > 0) {
-            if (sem_timeddown(mbox->not_empty, timeout_ms * 1000000ull)) {
+            remaining = deadline - NOW();
+
+            if ((remaining <= 0) || sem_timeddown(&mbox->not_empty, remaining)) {
+                __atomic_store_n(&mbox->wait_fetch, 0, __ATOMIC_RELAXED);
                 return SYS_ARCH_TIMEOUT;
             }
         } else {
-            sem_down(mbox->not_empty);
+            sem_down(&mbox->not_empty);
         }
 
-        mutex_lock(mbox->mutex);
+        __atomic_store_n(&mbox->wait_fetch, 0, __ATOMIC_RELAXED);
     }
 
-    if (msg != NULL) {
-        LWIP_DEBUGF(SYS_DEBUG, ("sys_mbox_fetch: mbox %p msg %p\n", (void *)mbox, *msg));
-        *msg = mbox->msgs[mbox->first % SYS_MBOX_SIZE];
-    }
-    else{
-        LWIP_DEBUGF(SYS_DEBUG, ("sys_mbox_fetch: mbox %p, null msg\n", (void *)mbox));
-    }
+    LWIP_DEBUGF(SYS_DEBUG, ("sys_mbox_fetch: mbox %p msg %p\n", (void *)mbox, (msg ? *msg : NULL)));
 
-    mbox->first++;
-
-    if (mbox->wait_send) {
-        sem_up(mbox->not_full);
-    }
-
-    mutex_unlock(mbox->mutex);
+    mbox_wake_producers(mbox);
 
     return sys_now() - start_time;
 }
@@ -398,28 +473,12 @@ u32_t sys_arch_mbox_tryfetch(sys_mbox_t *sys_mbox, void **msg)
 
     mbox = sys_mbox->mbox;
 
-    mutex_lock(mbox->mutex);
-
-    if (mbox->first == mbox->last) {
-        mutex_unlock(mbox->mutex);
+    if (!mbox_dequeue(mbox, msg))
         return SYS_MBOX_EMPTY;
-    }
 
-    if (msg != NULL) {
-        LWIP_DEBUGF(SYS_DEBUG, ("sys_mbox_tryfetch: mbox %p msg %p\n", (void *)mbox, *msg));
-        *msg = mbox->msgs[mbox->first % SYS_MBOX_SIZE];
-    }
-    else{
-        LWIP_DEBUGF(SYS_DEBUG, ("sys_mbox_tryfetch: mbox %p, null msg\n", (void *)mbox));
-    }
-
-    mbox->first++;
-
-    if (mbox->wait_send) {
-        sem_up(mbox->not_full);
-    }
+    LWIP_DEBUGF(SYS_DEBUG, ("sys_mbox_tryfetch: mbox %p msg %p\n", (void *)mbox, (msg ? *msg : NULL)));
 
-    mutex_unlock(mbox->mutex);
+    mbox_wake_producers(mbox);
 
     return 0;
 }
@@ -428,14 +487,9 @@ void sys_mbox_free(sys_mbox_t *sys_mbox)
 {
 
     if ((sys_mbox != NULL) && (sys_mbox->mbox != NULL)) {
-        _mbox_t *mbox = sys_mbox->mbox;
         SYS_STATS_DEC(mbox.used);
 
-        free(mbox->not_empty);
-        free(mbox->not_full);
-        free(mbox->mutex);
-        mbox->not_empty = mbox->not_full = mbox->mutex = NULL;
-        free(mbox);
+        sys_pool_put(&sys_mbox_pool, sys_mbox->mbox);
     }
 
 }
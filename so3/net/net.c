@@ -27,14 +27,24 @@
 #include <string.h>
 #include <dirent.h>
 #include <initcall.h>
+#include <timer.h>
 
 #include <net/lwip/tcpip.h>
 #include <net/lwip/sockets.h>
 #include <net/lwip/netif.h>
 #include <net/lwip/netifapi.h>
+#include <net/lwip/stats.h>
+#include <net/lwip/pbuf.h>
 
 #include <device/net.h>
 
+#if defined(CONFIG_NET_ZEROCOPY_RX) || defined(CONFIG_NET_ZEROCOPY_TX)
+#include <net/zerocopy.h>
+#endif
+
+/* Datagrams of a sendmmsg() given at once to lwIP */
+#define NET_SENDMMSG_BATCH	16
+
 /*
  * Mapping between internal fd and vfs fd
  */
@@ -60,23 +70,54 @@ static int get_lwip_fd(int fd)
 
 /**************************** Network subsystem ***************************************/
 
-int read_sock(int fd, void *buffer, int count)
+/*
+ * The VFS calls the read/write/close callbacks with the global fd (gfd).
+ */
+
+int read_sock(int gfd, void *buffer, int count)
 {
-        int lwip_fd = get_lwip_fd(fd);
-        return lwip_read(lwip_fd, buffer, count);
+        return lwip_read(lwip_fds[gfd], buffer, count);
 }
 
-int write_sock(int fd, const void *buffer, int count)
+int write_sock(int gfd, const void *buffer, int count)
 {
-        int lwip_fd = get_lwip_fd(fd);
-        return lwip_write(lwip_fd, buffer, count);
+        return lwip_write(lwip_fds[gfd], buffer, count);
 }
 
-int close_sock(int fd)
+static int readv_sock(int gfd, const struct iovec *iov, int iovcnt)
 {
-        int lwip_fd = get_lwip_fd(fd);
-        return lwip_close(lwip_fd);
+        return lwip_readv(lwip_fds[gfd], iov, iovcnt);
+}
+
+/* All segments are given at once to lwIP which can fill full TCP segments */
+static int writev_sock(int gfd, const struct iovec *iov, int iovcnt)
+{
+        return lwip_writev(lwip_fds[gfd], iov, iovcnt);
+}
+
+int close_sock(int gfd)
+{
+#ifdef CONFIG_NET_ZEROCOPY_RX
+        net_zc_release(gfd);
+#endif
+#ifdef CONFIG_NET_ZEROCOPY_TX
+        net_zc_tx_release(gfd);
+#endif
+        return lwip_close(lwip_fds[gfd]);
+}
+
+#ifdef CONFIG_NET_ZEROCOPY_RX
+/* The zero-copy receive pool is mapped read-only (see do_mmap()), on the opted-in sockets only */
+static void *mmap_sock(int fd, addr_t virt_addr, uint32_t page_count)
+{
+        if (!net_zc_enabled(current()->pcb->fd_array[fd])) {
+                set_errno(EACCES);
+                return NULL;
+        }
+
+        return net_zc_mmap(virt_addr, page_count);
 }
+#endif
 
 #warning redefine as ifreq
 struct ifreq2 {
@@ -105,6 +146,21 @@ struct sockaddr_in_usr {
         uint8_t sin_zero[8];
 };
 
+/**
+ * Translate the MSG_* flags given by the userspace into the lwIP ones.
+ */
+int user_to_lwip_msg_flags(int flags)
+{
+        int lwip_flags = 0;
+
+        if (flags & MSG_USR_PEEK)
+                lwip_flags |= MSG_PEEK;
+        if (flags & MSG_USR_DONTWAIT)
+                lwip_flags |= MSG_DONTWAIT;
+
+        return lwip_flags;
+}
+
 /**
  * Adapt a userspace sockaddr to a lwip one.
  * Iwip sockaddr have a sa_len field as first byte
@@ -127,6 +183,86 @@ struct sockaddr *user_to_lwip_sockadd(struct sockaddr_in_usr *usr, struct sockad
         return (struct sockaddr *)lwip;
 }
 
+/**
+ * Adapt a lwip sockaddr to a userspace one, truncated to <len> bytes.
+ * @return the length of the userspace sockaddr
+ */
+static socklen_t lwip_to_user_sockadd(struct sockaddr_in *lwip, struct sockaddr_in_usr *usr, socklen_t len)
+{
+        struct sockaddr_in_usr addr;
+
+        memset(&addr, 0, sizeof(struct sockaddr_in_usr));
+
+        addr.sin_family = lwip->sin_family;
+        addr.sin_port = lwip->sin_port;
+        addr.sin_addr = lwip->sin_addr;
+
+        memcpy(usr, &addr, min((size_t) len, sizeof(struct sockaddr_in_usr)));
+
+        return sizeof(struct sockaddr_in_usr);
+}
+
+#if LWIP_STATS
+
+static const char *memp_names[] = {
+#define LWIP_MEMPOOL(name, num, size, desc) desc,
+#include <net/lwip/priv/memp_std.h>
+};
+
+static void get_stats_proto(struct net_stats_proto *dst, struct stats_proto *src)
+{
+        dst->xmit = src->xmit;
+        dst->recv = src->recv;
+        dst->drop = src->drop;
+        dst->chkerr = src->chkerr;
+        dst->lenerr = src->lenerr;
+        dst->memerr = src->memerr;
+        dst->rterr = src->rterr;
+        dst->proterr = src->proterr;
+        dst->err = src->err;
+}
+
+static void get_stats_mem(struct net_stats_mem *dst, struct stats_mem *src, const char *name)
+{
+        strncpy(dst->name, name, sizeof(dst->name) - 1);
+        dst->avail = src->avail;
+        dst->used = src->used;
+        dst->max = src->max;
+        dst->err = src->err;
+}
+
+/*
+ * Take a snapshot of the lwIP counters.
+ */
+static int get_net_stats(struct net_stats *stats)
+{
+        int i;
+
+        memset(stats, 0, sizeof(struct net_stats));
+
+        LOCK_TCPIP_CORE();
+
+        get_stats_proto(&stats->link, &lwip_stats.link);
+        get_stats_proto(&stats->etharp, &lwip_stats.etharp);
+        get_stats_proto(&stats->ip, &lwip_stats.ip);
+        get_stats_proto(&stats->icmp, &lwip_stats.icmp);
+        get_stats_proto(&stats->udp, &lwip_stats.udp);
+        get_stats_proto(&stats->tcp, &lwip_stats.tcp);
+
+        get_stats_mem(&stats->heap, &lwip_stats.mem, "HEAP");
+
+        for (i = 0; (i < MEMP_MAX) && (i < NET_STATS_MAX_POOLS); i++)
+                get_stats_mem(&stats->pools[i], lwip_stats.memp[i], memp_names[i]);
+
+        stats->nr_pools = i;
+
+        UNLOCK_TCPIP_CORE();
+
+        return 0;
+}
+
+#endif /* LWIP_STATS */
+
 int ioctl_sock(int fd, unsigned long cmd, unsigned long args)
 {
         int lwip_fd = get_lwip_fd(fd);
@@ -135,6 +271,10 @@ int ioctl_sock(int fd, unsigned long cmd, unsigned long args)
         struct ifreq2 *ifreq = NULL;
         struct netif *netif = NULL;
         struct sockaddr_in *addr = NULL;
+#ifdef CONFIG_NET_ZEROCOPY_RX
+        socklen_t optlen = sizeof(int);
+        int type;
+#endif
 
         /* LwIP handeled the ioctl cmd */
         if (!lwip_ioctl(lwip_fd, cmd, (void *) args)) {
@@ -342,6 +482,63 @@ int ioctl_sock(int fd, unsigned long cmd, unsigned long args)
 
                 return 0;
 
+        case SIOCGNETSTATS:
+                if (!args) {
+                        set_errno(EINVAL);
+                        return -1;
+                }
+#if LWIP_STATS
+                return get_net_stats((struct net_stats *) args);
+#else
+                set_errno(ENOSYS);
+                return -1;
+#endif
+
+#ifdef CONFIG_NET_ZEROCOPY_TX
+        case SIOCZCSENDDONE:
+                if (!args) {
+                        set_errno(EINVAL);
+                        return -1;
+                }
+                return net_zc_tx_done(current()->pcb->fd_array[fd], (struct net_zc_txdone *) args);
+#endif
+
+#ifdef CONFIG_NET_ZEROCOPY_RX
+        case SIOCZCENABLE:
+                if (lwip_getsockopt(lwip_fd, SOL_SOCKET, SO_TYPE, &type, &optlen) < 0)
+                        return -1;
+
+                if (type != SOCK_STREAM) {
+                        set_errno(EOPNOTSUPP);
+                        return -1;
+                }
+
+                net_zc_enable(current()->pcb->fd_array[fd]);
+                return 0;
+
+        case SIOCGZCSIZE:
+                if (!args) {
+                        set_errno(EINVAL);
+                        return -1;
+                }
+                *((u32 *) args) = net_zc_size();
+                return 0;
+
+        case SIOCZCRECV:
+                if (!args || !net_zc_enabled(current()->pcb->fd_array[fd])) {
+                        set_errno(EINVAL);
+                        return -1;
+                }
+                return net_zc_recv(current()->pcb->fd_array[fd], lwip_fd, (struct net_zc_recv *) args);
+
+        case SIOCZCRECYCLE:
+                if (!args) {
+                        set_errno(EINVAL);
+                        return -1;
+                }
+                return net_zc_recycle(current()->pcb->fd_array[fd], (struct net_zc_recycle *) args);
+#endif
+
         case SIOCSIFMTU:
                 if (!args) {
                         set_errno(EINVAL);
@@ -370,10 +567,15 @@ static struct file_operations sockops = {
         .close = close_sock,
         .read = read_sock,
         .write = write_sock,
+        .readv = readv_sock,
+        .writev = writev_sock,
         .mount = NULL,
         .readdir = NULL,
         .stat = NULL,
-        .ioctl = ioctl_sock
+        .ioctl = ioctl_sock,
+#ifdef CONFIG_NET_ZEROCOPY_RX
+        .mmap = mmap_sock,
+#endif
 };
 
 struct file_operations *register_sock(void)
@@ -491,6 +693,12 @@ int do_accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen)
         /*  TODO check fd ok */
         lwip_fds[gfd] = lwip_bind_fd;
 
+#ifdef CONFIG_NET_ZEROCOPY_RX
+        /* The zero-copy receive is inherited from the listening socket */
+        if (net_zc_enabled(current()->pcb->fd_array[sockfd]))
+                net_zc_enable(gfd);
+#endif
+
         /* Copy back our sockaddr info in the usr data */
         if (addr)
         	memcpy(addr, addr_ptr, sizeof(struct sockaddr_in));
@@ -516,10 +724,37 @@ int do_recvfrom(int sockfd, void *mem, size_t len, int flags, struct sockaddr *f
 }
 
 
+/*
+ * send()/sendto() with MSG_ZEROCOPY, as a sendmmsg() of one message.
+ */
+static int send_zerocopy(int sockfd, const void *dataptr, size_t size, int flags, const struct sockaddr *to, socklen_t tolen)
+{
+        struct iovec iov;
+        struct mmsghdr_usr msg;
+
+        iov.iov_base = (void *) dataptr;
+        iov.iov_len = size;
+
+        memset(&msg, 0, sizeof(struct mmsghdr_usr));
+
+        msg.msg_hdr.msg_name = (void *) to;
+        msg.msg_hdr.msg_namelen = tolen;
+        msg.msg_hdr.msg_iov = &iov;
+        msg.msg_hdr.msg_iovlen = 1;
+
+        if (do_sendmmsg(sockfd, &msg, 1, flags) < 0)
+                return -1;
+
+        return msg.msg_len;
+}
+
 int do_send(int sockfd, const void *dataptr, size_t size, int flags)
 {
         int lwip_fd = get_lwip_fd(sockfd);
 
+        if (flags & MSG_USR_ZEROCOPY)
+                return send_zerocopy(sockfd, dataptr, size, flags, NULL, 0);
+
         return lwip_send(lwip_fd, dataptr, size, flags);
 }
 
@@ -528,12 +763,284 @@ int do_sendto(int sockfd, const void *dataptr, size_t size, int flags, const str
         struct sockaddr_in to_lwip;
         int lwip_fd = get_lwip_fd(sockfd);
 
+        if (flags & MSG_USR_ZEROCOPY)
+                return send_zerocopy(sockfd, dataptr, size, flags, to, tolen);
+
         user_to_lwip_sockadd((struct sockaddr_in_usr *) to, &to_lwip);
 
 
         return lwip_sendto(lwip_fd, dataptr, size, flags, (struct sockaddr *) &to_lwip, tolen);
 }
 
+/*
+ * Length of the data of a message, which must fit into a datagram.
+ */
+static int msg_usr_len(struct msghdr_usr *hdr, size_t *len)
+{
+        size_t i;
+
+        if ((hdr->msg_iovlen > IOV_MAX) || (hdr->msg_iovlen && !hdr->msg_iov)) {
+                set_errno(EINVAL);
+                return -1;
+        }
+
+        *len = 0;
+        for (i = 0; i < hdr->msg_iovlen; i++) {
+                *len += hdr->msg_iov[i].iov_len;
+
+                if ((hdr->msg_iov[i].iov_len > 0xffff) || (*len > 0xffff)) {
+                        set_errno(EMSGSIZE);
+                        return -1;
+                }
+        }
+
+        return 0;
+}
+
+/*
+ * Copy the data of a message into a pbuf.
+ */
+static struct pbuf *msg_usr_copy(struct msghdr_usr *hdr, size_t len)
+{
+        struct pbuf *p;
+        size_t i, offset = 0;
+
+        p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+        if (!p) {
+                set_errno(ENOBUFS);
+                return NULL;
+        }
+
+        for (i = 0; i < hdr->msg_iovlen; i++) {
+                memcpy((u8 *) p->payload + offset, hdr->msg_iov[i].iov_base, hdr->msg_iov[i].iov_len);
+                offset += hdr->msg_iov[i].iov_len;
+        }
+
+        return p;
+}
+
+/*
+ * Send up to NET_SENDMMSG_BATCH datagrams with a single call to lwIP.
+ *
+ * @return the number of datagrams sent, -1 on error if none has been sent
+ */
+static int sendmmsg_dgram(int gfd, int lwip_fd, struct mmsghdr_usr *msgvec, int count, int flags)
+{
+        struct lwip_pbuf_msg msgs[NET_SENDMMSG_BATCH];
+        struct sockaddr_in to[NET_SENDMMSG_BATCH];
+#ifdef CONFIG_NET_ZEROCOPY_TX
+        struct net_zc_txmsg *zc[NET_SENDMMSG_BATCH];
+#endif
+        struct msghdr_usr *hdr;
+        struct pbuf *p;
+        size_t len;
+        int n, sent;
+#ifdef CONFIG_NET_ZEROCOPY_TX
+        int i;
+#endif
+
+        for (n = 0; n < count; n++) {
+                hdr = &msgvec[n].msg_hdr;
+
+                if (msg_usr_len(hdr, &len) < 0)
+                        break;
+
+                p = NULL;
+
+#ifdef CONFIG_NET_ZEROCOPY_TX
+                zc[n] = NULL;
+
+                if (flags & MSG_USR_ZEROCOPY) {
+                        zc[n] = net_zc_tx_prepare(gfd, hdr->msg_iov, hdr->msg_iovlen, len, &p);
+                        if (!zc[n])
+                                break;
+                }
+#endif
+                if (!p)
+                        p = msg_usr_copy(hdr, len);
+
+                if (!p) {
+#ifdef CONFIG_NET_ZEROCOPY_TX
+                        if (zc[n])
+                                net_zc_tx_complete(gfd, zc[n], false);
+#endif
+                        break;
+                }
+
+                msgs[n].p = p;
+
+                if (hdr->msg_name && hdr->msg_namelen) {
+                        msgs[n].to = user_to_lwip_sockadd((struct sockaddr_in_usr *) hdr->msg_name, &to[n]);
+                        msgs[n].tolen = hdr->msg_namelen;
+                } else {
+                        msgs[n].to = NULL;
+                        msgs[n].tolen = 0;
+                }
+
+                msgvec[n].msg_len = len;
+        }
+
+        /* errno has been set by the failing message */
+        if (!n)
+                return -1;
+
+        sent = lwip_sendpbufs(lwip_fd, msgs, n);
+
+#ifdef CONFIG_NET_ZEROCOPY_TX
+        for (i = 0; i < n; i++)
+                if (zc[i])
+                        net_zc_tx_complete(gfd, zc[i], (i < sent));
+#endif
+
+        return sent;
+}
+
+/*
+ * TCP: the messages are written one after the other.
+ */
+static int sendmmsg_stream(int lwip_fd, struct mmsghdr_usr *msgvec, unsigned int vlen, int flags)
+{
+        struct msghdr msg;
+        unsigned int i;
+        ssize_t ret = 0;
+
+        for (i = 0; i < vlen; i++) {
+                memset(&msg, 0, sizeof(struct msghdr));
+
+                msg.msg_iov = msgvec[i].msg_hdr.msg_iov;
+                msg.msg_iovlen = msgvec[i].msg_hdr.msg_iovlen;
+
+                ret = lwip_sendmsg(lwip_fd, &msg, user_to_lwip_msg_flags(flags));
+                if (ret < 0)
+                        break;
+
+                msgvec[i].msg_len = ret;
+        }
+
+        return (i ? i : ret);
+}
+
+/**
+ * Send several messages with a single syscall. The datagrams of a UDP socket
+ * are given to lwIP by batches, which saves a trap and a lock of the stack
+ * per datagram. With MSG_ZEROCOPY (CONFIG_NET_ZEROCOPY_TX, UDP only), the
+ * datagrams refer to the user buffers instead of copying them.
+ *
+ * @return the number of messages sent, -1 on error if none has been sent
+ */
+int do_sendmmsg(int sockfd, struct mmsghdr_usr *msgvec, unsigned int vlen, int flags)
+{
+        int lwip_fd = get_lwip_fd(sockfd);
+        int gfd = current()->pcb->fd_array[sockfd];
+        int type, ret = 0;
+        socklen_t optlen = sizeof(int);
+        unsigned int sent = 0;
+
+        if (lwip_getsockopt(lwip_fd, SOL_SOCKET, SO_TYPE, &type, &optlen) < 0)
+                return -1;
+
+#ifndef CONFIG_NET_ZEROCOPY_TX
+        if (flags & MSG_USR_ZEROCOPY) {
+                set_errno(EOPNOTSUPP);
+                return -1;
+        }
+#endif
+
+        vlen = min(vlen, (unsigned int) NET_MMSG_MAX);
+
+        if (type == SOCK_STREAM) {
+                if (flags & MSG_USR_ZEROCOPY) {
+                        set_errno(EOPNOTSUPP);
+                        return -1;
+                }
+                return sendmmsg_stream(lwip_fd, msgvec, vlen, flags);
+        }
+
+        while (sent < vlen) {
+                ret = sendmmsg_dgram(gfd, lwip_fd, &msgvec[sent], min(vlen - sent, (unsigned int) NET_SENDMMSG_BATCH), flags);
+                if (ret <= 0)
+                        break;
+
+                sent += ret;
+
+                /* Stopped on an error */
+                if (ret < NET_SENDMMSG_BATCH)
+                        break;
+        }
+
+        return (sent ? sent : ret);
+}
+
+/**
+ * Receive several messages with a single syscall. With MSG_WAITFORONE, only
+ * the first message is waited for. The timeout is checked after each message,
+ * as Linux does: the call may block beyond it while waiting for a message.
+ *
+ * @return the number of messages received, -1 on error if none has been received
+ */
+int do_recvmmsg(int sockfd, struct mmsghdr_usr *msgvec, unsigned int vlen, int flags, struct timespec *timeout)
+{
+        int lwip_fd = get_lwip_fd(sockfd);
+        int lwip_flags = user_to_lwip_msg_flags(flags);
+        struct msghdr_usr *hdr;
+        struct sockaddr_in from;
+        struct msghdr msg;
+        unsigned int received = 0;
+        u64 deadline = 0;
+        ssize_t ret = 0;
+        size_t i;
+
+        if (timeout)
+                deadline = NOW() + SECONDS(timeout->tv_sec) + timeout->tv_nsec;
+
+        vlen = min(vlen, (unsigned int) NET_MMSG_MAX);
+
+        while (received < vlen) {
+                hdr = &msgvec[received].msg_hdr;
+
+                if (hdr->msg_iovlen > IOV_MAX) {
+                        set_errno(EMSGSIZE);
+                        ret = -1;
+                        break;
+                }
+
+                memset(&msg, 0, sizeof(struct msghdr));
+
+                msg.msg_name = (hdr->msg_name ? &from : NULL);
+                msg.msg_namelen = (hdr->msg_name ? sizeof(struct sockaddr_in) : 0);
+                msg.msg_iov = hdr->msg_iov;
+                msg.msg_iovlen = hdr->msg_iovlen;
+
+                ret = lwip_recvmsg(lwip_fd, &msg, lwip_flags);
+                if (ret < 0)
+                        break;
+
+                if (hdr->msg_name)
+                        hdr->msg_namelen = lwip_to_user_sockadd(&from, (struct sockaddr_in_usr *) hdr->msg_name, hdr->msg_namelen);
+
+                hdr->msg_controllen = 0;
+                hdr->msg_flags = 0;
+
+                /* A truncated datagram fills the buffers, lwIP returns its original length */
+                if (msg.msg_flags & MSG_TRUNC) {
+                        hdr->msg_flags |= MSG_USR_TRUNC;
+
+                        for (i = 0, ret = 0; i < hdr->msg_iovlen; i++)
+                                ret += hdr->msg_iov[i].iov_len;
+                }
+
+                msgvec[received++].msg_len = ret;
+
+                if (flags & MSG_USR_WAITFORONE)
+                        lwip_flags |= MSG_DONTWAIT;
+
+                if (timeout && (NOW() >= deadline))
+                        break;
+        }
+
+        return (received ? received : ret);
+}
+
 
 int do_setsockopt(int sockfd, int level, int optname, const void *optval, socklen_t optlen)
 {
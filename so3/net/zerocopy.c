@@ -0,0 +1,552 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Zero-copy socket receive.
+ *
+ * The network drivers receive the frames into a pool of page-sized buffers
+ * which are handed to lwIP as custom pbufs. A process reserves a window of the
+ * size of the pool with mmap() on a socket which has opted in with SIOCZCENABLE;
+ * SIOCZCRECV then takes the received pbufs of the socket from lwIP, maps their
+ * buffer read-only into the window (at the offset of the buffer in the pool) and
+ * returns the location of their payload instead of copying it. The buffers are
+ * held on behalf of the socket until SIOCZCRECYCLE (or close()) unmaps them and
+ * frees their pbuf, which puts them back into the pool.
+ *
+ * A page of the pool is thus only visible to the process which receives its
+ * frame, as long as the frame is held; the end of the page beyond the frame is
+ * cleared before it is mapped.
+ *
+ * The data which did not arrive in the pool (loopback, pool exhausted at
+ * receive time) is copied into a pool buffer, as recv() would do.
+ */
+
+#include <common.h>
+#include <memory.h>
+#include <errno.h>
+#include <string.h>
+#include <spinlock.h>
+#include <process.h>
+#include <vfs.h>
+#include <net.h>
+#include <vma.h>
+
+#include <net/zerocopy.h>
+
+#include <net/lwip/pbuf.h>
+#include <net/lwip/sockets.h>
+
+#include <asm/mmu.h>
+
+#define NET_ZC_POOL_SIZE	(CONFIG_NET_ZC_RX_PAGES * PAGE_SIZE)
+#define NET_ZC_NR_BUFS		(NET_ZC_POOL_SIZE / NET_ZC_BUF_SIZE)
+
+/* Processes which may have a window on the pool at the same time */
+#define NET_ZC_NR_WINDOWS	8
+
+/* Owner of a buffer: gfd + 1, 0 if no socket holds it */
+#define NET_ZC_NO_OWNER		0
+#define zc_owner(gfd)		((gfd) + 1)
+
+/* The descriptors are kept out of the pool so that the mapping only shows frame data */
+struct net_zc_buf {
+	struct pbuf_custom pc;
+
+	/* Free list */
+	struct net_zc_buf *next;
+
+	/* Socket which holds the buffer */
+	int owner;
+
+	/* Page of the buffer in the window of a process, 0 if not mapped */
+	uint32_t map_pid;
+	addr_t map_vaddr;
+};
+
+/* Window reserved with mmap() by a process */
+struct net_zc_win {
+	bool used;
+	uint32_t pid;
+	addr_t vaddr;
+};
+
+static u8 net_zc_pool[NET_ZC_POOL_SIZE] __attribute__((aligned(PAGE_SIZE)));
+
+static struct {
+	struct net_zc_buf bufs[NET_ZC_NR_BUFS];
+	struct net_zc_buf *free;
+	bool initialized;
+
+	/* Data taken from lwIP which did not fit into the segments of the last request */
+	struct pbuf *pending[MAX_FDS];
+
+	/* Sockets which have opted in (SIOCZCENABLE) */
+	bool enabled[MAX_FDS];
+
+	struct net_zc_win wins[NET_ZC_NR_WINDOWS];
+
+	spinlock_t lock;
+} net_zc;
+
+static inline unsigned int zc_index(void *buf) {
+	return ((u8 *) buf - net_zc_pool) / NET_ZC_BUF_SIZE;
+}
+
+static inline void *zc_data(struct net_zc_buf *zc) {
+	return net_zc_pool + (zc - net_zc.bufs) * NET_ZC_BUF_SIZE;
+}
+
+/* The free list is built on the first allocation since the drivers may come first */
+static void zc_init_locked(void) {
+	int i;
+
+	for (i = 0; i < NET_ZC_NR_BUFS; i++)
+		net_zc.bufs[i].next = ((i < NET_ZC_NR_BUFS - 1) ? &net_zc.bufs[i + 1] : NULL);
+
+	net_zc.free = &net_zc.bufs[0];
+	net_zc.initialized = true;
+}
+
+/**
+ * Get a buffer of NET_ZC_BUF_SIZE bytes from the pool.
+ *
+ * @return	the buffer, NULL if the pool is exhausted
+ */
+void *net_zc_buf_alloc(void) {
+	struct net_zc_buf *zc;
+	unsigned long flags;
+
+	flags = spin_lock_irqsave(&net_zc.lock);
+
+	if (unlikely(!net_zc.initialized))
+		zc_init_locked();
+
+	zc = net_zc.free;
+	if (zc)
+		net_zc.free = zc->next;
+
+	spin_unlock_irqrestore(&net_zc.lock, flags);
+
+	return (zc ? zc_data(zc) : NULL);
+}
+
+void net_zc_buf_free(void *buf) {
+	struct net_zc_buf *zc = &net_zc.bufs[zc_index(buf)];
+	unsigned long flags;
+
+	flags = spin_lock_irqsave(&net_zc.lock);
+
+	zc->owner = NET_ZC_NO_OWNER;
+	zc->next = net_zc.free;
+	net_zc.free = zc;
+
+	spin_unlock_irqrestore(&net_zc.lock, flags);
+}
+
+/*
+ * Called by pbuf_free() when the last reference to a pool buffer is dropped.
+ */
+static void zc_pbuf_free(struct pbuf *p) {
+	struct net_zc_buf *zc = (struct net_zc_buf *) p;
+
+	net_zc_buf_free(zc_data(zc));
+}
+
+static inline bool zc_pbuf(struct pbuf *p) {
+	return ((p->flags & PBUF_FLAG_IS_CUSTOM) && (((struct pbuf_custom *) p)->custom_free_function == zc_pbuf_free));
+}
+
+/**
+ * Wrap a pool buffer which holds a received frame of @len bytes into a pbuf.
+ * The buffer goes back to the pool when the pbuf is freed.
+ */
+struct pbuf *net_zc_pbuf(void *buf, u16 len) {
+	struct net_zc_buf *zc = &net_zc.bufs[zc_index(buf)];
+
+	zc->pc.custom_free_function = zc_pbuf_free;
+
+	return pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &zc->pc, buf, NET_ZC_BUF_SIZE);
+}
+
+/**
+ * Allocate a pbuf of @len bytes in the pool, for the drivers which copy
+ * the frames from the device (FIFO).
+ *
+ * @return	the pbuf, NULL if the pool is exhausted
+ */
+struct pbuf *net_zc_pbuf_alloc(u16 len) {
+	void *buf;
+
+	if (len > NET_ZC_BUF_SIZE)
+		return NULL;
+
+	buf = net_zc_buf_alloc();
+	if (!buf)
+		return NULL;
+
+	return net_zc_pbuf(buf, len);
+}
+
+/**
+ * SIOCZCENABLE: let the socket @gfd map the pool and receive without copy.
+ */
+void net_zc_enable(int gfd) {
+	net_zc.enabled[gfd] = true;
+}
+
+bool net_zc_enabled(int gfd) {
+	return net_zc.enabled[gfd];
+}
+
+/**
+ * Size of the pool, to be mapped with mmap() on a socket.
+ */
+u32 net_zc_size(void) {
+	return NET_ZC_POOL_SIZE;
+}
+
+/**
+ * Register the window of the current process at @virt_addr (mmap() on a socket).
+ * Nothing is mapped yet: the buffers are mapped along SIOCZCRECV. A new window
+ * of the process replaces the previous one.
+ */
+void *net_zc_mmap(addr_t virt_addr, uint32_t page_count) {
+	pcb_t *pcb = current()->pcb;
+	struct net_zc_win *win = NULL;
+	unsigned long flags;
+	int i;
+
+	if (page_count != CONFIG_NET_ZC_RX_PAGES) {
+		set_errno(EINVAL);
+		return NULL;
+	}
+
+	flags = spin_lock_irqsave(&net_zc.lock);
+
+	for (i = 0; i < NET_ZC_NR_WINDOWS; i++)
+		if (net_zc.wins[i].used && (net_zc.wins[i].pid == pcb->pid))
+			win = &net_zc.wins[i];
+
+	/* The slots of the processes which have gone are reused */
+	for (i = 0; !win && (i < NET_ZC_NR_WINDOWS); i++)
+		if (!net_zc.wins[i].used || !find_proc_by_pid(net_zc.wins[i].pid))
+			win = &net_zc.wins[i];
+
+	if (win) {
+		win->used = true;
+		win->pid = pcb->pid;
+		win->vaddr = virt_addr;
+	}
+
+	spin_unlock_irqrestore(&net_zc.lock, flags);
+
+	if (!win) {
+		set_errno(ENOMEM);
+		return NULL;
+	}
+
+	return (void *) virt_addr;
+}
+
+/*
+ * Window of the process @pcb, 0 if it has none.
+ */
+static addr_t zc_window(pcb_t *pcb) {
+	unsigned long flags;
+	addr_t vaddr = 0;
+	int i;
+
+	flags = spin_lock_irqsave(&net_zc.lock);
+
+	for (i = 0; i < NET_ZC_NR_WINDOWS; i++)
+		if (net_zc.wins[i].used && (net_zc.wins[i].pid == pcb->pid))
+			vaddr = net_zc.wins[i].vaddr;
+
+	spin_unlock_irqrestore(&net_zc.lock, flags);
+
+	return vaddr;
+}
+
+/*
+ * Map the buffer read-only into the window of @pcb. The window may have been
+ * unmapped by the process meanwhile: the buffer is then not mapped.
+ */
+static void zc_map(pcb_t *pcb, addr_t win, struct net_zc_buf *zc) {
+	addr_t vaddr = win + (zc - net_zc.bufs) * NET_ZC_BUF_SIZE;
+	unsigned long flags;
+	vma_t *vma;
+
+	flags = spin_lock_irqsave(&pcb->mm_lock);
+
+	vma = vma_find(pcb, vaddr);
+	if (vma && (vma->flags & VMA_DONTCOPY)) {
+		create_mapping(pcb->pgtable, vaddr, __pa(zc_data(zc)), PAGE_SIZE, false);
+		set_user_page_prot(pcb->pgtable, vaddr, true, false, false);
+
+		zc->map_pid = pcb->pid;
+		zc->map_vaddr = vaddr;
+	}
+
+	spin_unlock_irqrestore(&pcb->mm_lock, flags);
+}
+
+/*
+ * Remove the buffer from the window it has been mapped into, before it goes
+ * back to the pool. The process may have gone or unmapped its window.
+ */
+static void zc_unmap(struct net_zc_buf *zc) {
+	unsigned long flags;
+	pcb_t *pcb;
+	vma_t *vma;
+
+	if (!zc->map_vaddr)
+		return ;
+
+	pcb = find_proc_by_pid(zc->map_pid);
+	if (pcb) {
+		flags = spin_lock_irqsave(&pcb->mm_lock);
+
+		vma = vma_find(pcb, zc->map_vaddr);
+		if (vma && (vma->flags & VMA_DONTCOPY))
+			release_user_page(pcb->pgtable, zc->map_vaddr);
+
+		spin_unlock_irqrestore(&pcb->mm_lock, flags);
+	}
+
+	zc->map_vaddr = 0;
+}
+
+/*
+ * Detach the first pbuf of a chain, whose reference is given to the rest of the chain.
+ */
+static struct pbuf *zc_dechain(struct pbuf *p) {
+	struct pbuf *next = p->next;
+
+	if (next) {
+		pbuf_ref(next);
+		pbuf_dechain(p);
+	}
+
+	return next;
+}
+
+/*
+ * Give a single pbuf to the socket @gfd as segment @seg, mapped into the window
+ * @win of the process @pcb. The data which is not in the pool is copied into a
+ * pool buffer; beyond the size of a buffer, the rest is left in the pbuf.
+ *
+ * @return	the length of the segment, -1 if the data has to be copied and the pool is exhausted
+ */
+static int zc_take(int gfd, struct pbuf *p, struct net_zc_seg *seg, pcb_t *pcb, addr_t win) {
+	struct net_zc_buf *zc;
+	unsigned long flags;
+	u16 len = p->len;
+	u8 *end;
+	void *buf;
+
+	if (!zc_pbuf(p)) {
+		buf = net_zc_buf_alloc();
+		if (!buf)
+			return -1;
+
+		if (len > NET_ZC_BUF_SIZE)
+			len = NET_ZC_BUF_SIZE;
+
+		memcpy(buf, p->payload, len);
+
+		if (len < p->len)
+			pbuf_remove_header(p, len);
+		else
+			pbuf_free(p);
+
+		p = net_zc_pbuf(buf, len);
+	}
+
+	zc = (struct net_zc_buf *) p;
+
+	/* The rest of the page may still hold a previous frame */
+	end = (u8 *) zc_data(zc) + NET_ZC_BUF_SIZE;
+	memset((u8 *) p->payload + p->len, 0, end - ((u8 *) p->payload + p->len));
+
+	/* Mapped before it can be recycled */
+	zc_map(pcb, win, zc);
+
+	flags = spin_lock_irqsave(&net_zc.lock);
+	zc->owner = zc_owner(gfd);
+	spin_unlock_irqrestore(&net_zc.lock, flags);
+
+	seg->offset = (u8 *) p->payload - net_zc_pool;
+	seg->len = p->len;
+	seg->id = zc - net_zc.bufs;
+
+	return len;
+}
+
+/**
+ * SIOCZCRECV: return the next received data of a TCP socket as segments of the
+ * window of the calling process. Waits for data unless MSG_DONTWAIT is given, as recv().
+ *
+ * @return	the total length of the segments, 0 at the end of the stream, -1 on error
+ */
+int net_zc_recv(int gfd, int lwip_fd, struct net_zc_recv *req) {
+	pcb_t *pcb = current()->pcb;
+	struct pbuf *p, *next;
+	int flags = user_to_lwip_msg_flags(req->flags);
+	u32 max = min(req->max_segs, (u32) NET_ZC_MAX_SEGS);
+	ssize_t ret;
+	addr_t win;
+	int taken;
+	u16 len;
+
+	req->nr_segs = 0;
+	req->len = 0;
+
+	/* The process must have a window on the pool */
+	win = zc_window(pcb);
+
+	if (!max || !win) {
+		set_errno(EINVAL);
+		return -1;
+	}
+
+	p = net_zc.pending[gfd];
+	net_zc.pending[gfd] = NULL;
+
+	while (req->nr_segs < max) {
+
+		if (!p) {
+			ret = lwip_recv_pbuf(lwip_fd, &p, flags);
+			if (ret <= 0) {
+				/* Report the error or the end of the stream with the next request */
+				if (req->nr_segs)
+					break;
+
+				return ret;
+			}
+
+			/* Gather what is already there, without waiting any more */
+			flags |= MSG_DONTWAIT;
+		}
+
+		len = p->len;
+		next = zc_dechain(p);
+
+		if (!len) {
+			pbuf_free(p);
+		} else if ((taken = zc_take(gfd, p, &req->segs[req->nr_segs], pcb, win)) < 0) {
+			/* Keep the data for the next request once buffers have been recycled */
+			if (next)
+				pbuf_cat(p, next);
+			break;
+		} else {
+			req->len += taken;
+			req->nr_segs++;
+
+			/* The rest of a pbuf larger than a buffer comes next */
+			if (taken < len) {
+				if (next)
+					pbuf_cat(p, next);
+				next = p;
+			}
+		}
+
+		p = next;
+	}
+
+	net_zc.pending[gfd] = p;
+
+	if (!req->nr_segs) {
+		set_errno(ENOBUFS);
+		return -1;
+	}
+
+	return req->len;
+}
+
+/**
+ * SIOCZCRECYCLE: give back buffers returned by SIOCZCRECV on the socket @gfd.
+ *
+ * @return	0, -1 if a buffer is not held by the socket (the others are recycled)
+ */
+int net_zc_recycle(int gfd, struct net_zc_recycle *req) {
+	struct net_zc_buf *zc;
+	unsigned long flags;
+	u32 i, nr = min(req->nr_ids, (u32) NET_ZC_MAX_SEGS);
+	int ret = 0;
+
+	for (i = 0; i < nr; i++) {
+		if (req->ids[i] >= NET_ZC_NR_BUFS) {
+			ret = -1;
+			continue;
+		}
+
+		zc = &net_zc.bufs[req->ids[i]];
+
+		flags = spin_lock_irqsave(&net_zc.lock);
+
+		if (zc->owner != zc_owner(gfd)) {
+			spin_unlock_irqrestore(&net_zc.lock, flags);
+			ret = -1;
+			continue;
+		}
+
+		zc->owner = NET_ZC_NO_OWNER;
+
+		spin_unlock_irqrestore(&net_zc.lock, flags);
+
+		zc_unmap(zc);
+		pbuf_free(&zc->pc.pbuf);
+	}
+
+	if (ret)
+		set_errno(EINVAL);
+
+	return ret;
+}
+
+/**
+ * Release the buffers still held by the socket @gfd which is being closed.
+ */
+void net_zc_release(int gfd) {
+	struct net_zc_recycle req;
+	int i;
+
+	net_zc.enabled[gfd] = false;
+
+	if (net_zc.pending[gfd]) {
+		pbuf_free(net_zc.pending[gfd]);
+		net_zc.pending[gfd] = NULL;
+	}
+
+	req.nr_ids = 0;
+
+	for (i = 0; i < NET_ZC_NR_BUFS; i++) {
+		if (net_zc.bufs[i].owner != zc_owner(gfd))
+			continue;
+
+		req.ids[req.nr_ids++] = i;
+
+		if (req.nr_ids == NET_ZC_MAX_SEGS) {
+			net_zc_recycle(gfd, &req);
+			req.nr_ids = 0;
+		}
+	}
+
+	if (req.nr_ids)
+		net_zc_recycle(gfd, &req);
+}
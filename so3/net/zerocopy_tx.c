@@ -0,0 +1,301 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Zero-copy socket send (MSG_ZEROCOPY on UDP and RAW sockets).
+ *
+ * The datagram is given to lwIP as a chain of custom pbufs which refer to the
+ * user pages through the linear mapping, so that the driver can still reach
+ * them from any context. Each fragment holds a reference on its page frame, so
+ * that the frame is not reused if the sender unmaps it or exits while the data
+ * is still queued. Each message holds a reference per pbuf; once the stack and
+ * the driver have released all of them, the message is completed and its id is
+ * returned by SIOCZCSENDDONE. The user buffer must be left untouched until then.
+ *
+ * The ids of a socket are given in sequence to its messages, starting at 0,
+ * in the order they have been sent. The data which cannot be referenced
+ * (unmapped page, too many fragments) is copied, and the id of the message is
+ * then completed with NET_ZC_TX_COPIED.
+ */
+
+#include <common.h>
+#include <memory.h>
+#include <errno.h>
+#include <spinlock.h>
+#include <process.h>
+#include <vfs.h>
+#include <net.h>
+
+#include <net/zerocopy.h>
+
+#include <net/lwip/pbuf.h>
+
+#include <asm/mmu.h>
+
+/* A page-crossing buffer takes two fragments */
+#define NET_ZC_TX_MAX_FRAGS	8
+
+/* Owner of a message: gfd + 1, 0 if the socket has been closed */
+#define NET_ZC_NO_OWNER		0
+#define zc_owner(gfd)		((gfd) + 1)
+
+#define NET_ZC_TX_FREE		0
+#define NET_ZC_TX_BUSY		1
+#define NET_ZC_TX_DONE		2
+
+struct net_zc_txfrag {
+	struct pbuf_custom pc;
+	struct net_zc_txmsg *msg;
+
+	/* Frame referenced by the fragment, NULL if not owned by a process */
+	page_t *page;
+};
+
+struct net_zc_txmsg {
+	struct net_zc_txfrag frags[NET_ZC_TX_MAX_FRAGS];
+
+	/* One reference per fragment, plus the one of the sender until net_zc_tx_complete() */
+	int refcnt;
+
+	int state;
+	int owner;
+	bool copied;
+	u32 id;
+};
+
+static struct {
+	struct net_zc_txmsg msgs[CONFIG_NET_ZC_TX_MSGS];
+
+	/* Id of the next message sent on a socket */
+	u32 seq[MAX_FDS];
+
+	spinlock_t lock;
+} net_zc_tx;
+
+/* Called with the lock held */
+static void zc_tx_put(struct net_zc_txmsg *msg) {
+	if (--msg->refcnt)
+		return ;
+
+	msg->state = ((msg->owner == NET_ZC_NO_OWNER) ? NET_ZC_TX_FREE : NET_ZC_TX_DONE);
+}
+
+/*
+ * Called by pbuf_free() when the stack or the driver releases a fragment.
+ */
+static void zc_tx_frag_free(struct pbuf *p) {
+	struct net_zc_txfrag *frag = (struct net_zc_txfrag *) p;
+	page_t *page = frag->page;
+	unsigned long flags;
+
+	/* The fragment belongs to the message and may be reused once it is put */
+	flags = spin_lock_irqsave(&net_zc_tx.lock);
+	zc_tx_put(frag->msg);
+	spin_unlock_irqrestore(&net_zc_tx.lock, flags);
+
+	if (page)
+		put_page(page);
+}
+
+static struct net_zc_txmsg *zc_tx_alloc(int gfd) {
+	struct net_zc_txmsg *msg = NULL;
+	unsigned long flags;
+	int i;
+
+	flags = spin_lock_irqsave(&net_zc_tx.lock);
+
+	for (i = 0; i < CONFIG_NET_ZC_TX_MSGS; i++) {
+		if (net_zc_tx.msgs[i].state == NET_ZC_TX_FREE) {
+			msg = &net_zc_tx.msgs[i];
+
+			msg->state = NET_ZC_TX_BUSY;
+			msg->owner = zc_owner(gfd);
+			msg->refcnt = 1;
+			msg->copied = false;
+			break;
+		}
+	}
+
+	spin_unlock_irqrestore(&net_zc_tx.lock, flags);
+
+	return msg;
+}
+
+/*
+ * Build the chain of fragments which refer to the user buffers.
+ *
+ * @return	the chain, NULL if the data has to be copied
+ */
+static struct pbuf *zc_tx_chain(struct net_zc_txmsg *msg, const struct iovec *iov, int iovcnt) {
+	struct net_zc_txfrag *frag;
+	struct pbuf *p = NULL, *q;
+	unsigned long flags;
+	addr_t vaddr, paddr;
+	size_t len, chunk;
+	int i, nr = 0;
+
+	for (i = 0; i < iovcnt; i++) {
+		vaddr = (addr_t) iov[i].iov_base;
+		len = iov[i].iov_len;
+
+		while (len) {
+			chunk = PAGE_SIZE - (vaddr & ~PAGE_MASK);
+			if (chunk > len)
+				chunk = len;
+
+			if ((nr == NET_ZC_TX_MAX_FRAGS) || !user_space_vaddr(vaddr) ||
+			    !user_page_mapped(current_pgtable(), vaddr & PAGE_MASK))
+				goto copy;
+
+			paddr = virt_to_phys_pt(vaddr);
+
+			frag = &msg->frags[nr++];
+			frag->msg = msg;
+			frag->pc.custom_free_function = zc_tx_frag_free;
+
+			/* Keep the frame until the fragment is released */
+			frag->page = phys_to_page(paddr);
+			if (!pfn_valid(phys_to_pfn(paddr)) || !get_page_unless_zero(frag->page))
+				frag->page = NULL;
+
+			flags = spin_lock_irqsave(&net_zc_tx.lock);
+			msg->refcnt++;
+			spin_unlock_irqrestore(&net_zc_tx.lock, flags);
+
+			q = pbuf_alloced_custom(PBUF_RAW, chunk, PBUF_ROM, &frag->pc,
+						(void *) __va(paddr), chunk);
+			if (p)
+				pbuf_cat(p, q);
+			else
+				p = q;
+
+			vaddr += chunk;
+			len -= chunk;
+		}
+	}
+
+	return p;
+
+copy:
+	/* The reference of the sender keeps the message */
+	if (p)
+		pbuf_free(p);
+
+	return NULL;
+}
+
+/**
+ * Prepare a datagram of @len bytes to be sent without copy on the socket @gfd.
+ * *p is set to the chain of pbufs which refer to the user buffers, or to NULL
+ * if the data must be copied by the caller.
+ * net_zc_tx_complete() must be called once the datagram has been given to lwIP.
+ *
+ * @return	the message, NULL if too many messages are in flight (ENOBUFS)
+ */
+struct net_zc_txmsg *net_zc_tx_prepare(int gfd, const struct iovec *iov, int iovcnt, size_t len, struct pbuf **p) {
+	struct net_zc_txmsg *msg;
+
+	msg = zc_tx_alloc(gfd);
+	if (!msg) {
+		set_errno(ENOBUFS);
+		return NULL;
+	}
+
+	*p = (len ? zc_tx_chain(msg, iov, iovcnt) : NULL);
+	if (!*p)
+		msg->copied = true;
+
+	return msg;
+}
+
+/**
+ * Drop the reference of the sender. The message gets its id if it has been
+ * sent; it is completed once its data is not used any more.
+ */
+void net_zc_tx_complete(int gfd, struct net_zc_txmsg *msg, bool sent) {
+	unsigned long flags;
+
+	flags = spin_lock_irqsave(&net_zc_tx.lock);
+
+	if (sent)
+		msg->id = (net_zc_tx.seq[gfd]++ & ~NET_ZC_TX_COPIED) | (msg->copied ? NET_ZC_TX_COPIED : 0);
+	else
+		msg->owner = NET_ZC_NO_OWNER;
+
+	zc_tx_put(msg);
+
+	spin_unlock_irqrestore(&net_zc_tx.lock, flags);
+}
+
+/**
+ * SIOCZCSENDDONE: return the ids of the messages of the socket @gfd which
+ * have been completed since the last call.
+ *
+ * @return	the number of ids
+ */
+int net_zc_tx_done(int gfd, struct net_zc_txdone *req) {
+	struct net_zc_txmsg *msg;
+	unsigned long flags;
+	int i;
+
+	req->nr_ids = 0;
+
+	flags = spin_lock_irqsave(&net_zc_tx.lock);
+
+	for (i = 0; (i < CONFIG_NET_ZC_TX_MSGS) && (req->nr_ids < NET_ZC_MAX_SEGS); i++) {
+		msg = &net_zc_tx.msgs[i];
+
+		if ((msg->state != NET_ZC_TX_DONE) || (msg->owner != zc_owner(gfd)))
+			continue;
+
+		req->ids[req->nr_ids++] = msg->id;
+		msg->state = NET_ZC_TX_FREE;
+	}
+
+	spin_unlock_irqrestore(&net_zc_tx.lock, flags);
+
+	return req->nr_ids;
+}
+
+/**
+ * Forget the messages of the socket @gfd which is being closed. Those still
+ * in flight are freed once sent.
+ */
+void net_zc_tx_release(int gfd) {
+	struct net_zc_txmsg *msg;
+	unsigned long flags;
+	int i;
+
+	flags = spin_lock_irqsave(&net_zc_tx.lock);
+
+	for (i = 0; i < CONFIG_NET_ZC_TX_MSGS; i++) {
+		msg = &net_zc_tx.msgs[i];
+
+		if ((msg->state == NET_ZC_TX_FREE) || (msg->owner != zc_owner(gfd)))
+			continue;
+
+		if (msg->state == NET_ZC_TX_DONE)
+			msg->state = NET_ZC_TX_FREE;
+		else
+			msg->owner = NET_ZC_NO_OWNER;
+	}
+
+	net_zc_tx.seq[gfd] = 0;
+
+	spin_unlock_irqrestore(&net_zc_tx.lock, flags);
+}
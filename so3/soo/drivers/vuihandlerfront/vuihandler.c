@@ -261,7 +261,7 @@ void vuihandler_init_tx_circ_buf(struct vbus_device *vdev) {
 
 
 void vuihandler_probe(struct vbus_device *vdev) {
-	unsigned int rx_evtchn, tx_evtchn;
+	uint32_t evtchns[2];
 	vuihandler_rx_sring_t *rx_sring;
 	vuihandler_tx_sring_t *tx_sring;
 	struct vbus_transaction vbt;
@@ -272,13 +272,14 @@ void vuihandler_probe(struct vbus_device *vdev) {
 	vuihandler_priv = dev_get_drvdata(vdev->dev);
 	vuihandler_dev = vdev;
 
+	/* Event channels of the RX and TX rings */
+	vbus_alloc_evtchns(vdev, evtchns, ARRAY_SIZE(evtchns));
+
 	/* RX ring init */
 	vuihandler_priv->vuihandler.rx_ring_ref = GRANT_INVALID_REF;
 
-	vbus_alloc_evtchn(vdev, &rx_evtchn);
-
-	vuihandler_priv->vuihandler.rx_irq = bind_evtchn_to_irq_handler(rx_evtchn, vuihandler_rx_interrupt, NULL, vdev);
-	vuihandler_priv->vuihandler.rx_evtchn = rx_evtchn;
+	vuihandler_priv->vuihandler.rx_irq = bind_evtchn_to_irq_handler(evtchns[0], vuihandler_rx_interrupt, NULL, vdev);
+	vuihandler_priv->vuihandler.rx_evtchn = evtchns[0];
 
 	rx_sring = (vuihandler_rx_sring_t *) get_free_vpage();
 
@@ -304,10 +305,8 @@ void vuihandler_probe(struct vbus_device *vdev) {
 	/* TX ring init */
 	vuihandler_priv->vuihandler.tx_ring_ref = GRANT_INVALID_REF;
 
-	vbus_alloc_evtchn(vdev, &tx_evtchn);
-
-	vuihandler_priv->vuihandler.tx_irq = bind_evtchn_to_irq_handler(tx_evtchn, vuihandler_tx_interrupt, NULL, vdev);
-	vuihandler_priv->vuihandler.tx_evtchn = tx_evtchn;
+	vuihandler_priv->vuihandler.tx_irq = bind_evtchn_to_irq_handler(evtchns[1], vuihandler_tx_interrupt, NULL, vdev);
+	vuihandler_priv->vuihandler.tx_evtchn = evtchns[1];
 
 	tx_sring = (vuihandler_tx_sring_t *) get_free_vpage();
 
@@ -409,6 +408,8 @@ void vuihandler_shutdown(struct vbus_device *vdev) {
 
 void vuihandler_closed(struct vbus_device *vdev) {
 	vuihandler_priv_t *vuihandler_priv = dev_get_drvdata(vdev->dev);
+	grant_ref_t refs[2];
+	unsigned int nr = 0;
 
 	DBG0(VUIHANDLER_PREFIX "Frontend close\n");
 
@@ -416,10 +417,17 @@ void vuihandler_closed(struct vbus_device *vdev) {
 	 * Free the ring and deallocate the proper data.
 	 */
 
+	/* Both grants are revoked with a single hypercall */
+	if (vuihandler_priv->vuihandler.rx_ring_ref != GRANT_INVALID_REF)
+		refs[nr++] = vuihandler_priv->vuihandler.rx_ring_ref;
+	if (vuihandler_priv->vuihandler.tx_ring_ref != GRANT_INVALID_REF)
+		refs[nr++] = vuihandler_priv->vuihandler.tx_ring_ref;
+
+	gnttab_end_foreign_access_multi(refs, nr);
+
 	/* Free resources associated with old device channel. */
 	/* RX side */
 	if (vuihandler_priv->vuihandler.rx_ring_ref != GRANT_INVALID_REF) {
-		gnttab_end_foreign_access(vuihandler_priv->vuihandler.rx_ring_ref);
 		free_vpage((addr_t) vuihandler_priv->vuihandler.rx_ring.sring);
 
 		vuihandler_priv->vuihandler.rx_ring_ref = GRANT_INVALID_REF;
@@ -432,7 +440,6 @@ void vuihandler_closed(struct vbus_device *vdev) {
 	
 	/* TX side */
 	if (vuihandler_priv->vuihandler.tx_ring_ref != GRANT_INVALID_REF) {
-		gnttab_end_foreign_access(vuihandler_priv->vuihandler.tx_ring_ref);
 		free_vpage((addr_t) vuihandler_priv->vuihandler.tx_ring.sring);
 
 		vuihandler_priv->vuihandler.tx_ring_ref = GRANT_INVALID_REF;
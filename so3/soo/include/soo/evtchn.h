@@ -21,6 +21,7 @@
 
 #include <heap.h>
 #include <memory.h>
+#include <trace.h>
 
 #include <asm/processor.h>
 #include <asm/cacheflush.h>
@@ -56,6 +57,8 @@ static inline void notify_remote_via_evtchn(uint32_t evtchn)
 {
         avz_hyp_t args;
 
+        trace(TRACE_EVTCHN_SEND, evtchn, 0);
+
         args.cmd = AVZ_EVENT_CHANNEL_OP;
         
         args.u.avz_evtchn.evtchn_op.cmd = EVTCHNOP_send;
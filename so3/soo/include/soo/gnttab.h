@@ -36,6 +36,7 @@ int gnttab_grant_foreign_access(domid_t domid, unsigned long frame);
  * some time later.
  */
 void gnttab_end_foreign_access(grant_ref_t ref);
+void gnttab_end_foreign_access_multi(grant_ref_t *refs, unsigned int nr);
 
 void gnttab_map(domid_t domid, grant_ref_t grant_ref, void **vaddr);
 
@@ -35,6 +35,8 @@ int do_sync_directcomm(void *arg);
 void avz_get_shared(void);
 void avz_gnttab(gnttab_op_t *op);
 
+int avz_multicall(multicall_entry_t *entries, unsigned int nr);
+
 void avz_sig_terminate(void);
 
 #endif /* __HYPERVISOR_H__ */
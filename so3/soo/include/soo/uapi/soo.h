@@ -184,11 +184,17 @@ typedef struct evtchn_op evtchn_op_t;
 #define DOMCTL_pauseME       	1
 #define DOMCTL_unpauseME     	2
 #define DOMCTL_get_AVZ_shared	3
+#define DOMCTL_sched_adjust	4
 
 struct domctl {
     uint32_t cmd;
     domid_t  domain;
     addr_t avz_shared_paddr;    
+
+    /* DOMCTL_sched_adjust: relative weight and cap (% of a CPU, 0 = no cap) */
+    uint32_t weight;
+    uint32_t cap;
+    int result;
 };
 typedef struct domctl domctl_t;
 
@@ -412,6 +418,8 @@ typedef struct {
 #define AVZ_CONSOLE_IO_OP		18
 #define AVZ_DOMAIN_CONTROL_OP           19
 #define AVZ_GRANT_TABLE_OP              20
+#define AVZ_ME_PRECOPY			21
+#define AVZ_MULTICALL			22
 
 /* AVZ_EVENT_CHANNEL_OP */
 typedef struct {
@@ -463,6 +471,66 @@ typedef struct {
         int size;
 } avz_snapshot_t;
 
+/* AVZ_ME_PRECOPY */
+
+/*
+ * Live (pre-copy) migration of a ME
+ *
+ * - PRECOPY_START: start tracking the pages written by the ME (dirty logging).
+ *                  All pages are considered as dirty for the first round.
+ * - PRECOPY_ROUND: copy the pages dirtied since the previous round into the
+ *                  buffer while the ME keeps running. <size> gives the buffer size
+ *                  and returns the number of bytes written into it.
+ * - PRECOPY_WRITE: (destination side) apply a round buffer to the reserved slot.
+ * - PRECOPY_ABORT: stop dirty logging, the ME keeps running normally.
+ *
+ * The final stop-and-copy is achieved with AVZ_ME_READ_SNAPSHOT once the ME is
+ * suspended: only the residual dirty pages are then transferred along with the
+ * domain context.
+ *
+ * On the destination, the slot is reserved with AVZ_ME_WRITE_SNAPSHOT (slotID 0,
+ * no buffer and a size covering the dom_context and the ME memory) before the
+ * first PRECOPY_WRITE.
+ */
+#define PRECOPY_START			0
+#define PRECOPY_ROUND			1
+#define PRECOPY_WRITE			2
+#define PRECOPY_ABORT			3
+
+typedef struct {
+	/* Number of rounds achieved so far */
+	uint32_t round;
+
+	/* Pages transferred during the last round */
+	uint32_t pages_sent;
+
+	/* Pages dirtied by the ME during the last round (still to be sent) */
+	uint32_t pages_dirty;
+
+	/* Total number of pages of the ME */
+	uint32_t pages_total;
+
+	/* Total number of pages transferred since PRECOPY_START */
+	uint64_t total_sent;
+
+	/* Duration of the last round (ns) */
+	uint64_t round_ns;
+
+	/* Pages dirtied per second during the last round */
+	uint64_t dirty_rate;
+
+	/* Estimated downtime (ns) if the final stop-and-copy was done now */
+	uint64_t downtime_ns;
+} precopy_stats_t;
+
+typedef struct {
+	uint32_t slotID;
+	int op;
+	void *buffer_paddr;
+	int size;
+	precopy_stats_t stats;
+} avz_precopy_t;
+
 /* AVZ_MIG_FINAL */
 typedef struct {
         uint32_t slotID;
@@ -488,6 +556,26 @@ typedef struct {
         gnttab_op_t gnttab_op;
 } avz_gnttab_t;
 
+/* AVZ_MULTICALL
+ *
+ * Execute a batch of hypercalls with a single trap. <entries_paddr> is the
+ * (guest physical) address of an array of <nr> multicall_entry_t which the
+ * hypervisor processes in order; the arguments of each entry are updated
+ * in place like with a single hypercall and <result> gives the status of
+ * the entry (0, or -ENOSYS/-EINVAL if the sub-hypercall was rejected).
+ *
+ * A multicall cannot be nested.
+ */
+#define MULTICALL_MAX_ENTRIES	16
+
+typedef struct {
+	addr_t entries_paddr;
+	uint32_t nr;
+
+	/* Number of entries which have been rejected */
+	uint32_t nr_failed;
+} avz_multicall_t;
+
 /*
  * AVZ hypercall argument
  */
@@ -507,9 +595,17 @@ typedef struct {
                 avz_console_io_t avz_console_io_args;
                 avz_domctl_t avz_domctl_args;
                 avz_gnttab_t avz_gnttab_args;
+                avz_precopy_t avz_precopy_args;
+                avz_multicall_t avz_multicall_args;
         } u;
 } avz_hyp_t;
 
+/* Entry of an AVZ_MULTICALL batch */
+typedef struct {
+	avz_hyp_t args;
+	int result;
+} multicall_entry_t;
+
 typedef struct {
 	void *val;
 } pre_suspend_args_t;
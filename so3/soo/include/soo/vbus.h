@@ -211,6 +211,8 @@ void vbus_alloc_evtchn(struct vbus_device *dev, uint32_t *port);
 void vbus_bind_evtchn(struct vbus_device *dev, uint32_t remote_port, uint32_t *port);
 void vbus_free_evtchn(struct vbus_device *dev, uint32_t port);
 
+void vbus_alloc_evtchns(struct vbus_device *dev, uint32_t *ports, unsigned int nr);
+
 enum vbus_state vbus_read_driver_state(const char *path);
 bool vbus_read_driver_realtime(const char *path);
 
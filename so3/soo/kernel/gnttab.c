@@ -22,6 +22,7 @@
 #endif
 
 #include <memory.h>
+#include <heap.h>
 
 #include <soo/gnttab.h>
 #include <soo/hypervisor.h>
@@ -83,4 +84,32 @@ void gnttab_end_foreign_access(grant_ref_t ref)
         avz_gnttab(&gnttab_op);
 }
 
+/**
+ * @brief End the access through several grant references with a single
+ *        hypercall (multicall), typically when a frontend is closed.
+ *
+ * @param refs   Array of grant references
+ * @param nr     Number of references (up to MULTICALL_MAX_ENTRIES)
+ */
+void gnttab_end_foreign_access_multi(grant_ref_t *refs, unsigned int nr)
+{
+        multicall_entry_t *entries;
+        int i;
+
+        BUG_ON(nr > MULTICALL_MAX_ENTRIES);
+
+        entries = malloc(nr * sizeof(multicall_entry_t));
+        BUG_ON(!entries);
+
+        for (i = 0; i < nr; i++) {
+                entries[i].args.cmd = AVZ_GRANT_TABLE_OP;
+                entries[i].args.u.avz_gnttab_args.gnttab_op.cmd = GNTTAB_revoke_page;
+                entries[i].args.u.avz_gnttab_args.gnttab_op.ref = refs[i];
+        }
+
+        BUG_ON(avz_multicall(entries, nr) != 0);
+
+        free(entries);
+}
+
  
\ No newline at end of file
@@ -107,9 +107,9 @@ void avz_hypercall(avz_hyp_t *avz_hyp)
 
         memcpy(__avz_hyp, avz_hyp, sizeof(avz_hyp_t));
 
-        __asm_flush_dcache_range((addr_t) __avz_hyp, sizeof(avz_hyp_t));
+        __asm_flush_dcache_range((addr_t) __avz_hyp, (addr_t) __avz_hyp + sizeof(avz_hyp_t));
         __avz_hypercall(AVZ_HYPERCALL_TRAP, __pa(__avz_hyp));
-        __asm_invalidate_dcache_range((addr_t) __avz_hyp, sizeof(avz_hyp_t));
+        __asm_invalidate_dcache_range((addr_t) __avz_hyp, (addr_t) __avz_hyp + sizeof(avz_hyp_t));
 
         memcpy(avz_hyp, __avz_hyp, sizeof(avz_hyp_t));
 
@@ -117,6 +117,47 @@ void avz_hypercall(avz_hyp_t *avz_hyp)
                 free(__avz_hyp);
 }
 
+/**
+ * Issue a batch of hypercalls with a single trap (up to MULTICALL_MAX_ENTRIES).
+ *
+ * The arguments of each entry are updated in place as with avz_hypercall()
+ * and entries[i].result gives the status of the i-th hypercall.
+ *
+ * @return the number of entries which have been rejected by the hypervisor
+ */
+int avz_multicall(multicall_entry_t *entries, unsigned int nr)
+{
+        multicall_entry_t *__entries;
+        size_t size = nr * sizeof(multicall_entry_t);
+        avz_hyp_t args;
+
+        BUG_ON(nr > MULTICALL_MAX_ENTRIES);
+        BUG_ON(boot_stage < BOOT_STAGE_HEAP_READY);
+
+        if (!nr)
+                return 0;
+
+        /* As for a single hypercall, the batch must be in a linear-mapped zone */
+        __entries = malloc(size);
+        BUG_ON(!__entries);
+
+        memcpy(__entries, entries, size);
+        __asm_flush_dcache_range((addr_t) __entries, (addr_t) __entries + size);
+
+        args.cmd = AVZ_MULTICALL;
+        args.u.avz_multicall_args.entries_paddr = __pa(__entries);
+        args.u.avz_multicall_args.nr = nr;
+
+        avz_hypercall(&args);
+
+        __asm_invalidate_dcache_range((addr_t) __entries, (addr_t) __entries + size);
+        memcpy(entries, __entries, size);
+
+        free(__entries);
+
+        return args.u.avz_multicall_args.nr_failed;
+}
+
 void avz_sig_terminate(void) {
         __avz_hypercall(AVZ_HYPERCALL_SIGRETURN, 0);
 }
\ No newline at end of file
@@ -143,6 +143,37 @@ void vbus_alloc_evtchn(struct vbus_device *dev, uint32_t *evtchn)
 }
 
 
+/**
+ * Allocate several event channels for the given vbus_device with a single
+ * hypercall (multicall). The local evtchns are stored in evtchns[].
+ * The event channels are closed along with unbind_from_irqhandler().
+ */
+void vbus_alloc_evtchns(struct vbus_device *dev, uint32_t *evtchns, unsigned int nr)
+{
+        multicall_entry_t *entries;
+        int i;
+
+        BUG_ON(nr > MULTICALL_MAX_ENTRIES);
+
+        entries = malloc(nr * sizeof(multicall_entry_t));
+        BUG_ON(!entries);
+
+        for (i = 0; i < nr; i++) {
+                entries[i].args.cmd = AVZ_EVENT_CHANNEL_OP;
+
+                entries[i].args.u.avz_evtchn.evtchn_op.cmd = EVTCHNOP_alloc_unbound;
+                entries[i].args.u.avz_evtchn.evtchn_op.u.alloc_unbound.dom = DOMID_SELF;
+                entries[i].args.u.avz_evtchn.evtchn_op.u.alloc_unbound.remote_dom = dev->otherend_id;
+        }
+
+        BUG_ON(avz_multicall(entries, nr) != 0);
+
+        for (i = 0; i < nr; i++)
+                evtchns[i] = entries[i].args.u.avz_evtchn.evtchn_op.u.alloc_unbound.evtchn;
+
+        free(entries);
+}
+
 /**
  * Bind to an existing interdomain event channel in another domain. Returns 0
  * on success and stores the local evtchn in *evtchn. On error, returns -errno,
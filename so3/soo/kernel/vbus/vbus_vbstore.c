@@ -43,7 +43,7 @@
 #define PRINTF_BUFFER_SIZE 4096
 
 struct vbs_handle {
-	/* A list of replies. Currently only one will ever be outstanding. */
+	/* A list of replies. */
 	struct list_head reply_list;
 
 	/*
@@ -73,9 +73,73 @@ struct vbs_handle {
 	struct mutex watch_mutex;
 
 	spinlock_t msg_list_lock;
+
+	/*
+	 * Several requests may be outstanding. The room they take in the request ring
+	 * is released when their reply comes back; a sender waits on ring_space
+	 * if there is not enough room.
+	 */
+	unsigned int inflight;
+	bool ring_waiting;
+	struct completion ring_space;
+
+	/* Read cache, protected by cache_lock */
+	spinlock_t cache_lock;
+	uint32_t cache_gen;
 };
 static struct vbs_handle vbs_state;
 
+/*
+ * Request issued by this domain. The vbus_msg is the header which is copied
+ * into the ring; the reply is matched with its ID.
+ */
+struct vbs_request {
+	vbus_msg_t msg;
+
+	struct completion reply_wait;
+
+	/* The sender does not wait for the reply (batched transaction operations) */
+	bool posted;
+
+	/* Room taken in the request ring */
+	unsigned int size;
+};
+
+/* Maximum amount of request bytes which may be in flight */
+#define VBS_INFLIGHT_MAX	(VBSTORE_RING_SIZE / 2)
+
+/*
+ * A posted request has been rejected by vbstore. Nobody waits for its reply,
+ * so the failure is recorded until vbus_transaction_end() checks it.
+ * Protected by msg_list_lock.
+ */
+struct vbs_failed_request {
+	struct list_head list;
+	uint32_t transactionID;
+	uint32_t type;
+	uint32_t reply_type;
+};
+
+static LIST_HEAD(vbs_failed_requests);
+
+/*
+ * Client-side cache of values read from vbstore.
+ *
+ * Only nodes which are watched by this domain are cached, so that any change
+ * made by another domain is notified by a watch event which invalidates the
+ * entry. Values are not cached within a transaction.
+ */
+struct vbs_cache_entry {
+	struct list_head list;
+	char *path;
+	char *value;
+	unsigned int len;
+};
+
+static LIST_HEAD(vbs_cache);
+
+static struct vbus_watch *find_first_watch(struct list_head *__watches, const char *node);
+
 /* List of registered watches, and a lock to protect it. */
 static LIST_HEAD(watches);
 static LIST_HEAD(vbus_msg_standby_list);
@@ -104,17 +168,12 @@ void vbs_dump_watches(void) {
 /* Local reference to shared vbstore page between us and vbstore */
 volatile struct vbstore_domain_interface *__intf;
 
-/**
- * vbs_write - low level write
- * @data: buffer to send
- * @len: length of buffer
- *
- * Returns 0 on success, error otherwise.
+/*
+ * Get the place of <len> contiguous bytes in the request ring.
  */
-static void vbs_write(const void *data, unsigned len)
+static volatile char *vbs_ring_reserve(unsigned len)
 {
 	VBSTORE_RING_IDX prod;
-	volatile char *dst;
 
 	DBG("__intf->req_prod: %d __intf->req_pvt: %d __intf->req_cons: %d\n", __intf->req_prod, __intf->req_pvt, __intf->req_cons);
 
@@ -128,21 +187,36 @@ static void vbs_write(const void *data, unsigned len)
 			BUG();
 	}
 
-#warning assert that the ring is not full
-
-	dst = &__intf->req[prod];
-
 	/* Must write data /after/ reading the producer index. */
 	smp_mb();
 
-	memcpy((void *) dst, data, len);
+	return &__intf->req[prod];
+}
 
+static void vbs_ring_advance(unsigned len)
+{
 	__intf->req_pvt += len;
 
 	/* Other side must not see new producer until data is there. */
 	smp_mb();
 }
 
+/**
+ * vbs_write - low level write
+ * @data: buffer to send
+ * @len: length of buffer
+ */
+static void vbs_write(const void *data, unsigned len)
+{
+	volatile char *dst;
+
+	dst = vbs_ring_reserve(len);
+
+	memcpy((void *) dst, data, len);
+
+	vbs_ring_advance(len);
+}
+
 static void vbs_read(void *data, unsigned len)
 {
 	VBSTORE_RING_IDX cons;
@@ -171,64 +245,104 @@ static void vbs_read(void *data, unsigned len)
 }
 
 /*
- * Main function to send a message to vbstore. It is the only way to send a
- * message to vbstore. It follows a synchronous send/reply scheme.
+ * Wait until the request ring can accept <size> more bytes. A request larger
+ * than the limit is accepted if nothing else is in flight.
+ */
+static void vbs_wait_ring_space(unsigned int size)
+{
+	unsigned long flags;
+
+	for (;;) {
+		flags = spin_lock_irqsave(&vbs_state.msg_list_lock);
+
+		if (!vbs_state.inflight || (vbs_state.inflight + size <= VBS_INFLIGHT_MAX)) {
+			vbs_state.inflight += size;
+			spin_unlock_irqrestore(&vbs_state.msg_list_lock, flags);
+			return;
+		}
+
+		vbs_state.ring_waiting = true;
+
+		spin_unlock_irqrestore(&vbs_state.msg_list_lock, flags);
+
+		wait_for_completion(&vbs_state.ring_space);
+	}
+}
+
+/*
+ * Wait until all requests sent to vbstore have been answered. The caller holds
+ * request_mutex so that no new request can be sent meanwhile.
+ */
+static void vbs_wait_idle(void)
+{
+	unsigned long flags;
+
+	for (;;) {
+		flags = spin_lock_irqsave(&vbs_state.msg_list_lock);
+
+		if (!vbs_state.inflight) {
+			spin_unlock_irqrestore(&vbs_state.msg_list_lock, flags);
+			return;
+		}
+
+		vbs_state.ring_waiting = true;
+
+		spin_unlock_irqrestore(&vbs_state.msg_list_lock, flags);
+
+		wait_for_completion(&vbs_state.ring_space);
+	}
+}
+
+/*
+ * Send a message to vbstore. It is the only way to send a message to vbstore.
  * A message may have several strings within the payload. These (sub-)strings are known as vectors (msgvec_t).
+ *
+ * The sender does not hold the ring once the request is sent, so that other requests can be
+ * issued while waiting for the reply; the reply is matched with the message ID in the ISR.
  */
-static void *vbs_talkv(struct vbus_transaction t, vbus_msg_type_t type, const msgvec_t *vec, unsigned int num_vecs, unsigned int *len)
+static void vbs_send(struct vbs_request *req, struct vbus_transaction t, vbus_msg_type_t type, const msgvec_t *vec, unsigned int num_vecs)
 {
-	vbus_msg_t msg;
+	volatile char *dst;
 	unsigned int i;
-	char *payload	= NULL;
-	char *__payload_pos = NULL;
-	uint32_t flags;
+	unsigned long flags;
 
 	/* Interrupts must be enabled because we expect an (asynchronous) reply from the peer.*/
 	BUG_ON(local_irq_is_disabled());
 
-	mutex_lock(&vbs_state.request_mutex);
+	init_completion(&req->reply_wait);
+	req->msg.u.reply_wait = &req->reply_wait;
 
-	/* Message unique ID (on 32 bits) - 0 is a valid ID */
-	msg.id = vbus_msg_ID++;
+	req->msg.transactionID = t.id;
+	req->msg.type = type;
+	req->msg.len = 0;
+	for (i = 0; i < num_vecs; i++)
+		req->msg.len += vec[i].len;
 
-	msg.transactionID = t.id;
+	req->size = sizeof(vbus_msg_t) + req->msg.len;
 
-	/* Allocating a completion structure for this message - need to do that dynamically since the msg is part of the shared vbstore page
-	 * and the size may vary depending on SMP is enabled or not.
-	 */
-	msg.u.reply_wait = (struct completion *) malloc(sizeof(struct completion));
+	mutex_lock(&vbs_state.request_mutex);
 
-	init_completion(msg.u.reply_wait);
+	vbs_wait_ring_space(req->size);
 
-	msg.type = type;
-	msg.len = 0;
-	for (i = 0; i < num_vecs; i++)
-		msg.len += vec[i].len;
-
-	vbs_write(&msg, sizeof(msg));
+	/* Message unique ID (on 32 bits) - 0 is a valid ID */
+	req->msg.id = vbus_msg_ID++;
 
-	payload = malloc(msg.len);
-	if (payload == NULL) {
-		printk("%s:%d ERROR cannot kmalloc the msg payload.\n", __func__, __LINE__);
-		BUG();
-	}
-	memset(payload, 0, msg.len);
+	vbs_write(&req->msg, sizeof(vbus_msg_t));
 
-	__payload_pos = payload;
+	/* The payload is copied straight from the vectors into the ring. */
+	dst = vbs_ring_reserve(req->msg.len);
 	for (i = 0; i < num_vecs; i++) {
-		memcpy(__payload_pos, vec[i].base, vec[i].len);
-		__payload_pos += vec[i].len;
+		memcpy((void *) dst, vec[i].base, vec[i].len);
+		dst += vec[i].len;
 	}
+	vbs_ring_advance(req->msg.len);
 
-	DBG("Msg type: %d msg len: %d   content: %s\n", msg.type, msg.len, payload);
+	DBG("Msg type: %d msg len: %d ID: %d\n", req->msg.type, req->msg.len, req->msg.id);
 
-	vbs_write(payload, msg.len);
-	free(payload);
-
-	/* Store the current vbus_msg into the standby list for waiting the reply from vbstore. */
+	/* Store the request into the standby list for waiting the reply from vbstore. */
 	flags = spin_lock_irqsave(&vbs_state.msg_list_lock);
 
-	list_add_tail(&msg.list, &vbus_msg_standby_list);
+	list_add_tail(&req->msg.list, &vbus_msg_standby_list);
 
 	spin_unlock_irqrestore(&vbs_state.msg_list_lock, flags);
 
@@ -236,35 +350,213 @@ static void *vbs_talkv(struct vbus_transaction t, vbus_msg_type_t type, const ms
 
 	smp_mb();
 
+	mutex_unlock(&vbs_state.request_mutex);
+
 	notify_remote_via_evtchn(avz_shared->dom_desc.u.ME.vbstore_levtchn);
+}
+
+/*
+ * Send a message to vbstore and wait for the reply.
+ * Returns the (heap allocated) reply payload.
+ */
+static void *vbs_talkv(struct vbus_transaction t, vbus_msg_type_t type, const msgvec_t *vec, unsigned int num_vecs, unsigned int *len)
+{
+	struct vbs_request req;
+	void *payload;
+
+	req.posted = false;
+
+	vbs_send(&req, t, type, vec, num_vecs);
 
 	/* Now we are waiting for the answer from vbstore */
-	DBG("Now, we wait for the reply / msg ID: %d (0x%lx)\n", msg.id, &msg.list);
+	DBG("Now, we wait for the reply / msg ID: %d\n", req.msg.id);
 
-	wait_for_completion(msg.u.reply_wait);
+	wait_for_completion(&req.reply_wait);
 
-	DBG("Talkv protocol completed / reply: %lx\n", msg.reply);
+	DBG("Talkv protocol completed / reply: %lx\n", req.msg.reply);
 
 	/* Consistency check */
-	if ((msg.reply->type != msg.type) || (msg.reply->id != msg.id)) {
+	if ((req.msg.reply->type != req.msg.type) || (req.msg.reply->id != req.msg.id)) {
 		printk("%s: reply msg type or ID does not match...\n", __func__);
-		printk("VBus received type [%d] expected: %d, received ID [%d] expected: %d\n", msg.reply->type, msg.type, msg.reply->id, msg.id);
+		printk("VBus received type [%d] expected: %d, received ID [%d] expected: %d\n", req.msg.reply->type, req.msg.type, req.msg.reply->id, req.msg.id);
 		BUG();
 	}
 
-	payload = msg.reply->payload;
+	payload = req.msg.reply->payload;
 	if (len != NULL)
-		*len = msg.reply->len;
+		*len = req.msg.reply->len;
 
 	/* Free the reply msg */
-	free(msg.reply);
-	free(msg.u.reply_wait);
-
-	mutex_unlock(&vbs_state.request_mutex);
+	free(req.msg.reply);
 
 	return payload;
 }
 
+/*
+ * Send a message to vbstore without waiting for the reply. It is used for the
+ * update operations within a transaction: they are committed in a batch and
+ * vbus_transaction_end() waits for the whole transaction (vbstore processes
+ * and replies to the requests in order).
+ */
+static void vbs_post(struct vbus_transaction t, vbus_msg_type_t type, const msgvec_t *vec, unsigned int num_vecs)
+{
+	struct vbs_request *req;
+
+	req = malloc(sizeof(struct vbs_request));
+	BUG_ON(!req);
+
+	req->posted = true;
+
+	vbs_send(req, t, type, vec, num_vecs);
+}
+
+/*
+ * Issue an update operation: batched within a transaction, synchronous otherwise.
+ */
+static void vbs_update(struct vbus_transaction t, vbus_msg_type_t type, const msgvec_t *vec, unsigned int num_vecs)
+{
+	char *str;
+
+	if (t.id) {
+		vbs_post(t, type, vec, num_vecs);
+		return ;
+	}
+
+	str = vbs_talkv(t, type, vec, num_vecs, NULL);
+	if (IS_ERR(str))
+		BUG();
+
+	if (str)
+		free(str);
+}
+
+/*
+ * Look for a cached value. cache_lock must be held.
+ */
+static struct vbs_cache_entry *vbs_cache_lookup(const char *path)
+{
+	struct vbs_cache_entry *entry;
+
+	list_for_each_entry(entry, &vbs_cache, list)
+		if (!strcmp(entry->path, path))
+			return entry;
+
+	return NULL;
+}
+
+static void vbs_cache_free(struct vbs_cache_entry *entry)
+{
+	list_del(&entry->list);
+
+	free(entry->path);
+	free(entry->value);
+	free(entry);
+}
+
+/*
+ * Invalidate the cached values of a node and its subtree.
+ */
+static void vbs_cache_invalidate(const char *path)
+{
+	struct vbs_cache_entry *entry, *tmp;
+	size_t len = strlen(path);
+	unsigned long flags;
+
+	flags = spin_lock_irqsave(&vbs_state.cache_lock);
+
+	vbs_state.cache_gen++;
+
+	list_for_each_entry_safe(entry, tmp, &vbs_cache, list)
+		if (!strncmp(entry->path, path, len) && ((entry->path[len] == '\0') || (entry->path[len] == '/')))
+			vbs_cache_free(entry);
+
+	spin_unlock_irqrestore(&vbs_state.cache_lock, flags);
+}
+
+/*
+ * Drop the whole cache, e.g. when the ME is resumed on another smart object.
+ */
+static void vbs_cache_flush(void)
+{
+	struct vbs_cache_entry *entry, *tmp;
+	unsigned long flags;
+
+	flags = spin_lock_irqsave(&vbs_state.cache_lock);
+
+	vbs_state.cache_gen++;
+
+	list_for_each_entry_safe(entry, tmp, &vbs_cache, list)
+		vbs_cache_free(entry);
+
+	spin_unlock_irqrestore(&vbs_state.cache_lock, flags);
+}
+
+/*
+ * Get a copy of a cached value, or NULL if the value is not in the cache.
+ */
+static void *vbs_cache_get(const char *path, unsigned int *len)
+{
+	struct vbs_cache_entry *entry;
+	unsigned long flags;
+	void *value = NULL;
+
+	flags = spin_lock_irqsave(&vbs_state.cache_lock);
+
+	entry = vbs_cache_lookup(path);
+	if (entry) {
+		value = malloc(entry->len);
+		BUG_ON(!value);
+
+		memcpy(value, entry->value, entry->len);
+		if (len)
+			*len = entry->len;
+	}
+
+	spin_unlock_irqrestore(&vbs_state.cache_lock, flags);
+
+	return value;
+}
+
+/*
+ * Store a value read from vbstore if the node is watched. <gen> is the cache
+ * generation sampled before the read was issued: if a watch event has been
+ * received in-between, the value may be stale and it is not cached.
+ */
+static void vbs_cache_put(const char *path, const void *value, unsigned int len, uint32_t gen)
+{
+	struct vbs_cache_entry *entry;
+	unsigned long flags;
+
+	if (!find_first_watch(&watches, path))
+		return ;
+
+	entry = malloc(sizeof(struct vbs_cache_entry));
+	BUG_ON(!entry);
+
+	entry->path = kasprintf("%s", path);
+	entry->value = malloc(len);
+	BUG_ON(!entry->path || !entry->value);
+
+	memcpy(entry->value, value, len);
+	entry->len = len;
+
+	flags = spin_lock_irqsave(&vbs_state.cache_lock);
+
+	if ((gen != vbs_state.cache_gen) || vbs_cache_lookup(path)) {
+		spin_unlock_irqrestore(&vbs_state.cache_lock, flags);
+
+		free(entry->path);
+		free(entry->value);
+		free(entry);
+
+		return ;
+	}
+
+	list_add(&entry->list, &vbs_cache);
+
+	spin_unlock_irqrestore(&vbs_state.cache_lock, flags);
+}
+
 /* Send a single message to vbstore.
  * Returns an (heap) allocated message (payload) to be free'd by the called.
  */
@@ -386,10 +678,29 @@ void *vbus_read(struct vbus_transaction t, const char *dir, const char *node, un
 {
 	char *path;
 	void *ret;
+	unsigned int __len = 0;
+	uint32_t gen;
 
 	path = join(dir, node);
 
-	ret = vbs_single(t, VBS_READ, path, len);
+	/* The values read within a transaction are never cached */
+	if (!t.id) {
+		ret = vbs_cache_get(path, len);
+		if (ret) {
+			free(path);
+			return ret;
+		}
+	}
+
+	gen = vbs_state.cache_gen;
+
+	ret = vbs_single(t, VBS_READ, path, &__len);
+
+	if (!t.id && !IS_ERR(ret) && __len)
+		vbs_cache_put(path, ret, __len, gen);
+
+	if (len)
+		*len = __len;
 
 	free(path);
 
@@ -397,13 +708,12 @@ void *vbus_read(struct vbus_transaction t, const char *dir, const char *node, un
 }
 
 /* Write the value of a single file.
- * Returns -err on failure.
+ * Within a transaction, the write is batched and committed by vbus_transaction_end().
  */
 void vbus_write(struct vbus_transaction t, const char *dir, const char *node, const char *string)
 {
 	char *path;
 	msgvec_t vec[2];
-	char *str;
 
 	path = join(dir, node);
 	if (IS_ERR(path))
@@ -415,12 +725,10 @@ void vbus_write(struct vbus_transaction t, const char *dir, const char *node, co
 	vec[1].base = (void *) string;
 	vec[1].len = strlen(string) + 1;
 
-	str = vbs_talkv(t, VBS_WRITE, vec, ARRAY_SIZE(vec), NULL);
+	/* Read-your-writes: the watch event will come later */
+	vbs_cache_invalidate(path);
 
-	if (IS_ERR(str))
-		BUG();
-	if (str)
-		free(str);
+	vbs_update(t, VBS_WRITE, vec, ARRAY_SIZE(vec));
 
 	free(path);
 }
@@ -429,18 +737,16 @@ void vbus_write(struct vbus_transaction t, const char *dir, const char *node, co
 void vbus_mkdir(struct vbus_transaction t, const char *dir, const char *node)
 {
 	char *path;
-	char *str;
+	msgvec_t vec;
 
 	path = join(dir, node);
 	if (IS_ERR(path))
 		BUG();
 
-	str = vbs_single(t, VBS_MKDIR, path, NULL);
-	if (IS_ERR(str))
-		BUG();
+	vec.base = (void *) path;
+	vec.len = strlen(path) + 1;
 
-	if (str)
-		free(str);
+	vbs_update(t, VBS_MKDIR, &vec, 1);
 
 	free(path);
 }
@@ -449,17 +755,18 @@ void vbus_mkdir(struct vbus_transaction t, const char *dir, const char *node)
 void vbus_rm(struct vbus_transaction t, const char *dir, const char *node)
 {
 	char *path;
-	char *str;
+	msgvec_t vec;
 
 	path = join(dir, node);
 	if (IS_ERR(path))
 		BUG();
 
-	str = vbs_single(t, VBS_RM, path, NULL);
-	if (IS_ERR(str))
-		BUG();
-	if (str)
-		free(str);
+	vec.base = (void *) path;
+	vec.len = strlen(path) + 1;
+
+	vbs_cache_invalidate(path);
+
+	vbs_update(t, VBS_RM, &vec, 1);
 
 	free(path);
 }
@@ -491,9 +798,17 @@ void vbus_transaction_start(struct vbus_transaction *t)
 /*
  * End a transaction.
  * At this moment, pending watch events raised during operations bound to this transaction ID can be sent to watchers.
+ *
+ * The update operations of the transaction have been posted without waiting for their reply;
+ * since vbstore processes the requests in order, the reply to VBS_TRANSACTION_END means
+ * that the whole transaction has been committed and that the replies of its operations
+ * have all been received.
  */
 void vbus_transaction_end(struct vbus_transaction t)
 {
+	struct vbs_failed_request *failed, *tmp;
+	unsigned long flags;
+	bool error = false;
 	char *str;
 
 	str = vbs_single(t, VBS_TRANSACTION_END, "", NULL);
@@ -505,6 +820,26 @@ void vbus_transaction_end(struct vbus_transaction t)
 
 	if (str)
 		free(str);
+
+	flags = spin_lock_irqsave(&vbs_state.msg_list_lock);
+
+	list_for_each_entry_safe(failed, tmp, &vbs_failed_requests, list) {
+		if (failed->transactionID == t.id) {
+			printk("%s: transaction ID %d: vbstore replied with type [%d] to a request of type %d\n",
+			       __func__, t.id, failed->reply_type, failed->type);
+
+			list_del(&failed->list);
+			free(failed);
+
+			error = true;
+		}
+	}
+
+	spin_unlock_irqrestore(&vbs_state.msg_list_lock, flags);
+
+	/* Same as a failed synchronous update (see vbs_talkv()) */
+	if (error)
+		BUG();
 	
 	mutex_lock(&vbs_state.transaction_mutex);
 
@@ -699,6 +1034,9 @@ static void ____unregister_vbus_watch(struct list_head *__watches, struct vbus_w
 
 		local_irq_restore(flags);
 
+		/* Changes on this node will not be notified anymore */
+		vbs_cache_invalidate(watch->node);
+
 		vbs_unwatch(watch->node);
 
 	} else
@@ -773,6 +1111,8 @@ static void *vbus_watch_thread(void *unused)
 irq_return_t vbus_vbstore_isr(int irq, void *data)
 {
 	vbus_msg_t *msg, *orig_msg, *orig_msg_tmp;
+	struct vbs_request *req = NULL;
+	struct vbs_failed_request *failed;
 	struct vbus_watch *__w;
 	bool found;
 
@@ -807,6 +1147,8 @@ irq_return_t vbus_vbstore_isr(int irq, void *data)
 
 		if (msg->type == VBS_WATCH_EVENT) {
 
+			vbs_cache_invalidate(msg->payload);
+
 			found = false;
 
 			list_for_each_entry(__w, &watches, list) {
@@ -829,23 +1171,57 @@ irq_return_t vbus_vbstore_isr(int irq, void *data)
 			/* Look for the peer vbus_msg which did the request */
 			found = false;
 
+			spin_lock(&vbs_state.msg_list_lock);
+
 			list_for_each_entry_safe(orig_msg, orig_msg_tmp, &vbus_msg_standby_list, list) {
 				if (orig_msg->id == msg->id) {
 					list_del(&orig_msg->list); /* Remove this message from the standby list */
 
 					found = true;
-					orig_msg->reply = msg;
+					req = container_of(orig_msg, struct vbs_request, msg);
 
-					/* Wake up the thread waiting for the answer */
-					complete(orig_msg->u.reply_wait);
+					/* Release the room of the request in the ring */
+					vbs_state.inflight -= req->size;
+					if (vbs_state.ring_waiting) {
+						vbs_state.ring_waiting = false;
+						complete(&vbs_state.ring_space);
+					}
 
 					break; /* Ending the search loop */
 				}
 			}
 
+			spin_unlock(&vbs_state.msg_list_lock);
+
 			if (!found) /* A pending message MUST exist */
 				BUG();
 
+			if (req->posted) {
+				/* Nobody is waiting for this reply; an error is kept for the end of the transaction */
+				if (msg->type != req->msg.type) {
+					failed = malloc(sizeof(struct vbs_failed_request));
+					BUG_ON(!failed);
+
+					failed->transactionID = req->msg.transactionID;
+					failed->type = req->msg.type;
+					failed->reply_type = msg->type;
+
+					spin_lock(&vbs_state.msg_list_lock);
+					list_add_tail(&failed->list, &vbs_failed_requests);
+					spin_unlock(&vbs_state.msg_list_lock);
+				}
+
+				if (msg->payload)
+					free(msg->payload);
+				free(msg);
+				free(req);
+			} else {
+				orig_msg->reply = msg;
+
+				/* Wake up the thread waiting for the answer */
+				complete(orig_msg->u.reply_wait);
+			}
+
 		}
 
 	}
@@ -877,11 +1253,18 @@ void vbs_suspend(void)
 {
 	mutex_lock(&vbs_state.watch_mutex);
 	mutex_lock(&vbs_state.request_mutex);
+
+	/* The requests already sent (synchronous or posted) must get their reply first */
+	vbs_wait_idle();
+
 	transaction_suspend();
 }
 
 void vbs_resume(void)
 {
+	/* The contents of vbstore may have changed while we were suspended */
+	vbs_cache_flush();
+
 	transaction_resume();
 
 	mutex_unlock(&vbs_state.request_mutex);
@@ -917,9 +1300,14 @@ void vbus_vbstore_init(void)
 	mutex_init(&vbs_state.transaction_group_mutex);
 
 	spin_lock_init(&vbs_state.msg_list_lock);
+	spin_lock_init(&vbs_state.cache_lock);
 
 	vbs_state.transaction_count = 0;
 
+	vbs_state.inflight = 0;
+	vbs_state.ring_waiting = false;
+	init_completion(&vbs_state.ring_space);
+
 	init_completion(&vbs_state.watch_wait);
 
 	/* Initialize the shared memory rings to talk to vbstore */
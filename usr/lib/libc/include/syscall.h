@@ -71,6 +71,9 @@
 #define syscallSetTimeOfDay		39
 #define syscallClockGetTime		40
 
+#define syscallMunmap			41
+#define syscallMprotect			42
+
 #define syscallThreadYield		43
 
 #define syscallSbrk			45
@@ -80,6 +83,13 @@
 #define syscallSigreturn         	48
 
 #define syscallLseek			50
+#define syscallReadv			51
+#define syscallWritev			52
+#define syscallSendfile			53
+#define syscallSplice			54
+#define syscallShmOpen			55
+#define syscallShmUnlink		56
+#define syscallFtruncate		57
 
 #define syscallMutexLock		60
 #define syscallMutexUnlock		61
@@ -92,6 +102,8 @@
 
 #define syscallSetsockopt		110
 #define syscallRecvfrom			111
+#define syscallSendmmsg			112
+#define syscallRecvmmsg			113
 
 
 #define SYSINFO_DUMP_HEAP	0
@@ -297,6 +309,33 @@ int sys_fcntl(int fd, int cmd, void *val);
 
 off_t sys_lseek(int fd, off_t offset, int whence);
 
+/**
+ * Scatter-gather versions of sys_read() and sys_write(): the buffers described by the
+ * @iovcnt entries of @iov are filled (resp. written) in order, in one system call.
+ *
+ * Returns the number of bytes transferred, or -1 on error with errno set appropriately.
+ */
+int sys_readv(int fd, const struct iovec *iov, int iovcnt);
+int sys_writev(int fd, const struct iovec *iov, int iovcnt);
+
+/**
+ * Copy up to @count bytes from @in_fd to @out_fd within the kernel.
+ * If @offset is not NULL, data is read from this offset which is updated,
+ * and the file offset of @in_fd is left unchanged.
+ *
+ * Returns the number of bytes written to @out_fd, or -1 on error.
+ */
+int sys_sendfile(int out_fd, int in_fd, off_t *offset, size_t count);
+
+/**
+ * Move up to @len bytes between a pipe and another file (socket, file, device)
+ * without copying them to user space. One of @fd_in or @fd_out must be a pipe;
+ * offsets are not supported and must be NULL.
+ *
+ * Returns the number of bytes moved, 0 at end of input, or -1 on error.
+ */
+int sys_splice(int fd_in, off_t *off_in, int fd_out, off_t *off_out, size_t len, unsigned int flags);
+
 /**
  * This IOCTL command returns the number of column and lines of the given
  * fd. the result is returned in the following form:
@@ -466,6 +505,27 @@ int sys_send(int socket_fd, void *buffer, int count, int flags);
  */
 int sys_sendto(int fd, const void *buf, size_t len, int flags, const struct sockaddr *addr, socklen_t alen);
 
+struct mmsghdr;
+
+/**
+ * This system call is used to transmit several messages at once.
+ * The datagrams of a UDP socket are given to the network stack by batches.
+ *
+ * Returns the number of messages sent, the length of each one being stored
+ * in its msg_len field. On error, -1 is returned if no message has been sent,
+ * and errno is set appropriately.
+ */
+int sys_sendmmsg(int fd, struct mmsghdr *msgvec, unsigned int vlen, unsigned int flags);
+
+/**
+ * This system call is used to receive several messages at once. With
+ * MSG_WAITFORONE, only the first message is waited for.
+ *
+ * Returns the number of messages received. On error, -1 is returned if no
+ * message has been received, and errno is set appropriately.
+ */
+int sys_recvmmsg(int fd, struct mmsghdr *msgvec, unsigned int vlen, unsigned int flags, struct timespec *timeout);
+
 /* 
  * This system call returns information about a file in the buffer
  * pointed by <statbuf>.
@@ -477,16 +537,42 @@ int sys_setsockopt(int fd, int level, int optname, const void *optval, socklen_t
 
 
 /**
- * This system call is used to map a file (or a portion of it) to a memory buffer
- * in virtual memory. You have to open a file prior this call.
+ * This system call is used to map memory in the virtual address space of the process.
  *
- * start: start of the virtual memory somewhere in the heap area of the process
+ * start: address hint (or exact address with MAP_FIXED), 0 to let the kernel choose
  * length: represents how many bytes you want to map
- * prot: is the mode of accessing mapped memory (READ, WRITE, READ/WRITE)
- * fd: is the file descriptor of the opened file
- * offset: is where to start mapping in the file
+ * prot: is the mode of accessing mapped memory (PROT_READ, PROT_WRITE, PROT_EXEC)
+ * flags: MAP_SHARED or MAP_PRIVATE, possibly with MAP_ANONYMOUS and MAP_FIXED
+ * fd: is the file descriptor of the device or shared memory object (-1 with MAP_ANONYMOUS)
+ * offset: is where to start mapping in the object
+ *
+ * Returns the address of the mapping, or MAP_FAILED on error.
+ */
+void *sys_mmap(unsigned long start, size_t length, int prot, int flags, int fd, off_t offset);
+
+/**
+ * Remove the mappings of a range of addresses. Returns 0 on success, -1 on error.
+ */
+int sys_munmap(unsigned long start, size_t length);
+
+/**
+ * Change the access permissions (PROT_*) of a mapped range. Returns 0 on success, -1 on error.
+ */
+int sys_mprotect(unsigned long start, size_t length, int prot);
+
+/**
+ * Open, or create with O_CREAT, a named shared memory object which can be mapped
+ * with MAP_SHARED. Its size is set with sys_ftruncate().
+ *
+ * Returns a file descriptor, or -1 on error.
+ */
+int sys_shm_open(const char *name, int oflag, mode_t mode);
+int sys_shm_unlink(const char *name);
+
+/**
+ * Set the size of a shared memory object. Returns 0 on success, -1 on error.
  */
-void *sys_mmap(uint32_t start, size_t length, int prot, int fd, off_t offset);
+int sys_ftruncate(int fd, off_t length);
 
 /**
  * The ptrace() system call provides a means by which one process (the "tracer")
@@ -1,8 +1,28 @@
+/*
+ * User space allocator
+ *
+ * Small requests (up to SMALL_MAX bytes) are rounded up to a size class and
+ * served from 16 KB slabs which only contain objects of one class. Freed
+ * objects go back to a per-thread cache, so that a malloc()/free() pair is a
+ * list push/pop in the common case. The caches are refilled from (and
+ * flushed to) the central per-class lists by batches.
+ *
+ * Larger requests are served by a boundary-tag allocator: every chunk
+ * carries its size and the previous chunk's size (when free), so that
+ * a freed chunk is merged with its free neighbours in constant time. Free
+ * chunks are kept in power-of-two bins and the highest chunk of the arena
+ * (top) is extended or shrunk with sbrk() as needed.
+ *
+ * The heap is a window of HEAP_SIZE bytes starting at the initial program
+ * break and is populated on demand by the kernel.
+ */
+
 #include <syscall.h>
 #include <malloc.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <unistd.h>
 
 /* debugging */
@@ -10,462 +30,621 @@
 #define DEBUG
 #endif
 
-#define dprintf(...) \
-            do { if (DEBUG) fprintf(stderr, __VA_ARGS__); } while (0)
-
 #ifdef DEBUG
-#define DBG(...) printf("Malloc: Debug", __func__, __VA_ARGS__)
+#define DBG(fmt, ...) printf("malloc: %s: " fmt, __func__, ##__VA_ARGS__)
 #else
 #define DBG(...)
 #endif
 
-/* 
- * Check if need of another init
- */
-static bool is_heap_init = 0;
+#define MALLOC_ALIGN		16
+
+#define ALIGN_UP(x, a)		(((x) + (a) - 1) & ~((uintptr_t) (a) - 1))
 
-/* there's a list for each size. The size changes over the process lifetime. */
-struct mem_chunk {
+/* Granularity of the heap growth */
+#define HEAP_GROW		(64 * 1024)
 
-    /* Pointer to the next memchunk of a different size */
-    struct mem_chunk *next_list;
+/* The top chunk is shrunk when it gets larger than this */
+#define TRIM_THRESHOLD		(256 * 1024)
 
-    /* Pointer to the next memchunk of this size. */
-    struct mem_chunk *next_chunk;
+/* Small objects */
+#define SMALL_MAX		1024
+#define NR_CLASSES		20
 
-    /* Refer to the head of the (2nd-dimension) list for this size */
-    struct mem_chunk *head;
+#define SLAB_SHIFT		14
+#define SLAB_SIZE		(1 << SLAB_SHIFT)
 
-    /*
-     * Size in bytes of the user area (this does NOT include the size of mem_chunk).
-     * This size can be over the requested size if the remaining area is not large enough
-     * to store the mem_chunk structure (use req_size to have the *real* requested area in any case).
-     */
-    size_t size;
+/* Max. number of threads in a process (see PROC_THREAD_MAX in the kernel) */
+#define NR_CACHES		32
 
-    /* Real requested size by the user. */
-    size_t req_size;
+/* Size of a thread stack slot (see THREAD_STACK_SIZE in the kernel) */
+#define STACK_SLOT_SHIFT	16
 
-    /* Used in case of specific alignment on address - These bytes are lost */
-    size_t padding_bytes;
+/*
+ * Header of a chunk managed by the boundary-tag allocator. <prev_size> is
+ * only meaningful when the previous chunk is free.
+ */
+struct chunk {
+	size_t prev_size;
+	size_t size;
 };
 
-typedef struct mem_chunk mem_chunk_t;
+/* The chunk is allocated */
+#define C_INUSE			1
 
-/* Head of the quick list */
-static struct mem_chunk *quick_list;
+/* The previous chunk is allocated */
+#define P_INUSE			2
 
-/*
- * Initialization of the quick-fit list.
- */
-void heap_init(void)
-{
-	quick_list = (mem_chunk_t *) sbrk(0);
+#define C_FLAGS			(C_INUSE | P_INUSE)
 
-	quick_list->next_list = NULL;
-	quick_list->next_chunk = NULL;
-	quick_list->head = quick_list;
+#define CHUNK_HDR		ALIGN_UP(sizeof(struct chunk), MALLOC_ALIGN)
 
-	/* Reserve the place for the first mem_chunk */
-	quick_list->size = HEAP_SIZE - sizeof(mem_chunk_t);
-	quick_list->padding_bytes = 0;
+/* Free chunks are linked in their bin through their user area */
+struct free_links {
+	struct chunk *next, *prev;
+};
 
-        DBG("SO3: allocating a kernel heap of %d bytes.\n", quick_list->size);
+#define MIN_CHUNK		(CHUNK_HDR + ALIGN_UP(sizeof(struct free_links), MALLOC_ALIGN))
 
-        DBG("[list_init] List initialized. sizeof(mem_chunk_t) = %d bytes, sizeof(int) = %d bytes\n", sizeof(mem_chunk_t), sizeof(int));
-}
+#define NR_BINS			32
 
-/*
- * Print the content of the quick-fit list.
- */
-void dump_heap(const char *info)
-{
-	int i, j;
-	mem_chunk_t *list = quick_list;
-	mem_chunk_t *chunk = quick_list;
-	uint32_t total_size = 0;
+#define chunk_size(c)		((c)->size & ~((size_t) C_FLAGS))
+#define chunk_next(c)		((struct chunk *) ((char *) (c) + chunk_size(c)))
+#define chunk_prev(c)		((struct chunk *) ((char *) (c) - (c)->prev_size))
+#define chunk_links(c)		((struct free_links *) ((char *) (c) + CHUNK_HDR))
+#define chunk_to_mem(c)		((void *) ((char *) (c) + CHUNK_HDR))
+#define mem_to_chunk(p)		((struct chunk *) ((char *) (p) - CHUNK_HDR))
 
-	i = j = 0;
+/* Central state of a size class */
+struct size_class {
+	/* Objects given back by the thread caches */
+	void *free;
 
-	while (list) {
-		printf("[%s - print_list] [0x%p] List #%d\n", info, list, j++);
+	/* Not yet used part of the current slab */
+	char *bump, *bump_end;
+};
 
-		while (chunk) {
-			printf("[%s - print_list] [%p] %d size = %d bytes, head = %p, next_list = %p, next_chunk = %p ---> \n",
-		 	       info, chunk, i++, chunk->size, chunk->head, chunk->next_list,  chunk->next_chunk);
-			total_size += chunk->size;
+/* Per-thread cache of small objects */
+struct thread_cache {
+	int lock;
 
-			chunk = chunk->next_chunk;
-		}
-		i = 0;
+	struct {
+		void *head;
+		unsigned int count;
+	} bins[NR_CLASSES];
+};
 
-		list = list->next_list;
-		chunk = list;
-	}
-	printf("  [%s] Heap total remaining size: %d\n", info, total_size);
+static const unsigned short class_size[NR_CLASSES] = {
+	16, 32, 48, 64, 80, 96, 112, 128,
+	160, 192, 224, 256, 320, 384, 448, 512,
+	640, 768, 896, 1024
+};
+
+/* Size class of a request, indexed by its size in 16-byte units */
+static unsigned char size_to_class[(SMALL_MAX / MALLOC_ALIGN) + 1];
+
+/* Number of objects moved at once between a thread cache and the central lists */
+static unsigned int class_batch[NR_CLASSES];
+
+static struct size_class classes[NR_CLASSES];
+
+static struct thread_cache caches[NR_CACHES];
+
+/* Size class + 1 of each slab of the heap window, 0 if not a slab */
+static unsigned char slab_class[(HEAP_SIZE >> SLAB_SHIFT) + 1];
 
+/* Protects the arena and the central class lists */
+static int arena_lock;
+
+static bool is_heap_init;
+
+static char *arena_base, *arena_end;
+static struct chunk *top;
+
+static struct chunk *bins[NR_BINS];
+static unsigned int binmap;
+
+static inline void malloc_lock(int *lock)
+{
+	while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE))
+		sys_thread_yield();
 }
 
-void print_chunk(mem_chunk_t *chunk, const char *caller, const char *name)
+static inline void malloc_unlock(int *lock)
 {
-	DBG("[%s - print_chunk] [%p] [%s] %d bytes, next_list = %p, next_chunk = %p\n",
-	    caller, chunk, name, chunk->size, chunk->next_list, chunk->next_chunk);
+	__atomic_store_n(lock, 0, __ATOMIC_RELEASE);
 }
 
 /*
- * Re-init a chunk
+ * There is no TLS: a thread is identified by the stack slot it is running
+ * on. The stack slots are THREAD_STACK_SIZE large and end one page below
+ * a THREAD_STACK_SIZE-aligned address, hence the page added to sp.
+ * Two threads sharing a cache remain correct thanks to the cache lock.
  */
-static void reset_chunk(mem_chunk_t *chunk)
+static inline struct thread_cache *this_cache(void)
 {
-	DBG("[reset_chunk] %p\n", chunk);
-
-	chunk->next_list = NULL;
-	chunk->next_chunk = NULL;
-	chunk->head = NULL;
+	uintptr_t sp = (uintptr_t) __builtin_frame_address(0);
 
-	/* Of course, size is preserved. */
+	return &caches[((sp + 4096) >> STACK_SLOT_SHIFT) % NR_CACHES];
 }
 
-/*
- * Remove a memchunk from its current position in the quick list.
- */
-static void remove_chunk(mem_chunk_t *chunk)
+static inline unsigned int bin_index(size_t size)
 {
-	mem_chunk_t *__chunk, *head;
-
-	DBG("[remove_chunk] %p\n", chunk);
+	return 31 - __builtin_clz((unsigned int) size);
+}
 
-	__chunk = chunk;
-	head = chunk->head;
+static void bin_insert(struct chunk *c)
+{
+	unsigned int idx = bin_index(chunk_size(c));
+	struct free_links *l = chunk_links(c);
 
-	/* Special case if the memchunk to be removed is the head of its list */
-	if (head == chunk) {
-		/* The memchunk is at the head of the list */
-		head = quick_list;
+	l->prev = NULL;
+	l->next = bins[idx];
+	if (bins[idx])
+		chunk_links(bins[idx])->prev = c;
 
-		/* Update the memchunk list references if necessary */
-		if (chunk == quick_list)
+	bins[idx] = c;
+	binmap |= (1u << idx);
+}
 
-			/* Check if the memchunk is at the head of the quick list */
-			quick_list = ((chunk->next_chunk == NULL) ? chunk->next_list : chunk->next_chunk);
+static void bin_remove(struct chunk *c)
+{
+	unsigned int idx = bin_index(chunk_size(c));
+	struct free_links *l = chunk_links(c);
 
-		else {
-			/* Look for the head predecessor of this chunk */
-			while (head->next_list != chunk)
-				head = head->next_list;
+	if (l->prev)
+		chunk_links(l->prev)->next = l->next;
+	else
+		bins[idx] = l->next;
 
-			/* Update the previous head to the next_list */
-			if (chunk->next_chunk == NULL)
-				head->next_list = chunk->next_list;
-			else
-				head->next_list = chunk->next_chunk;
+	if (l->next)
+		chunk_links(l->next)->prev = l->prev;
 
-		}
+	if (!bins[idx])
+		binmap &= ~(1u << idx);
+}
 
-		if (chunk->next_chunk != NULL) {
-			/* We also need to update the head of each chunk of associated list */
-			head = chunk->next_chunk;
-			head->next_list = chunk->next_list; /* Just the head */
+/*
+ * Initialization of the arena and of the size classes.
+ */
+static void heap_init(void)
+{
+	unsigned int i, cls;
+	char *brk;
 
-			chunk = head;
-			do {
-				chunk->head = head;
-				chunk = chunk->next_chunk;
-			} while (chunk != NULL);
-		}
+	for (i = 0, cls = 0; i <= SMALL_MAX / MALLOC_ALIGN; i++) {
+		while (class_size[cls] < i * MALLOC_ALIGN)
+			cls++;
+		size_to_class[i] = cls;
+	}
 
-	} else {
+	for (cls = 0; cls < NR_CLASSES; cls++) {
+		class_batch[cls] = 4096 / class_size[cls];
+		if (class_batch[cls] < 4)
+			class_batch[cls] = 4;
+		if (class_batch[cls] > 64)
+			class_batch[cls] = 64;
+	}
 
-		while (head->next_chunk != chunk)
-			head = head->next_chunk;
+	brk = sbrk(0);
+	arena_base = (char *) ALIGN_UP((uintptr_t) brk, MALLOC_ALIGN);
 
-		/* Found, detach the mem chunk */
-		head->next_chunk = chunk->next_chunk;
+	if (sbrk((arena_base - brk) + HEAP_GROW) == (void *) -1) {
+		printf("[malloc] Cannot initialize the heap\n");
+		return ;
 	}
 
-	reset_chunk(__chunk);
+	arena_end = arena_base + HEAP_GROW;
 
-#ifdef DEBUG
-	dump_heap(__func__);
-#endif
+	top = (struct chunk *) arena_base;
+	top->prev_size = 0;
+	top->size = HEAP_GROW | P_INUSE;
+
+	__atomic_store_n(&is_heap_init, true, __ATOMIC_RELEASE);
 
+	DBG("heap at %p, %d bytes available\n", arena_base, HEAP_SIZE);
 }
 
 /*
- * Insert a new mem_chunk in the quick list.
+ * Make the top chunk at least <size> + MIN_CHUNK bytes large so that a chunk
+ * of <size> bytes can be carved out of it.
  */
-static void append_chunk(mem_chunk_t *chunk)
+static bool grow_top(size_t size)
 {
-	mem_chunk_t *tmp_list, *last;
-	mem_chunk_t *tmp_chunk;
+	size_t inc;
 
-	DBG("[append_chunk] %p with size %d padding: %d\n", chunk, chunk->size, chunk->padding_bytes);
+	inc = ALIGN_UP(size + MIN_CHUNK - chunk_size(top), HEAP_GROW);
 
-	reset_chunk(chunk);
+	if (arena_end + inc > arena_base + HEAP_SIZE)
+		return false;
 
-	if (!quick_list) {
-		DBG("[append_chunk] Adding first entry in quick_list\n");
-		quick_list = chunk;
-		chunk->head = quick_list;
-	} else {
+	if (sbrk(inc) == (void *) -1)
+		return false;
 
-		/* Try to append our chunk to existing list */
-		tmp_list = quick_list;
+	arena_end += inc;
+	top->size += inc;
 
-		while ((tmp_list != NULL) && (tmp_list->size < chunk->size)) {
-			last = tmp_list; /* Useful in the latest case */
-			tmp_list = tmp_list->next_list;
-		}
+	return true;
+}
 
-		if (tmp_list != NULL) { /* We found a position in the list (sorted items) */
+/*
+ * Give the pages at the end of a large top chunk back to the kernel.
+ */
+static void trim_top(void)
+{
+	size_t release;
 
-			if (tmp_list->size == chunk->size) { /* Good, we have found the right size */
-				DBG("[append_chunk] found a list with the right size %d\n", chunk->size);
-				tmp_chunk = tmp_list;
+	if (chunk_size(top) <= TRIM_THRESHOLD)
+		return ;
 
-				/* Go to end of list */
-				while (tmp_chunk->next_chunk != NULL)
-					tmp_chunk = tmp_chunk->next_chunk;
+	release = (chunk_size(top) - HEAP_GROW) & ~((size_t) HEAP_GROW - 1);
 
-				/* Append our new free chunk */
-				tmp_chunk->next_chunk = chunk;
-				chunk->head = tmp_list;
+	if (sbrk(-(intptr_t) release) == (void *) -1)
+		return ;
 
-			} else { /* Not the right size, but tmp_list->size is greater than chunk->size, so create a list entry and insert right before */
+	arena_end -= release;
+	top->size -= release;
+}
 
-				DBG("[append_chunk] creating list of new size %d\n", chunk->size);
+/*
+ * Give a chunk back to the arena and merge it with its free neighbours.
+ */
+static void release_chunk(struct chunk *c)
+{
+	size_t size = chunk_size(c);
+	struct chunk *next = chunk_next(c);
 
-				if (tmp_list == quick_list) { /* This entry is the quick_list origin, update it */
-					chunk->next_list = quick_list;
-					chunk->head = chunk;
-					quick_list = chunk;
+	if (!(c->size & P_INUSE)) {
+		c = chunk_prev(c);
+		bin_remove(c);
+		size += chunk_size(c);
+	}
 
-				} else { /* Somewhere else in the quick list ... */
+	if (next == top) {
+		top = c;
+		top->size = (size + chunk_size(next)) | P_INUSE;
+		trim_top();
+		return ;
+	}
 
-					tmp_chunk = quick_list;
-					while (tmp_chunk->next_list != tmp_list)
-						tmp_chunk = tmp_chunk->next_list;
+	if (!(next->size & C_INUSE)) {
+		bin_remove(next);
+		size += chunk_size(next);
+	} else
+		next->size &= ~P_INUSE;
 
-					/* Insert it - tmp_chunk now refers to the previous list. */
+	c->size = size | P_INUSE;
+	chunk_next(c)->prev_size = size;
 
-					tmp_chunk->next_list = chunk;
+	bin_insert(c);
+}
 
-					chunk->next_list = tmp_list;
-					chunk->head = chunk;
-				}
-			}
+/*
+ * Shrink an allocated chunk to <size> bytes, the remaining part being freed.
+ */
+static void split_chunk(struct chunk *c, size_t size)
+{
+	struct chunk *rem;
 
-		} else { /* Definitively at the end of the list */
+	if (chunk_size(c) - size < MIN_CHUNK)
+		return ;
 
-			DBG("[append_chunk] adding at the end of quick_list with new size %d\n", chunk->size);
+	rem = (struct chunk *) ((char *) c + size);
+	rem->size = (chunk_size(c) - size) | C_INUSE | P_INUSE;
+	c->size = size | (c->size & C_FLAGS);
 
-			last->next_list = chunk;
-			chunk->head = chunk;
-		}
-	}
+	release_chunk(rem);
 }
 
 /*
- * Find neighbouring chunks and merge them
+ * Get an allocated chunk of <size> bytes, <size> including the header.
  */
-static void merge_chunks(mem_chunk_t *new_chunk)
+static struct chunk *alloc_chunk(size_t size)
 {
-	mem_chunk_t *tmp_list;
-	mem_chunk_t *tmp_chunk, *merged_chunk;
+	unsigned int idx = bin_index(size);
+	unsigned int map;
+	struct chunk *c;
+
+	/* First fit among the chunks of the same order */
+	for (c = bins[idx]; c; c = chunk_links(c)->next)
+		if (chunk_size(c) >= size)
+			goto found;
+
+	/* Any chunk of a higher order is large enough */
+	map = (idx + 1 < NR_BINS) ? (binmap & ~((2u << idx) - 1)) : 0;
+	if (map) {
+		c = bins[__builtin_ctz(map)];
+		goto found;
+	}
 
-	/*
-	 * Inspect the whole quick list to see if some possible merge is feasible. Since a merged chunk may be adjacent to another one, we need to
-	 * re-iterate on the quick list to find a possible candidate for a merge.
-	 */
-recheck:
-	tmp_list = quick_list;
+	/* Carve it out of the top chunk */
+	if ((chunk_size(top) < size + MIN_CHUNK) && !grow_top(size))
+		return NULL;
 
-	while (tmp_list) {
-		tmp_chunk = tmp_list;
+	c = top;
+	top = (struct chunk *) ((char *) c + size);
+	top->size = (chunk_size(c) - size) | P_INUSE;
+	c->size = size | C_INUSE | (c->size & P_INUSE);
 
-		/* Iterate through every chunk */
-		while (tmp_chunk) {
+	return c;
 
-			/* Check if merging required. If we do this each time a chunk is freed,
-			 * it's sufficient to only check for chunks adjacent to the one just freed */
-			if ((char *) new_chunk + new_chunk->size + sizeof(mem_chunk_t) == (char *) tmp_chunk || /* adjacent chunk after */
-					(char *) tmp_chunk + tmp_chunk->size + sizeof(mem_chunk_t) == (char *) new_chunk) { /* adjacent chunk before */
+found:
+	bin_remove(c);
 
+	c->size |= C_INUSE;
+	chunk_next(c)->size |= P_INUSE;
 
-				/* tmp_chunk is adjacent to new_chunk. Merge them */
-				DBG("[merge_chunks] merging new_chunk [%p] with tmp_chunk [%p]\n", new_chunk, tmp_chunk);
-#ifdef DEBUG
-				dump_heap(__func__);
-#endif
+	split_chunk(c, size);
 
-				/* merge these two chunks into a new one */
-				if (new_chunk < tmp_chunk) {
+	return c;
+}
 
-					/* new_chunk is before tmp_chunk */
-					new_chunk->size += tmp_chunk->size + sizeof(mem_chunk_t); /* Recover space used by memchunk */
-					merged_chunk = new_chunk;
+/*
+ * Get a chunk whose user area is aligned on <align> bytes.
+ */
+static struct chunk *alloc_chunk_aligned(size_t size, size_t align)
+{
+	struct chunk *c, *aligned;
+	uintptr_t mem;
+	size_t lead;
 
-				} else {
+	if (align <= MALLOC_ALIGN)
+		return alloc_chunk(size);
 
-					/* new_chunk is after tmp_chunk */
-					tmp_chunk->size += new_chunk->size + sizeof(mem_chunk_t);
-					merged_chunk = tmp_chunk;
+	c = alloc_chunk(size + align + MIN_CHUNK);
+	if (!c)
+		return NULL;
 
-				}
+	mem = ALIGN_UP((uintptr_t) chunk_to_mem(c), align);
+	if (mem == (uintptr_t) chunk_to_mem(c))
+		goto out;
 
-				/* Remove both chunks from the list... */
-				remove_chunk(tmp_chunk);
-				remove_chunk(new_chunk);
+	/* The leading part must be large enough to become a free chunk */
+	if (mem - (uintptr_t) chunk_to_mem(c) < MIN_CHUNK)
+		mem += align;
 
-				/* ...and append the merged chunk. */
-				DBG("[merge_chunks] tmp_chunk: %p new_chunk: %p merged_chunk: %p merged_chunk->size = %d\n", tmp_chunk, new_chunk, merged_chunk, merged_chunk->size);
-				append_chunk(merged_chunk);
+	aligned = mem_to_chunk(mem);
+	lead = (char *) aligned - (char *) c;
 
-				/* we will recheck for any adjacent chunk with our merged chunk */
-				new_chunk = merged_chunk;
-				goto recheck;
-			}
+	aligned->prev_size = lead;
+	aligned->size = (chunk_size(c) - lead) | C_INUSE;
+	c->size = lead | (c->size & C_FLAGS);
 
-			tmp_chunk = tmp_chunk->next_chunk;
-		}
+	release_chunk(c);
+	c = aligned;
 
-		tmp_list = tmp_list->next_list;
-	}
+out:
+	split_chunk(c, size);
 
+	return c;
 }
 
-/*
- * Allocate a memory area of a certain size (<size> bytes).
- * The address can be requested to be aligned according to @alignment which has to be a power of 2.
- */
-static void *__malloc(size_t requested, unsigned int alignment)
+static inline size_t request_to_size(size_t requested)
 {
-	mem_chunk_t *victim;
-	mem_chunk_t *remaining = NULL; /* new free chunk if size < victim->size */
-	mem_chunk_t tmp_memchunk; /* Used for possible shifting of the structure */
-	void *addr = NULL, *tmp_addr;
+	size_t size = ALIGN_UP(requested + CHUNK_HDR, MALLOC_ALIGN);
 
+	return ((size < MIN_CHUNK) ? MIN_CHUNK : size);
+}
 
-#ifdef DEBUG
-	dump_heap(__func__);
-#endif
+static void *large_alloc(size_t requested, size_t align)
+{
+	struct chunk *c;
 
-        if (!is_heap_init) {
-                heap_init();
-                is_heap_init = 1;
-        }
+	if (requested >= HEAP_SIZE)
+		return NULL;
 
+	malloc_lock(&arena_lock);
+	c = alloc_chunk_aligned(request_to_size(requested), align);
+	malloc_unlock(&arena_lock);
 
-	DBG("[malloc] requested size = %d, mem_chunk_size = %d bytes\n", requested, sizeof(mem_chunk_t));
+	if (!c) {
+		printf("[malloc] Not enough free space\n");
+		return NULL;
+	}
 
-	/* find the best fit in our list */
-	victim = quick_list;
+	return chunk_to_mem(c);
+}
 
-next_list:
-	/* We check victim to be different of NULL since we might iterate several times */
-	while (victim && (victim->size < requested))
-		victim = victim->next_list;
+static void large_free(void *ptr)
+{
+	malloc_lock(&arena_lock);
+	release_chunk(mem_to_chunk(ptr));
+	malloc_unlock(&arena_lock);
+}
 
-	if (!victim) {
-		/* not enough free space left */
-		/* FIXME: do sbrk() here to request more space. Request less space in init() */
-		printf("[malloc] Not enough free space");
+/* Slabs are aligned on SLAB_SIZE while the arena is not */
+static inline unsigned int slab_of(void *ptr)
+{
+	return ((uintptr_t) ptr >> SLAB_SHIFT) - ((uintptr_t) arena_base >> SLAB_SHIFT);
+}
 
-		dump_heap("Heap overflow");
+/*
+ * Return the size class + 1 of a pointer, 0 if it is a large block.
+ */
+static inline unsigned int ptr_class(void *ptr)
+{
+	/* arena_end may be moved concurrently, the heap window is fixed */
+	if (((char *) ptr < arena_base) || ((char *) ptr >= arena_base + HEAP_SIZE))
+		return 0;
 
-		return NULL;
-	}
+	return slab_class[slab_of(ptr)];
+}
 
-	/* Go to the end of the list to avoid overhead time to re-process head of each chunk */
-	while (victim->next_chunk != NULL)
-		victim = victim->next_chunk;
+/*
+ * Move up to a batch of objects of a class from the central lists to <tc>.
+ * The arena lock is held.
+ */
+static void cache_refill(struct thread_cache *tc, unsigned int cls)
+{
+	struct size_class *sc = &classes[cls];
+	unsigned int size = class_size[cls];
+	unsigned int n;
+	struct chunk *slab;
+	void *obj;
 
-	/* Calculate the *real* address that will be returned to the caller */
-	addr = (char *) victim + sizeof(mem_chunk_t);
+	for (n = 0; n < class_batch[cls]; n++) {
+		if (sc->free) {
+			obj = sc->free;
+			sc->free = *(void **) obj;
 
-	/* Store the requested size if the area becomes larger than requested because of the lack of space to store remaining chunk. */
-	victim->req_size = requested;
+		} else {
+			if (sc->bump + size > sc->bump_end) {
+				slab = alloc_chunk_aligned(request_to_size(SLAB_SIZE), SLAB_SIZE);
+				if (!slab)
+					break;
+
+				sc->bump = chunk_to_mem(slab);
+				sc->bump_end = sc->bump + SLAB_SIZE;
+				slab_class[slab_of(sc->bump)] = cls + 1;
+			}
+			obj = sc->bump;
+			sc->bump += size;
+		}
 
-	/*
-	 * We enforce the address returned to be word-aligned so that if some data which requires word-alignment
-	 * (for example in case of ldrex/strex based monitors) will stay aligned.
-	 */
+		*(void **) obj = tc->bins[cls].head;
+		tc->bins[cls].head = obj;
+		tc->bins[cls].count++;
+	}
+}
 
-	alignment = ((alignment == 0) ? sizeof(int) : alignment);
+/*
+ * Give a batch of objects of a class back to the central list.
+ */
+static void cache_flush(struct thread_cache *tc, unsigned int cls)
+{
+	struct size_class *sc = &classes[cls];
+	unsigned int n;
+	void *obj;
 
-	/* Is a specific alignment requested ? (alignment must be a power of 2) */
+	malloc_lock(&arena_lock);
 
-	if (alignment > 0) {
-		tmp_addr = (void *) (((unsigned long) addr + alignment - 1) & -((signed) alignment));
+	for (n = 0; (n < class_batch[cls]) && tc->bins[cls].head; n++) {
+		obj = tc->bins[cls].head;
+		tc->bins[cls].head = *(void **) obj;
+		tc->bins[cls].count--;
 
-		/* If there is a required shift, padding bytes are considered as payload bytes of the chunk */
-		if ((unsigned int) (tmp_addr - addr) + requested  > victim->size) {
+		*(void **) obj = sc->free;
+		sc->free = obj;
+	}
 
-			/* Look at a next possible victim in this list */
-			victim = victim->head->next_list;
+	malloc_unlock(&arena_lock);
+}
 
-			goto next_list;
+static void *small_alloc(size_t requested)
+{
+	unsigned int cls = size_to_class[(requested + MALLOC_ALIGN - 1) / MALLOC_ALIGN];
+	struct thread_cache *tc = this_cache();
+	void *obj;
 
-		} else {
+	malloc_lock(&tc->lock);
 
-			victim->padding_bytes = tmp_addr - addr;
+	if (!tc->bins[cls].head) {
+		malloc_lock(&arena_lock);
+		cache_refill(tc, cls);
+		malloc_unlock(&arena_lock);
+	}
 
-			addr = tmp_addr;
-		}
+	obj = tc->bins[cls].head;
+	if (obj) {
+		tc->bins[cls].head = *(void **) obj;
+		tc->bins[cls].count--;
 	}
 
-	/* This chunk isn't free anymore */
+	malloc_unlock(&tc->lock);
 
-	remove_chunk(victim);
+	if (!obj)
+		printf("[malloc] Not enough free space\n");
 
-	/*
-	* If there is a remaining size, and if this remaining size supports storing a mem_chunk_t, then we
-	* can append a new (free) memchunk, otherwise remaining bytes are lost.
-	*/
-	if (victim->size > requested + victim->padding_bytes + sizeof(mem_chunk_t)) {
+	return obj;
+}
 
-		/* Split this chunk and append in the list. */
-		remaining = (mem_chunk_t *) ((char *) victim + sizeof(mem_chunk_t) + requested + victim->padding_bytes);
-		remaining->size = victim->size - requested - sizeof(mem_chunk_t) - victim->padding_bytes;
-		remaining->padding_bytes = 0;
+static void small_free(void *ptr, unsigned int cls)
+{
+	struct thread_cache *tc = this_cache();
 
-		/* Re-calculate the size of the allocated chunk. */
-		victim->size = requested + victim->padding_bytes;
+	malloc_lock(&tc->lock);
 
-		append_chunk(remaining);
+	*(void **) ptr = tc->bins[cls].head;
+	tc->bins[cls].head = ptr;
 
-	}
+	if (++tc->bins[cls].count > 2 * class_batch[cls])
+		cache_flush(tc, cls);
 
-	/*
-	* If there are some padding bytes, we need to shift the mem_chunk_t of these bytes
-	* so that it is possible to retrieve the structure when freeing.
-	*/
-	if (victim->padding_bytes) {
-		memcpy(&tmp_memchunk, victim, sizeof(mem_chunk_t));
-		memcpy(((char *) victim) + victim->padding_bytes, &tmp_memchunk, sizeof(mem_chunk_t));
-	}
+	malloc_unlock(&tc->lock);
+}
 
+static inline void check_heap_init(void)
+{
+	if (__atomic_load_n(&is_heap_init, __ATOMIC_ACQUIRE))
+		return ;
 
-#ifdef DEBUG
-	dump_heap(__func__);
-#endif
+	malloc_lock(&arena_lock);
+	if (!is_heap_init)
+		heap_init();
+	malloc_unlock(&arena_lock);
+}
+
+/*
+ * Usable size of an allocated area.
+ */
+static size_t usable_size(void *ptr)
+{
+	unsigned int cls = ptr_class(ptr);
+
+	if (cls)
+		return class_size[cls - 1];
 
-	return addr;
+	return chunk_size(mem_to_chunk(ptr)) - CHUNK_HDR;
 }
 
+/*
+ * Print the state of the heap.
+ */
+void dump_heap(const char *info)
+{
+	struct chunk *c;
+	size_t free_size = 0;
+	unsigned int i, nr_free = 0;
+
+	malloc_lock(&arena_lock);
+
+	for (i = 0; i < NR_BINS; i++)
+		for (c = bins[i]; c; c = chunk_links(c)->next) {
+			free_size += chunk_size(c);
+			nr_free++;
+		}
+
+	printf("  [%s] arena %p - %p (%d bytes), top %d bytes, %d free chunks (%d bytes)\n",
+	       info, arena_base, arena_end, (int) (arena_end - arena_base),
+	       (int) chunk_size(top), nr_free, (int) free_size);
+
+	malloc_unlock(&arena_lock);
+}
 
 /*
  * Request a chunk of heap memory of @size bytes.
  */
-void *malloc(size_t size) {
-	return __malloc(size, 0);
+void *malloc(size_t size)
+{
+	check_heap_init();
+
+	if (size <= SMALL_MAX)
+		return small_alloc(size);
+
+	return large_alloc(size, MALLOC_ALIGN);
 }
 
 /*
  * @memalign to retrieve a malloc area of a @requested size with a specific @alignment which is a power of 2.
  */
-void *memalign(size_t size, size_t alignment) {
-	return __malloc(size, alignment);
+void *memalign(size_t size, size_t alignment)
+{
+	check_heap_init();
+
+	/* Class sizes are multiples of MALLOC_ALIGN and slabs are aligned */
+	if ((size <= SMALL_MAX) && (alignment <= MALLOC_ALIGN))
+		return small_alloc(size);
+
+	return large_alloc(size, alignment);
 }
 
 /**
@@ -480,64 +659,79 @@ void *memalign(size_t size, size_t alignment) {
  */
 void free(void *ptr)
 {
-	mem_chunk_t *chunk = (mem_chunk_t *)((char *) ptr - sizeof(mem_chunk_t));
-	mem_chunk_t tmp_memchunk;
+	unsigned int cls;
 
 	if (!ptr)
 		return ;
 
-	if (chunk->padding_bytes) {
-		/* Restore the original position of the memchunk if any padding bytes are considered. */
-		memcpy(&tmp_memchunk, chunk, sizeof(mem_chunk_t));
+	cls = ptr_class(ptr);
+	if (cls)
+		small_free(ptr, cls - 1);
+	else
+		large_free(ptr);
+}
+
+/*
+ * Re-allocate an existing memory area (previously allocated with malloc).
+ * The size can be greater, equal, or less than the original.
+ */
+void *realloc(void *__ptr, size_t __size)
+{
+	struct chunk *c, *next;
+	size_t old_size, size;
+	void *alloc;
+
+	if (!__ptr)
+		return malloc(__size);
 
-		chunk = (mem_chunk_t *) ((char *) chunk - tmp_memchunk.padding_bytes);
+	old_size = usable_size(__ptr);
 
-		memcpy(chunk, &tmp_memchunk, sizeof(mem_chunk_t));
+	if (!ptr_class(__ptr) && (__size > SMALL_MAX)) {
+		c = mem_to_chunk(__ptr);
+		size = request_to_size(__size);
 
-		chunk->padding_bytes = 0;
-	}
+		malloc_lock(&arena_lock);
 
-	DBG("[free_chunk] %p with size %d\n", chunk, chunk->size);
+		/* Try to resize in place, possibly by absorbing the next chunk */
+		if (size > chunk_size(c)) {
+			next = chunk_next(c);
 
-#ifdef DEBUG
-	dump_heap("free {before}");
-#endif
-	append_chunk(chunk);
-	merge_chunks(chunk);
+			if ((next == top) && ((chunk_size(c) + chunk_size(top) >= size + MIN_CHUNK) ||
+					      grow_top(size - chunk_size(c)))) {
+				top = (struct chunk *) ((char *) c + size);
+				top->size = (chunk_size(c) + chunk_size(next) - size) | P_INUSE;
+				c->size = size | (c->size & C_FLAGS);
 
-#ifdef DEBUG
-	dump_heap("free {after}");
-#endif
-}
+			} else if ((next != top) && !(next->size & C_INUSE) &&
+				   (chunk_size(c) + chunk_size(next) >= size)) {
+				bin_remove(next);
+				c->size += chunk_size(next);
+				chunk_next(c)->size |= P_INUSE;
+			}
+		}
 
-/*
- * Re-allocate an existing memory area (previously allocated with malloc).
- * The size can be greater, equal, or less than the original.
- */
-void *realloc(void *__ptr, size_t __size) {
+		if (size <= chunk_size(c)) {
+			split_chunk(c, size);
+			malloc_unlock(&arena_lock);
 
-	void *alloc;
-	struct mem_chunk *chunk;
+			return __ptr;
+		}
 
-	chunk = (struct mem_chunk *) (__ptr - sizeof(struct mem_chunk));
+		malloc_unlock(&arena_lock);
 
-	/* Check if the new zone is smaller than the original */
-	if (__size < chunk->req_size)
-		__size = chunk->req_size;
+	} else if (__size <= old_size) {
+		return __ptr;
+	}
+
+	DBG("Requesting a size of %d\n", (int) __size);
 
 	alloc = malloc(__size);
 	if (!alloc)
 		return NULL;
 
-	DBG("Requesting a size of %d\n", __size);
-	DBG("Copying a size of %d\n", ((__size < chunk->req_size) ? __size : chunk->req_size));
-	DBG("allocation pointer %p\n", alloc);
-
-	memcpy(alloc, __ptr, ((__size < chunk->req_size) ? __size : chunk->req_size));
+	memcpy(alloc, __ptr, ((__size < old_size) ? __size : old_size));
 
 	free(__ptr);
 
 	return alloc;
-
 }
-
@@ -1,13 +1,16 @@
 #include <sys/mman.h>
-#include "libc.h"
-#include "syscall.h"
+#include <syscall.h>
+#include <libc.h>
+
+/* libc.page_size is not set up (no auxiliary vector) */
+#define MPROTECT_PAGE_SIZE	4096
 
 int __mprotect(void *addr, size_t len, int prot)
 {
 	size_t start, end;
-	start = (size_t)addr & -PAGE_SIZE;
-	end = (size_t)((char *)addr + len + PAGE_SIZE-1) & -PAGE_SIZE;
-	return syscall(SYS_mprotect, start, end-start, prot);
+	start = (size_t)addr & -MPROTECT_PAGE_SIZE;
+	end = (size_t)((char *)addr + len + MPROTECT_PAGE_SIZE-1) & -MPROTECT_PAGE_SIZE;
+	return sys_mprotect(start, end-start, prot);
 }
 
 weak_alias(__mprotect, mprotect);
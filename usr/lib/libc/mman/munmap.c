@@ -1,14 +1,10 @@
 #include <sys/mman.h>
-#include "syscall.h"
-#include "libc.h"
-
-static void dummy(void) { }
-weak_alias(dummy, __vm_wait);
+#include <syscall.h>
+#include <libc.h>
 
 int __munmap(void *start, size_t len)
 {
-	__vm_wait();
-	return syscall(SYS_munmap, start, len);
+	return sys_munmap((unsigned long) start, len);
 }
 
 weak_alias(__munmap, munmap);
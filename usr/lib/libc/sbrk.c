@@ -5,7 +5,7 @@
 
 void *sbrk(intptr_t inc)
 {
-	return sys_sbrk(0);
+	return sys_sbrk(inc);
 #if 0
 	if (inc) return (void *)__syscall_ret(-ENOMEM);
 	return (void *)__syscall(SYS_brk, 0);
@@ -15,16 +15,7 @@ size_t __stdio_write(FILE *f, const unsigned char *buf, size_t len)
 	ssize_t cnt;
 
 	for (;;) {
-
-#if 0
-		cnt = syscall(SYS_writev, f->fd, iov, iovcnt);
-#endif
-		cnt = 0;
-
-		if (iov[0].iov_len > 0)
-			cnt += sys_write(f->fd, iov[0].iov_base, iov[0].iov_len);
-		if (iov[1].iov_len > 0)
-			cnt += sys_write(f->fd, iov[1].iov_base, iov[1].iov_len);
+		cnt = sys_writev(f->fd, iov, iovcnt);
 
 		if (cnt == rem) {
 			f->wend = f->buf + f->buf_size;
@@ -1,10 +1,10 @@
 #include <unistd.h>
-#include "syscall.h"
-#include "libc.h"
+#include <syscall.h>
+#include <libc.h>
 
 int ftruncate(int fd, off_t length)
 {
-	return syscall(SYS_ftruncate, fd, __SYSCALL_LL_O(length));
+	return sys_ftruncate(fd, length);
 }
 
 LFS64(ftruncate);
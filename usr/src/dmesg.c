@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Display the kernel log kept in /dev/kmsg (CONFIG_PRINTK_RING).
+ *
+ * Usage: dmesg [-r]
+ *   -r  raw records (<seq>,<timestamp in us>,<cpu>;<text>)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static char buf[4096];
+
+int main(int argc, char **argv)
+{
+	unsigned long long seq, ts;
+	unsigned int cpu;
+	char *line, *next, *text;
+	int fd, len, raw = 0;
+
+	if ((argc > 1) && !strcmp(argv[1], "-r"))
+		raw = 1;
+
+	fd = open("/dev/kmsg", O_RDONLY);
+	if (fd < 0) {
+		printf("dmesg: cannot open /dev/kmsg\n");
+		return 1;
+	}
+
+	/* The kernel only returns whole records */
+	while ((len = read(fd, buf, sizeof(buf) - 1)) > 0) {
+		buf[len] = 0;
+
+		for (line = buf; *line; line = next) {
+			next = strchr(line, '\n');
+			*next++ = 0;
+
+			text = strchr(line, ';');
+
+			if (raw || !text || (sscanf(line, "%llu,%llu,%u", &seq, &ts, &cpu) != 3))
+				printf("%s\n", line);
+			else
+				printf("[%5llu.%06llu] %s\n", ts / 1000000, ts % 1000000, text + 1);
+		}
+	}
+
+	close(fd);
+
+	return 0;
+}
@@ -67,7 +67,7 @@ int main(int argc, char **argv)
 	ioctl(fd, IOCTL_FB_SIZE, &fb_size);
 
 	/* Map the framebuffer memory to a process virtual address. */
-	fbp = mmap(NULL, fb_size, 0, 0, fd, 0);
+	fbp = mmap(NULL, fb_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
 
 	/* Display lines of different colors. */
 	for (i = 0; i < vres; i++) {
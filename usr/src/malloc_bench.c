@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Allocation micro-benchmark
+ *
+ * Usage: malloc_bench [iterations] [threads]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <sys/time.h>
+
+#define DEFAULT_ITERATIONS	100000
+#define DEFAULT_THREADS		4
+
+#define BATCH			256
+#define MAX_THREADS		16
+
+static unsigned int iterations;
+
+static unsigned long long now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (unsigned long long) tv.tv_sec * 1000000ull + tv.tv_usec;
+}
+
+static unsigned int next_rand(unsigned int *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+
+	return (*seed >> 8);
+}
+
+static void report(const char *name, unsigned long long start, unsigned int ops)
+{
+	unsigned long long elapsed = now_us() - start;
+
+	printf("%-28s %10u ops %10llu us %8llu ns/op\n",
+	       name, ops, elapsed, (elapsed * 1000ull) / (ops ? ops : 1));
+}
+
+/* malloc() immediately followed by free() of the same size */
+static void bench_pairs(const char *name, size_t size)
+{
+	unsigned long long start = now_us();
+	unsigned int i;
+	void *p;
+
+	for (i = 0; i < iterations; i++) {
+		p = malloc(size);
+		*(volatile char *) p = 0;
+		free(p);
+	}
+
+	report(name, start, iterations);
+}
+
+/* A batch of allocations released in the reverse order */
+static void bench_batch(const char *name, size_t size)
+{
+	void *p[BATCH];
+	unsigned long long start = now_us();
+	unsigned int i, j;
+
+	for (i = 0; i < iterations / BATCH; i++) {
+		for (j = 0; j < BATCH; j++)
+			p[j] = malloc(size);
+		for (j = BATCH; j > 0; j--)
+			free(p[j - 1]);
+	}
+
+	report(name, start, (iterations / BATCH) * BATCH);
+}
+
+/* Random sizes, random lifetimes */
+static void *bench_random(void *arg)
+{
+	unsigned int seed = (unsigned long) arg;
+	void *p[BATCH] = { NULL };
+	unsigned int i, k, r;
+
+	for (i = 0; i < iterations; i++) {
+		r = next_rand(&seed);
+		k = r % BATCH;
+
+		if (p[k]) {
+			free(p[k]);
+			p[k] = NULL;
+		} else {
+			p[k] = malloc(((r >> 8) & 7) ? (r >> 12) % 512 : (r >> 12) % 16384);
+			if (p[k])
+				*(char *) p[k] = 0;
+		}
+	}
+
+	for (k = 0; k < BATCH; k++)
+		free(p[k]);
+
+	return NULL;
+}
+
+static void bench_threads(unsigned int nr_threads)
+{
+	pthread_t threads[MAX_THREADS];
+	unsigned long long start;
+	unsigned int i;
+
+	start = now_us();
+
+	for (i = 0; i < nr_threads; i++)
+		pthread_create(&threads[i], NULL, bench_random, (void *) (unsigned long) (i + 1));
+
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	report("random (threads)", start, iterations * nr_threads);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned int nr_threads = DEFAULT_THREADS;
+	unsigned long long start;
+
+	iterations = DEFAULT_ITERATIONS;
+
+	if (argc > 1)
+		iterations = atoi(argv[1]);
+	if (argc > 2)
+		nr_threads = atoi(argv[2]);
+
+	if (nr_threads > MAX_THREADS)
+		nr_threads = MAX_THREADS;
+
+	bench_pairs("malloc/free 16 bytes", 16);
+	bench_pairs("malloc/free 256 bytes", 256);
+	bench_pairs("malloc/free 4 KB", 4096);
+	bench_pairs("malloc/free 64 KB", 65536);
+
+	bench_batch("batch 32 bytes", 32);
+	bench_batch("batch 1 KB", 1024);
+	bench_batch("batch 8 KB", 8192);
+
+	start = now_us();
+	bench_random((void *) 1);
+	report("random", start, iterations);
+
+	if (nr_threads)
+		bench_threads(nr_threads);
+
+	return 0;
+}
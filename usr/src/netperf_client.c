@@ -34,9 +34,20 @@
 
 #define PORT 5000
 
-char buff[1024];
+#define MAX_WRITE_SIZE	65536
+
+char buff[MAX_WRITE_SIZE];
+
+/* Size of each write() issued to the socket */
+static int write_size = 1024;
+
+/* Totals over all bursts */
+static unsigned long long total_bytes;
+static float total_ms;
+
 float send_burst(int s, int kB) {
-	int sent = 0, written, error = 0;
+	unsigned long long sent = 0, len = (unsigned long long) kB * 1024;
+	int written, chunk;
 	float rtt_ms = 0;
 	struct timeval start, end;
 
@@ -44,20 +55,22 @@ float send_burst(int s, int kB) {
 
 	gettimeofday(&start, NULL);
 
-	while (sent++ < kB) {
-		memset(buff, sent, sizeof(buff) - 1);
-		buff[1023] = 0;
-		if ((written = write(s, buff, sizeof(buff))) <= 0) {
+	while (sent < len) {
+		chunk = (len - sent < write_size) ? len - sent : write_size;
+		if ((written = write(s, buff, chunk)) <= 0) {
 			printf("Write error \n");
-			error++;
-			continue;
+			break;
 		}
+		sent += written;
 	}
 	gettimeofday(&end, NULL);
 	rtt_ms = end.tv_usec / 1000.0 + end.tv_sec * 1000 - (start.tv_usec / 1000.0 + start.tv_sec * 1000);
 
-	printf("%d kB in %Lf ms\n", kB, rtt_ms);
-	printf("%f mb/s\n", (kB * 8.0 / 1024) / (rtt_ms / 1000.0));
+	total_bytes += sent;
+	total_ms += rtt_ms;
+
+	printf("%llu bytes in %f ms\n", sent, rtt_ms);
+	printf("%f Mbit/s\n", (sent * 8.0 / 1000000.0) / (rtt_ms / 1000.0));
 
 	return rtt_ms;
 }
@@ -73,10 +86,18 @@ int main(int argc, char **argv) {
 		max_kB = atoi(argv[2]);
 	}
 
+	if (argc > 3) {
+		write_size = atoi(argv[3]);
+		if (write_size <= 0 || write_size > MAX_WRITE_SIZE) {
+			printf("Write size must be between 1 and %d bytes\n", MAX_WRITE_SIZE);
+			return 1;
+		}
+	}
+
 	timeout.tv_sec = 10;
 	timeout.tv_usec = 0;
 
-	memset(buff, 0, sizeof(buff));
+	memset(buff, 0xa5, sizeof(buff));
 	memset(&srv_addr, 0, sizeof(srv_addr));
 
 	s = socket(AF_INET, SOCK_STREAM, 0);
@@ -119,7 +140,11 @@ int main(int argc, char **argv) {
 	} while (rtt_ms * kB_increment < max_rtt_ms && (current_kB *= kB_increment) <= max_kB);
 
 	if (rtt_ms * kB_increment > max_rtt_ms)
-		printf("Aborted as next burst estimated rtt(%Lf ms) exeeded the max rtt of %Lf ms \n", rtt_ms, max_rtt_ms);
+		printf("Aborted as next burst estimated rtt(%f ms) exeeded the max rtt of %f ms \n", rtt_ms, max_rtt_ms);
+
+	if (total_ms > 0)
+		printf("\nTotal: %llu bytes in %f ms (%d-byte writes): %f Mbit/s\n", total_bytes, total_ms, write_size,
+		       (total_bytes * 8.0 / 1000000.0) / (total_ms / 1000.0));
 
 	close(s);
 
@@ -32,11 +32,28 @@
 #include <netinet/ip_icmp.h>
 #include <arpa/inet.h>
 
+#define BUFFER_SIZE	16384
+
+static char buff[BUFFER_SIZE];
+
+static double elapsed_s(struct timeval *start, struct timeval *end) {
+	return (end->tv_sec - start->tv_sec) + (end->tv_usec - start->tv_usec) / 1000000.0;
+}
+
+/*
+ * Throughput in Mbit/s
+ */
+static double mbps(unsigned long long bytes, double s) {
+	return (s > 0) ? (bytes * 8.0) / (s * 1000000.0) : 0;
+}
+
 int main(int argc, char **argv) {
 
 	int s, connfd, read_len;
 	struct sockaddr_in srv_addr, client_addr;
-	char buff[1024];
+	struct timeval start, last, now;
+	unsigned long long total, interval;
+	double s_total, s_interval;
 
 	memset(buff, 0, sizeof(buff));
 	memset(&client_addr, 0, sizeof(client_addr));
@@ -77,10 +94,29 @@ int main(int argc, char **argv) {
 		snprintf(buff, sizeof(buff), "Hello world %d\n", s);
 		write(connfd, buff, strlen(buff));
 
+		total = interval = 0;
+		gettimeofday(&start, NULL);
+		last = start;
+
 		while ((read_len = read(connfd, buff, sizeof(buff))) > 0) {
-			printf("Read %d bytes\n", read_len);
+			total += read_len;
+			interval += read_len;
+
+			/* Report the throughput every second */
+			gettimeofday(&now, NULL);
+			s_interval = elapsed_s(&last, &now);
+			if (s_interval >= 1.0) {
+				printf("%.1f s: %llu bytes, %.2f Mbit/s\n", elapsed_s(&start, &now), interval, mbps(interval, s_interval));
+				interval = 0;
+				last = now;
+			}
 		}
 
+		gettimeofday(&now, NULL);
+		s_total = elapsed_s(&start, &now);
+
+		printf("Received %llu bytes in %.3f s: %.2f Mbit/s\n", total, s_total, mbps(total, s_total));
+
 		if (read_len < 0) {
 			printf("Impossible to read the message \n");
 			goto end_client;
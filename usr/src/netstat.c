@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Display the lwIP statistics (CONFIG_LWIP_STATS): protocol counters and
+ * the usage of the heap and memory pools, to size them from actual data.
+ *
+ * Usage: netstat [-p]     -p only displays the memory pools
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <arpa/inet.h>
+
+/* Must match so3/include/net.h */
+#define SIOCGNETSTATS	0x89f0
+
+#define NET_STATS_MAX_POOLS	32
+
+struct net_stats_proto {
+	uint32_t xmit;
+	uint32_t recv;
+	uint32_t drop;
+	uint32_t chkerr;
+	uint32_t lenerr;
+	uint32_t memerr;
+	uint32_t rterr;
+	uint32_t proterr;
+	uint32_t err;
+};
+
+struct net_stats_mem {
+	char name[16];
+	uint32_t avail;
+	uint32_t used;
+	uint32_t max;
+	uint32_t err;
+};
+
+struct net_stats {
+	struct net_stats_proto link;
+	struct net_stats_proto etharp;
+	struct net_stats_proto ip;
+	struct net_stats_proto icmp;
+	struct net_stats_proto udp;
+	struct net_stats_proto tcp;
+
+	struct net_stats_mem heap;
+
+	uint32_t nr_pools;
+	struct net_stats_mem pools[NET_STATS_MAX_POOLS];
+};
+
+static struct net_stats stats;
+
+static void print_proto(const char *name, struct net_stats_proto *p)
+{
+	printf("%-7s %10u %10u %8u %8u %8u %8u %8u %8u %8u\n", name, p->xmit, p->recv, p->drop, p->chkerr,
+	       p->lenerr, p->memerr, p->rterr, p->proterr, p->err);
+}
+
+static void print_mem(struct net_stats_mem *m)
+{
+	/* A pool which has been exhausted (err) or is close to it (max) should be enlarged */
+	printf("%-16s %8u %8u %8u %8u%s\n", m->name, m->avail, m->used, m->max, m->err,
+	       (m->err ? "  <- exhausted" : ""));
+}
+
+int main(int argc, char **argv)
+{
+	int fd, i;
+	int pools_only = ((argc > 1) && !strcmp(argv[1], "-p"));
+
+	fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		printf("netstat: cannot create a socket\n");
+		return 1;
+	}
+
+	if (ioctl(fd, SIOCGNETSTATS, &stats) < 0) {
+		printf("netstat: no statistics (CONFIG_LWIP_STATS disabled?)\n");
+		close(fd);
+		return 1;
+	}
+
+	close(fd);
+
+	if (!pools_only) {
+		printf("%-7s %10s %10s %8s %8s %8s %8s %8s %8s %8s\n", "proto", "xmit", "recv", "drop", "chkerr",
+		       "lenerr", "memerr", "rterr", "proterr", "err");
+
+		print_proto("link", &stats.link);
+		print_proto("etharp", &stats.etharp);
+		print_proto("ip", &stats.ip);
+		print_proto("icmp", &stats.icmp);
+		print_proto("udp", &stats.udp);
+		print_proto("tcp", &stats.tcp);
+
+		printf("\n");
+	}
+
+	printf("%-16s %8s %8s %8s %8s\n", "pool", "avail", "used", "max", "err");
+
+	print_mem(&stats.heap);
+
+	for (i = 0; i < stats.nr_pools; i++)
+		print_mem(&stats.pools[i]);
+
+	return 0;
+}
@@ -0,0 +1,418 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Control the PMU sampling profiler (CONFIG_ARMV8_PMU_PROFILER) and display a flat profile.
+ *
+ * Usage: prof start [period] [event]   sample every <period> cycles (or PMU events <event>)
+ *        prof stop
+ *        prof report [-k kernel.elf] [-u app.elf] [-p pid] [-n lines]
+ *
+ * The report reads the samples and symbolizes the kernel addresses with the symbol
+ * table of the kernel ELF image (-k), and the user addresses with the one of the
+ * application (-u), optionally restricted to the process <pid>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+
+/* Must match so3/include/profile.h */
+#define PROFILE_SAMPLE_USER	(1 << 0)
+
+struct profile_sample {
+	uint64_t pc;
+	uint64_t lr;
+	uint32_t tid;
+	uint32_t pid;
+	uint16_t cpu;
+	uint16_t flags;
+	uint32_t reserved;
+};
+
+#define PROFILE_IOCTL_START	0
+#define PROFILE_IOCTL_STOP	1
+#define PROFILE_IOCTL_RESET	2
+#define PROFILE_IOCTL_EVENT	3
+#define PROFILE_IOCTL_LOST	4
+
+#define PROFILE_EVENT_CYCLES	(-1)
+
+/* ELF64 definitions needed to read a symbol table */
+typedef struct {
+	unsigned char e_ident[16];
+	uint16_t e_type;
+	uint16_t e_machine;
+	uint32_t e_version;
+	uint64_t e_entry;
+	uint64_t e_phoff;
+	uint64_t e_shoff;
+	uint32_t e_flags;
+	uint16_t e_ehsize;
+	uint16_t e_phentsize;
+	uint16_t e_phnum;
+	uint16_t e_shentsize;
+	uint16_t e_shnum;
+	uint16_t e_shstrndx;
+} elf64_ehdr_t;
+
+typedef struct {
+	uint32_t sh_name;
+	uint32_t sh_type;
+	uint64_t sh_flags;
+	uint64_t sh_addr;
+	uint64_t sh_offset;
+	uint64_t sh_size;
+	uint32_t sh_link;
+	uint32_t sh_info;
+	uint64_t sh_addralign;
+	uint64_t sh_entsize;
+} elf64_shdr_t;
+
+typedef struct {
+	uint32_t st_name;
+	unsigned char st_info;
+	unsigned char st_other;
+	uint16_t st_shndx;
+	uint64_t st_value;
+	uint64_t st_size;
+} elf64_sym_t;
+
+#define SHT_SYMTAB	2
+#define STT_NOTYPE	0
+#define STT_FUNC	2
+
+struct symbol {
+	uint64_t addr;
+	uint64_t size;
+	const char *name;
+	unsigned int count;
+};
+
+struct symtab {
+	struct symbol *syms;
+	int nr;
+	char *strtab;
+
+	/* Samples which could not be symbolized */
+	unsigned int unknown;
+};
+
+static struct symtab ksyms, usyms;
+
+static struct profile_sample *samples;
+static int nr_samples;
+
+static int read_at(int fd, void *buf, size_t len, off_t off)
+{
+	if (lseek(fd, off, SEEK_SET) != off)
+		return -1;
+
+	return ((read(fd, buf, len) == len) ? 0 : -1);
+}
+
+static int cmp_addr(const void *a, const void *b)
+{
+	const struct symbol *sa = a, *sb = b;
+
+	return ((sa->addr < sb->addr) ? -1 : (sa->addr > sb->addr));
+}
+
+/*
+ * Load the function symbols of an ELF64 file.
+ */
+static int load_symtab(const char *path, struct symtab *tab)
+{
+	elf64_ehdr_t ehdr;
+	elf64_shdr_t *shdr = NULL, *sym_sh, *str_sh;
+	elf64_sym_t *elf_syms = NULL;
+	int fd, i, n, type;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		printf("prof: cannot open %s\n", path);
+		return -1;
+	}
+
+	if (read_at(fd, &ehdr, sizeof(ehdr), 0) || memcmp(ehdr.e_ident, "\177ELF", 4) || (ehdr.e_ident[4] != 2))
+		goto bad;
+
+	shdr = malloc(ehdr.e_shnum * sizeof(elf64_shdr_t));
+	if (!shdr)
+		goto bad;
+
+	for (i = 0; i < ehdr.e_shnum; i++)
+		if (read_at(fd, &shdr[i], sizeof(elf64_shdr_t), ehdr.e_shoff + i * ehdr.e_shentsize))
+			goto bad;
+
+	for (i = 0; (i < ehdr.e_shnum) && (shdr[i].sh_type != SHT_SYMTAB); i++) ;
+	if (i == ehdr.e_shnum)
+		goto bad;
+
+	sym_sh = &shdr[i];
+	str_sh = &shdr[sym_sh->sh_link];
+
+	elf_syms = malloc(sym_sh->sh_size);
+	tab->strtab = malloc(str_sh->sh_size);
+	if (!elf_syms || !tab->strtab)
+		goto bad;
+
+	if (read_at(fd, elf_syms, sym_sh->sh_size, sym_sh->sh_offset) ||
+	    read_at(fd, tab->strtab, str_sh->sh_size, str_sh->sh_offset))
+		goto bad;
+
+	n = sym_sh->sh_size / sizeof(elf64_sym_t);
+	tab->syms = calloc(n, sizeof(struct symbol));
+	if (!tab->syms)
+		goto bad;
+
+	for (i = 0; i < n; i++) {
+		type = elf_syms[i].st_info & 0xf;
+
+		/* Functions, and labels of assembly code (but not the $x/$d mapping symbols) */
+		if (!elf_syms[i].st_value || !elf_syms[i].st_shndx || !elf_syms[i].st_name)
+			continue;
+		if ((type != STT_FUNC) && ((type != STT_NOTYPE) || (tab->strtab[elf_syms[i].st_name] == '$')))
+			continue;
+
+		tab->syms[tab->nr].addr = elf_syms[i].st_value;
+		tab->syms[tab->nr].size = elf_syms[i].st_size;
+		tab->syms[tab->nr].name = tab->strtab + elf_syms[i].st_name;
+		tab->nr++;
+	}
+
+	qsort(tab->syms, tab->nr, sizeof(struct symbol), cmp_addr);
+
+	free(elf_syms);
+	free(shdr);
+	close(fd);
+
+	return 0;
+
+bad:
+	printf("prof: cannot read the symbol table of %s\n", path);
+
+	free(elf_syms);
+	free(shdr);
+	close(fd);
+
+	return -1;
+}
+
+/*
+ * Symbol containing <addr>, or NULL.
+ */
+static struct symbol *lookup(struct symtab *tab, uint64_t addr)
+{
+	int lo = 0, hi = tab->nr - 1, mid;
+	struct symbol *s;
+
+	if (!tab->nr || (addr < tab->syms[0].addr))
+		return NULL;
+
+	while (lo < hi) {
+		mid = (lo + hi + 1) / 2;
+		if (tab->syms[mid].addr <= addr)
+			lo = mid;
+		else
+			hi = mid - 1;
+	}
+
+	s = &tab->syms[lo];
+
+	if (s->size && (addr >= s->addr + s->size))
+		return NULL;
+
+	return s;
+}
+
+static int read_samples(int fd)
+{
+	int len, cap = 0;
+
+	while (1) {
+		if (nr_samples + 256 > cap) {
+			cap += 4096;
+			samples = realloc(samples, cap * sizeof(struct profile_sample));
+			if (!samples)
+				return -1;
+		}
+
+		len = read(fd, &samples[nr_samples], 256 * sizeof(struct profile_sample));
+		if (len <= 0)
+			break;
+
+		nr_samples += len / sizeof(struct profile_sample);
+	}
+
+	return 0;
+}
+
+struct entry {
+	struct symbol *sym;
+	char kind;
+};
+
+static int cmp_count(const void *a, const void *b)
+{
+	const struct entry *ea = a, *eb = b;
+
+	return (int) eb->sym->count - (int) ea->sym->count;
+}
+
+static void report(int lines, int pid)
+{
+	struct profile_sample *s;
+	struct symbol *sym;
+	struct entry *entries;
+	int i, n = 0, total = 0;
+
+	for (i = 0; i < nr_samples; i++) {
+		s = &samples[i];
+
+		if (s->flags & PROFILE_SAMPLE_USER) {
+			if ((pid >= 0) && (s->pid != pid))
+				continue;
+
+			sym = lookup(&usyms, s->pc);
+			if (sym)
+				sym->count++;
+			else
+				usyms.unknown++;
+		} else {
+			sym = lookup(&ksyms, s->pc);
+			if (sym)
+				sym->count++;
+			else
+				ksyms.unknown++;
+		}
+		total++;
+	}
+
+	printf("%d samples\n\n", total);
+	if (!total)
+		return;
+
+	entries = malloc((ksyms.nr + usyms.nr + 1) * sizeof(struct entry));
+	if (!entries)
+		return;
+
+	for (i = 0; i < ksyms.nr; i++)
+		if (ksyms.syms[i].count) {
+			entries[n].sym = &ksyms.syms[i];
+			entries[n++].kind = 'k';
+		}
+
+	for (i = 0; i < usyms.nr; i++)
+		if (usyms.syms[i].count) {
+			entries[n].sym = &usyms.syms[i];
+			entries[n++].kind = 'u';
+		}
+
+	qsort(entries, n, sizeof(struct entry), cmp_count);
+
+	printf("      %%   samples  symbol\n");
+
+	for (i = 0; (i < n) && (i < lines); i++)
+		printf("%6.2f%% %9u  [%c] %s\n", entries[i].sym->count * 100.0 / total, entries[i].sym->count,
+		       entries[i].kind, entries[i].sym->name);
+
+	if (ksyms.unknown)
+		printf("%6.2f%% %9u  [k] ?\n", ksyms.unknown * 100.0 / total, ksyms.unknown);
+	if (usyms.unknown)
+		printf("%6.2f%% %9u  [u] ?\n", usyms.unknown * 100.0 / total, usyms.unknown);
+
+	free(entries);
+}
+
+static void usage(void)
+{
+	printf("Usage: prof start [period] [event]\n");
+	printf("       prof stop\n");
+	printf("       prof report [-k kernel.elf] [-u app.elf] [-p pid] [-n lines]\n");
+}
+
+int main(int argc, char **argv)
+{
+	int fd, i, pid = -1, lines = 30, ret = 0;
+	unsigned long period;
+
+	if (argc < 2) {
+		usage();
+		return 1;
+	}
+
+	fd = open("/dev/profile", O_RDWR);
+	if (fd < 0) {
+		printf("prof: cannot open /dev/profile\n");
+		return 1;
+	}
+
+	if (!strcmp(argv[1], "start")) {
+		period = ((argc > 2) ? strtoul(argv[2], NULL, 0) : 0);
+
+		if (ioctl(fd, PROFILE_IOCTL_EVENT, ((argc > 3) ? strtoul(argv[3], NULL, 0) : PROFILE_EVENT_CYCLES)) < 0) {
+			printf("prof: the PMU has no event counter\n");
+			ret = 1;
+			goto out;
+		}
+
+		ioctl(fd, PROFILE_IOCTL_RESET, 0);
+		ioctl(fd, PROFILE_IOCTL_START, period);
+
+	} else if (!strcmp(argv[1], "stop")) {
+		ioctl(fd, PROFILE_IOCTL_STOP, 0);
+
+	} else if (!strcmp(argv[1], "report")) {
+		for (i = 2; i < argc - 1; i += 2) {
+			if (!strcmp(argv[i], "-k"))
+				load_symtab(argv[i + 1], &ksyms);
+			else if (!strcmp(argv[i], "-u"))
+				load_symtab(argv[i + 1], &usyms);
+			else if (!strcmp(argv[i], "-p"))
+				pid = atoi(argv[i + 1]);
+			else if (!strcmp(argv[i], "-n"))
+				lines = atoi(argv[i + 1]);
+		}
+
+		ioctl(fd, PROFILE_IOCTL_STOP, 0);
+
+		if (read_samples(fd)) {
+			printf("prof: out of memory\n");
+			ret = 1;
+			goto out;
+		}
+
+		printf("%d samples lost\n", ioctl(fd, PROFILE_IOCTL_LOST, 0));
+
+		report(lines, pid);
+	} else {
+		usage();
+		ret = 1;
+	}
+
+out:
+	close(fd);
+
+	return ret;
+}
@@ -134,6 +134,11 @@ void process_cmd(void) {
 		return ;
 	}
 
+	if (!strcmp(tokens[0], "dumpsoftirq")) {
+		sys_info(5, 0);
+		return ;
+	}
+
 	if (!strcmp(tokens[0], "exit")) {
 		if (getpid() == 1) {
 			printf("The shell root process can not be terminated...\n");
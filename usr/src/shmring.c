@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Exchange data between two processes through a ring buffer in shared memory.
+ * The producer (child) and the consumer (parent) map the same shm_open() object.
+ *
+ * Usage: shmring [count]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#define SHM_NAME	"/shmring"
+#define RING_SLOTS	1024
+#define DEFAULT_COUNT	1000000
+
+struct ring {
+	volatile uint32_t head;		/* Written by the producer */
+	volatile uint32_t tail;		/* Written by the consumer */
+	uint32_t slots[RING_SLOTS];
+};
+
+static unsigned long long now_us(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+
+	return (unsigned long long) tv.tv_sec * 1000000ull + tv.tv_usec;
+}
+
+static void producer(struct ring *ring, uint32_t count)
+{
+	uint32_t i, head;
+
+	for (i = 0; i < count; i++) {
+		head = ring->head;
+
+		while (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) == RING_SLOTS)
+			pthread_yield();
+
+		ring->slots[head % RING_SLOTS] = i;
+		__atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+	}
+}
+
+static int consumer(struct ring *ring, uint32_t count)
+{
+	uint32_t i, tail;
+
+	for (i = 0; i < count; i++) {
+		tail = ring->tail;
+
+		while (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == tail)
+			pthread_yield();
+
+		if (ring->slots[tail % RING_SLOTS] != i) {
+			printf("shmring: got %u instead of %u\n", ring->slots[tail % RING_SLOTS], i);
+			return -1;
+		}
+
+		__atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	uint32_t count = DEFAULT_COUNT;
+	unsigned long long start, elapsed;
+	struct ring *ring;
+	int fd, ret;
+	pid_t pid;
+
+	if (argc > 1)
+		count = atoi(argv[1]);
+
+	fd = shm_open(SHM_NAME, O_CREAT | O_EXCL | O_RDWR, 0600);
+	if (fd < 0) {
+		printf("shmring: shm_open failed\n");
+		return 1;
+	}
+
+	/* The name is not needed anymore, the object lives as long as it is mapped */
+	shm_unlink(SHM_NAME);
+
+	if (ftruncate(fd, sizeof(struct ring)) < 0) {
+		printf("shmring: ftruncate failed\n");
+		return 1;
+	}
+
+	ring = mmap(NULL, sizeof(struct ring), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ring == MAP_FAILED) {
+		printf("shmring: mmap failed\n");
+		return 1;
+	}
+
+	close(fd);
+
+	start = now_us();
+
+	pid = fork();
+	if (!pid) {
+		producer(ring, count);
+		exit(0);
+	}
+
+	ret = consumer(ring, count);
+
+	waitpid(pid, NULL, 0);
+
+	elapsed = now_us() - start;
+
+	if (!ret)
+		printf("shmring: %u words in %llu us (%llu ns/word)\n", count, elapsed,
+		       (elapsed * 1000ull) / (count ? count : 1));
+
+	munmap(ring, sizeof(struct ring));
+
+	return (ret ? 1 : 0);
+}
@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Display the per-syscall statistics of the kernel (CONFIG_SYSCALL_STATS).
+ *
+ * Usage: sstat [-r] [-h]
+ *   -r  reset the counters
+ *   -h  display the latency histograms
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <syscall.h>
+
+#include <sys/ioctl.h>
+
+/* Must match so3/include/sysstat.h */
+#define SYSSTAT_HIST_BUCKETS	16
+#define SYSSTAT_IOCTL_RESET	0
+
+struct sysstat_entry {
+	uint32_t nr;
+	uint32_t count;
+	uint64_t total_ns;
+	uint64_t max_ns;
+	uint32_t hist[SYSSTAT_HIST_BUCKETS];
+};
+
+/* Indexed by the syscall codes shared with the kernel */
+static const char *syscall_names[] = {
+	[syscallExit] = "exit",
+	[syscallExecve] = "execve",
+	[syscallWaitpid] = "waitpid",
+	[syscallRead] = "read",
+	[syscallWrite] = "write",
+	[syscallPause] = "pause",
+	[syscallFork] = "fork",
+	[syscallPtrace] = "ptrace",
+	[syscallReaddir] = "readdir",
+	[syscallChdir] = "chdir",
+	[syscallGetcwd] = "getcwd",
+	[syscallCreate] = "create",
+	[syscallUnlink] = "unlink",
+	[syscallOpen] = "open",
+	[syscallClose] = "close",
+	[syscallThreadCreate] = "thread_create",
+	[syscallThreadJoin] = "thread_join",
+	[syscallThreadExit] = "thread_exit",
+	[syscallPipe] = "pipe",
+	[syscallIoctl] = "ioctl",
+	[syscallFcntl] = "fcntl",
+	[syscallDup] = "dup",
+	[syscallDup2] = "dup2",
+	[syscallSchedSetParam] = "sched_setparam",
+	[syscallSocket] = "socket",
+	[syscallBind] = "bind",
+	[syscallListen] = "listen",
+	[syscallAccept] = "accept",
+	[syscallConnect] = "connect",
+	[syscallRecv] = "recv",
+	[syscallSend] = "send",
+	[syscallSendTo] = "sendto",
+	[syscallStat] = "stat",
+	[syscallMmap] = "mmap",
+	[syscallEndProc] = "endproc",
+	[syscallGetpid] = "getpid",
+	[syscallGetTimeOfDay] = "gettimeofday",
+	[syscallSetTimeOfDay] = "settimeofday",
+	[syscallClockGetTime] = "clock_gettime",
+	[syscallMunmap] = "munmap",
+	[syscallMprotect] = "mprotect",
+	[syscallThreadYield] = "thread_yield",
+	[syscallSbrk] = "sbrk",
+	[syscallSigaction] = "sigaction",
+	[syscallKill] = "kill",
+	[syscallSigreturn] = "sigreturn",
+	[syscallLseek] = "lseek",
+	[syscallReadv] = "readv",
+	[syscallWritev] = "writev",
+	[syscallSendfile] = "sendfile",
+	[syscallSplice] = "splice",
+	[syscallShmOpen] = "shm_open",
+	[syscallShmUnlink] = "shm_unlink",
+	[syscallFtruncate] = "ftruncate",
+	[syscallMutexLock] = "mutex_lock",
+	[syscallMutexUnlock] = "mutex_unlock",
+	[syscallPs] = "ps",
+	[syscallNanosleep] = "nanosleep",
+	[syscallSysinfo] = "sysinfo",
+	[syscallSetsockopt] = "setsockopt",
+	[syscallRecvfrom] = "recvfrom",
+	[syscallSendmmsg] = "sendmmsg",
+	[syscallRecvmmsg] = "recvmmsg",
+};
+
+#define NR_SYSCALL_NAMES	(sizeof(syscall_names) / sizeof(syscall_names[0]))
+
+/* Records read from /dev/sysstat at once */
+#define SSTAT_CHUNK		32
+
+/* Sort by decreasing total time */
+static int cmp_total(const void *a, const void *b)
+{
+	const struct sysstat_entry *ea = a, *eb = b;
+
+	if (ea->total_ns == eb->total_ns)
+		return 0;
+
+	return ((ea->total_ns < eb->total_ns) ? 1 : -1);
+}
+
+static void print_hist(struct sysstat_entry *e)
+{
+	int i;
+
+	for (i = 0; i < SYSSTAT_HIST_BUCKETS; i++) {
+		if (!e->hist[i])
+			continue;
+
+		if (i == 0)
+			printf("      <1 us        %10u\n", e->hist[i]);
+		else if (i == SYSSTAT_HIST_BUCKETS - 1)
+			printf("      >=%-6u us   %10u\n", 1u << (i - 1), e->hist[i]);
+		else
+			printf("      %6u-%-6u %10u\n", 1u << (i - 1), 1u << i, e->hist[i]);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	struct sysstat_entry *stats = NULL;
+	char unknown[16];
+	const char *name;
+	int fd, n, i, j, ret;
+	int show_hist = 0;
+	uint32_t returned;
+	uint64_t total = 0;
+
+	fd = open("/dev/sysstat", O_RDWR);
+	if (fd < 0) {
+		printf("sstat: cannot open /dev/sysstat (CONFIG_SYSCALL_STATS disabled?)\n");
+		return 1;
+	}
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-r")) {
+			ioctl(fd, SYSSTAT_IOCTL_RESET, 0);
+			close(fd);
+			return 0;
+		}
+		if (!strcmp(argv[i], "-h"))
+			show_hist = 1;
+	}
+
+	/* The kernel may know more syscalls than this table: read until the end */
+	n = 0;
+	for (;;) {
+		stats = realloc(stats, (n + SSTAT_CHUNK) * sizeof(struct sysstat_entry));
+		if (!stats) {
+			printf("sstat: out of memory\n");
+			close(fd);
+			return 1;
+		}
+
+		ret = read(fd, &stats[n], SSTAT_CHUNK * sizeof(struct sysstat_entry));
+		if (ret <= 0)
+			break;
+
+		n += ret / sizeof(struct sysstat_entry);
+	}
+	close(fd);
+
+	if (ret < 0) {
+		printf("sstat: cannot read /dev/sysstat\n");
+		return 1;
+	}
+
+	qsort(stats, n, sizeof(struct sysstat_entry), cmp_total);
+
+	for (i = 0; i < n; i++)
+		total += stats[i].total_ns;
+
+	printf("%-16s %10s %12s %10s %10s %6s\n", "syscall", "calls", "total(us)", "avg(ns)", "max(ns)", "%time");
+
+	for (i = 0; i < n; i++) {
+		struct sysstat_entry *e = &stats[i];
+
+		/* Calls which did not return (exit, ...) are not in the histogram */
+		for (j = 0, returned = 0; j < SYSSTAT_HIST_BUCKETS; j++)
+			returned += e->hist[j];
+
+		/* A syscall missing from the table is shown by its number */
+		if ((e->nr < NR_SYSCALL_NAMES) && syscall_names[e->nr]) {
+			name = syscall_names[e->nr];
+		} else {
+			snprintf(unknown, sizeof(unknown), "#%u", e->nr);
+			name = unknown;
+		}
+
+		printf("%-16s %10u %12llu %10llu %10llu %5llu%%\n", name,
+		       e->count, (unsigned long long) (e->total_ns / 1000),
+		       (unsigned long long) (returned ? e->total_ns / returned : 0),
+		       (unsigned long long) e->max_ns,
+		       (unsigned long long) (total ? (e->total_ns * 100) / total : 0));
+
+		if (show_hist)
+			print_hist(e);
+	}
+
+	free(stats);
+
+	return 0;
+}
@@ -0,0 +1,158 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Control the kernel tracepoints (CONFIG_TRACE) and dump the recorded events.
+ *
+ * Usage: tracedump -e [mask]   start tracing the events of mask (all by default)
+ *        tracedump -s          stop tracing
+ *        tracedump -r          discard the recorded events
+ *        tracedump [-o file]   stop tracing and dump the events, as text or
+ *                              in a binary file for scripts/trace2json.py
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/ioctl.h>
+
+/* Must match so3/include/trace.h */
+#define TRACE_IOCTL_ENABLE	0
+#define TRACE_IOCTL_RESET	1
+#define TRACE_IOCTL_FREQ	2
+
+struct trace_record {
+	uint64_t ts;
+	uint16_t event;
+	uint16_t cpu;
+	uint32_t a0;
+	uint64_t a1;
+};
+
+static const char *event_names[] = {
+	"sched_switch", "irq_entry", "irq_exit", "softirq_entry", "softirq_exit",
+	"syscall_entry", "syscall_exit", "timer_expire", "page_alloc", "page_free",
+	"evtchn_send",
+};
+
+#define NR_EVENTS	(sizeof(event_names) / sizeof(event_names[0]))
+
+/* Header of the binary dump file */
+struct trace_file_header {
+	char magic[8];		/* "SO3TRACE" */
+	uint32_t version;
+	uint32_t freq;		/* Frequency of the timestamps (Hz) */
+	uint32_t record_size;
+	uint32_t reserved;
+};
+
+static struct trace_record recs[256];
+
+static void usage(void)
+{
+	printf("Usage: tracedump -e [mask] | -s | -r | [-o file]\n");
+}
+
+int main(int argc, char **argv)
+{
+	struct trace_file_header hdr;
+	struct trace_record *r;
+	unsigned long mask;
+	uint32_t freq;
+	int fd, out = -1, len, i;
+
+	fd = open("/dev/trace", O_RDWR);
+	if (fd < 0) {
+		printf("tracedump: cannot open /dev/trace\n");
+		return 1;
+	}
+
+	if ((argc > 1) && !strcmp(argv[1], "-e")) {
+		mask = ((argc > 2) ? strtoul(argv[2], NULL, 0) : (1UL << NR_EVENTS) - 1);
+
+		ioctl(fd, TRACE_IOCTL_ENABLE, mask);
+		goto out;
+	}
+
+	if ((argc > 1) && !strcmp(argv[1], "-s")) {
+		ioctl(fd, TRACE_IOCTL_ENABLE, 0);
+		goto out;
+	}
+
+	if ((argc > 1) && !strcmp(argv[1], "-r")) {
+		ioctl(fd, TRACE_IOCTL_RESET, 0);
+		goto out;
+	}
+
+	if (argc > 1) {
+		if (strcmp(argv[1], "-o") || (argc < 3)) {
+			usage();
+			close(fd);
+			return 1;
+		}
+
+		out = open(argv[2], O_WRONLY | O_CREAT | O_TRUNC);
+		if (out < 0) {
+			printf("tracedump: cannot create %s\n", argv[2]);
+			close(fd);
+			return 1;
+		}
+	}
+
+	/* The buffers must not be written while being read */
+	ioctl(fd, TRACE_IOCTL_ENABLE, 0);
+
+	freq = ioctl(fd, TRACE_IOCTL_FREQ, 0);
+
+	if (out >= 0) {
+		memset(&hdr, 0, sizeof(hdr));
+		memcpy(hdr.magic, "SO3TRACE", 8);
+		hdr.version = 1;
+		hdr.freq = freq;
+		hdr.record_size = sizeof(struct trace_record);
+
+		write(out, &hdr, sizeof(hdr));
+	}
+
+	while ((len = read(fd, recs, sizeof(recs))) > 0) {
+		if (out >= 0) {
+			write(out, recs, len);
+			continue;
+		}
+
+		for (i = 0; i < len / sizeof(struct trace_record); i++) {
+			r = &recs[i];
+
+			printf("%llu.%06llu cpu%u %-14s %u 0x%llx\n",
+			       (unsigned long long) (r->ts / freq), (unsigned long long) ((r->ts % freq) * 1000000 / freq),
+			       r->cpu, ((r->event < NR_EVENTS) ? event_names[r->event] : "?"),
+			       r->a0, (unsigned long long) r->a1);
+		}
+	}
+
+	if (out >= 0)
+		close(out);
+out:
+	close(fd);
+
+	return 0;
+}
@@ -0,0 +1,225 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Send a burst of small UDP datagrams and display the packet rate, to compare
+ * sendto(), sendmmsg() and the zero-copy send (CONFIG_NET_ZEROCOPY_TX).
+ *
+ * Usage: udpburst [-b batch] [-z] [-n count] [-s size] <ip> [port]
+ *
+ *   -b   number of datagrams per sendmmsg() (default 1: one sendto() per datagram)
+ *   -z   zero-copy send (MSG_ZEROCOPY); a buffer is reused once its completion
+ *        has been returned by SIOCZCSENDDONE
+ *   -n   number of datagrams (default 100000)
+ *   -s   size of each datagram (default 64)
+ *
+ * The datagrams can be received on the host with e.g. "nc -ul 5001 > /dev/null".
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <arpa/inet.h>
+
+/* Must match so3/include/net.h */
+#define SIOCZCSENDDONE		0x89f4
+
+#define NET_ZC_MAX_SEGS		32
+#define NET_ZC_TX_COPIED	0x80000000
+
+struct net_zc_txdone {
+	uint32_t nr_ids;
+	uint32_t ids[NET_ZC_MAX_SEGS];
+};
+
+/* Kernel limit of a sendmmsg() batch */
+#define MAX_BATCH	1024
+#define MAX_SIZE	1472
+
+/* Buffers of the zero-copy send, fewer than the messages in flight of the kernel */
+#define NR_BUFS		32
+
+static char bufs[NR_BUFS][MAX_SIZE];
+static int busy[NR_BUFS];
+
+static struct mmsghdr msgs[MAX_BATCH];
+static struct iovec iovs[MAX_BATCH];
+
+static unsigned long completed, copied;
+
+static double elapsed_s(struct timeval *start, struct timeval *end) {
+	return (end->tv_sec - start->tv_sec) + (end->tv_usec - start->tv_usec) / 1000000.0;
+}
+
+/*
+ * Release the buffers whose zero-copy send is completed.
+ */
+static int reap(int s) {
+	struct net_zc_txdone done;
+	int i;
+
+	if (ioctl(s, SIOCZCSENDDONE, &done) < 0)
+		return -1;
+
+	for (i = 0; i < done.nr_ids; i++) {
+		if (done.ids[i] & NET_ZC_TX_COPIED)
+			copied++;
+
+		busy[(done.ids[i] & ~NET_ZC_TX_COPIED) % NR_BUFS] = 0;
+		completed++;
+	}
+
+	return done.nr_ids;
+}
+
+/*
+ * Wait for a completion, leaving the CPU to the driver meanwhile.
+ */
+static int reap_wait(int s) {
+	int n;
+
+	while ((n = reap(s)) == 0)
+		usleep(100);
+
+	return n;
+}
+
+int main(int argc, char **argv) {
+	int s, i, ret, zerocopy = 0, batch = 1, size = 64, port = 5001;
+	unsigned long count = 100000, sent = 0, seq = 0;
+	struct sockaddr_in dst;
+	struct timeval start, end;
+	const char *ip = NULL;
+	double secs;
+	int n;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-z"))
+			zerocopy = 1;
+		else if (!strcmp(argv[i], "-b") && (i + 1 < argc))
+			batch = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-n") && (i + 1 < argc))
+			count = strtoul(argv[++i], NULL, 0);
+		else if (!strcmp(argv[i], "-s") && (i + 1 < argc))
+			size = atoi(argv[++i]);
+		else if (!ip)
+			ip = argv[i];
+		else
+			port = atoi(argv[i]);
+	}
+
+	if (!ip || (batch <= 0) || (batch > MAX_BATCH) || (size <= 0) || (size > MAX_SIZE)) {
+		printf("Usage: udpburst [-b batch] [-z] [-n count] [-s size] <ip> [port]\n");
+		printf("  batch within 1..%d, size within 1..%d\n", MAX_BATCH, MAX_SIZE);
+		return 1;
+	}
+
+	/* In zero-copy mode, each message of a batch needs its own buffer */
+	if (zerocopy && (batch > NR_BUFS))
+		batch = NR_BUFS;
+
+	s = socket(AF_INET, SOCK_DGRAM, 0);
+	if (s < 0) {
+		printf("udpburst: cannot create a socket\n");
+		return 1;
+	}
+
+	memset(&dst, 0, sizeof(dst));
+	dst.sin_family = AF_INET;
+	dst.sin_port = htons(port);
+	dst.sin_addr.s_addr = inet_addr(ip);
+
+	for (i = 0; i < NR_BUFS; i++)
+		memset(bufs[i], 'a' + i % 26, MAX_SIZE);
+
+	gettimeofday(&start, NULL);
+
+	while (sent < count) {
+		if ((batch == 1) && !zerocopy) {
+			if (sendto(s, bufs[0], size, 0, (struct sockaddr *) &dst, sizeof(dst)) < 0)
+				break;
+			sent++;
+			continue;
+		}
+
+		n = ((count - sent) < batch) ? (count - sent) : batch;
+
+		for (i = 0; i < n; i++) {
+			/* Zero-copy: message seq + i goes into buffer (seq + i) % NR_BUFS */
+			char *buf = (zerocopy ? bufs[(seq + i) % NR_BUFS] : bufs[0]);
+
+			while (zerocopy && busy[(seq + i) % NR_BUFS])
+				if (reap_wait(s) < 0)
+					goto out;
+
+			iovs[i].iov_base = buf;
+			iovs[i].iov_len = size;
+
+			memset(&msgs[i].msg_hdr, 0, sizeof(struct msghdr));
+			msgs[i].msg_hdr.msg_name = &dst;
+			msgs[i].msg_hdr.msg_namelen = sizeof(dst);
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		ret = sendmmsg(s, msgs, n, (zerocopy ? MSG_ZEROCOPY : 0));
+		if (ret < 0) {
+			/* Too many zero-copy messages in flight */
+			if (zerocopy && (errno == ENOBUFS) && (reap_wait(s) > 0))
+				continue;
+			break;
+		}
+
+		if (zerocopy)
+			for (i = 0; i < ret; i++)
+				busy[(seq + i) % NR_BUFS] = 1;
+
+		seq += ret;
+		sent += ret;
+	}
+
+out:
+	gettimeofday(&end, NULL);
+	secs = elapsed_s(&start, &end);
+
+	if (sent < count)
+		printf("udpburst: send error after %lu datagrams (errno %d)\n", sent, errno);
+
+	printf("Sent %lu datagrams of %d bytes in %.3f s: %.0f packets/s, %.2f Mbit/s\n", sent, size, secs,
+	       (secs > 0) ? sent / secs : 0, (secs > 0) ? (sent * size * 8.0) / (secs * 1000000.0) : 0);
+
+	if (zerocopy) {
+		/* Wait for the last completions before closing */
+		while ((completed < seq) && (reap_wait(s) > 0))
+			;
+		printf("Zero-copy completions: %lu, %lu of them copied\n", completed, copied);
+	}
+
+	close(s);
+
+	return 0;
+}
@@ -157,8 +157,8 @@ int fb_init(void)
 	printf("Resolution: %d x %d\n", scr_hres, scr_vres);
 
 	/* Map the framebuffer into process memory. */
-	fbp = mmap(NULL, fb_size, 0, 0, fd, 0);
-	if (!fbp) {
+	fbp = mmap(NULL, fb_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (fbp == MAP_FAILED) {
 		printf("Couldn't map framebuffer.\n");
 		return -1;
 	}
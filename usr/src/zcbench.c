@@ -0,0 +1,238 @@
+/*
+ * Copyright (C) 2026 Daniel Rossier <daniel.rossier@heig-vd.ch>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ */
+
+/*
+ * Compare the copy and the zero-copy (CONFIG_NET_ZEROCOPY_RX) socket receive.
+ *
+ * Usage: zcbench [-z] [-n] [-p port] [-s size]
+ *
+ *   -z   zero-copy receive: the data is read in the mapping of the receive pool
+ *   -n   do not read the data (by default, it is summed as an application would
+ *        consume it, so that both modes touch each byte once)
+ *   -p   TCP port to listen on (default 5001)
+ *   -s   size of each read() in copy mode (default 16384)
+ *
+ * Each connection is received until the peer closes it, e.g. from a host with
+ * "dd if=/dev/zero bs=64k count=1024 | nc <target> 5001"; the throughput and
+ * the sum of the data are then displayed, and should match between the modes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+
+#include <sys/socket.h>
+#include <sys/ioctl.h>
+#include <arpa/inet.h>
+
+/* Must match so3/include/net.h */
+#define SIOCGZCSIZE	0x89f1
+#define SIOCZCRECV	0x89f2
+#define SIOCZCRECYCLE	0x89f3
+#define SIOCZCENABLE	0x89f5
+
+#define NET_ZC_MAX_SEGS	32
+
+struct net_zc_seg {
+	uint32_t offset;
+	uint32_t len;
+	uint32_t id;
+};
+
+struct net_zc_recv {
+	uint32_t max_segs;
+	uint32_t flags;
+	uint32_t nr_segs;
+	uint32_t len;
+	struct net_zc_seg segs[NET_ZC_MAX_SEGS];
+};
+
+struct net_zc_recycle {
+	uint32_t nr_ids;
+	uint32_t ids[NET_ZC_MAX_SEGS];
+};
+
+#define MAX_READ_SIZE	65536
+
+static char buff[MAX_READ_SIZE];
+
+static int touch = 1;
+
+static double elapsed_s(struct timeval *start, struct timeval *end) {
+	return (end->tv_sec - start->tv_sec) + (end->tv_usec - start->tv_usec) / 1000000.0;
+}
+
+/*
+ * Throughput in Mbit/s
+ */
+static double mbps(unsigned long long bytes, double s) {
+	return (s > 0) ? (bytes * 8.0) / (s * 1000000.0) : 0;
+}
+
+static uint32_t sum(const unsigned char *data, int len, uint32_t acc) {
+	int i;
+
+	if (!touch)
+		return acc;
+
+	for (i = 0; i < len; i++)
+		acc += data[i];
+
+	return acc;
+}
+
+static long long recv_copy(int fd, int size, uint32_t *acc) {
+	long long total = 0;
+	int len;
+
+	while ((len = read(fd, buff, size)) > 0) {
+		*acc = sum((unsigned char *) buff, len, *acc);
+		total += len;
+	}
+
+	return ((len < 0) ? -1 : total);
+}
+
+static long long recv_zerocopy(int fd, const unsigned char *pool, uint32_t *acc) {
+	struct net_zc_recv req;
+	struct net_zc_recycle rec;
+	long long total = 0;
+	int len, i;
+
+	while (1) {
+		req.max_segs = NET_ZC_MAX_SEGS;
+		req.flags = 0;
+
+		len = ioctl(fd, SIOCZCRECV, &req);
+		if (len <= 0)
+			break;
+
+		for (i = 0; i < req.nr_segs; i++) {
+			*acc = sum(pool + req.segs[i].offset, req.segs[i].len, *acc);
+			rec.ids[i] = req.segs[i].id;
+		}
+
+		/* The buffers go back to the pool for the next frames */
+		rec.nr_ids = req.nr_segs;
+		ioctl(fd, SIOCZCRECYCLE, &rec);
+
+		total += len;
+	}
+
+	return ((len < 0) ? -1 : total);
+}
+
+int main(int argc, char **argv) {
+	int s, fd, i, zerocopy = 0, port = 5001, size = 16384;
+	struct sockaddr_in srv_addr;
+	struct timeval start, end;
+	unsigned char *pool = NULL;
+	uint32_t pool_size, acc;
+	long long total;
+	double secs;
+
+	for (i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-z"))
+			zerocopy = 1;
+		else if (!strcmp(argv[i], "-n"))
+			touch = 0;
+		else if (!strcmp(argv[i], "-p") && (i + 1 < argc))
+			port = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-s") && (i + 1 < argc))
+			size = atoi(argv[++i]);
+		else {
+			printf("Usage: zcbench [-z] [-n] [-p port] [-s size]\n");
+			return 1;
+		}
+	}
+
+	if ((size <= 0) || (size > MAX_READ_SIZE)) {
+		printf("zcbench: the read size must be within 1..%d\n", MAX_READ_SIZE);
+		return 1;
+	}
+
+	s = socket(AF_INET, SOCK_STREAM, 0);
+	if (s < 0) {
+		printf("zcbench: cannot create a socket\n");
+		return 1;
+	}
+
+	memset(&srv_addr, 0, sizeof(srv_addr));
+	srv_addr.sin_family = AF_INET;
+	srv_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	srv_addr.sin_port = htons(port);
+
+	if ((bind(s, (struct sockaddr *) &srv_addr, sizeof(srv_addr)) < 0) || (listen(s, 1) < 0)) {
+		printf("zcbench: cannot listen on port %d\n", port);
+		return 1;
+	}
+
+	if (zerocopy) {
+		/* The accepted sockets inherit the zero-copy receive */
+		if ((ioctl(s, SIOCZCENABLE, 0) < 0) || (ioctl(s, SIOCGZCSIZE, &pool_size) < 0)) {
+			printf("zcbench: no zero-copy receive (CONFIG_NET_ZEROCOPY_RX disabled?)\n");
+			return 1;
+		}
+
+		/* The window of the process serves all its sockets */
+		pool = mmap(NULL, pool_size, PROT_READ, MAP_SHARED, s, 0);
+		if (pool == MAP_FAILED) {
+			printf("zcbench: cannot map the receive pool\n");
+			return 1;
+		}
+	}
+
+	while (1) {
+		printf("\n%s receive, waiting on port %d...\n", (zerocopy ? "Zero-copy" : "Copy"), port);
+
+		fd = accept(s, NULL, NULL);
+		if (fd < 0) {
+			printf("zcbench: error on accept\n");
+			continue;
+		}
+
+		acc = 0;
+		gettimeofday(&start, NULL);
+
+		if (zerocopy)
+			total = recv_zerocopy(fd, pool, &acc);
+		else
+			total = recv_copy(fd, size, &acc);
+
+		gettimeofday(&end, NULL);
+		secs = elapsed_s(&start, &end);
+
+		close(fd);
+
+		if (total < 0) {
+			printf("zcbench: receive error\n");
+			continue;
+		}
+
+		printf("Received %lld bytes in %.3f s: %.2f Mbit/s", total, secs, mbps(total, secs));
+		if (touch)
+			printf(", sum 0x%08x", acc);
+		printf("\n");
+	}
+
+	return 0;
+}